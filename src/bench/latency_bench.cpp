@@ -0,0 +1,330 @@
+// Forward latency of switch: a publisher and a subscriber endpoint on one host, the publisher
+// sends PUBLISH_2 to the subscriber at a fixed rate with its send time in the content, the
+// subscriber reports the distribution of (receive time - send time). Both sides run on plain
+// blocking sockets with TCP_NODELAY, so the numbers are the switch's, not of an event loop.
+// See run_latency.sh for the comparison of the busy polling mode with the default.
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "argparse/argparse.hpp"
+#include "switch_message.h"
+#include "command_messages.h"
+#include "endpoint_role.h"
+
+using std::string;
+using std::vector;
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    string   host = "127.0.0.1";
+    uint16_t port = 10000;
+    string   access_code;
+    uint32_t count = 100000;        // measured publishes
+    uint32_t warmup = 10000;        // publishes not measured, before count
+    uint32_t size = 64;             // content bytes, at least the timestamp
+    uint32_t rate = 10000;          // publishes per second
+    ep_id_t  id_base = 0;           // the publisher is id_base, the subscriber id_base + 1
+    bool     is_spinning = false;   // the subscriber spins on recv instead of blocking
+};
+
+static int64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static int Connect(const BenchOptions& options)
+{
+    struct addrinfo hints, *addrs = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    auto port = std::to_string(options.port);
+    int err = getaddrinfo(options.host.c_str(), port.c_str(), &hints, &addrs);
+    if (err != 0) {
+        fprintf(stderr, "[Connect] Error: %s: %s\n", options.host.c_str(), gai_strerror(err));
+        return -1;
+    }
+    int fd = -1;
+    for (auto addr = addrs; addr; addr = addr->ai_next) {
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addrs);
+    if (fd < 0) {
+        fprintf(stderr, "[Connect] Error: %s:%d: %s\n", options.host.c_str(), options.port, strerror(errno));
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return fd;
+}
+
+static bool SendAll(int fd, const string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        auto n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf(stderr, "[SendAll] Error: %s\n", strerror(errno));
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+static bool RecvAll(int fd, char* data, size_t len, bool is_spinning)
+{
+    size_t recvd = 0;
+    while (recvd < len) {
+        auto n = recv(fd, data + recvd, len - recvd, is_spinning ? MSG_DONTWAIT : 0);
+        if (n < 0 && (errno == EINTR || (is_spinning && (errno == EAGAIN || errno == EWOULDBLOCK)))) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        recvd += n;
+    }
+    return true;
+}
+
+// a frame in host byte order, nullptr if the connection is closed
+static CommandMessage* RecvFrame(int fd, string& frame, bool is_spinning)
+{
+    frame.resize(CommandMessage::HeaderSize());
+    if (! RecvAll(fd, frame.data(), frame.size(), is_spinning)) {
+        return nullptr;
+    }
+    auto cmdMsg = CommandMessage::FromNetworkData(frame.data(), frame.size(), true);
+    size_t payload_len = cmdMsg->Size() - CommandMessage::HeaderSize();
+    frame.resize(CommandMessage::HeaderSize() + payload_len);
+    if (payload_len > 0 && ! RecvAll(fd, frame.data() + CommandMessage::HeaderSize(), payload_len, is_spinning)) {
+        return nullptr;
+    }
+    return (CommandMessage*)frame.data();
+}
+
+static string EncodeFrame(ECommand cmd, const string& payload)
+{
+    CommandMessage cmdMsg;
+    cmdMsg.SetCommand(cmd);
+    cmdMsg.SetToJSON();
+    cmdMsg.SetPayloadLen(payload.size());
+    cmdMsg.ConvertToNetworkMessage(true);
+    string frame((char*)&cmdMsg, sizeof(cmdMsg));
+    frame.append(payload);
+    return frame;
+}
+
+static bool Register(int fd, ep_id_t id, const BenchOptions& options)
+{
+    CommandRegister reg_cmd;
+    reg_cmd.id = id;
+    reg_cmd.role = (role_id_t)EEndpointRole::Normal;
+    reg_cmd.access_code = options.access_code;
+    if (! SendAll(fd, EncodeFrame(ECommand::REG, reg_cmd.encodeToJSON()))) {
+        return false;
+    }
+    string frame;
+    while (auto cmdMsg = RecvFrame(fd, frame, false)) {
+        if (cmdMsg->Command() != ECommand::REG || ! cmdMsg->HasResponseFlag()) {
+            continue;
+        }
+        auto result = cmdMsg->GetResultMessage();
+        if (result->errcode != 0) {
+            fprintf(stderr, "[Register] Error: endpoint %u, errcode: %d, %s\n", id, result->errcode,
+                    string(cmdMsg->GetResultMessageContent(), cmdMsg->GetResultMessageContentSize()).c_str());
+            return false;
+        }
+        return true;
+    }
+    fprintf(stderr, "[Register] Error: endpoint %u, the connection is closed\n", id);
+    return false;
+}
+
+static void PrintLatencies(vector<int64_t>& latencies)
+{
+    if (latencies.empty()) {
+        printf("no publish received\n");
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        size_t i = std::min(latencies.size() - 1, (size_t)(p / 100.0 * latencies.size()));
+        return latencies[i] / 1000.0;
+    };
+    printf("count: %ld, latency (us): min: %.1f, p50: %.1f, p90: %.1f, p99: %.1f, p99.9: %.1f, max: %.1f\n",
+            latencies.size(), latencies.front() / 1000.0, percentile(50), percentile(90), percentile(99),
+            percentile(99.9), latencies.back() / 1000.0);
+}
+
+int parse_arguments(int argc, char **argv, BenchOptions& options) {
+    argparse::ArgumentParser program("latency_bench");
+
+    program.add_description("Forward latency of switch, from a publisher to a subscriber");
+
+    program.add_argument("-H", "--host")
+        .help("host of switch")
+        .default_value(options.host);
+    program.add_argument("-p", "--port")
+        .help("port of switch")
+        .default_value(10000)
+        .scan<'i', int>();
+    program.add_argument("-a", "--access_code")
+        .help("access code of REG")
+        .default_value(string(""));
+    program.add_argument("-n", "--count")
+        .help("measured publishes")
+        .default_value(100000)
+        .scan<'i', int>();
+    program.add_argument("-w", "--warmup")
+        .help("publishes before the measured ones")
+        .default_value(10000)
+        .scan<'i', int>();
+    program.add_argument("-s", "--size")
+        .help("content bytes of publish, at least 8")
+        .default_value(64)
+        .scan<'i', int>();
+    program.add_argument("-r", "--rate")
+        .help("publishes per second")
+        .default_value(10000)
+        .scan<'i', int>();
+    program.add_argument("-i", "--id")
+        .help("endpoint id of the publisher, the subscriber is the next one, 0: by pid")
+        .default_value(0)
+        .scan<'i', int>();
+    program.add_argument("-b", "--busy")
+        .help("the subscriber spins on the socket instead of blocking")
+        .default_value(false)
+        .implicit_value(true);
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        return -1;
+    }
+
+    options.host = program.get<string>("--host");
+    options.port = program.get<int>("--port");
+    options.access_code = program.get<string>("--access_code");
+    options.count = std::max(program.get<int>("--count"), 1);
+    options.warmup = std::max(program.get<int>("--warmup"), 0);
+    options.size = std::max<int>(program.get<int>("--size"), sizeof(int64_t));
+    options.rate = std::max(program.get<int>("--rate"), 1);
+    options.id_base = program.get<int>("--id");
+    if (options.id_base == 0) {
+        options.id_base = 100000 + (getpid() % 100000) * 2;
+    }
+    options.is_spinning = program.get<bool>("--busy");
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (parse_arguments(argc, argv, options) < 0) {
+        return 1;
+    }
+
+    ep_id_t pub_id = options.id_base;
+    ep_id_t sub_id = options.id_base + 1;
+    int pub_fd = Connect(options);
+    int sub_fd = Connect(options);
+    if (pub_fd < 0 || sub_fd < 0 || ! Register(pub_fd, pub_id, options) || ! Register(sub_fd, sub_id, options)) {
+        return 1;
+    }
+
+    uint32_t total = options.warmup + options.count;
+    vector<int64_t> latencies;
+    latencies.reserve(options.count);
+    std::atomic<bool> is_done(false);
+
+    std::thread subscriber([&]() {
+        string frame;
+        uint32_t received = 0;
+        while (received < total) {
+            auto cmdMsg = RecvFrame(sub_fd, frame, options.is_spinning);
+            if (! cmdMsg) {
+                fprintf(stderr, "[subscriber] Error: the connection is closed, received: %u\n", received);
+                break;
+            }
+            if (cmdMsg->Command() != ECommand::PUBLISH_2 || cmdMsg->HasResponseFlag()) {
+                continue;
+            }
+            auto now = NowNs();
+            auto [payload, payload_len] = cmdMsg->Payload();
+            if (payload_len < sizeof(int64_t)) {
+                continue;
+            }
+            int64_t sent_at;
+            memcpy(&sent_at, payload, sizeof(sent_at));
+            if (++received > options.warmup) {
+                latencies.push_back(now - sent_at);
+            }
+        }
+        is_done = true;
+    });
+    // the RESULTs of the publishes, not measured
+    std::thread drainer([&]() {
+        string frame;
+        while (! is_done && RecvFrame(pub_fd, frame, false)) {
+        }
+    });
+
+    PublishingMessage pub_msg;
+    pub_msg.source = pub_id;
+    pub_msg.n_targets = 1;
+    string hdr_ext((char*)&pub_msg, sizeof(pub_msg));
+    hdr_ext.append((char*)&sub_id, sizeof(sub_id));
+    string content(options.size, 'x');
+
+    auto interval = std::chrono::nanoseconds(1000000000LL / options.rate);
+    auto next_at = Clock::now();
+    for (uint32_t i = 0; i < total && ! is_done; i++) {
+        while (Clock::now() < next_at) {
+            // spin for the pacing, sleeping would add its own jitter
+        }
+        next_at += interval;
+        int64_t sent_at = NowNs();
+        memcpy(content.data(), &sent_at, sizeof(sent_at));
+        if (! SendAll(pub_fd, EncodeFrame(ECommand::PUBLISH_2, hdr_ext + content))) {
+            break;
+        }
+    }
+
+    subscriber.join();
+    shutdown(pub_fd, SHUT_RDWR);
+    drainer.join();
+    close(pub_fd);
+    close(sub_fd);
+
+    printf("publishes: %u at %u/s, content: %u bytes, subscriber %s\n", total, options.rate, options.size,
+            options.is_spinning ? "spinning" : "blocking");
+    PrintLatencies(latencies);
+    return 0;
+}
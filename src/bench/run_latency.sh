@@ -0,0 +1,46 @@
+#!/bin/bash
+# Forward latency of switch in the default mode and in the busy polling mode.
+# Starts ../server/switch with switch_config.toml, once per mode, and runs latency_bench against it.
+#   ./run_latency.sh [cpu of the reactor] [latency_bench arguments...]
+# For epoll_wait to spin in the busy polling mode: sysctl -w net.core.busy_poll=50, a switch built
+# with USE_IO_URING spins in its loop instead
+# For stable tails pin the reactor to an isolated core (isolcpus=, nohz_full=), the bench
+# is kept off that core by taskset.
+
+cd "$(dirname "$0")"
+
+SWITCH=../server/switch
+CONFIG=../server/switch_config.toml
+CPU=${1:--1}
+shift
+PORT=$(grep -m1 '^port' $CONFIG | sed 's/[^0-9]//g')
+ACCESS_CODE=$(grep -m1 '^access_code' $CONFIG | sed 's/.*"\(.*\)".*/\1/')
+
+run_mode() {
+    local busy_poll=$1
+    local config=$(mktemp /tmp/switch_latency_XXXXXX.toml)
+    sed -e "s/^busy_poll = .*/busy_poll = $busy_poll/" \
+        -e "s/^busy_poll_cpu = .*/busy_poll_cpu = $CPU/" $CONFIG > $config
+    $SWITCH -f $config > /tmp/switch_latency.log 2>&1 &
+    local pid=$!
+    sleep 1
+
+    local bench="./latency_bench -p $PORT -a $ACCESS_CODE"
+    if [ "$busy_poll" = "true" ]; then
+        bench="$bench -b"
+    fi
+    if [ "$CPU" -ge 0 ]; then
+        # the bench on the other cores
+        local cpus=$(for i in $(seq 0 $(($(nproc) - 1))); do [ $i -ne $CPU ] && echo -n "$i,"; done)
+        bench="taskset -c ${cpus%,} $bench"
+    fi
+    echo "== busy_poll: $busy_poll"
+    $bench "$@"
+
+    kill $pid
+    wait $pid 2>/dev/null
+    rm -f $config
+}
+
+run_mode false "$@"
+run_mode true "$@"
@@ -11,12 +11,27 @@ using std::string;
 using std::vector;
 using std::map;
 
+// forwarding and subscription state of an endpoint, replayed by a re-registering client
+struct CommandEndpointState {
+    vector<ep_id_t> fwd_targets;
+    vector<ep_id_t> subs_sources;
+    vector<ep_id_t> rej_sources;
+    vector<msg_type_t> subs_messages;
+    vector<msg_type_t> rej_messages;
+    vector<msg_type_t> conflated_messages;  // subscribed messages in conflation mode
+    map<msg_type_t, string> filters;        // content filters of subscribed messages
+    vector<group_id_t> groups;              // joined groups, not carried by SUBSTATE, see JOIN/LEAVE
+};
+
 struct CommandRegister {
     ep_id_t id = 0;
     role_id_t role = 0;
     string access_code;
     string token;
     svc_type_t svc_type = 0;
+    bool with_state = false;        // if true, state replaces the state of endpoint on Switch
+    CommandEndpointState state;
+    vector<string> compressions;    // the compressions supported by client, in order of preference
     string _raw_data;
 
     bool decodeFromJSON(const string& data);
@@ -30,6 +45,7 @@ struct CommandResultRegister {
     ep_id_t id = 0;
     string token;
     role_id_t role = 0;
+    string compression;             // the compression selected by Switch, empty for none
     string _raw_data;
 
     bool decodeFromJSON(const string& data);
@@ -55,6 +71,8 @@ using CommandUnforward = CommandForward;  // same as CommandForward
 struct CommandSubUnsubRejUnrej {
     vector<ep_id_t> sources;
     vector<msg_type_t> messages;
+    bool conflate = false;      // for SUB, deliver only the latest queued value per (msg_type, key)
+    string filter;              // for SUB, the content filter of the messages, see switch_message_filter.h
     string _raw_data;
 
     bool decodeFromJSON(const string& data);
@@ -69,6 +87,38 @@ using CommandUnsubscribe = CommandSubUnsubRejUnrej;
 using CommandReject = CommandSubUnsubRejUnrej;
 using CommandUnreject = CommandSubUnsubRejUnrej;
 
+struct CommandJoinLeave {
+    vector<group_id_t> groups;  // 1 ~ MAX_GROUP_ID
+    string _raw_data;
+
+    bool decodeFromJSON(const string& data);
+    string encodeToJSON();
+
+    bool decodeFromPB(const string& data);
+    string encodeToPB();
+};
+using CommandJoin = CommandJoinLeave;
+using CommandLeave = CommandJoinLeave;
+
+// SUBSTATE: the forwarding and subscription state of an endpoint in one atomic command.
+// Full: `add` replaces the whole state. Delta: `add` is merged into the state and `remove`
+// taken out of it, the keys of remove.filters are the messages to drop the filter of.
+// Binary encoded (codec 0), it carries hundreds of ids at the start of a session:
+//   [version(u8)][is_full(u8)][add][remove]
+// state: fwd_targets, subs_sources, rej_sources, subs_messages, rej_messages, conflated_messages
+// as [count(u32)][ids], then filters as [count(u32)] { [msg_type][length(u32)][expression] }
+struct CommandSubscriptionState {
+    static const uint8_t ENCODING_VERSION = 1;
+
+    bool is_full = false;
+    CommandEndpointState add;
+    CommandEndpointState remove;
+    string _raw_data;
+
+    bool decodeFromBinary(const string& data);
+    string encodeToBinary();
+};
+
 struct CommandInfoReq {
     bool is_details = false;
     ep_id_t endpoint_id = 0;
@@ -89,8 +139,8 @@ struct CommandInfo {
     string admin_code;
     struct {
         uint32_t total = 0;
-        uint32_t rx_bytes = 0;
-        uint32_t tx_bytes = 0;
+        uint64_t rx_bytes = 0;
+        uint64_t tx_bytes = 0;
         map<ep_id_t, map<string, uint32_t>> eps;  // id -> {uptime, ...}
     } endpoints;
     struct {
@@ -136,8 +186,28 @@ struct CommandEndpointInfo {
     vector<ep_id_t> rej_sources;
     vector<msg_type_t> subs_messages;
     vector<msg_type_t> rej_messages;
-    uint32_t rx_bytes = 0;
-    uint32_t tx_bytes = 0;
+    vector<msg_type_t> conflated_messages;
+    map<msg_type_t, string> filters;
+    vector<group_id_t> groups;
+    uint64_t rx_bytes = 0;
+    uint64_t tx_bytes = 0;
+    uint64_t msgs_in = 0;           // frames received from the endpoint
+    uint64_t msgs_out = 0;          // frames sent to the endpoint
+    uint64_t rejected_msgs = 0;     // received over the rate limit
+    uint32_t expired_frames = 0;    // skipped for exceeding ttl
+    uint32_t conflated_frames = 0;  // replaced by newer values while queued
+    uint32_t queued_frames = 0;     // waiting in the output queue
+    uint32_t max_queued_frames = 0;
+    uint64_t queued_bytes = 0;
+    uint64_t max_queued_bytes = 0;
+    uint32_t fwd_latency_avg = 0;   // milliseconds in the output queue
+    uint32_t fwd_latency_max = 0;
+    struct MessageStats {
+        msg_type_t msg_type = 0;
+        uint64_t in = 0;            // published by the endpoint
+        uint64_t out = 0;           // routed to the endpoint
+    };
+    vector<MessageStats> top_messages;  // the busiest message types, the busiest first
 
     string _raw_data;
 
@@ -149,11 +219,22 @@ struct CommandEndpointInfo {
 };
 using CommandEndpointInfoPtr = std::shared_ptr<CommandEndpointInfo>;
 
+// rate limits of a role or an endpoint, 0: unlimited
+struct CommandRateLimit {
+    string role;                // the default limits of role, if not empty
+    ep_id_t endpoint = 0;       // otherwise the override of endpoint
+    uint32_t msgs_per_sec = 0;
+    uint32_t bytes_per_sec = 0;
+    bool reset = false;         // remove the override of endpoint
+};
+
 struct CommandSetup {
     string access_code;
     string new_admin_code;
     string new_access_code;
     string mode;
+    vector<CommandRateLimit> rate_limits;
+    string rate_limit_policy;   // reject, delay or disconnect
     string _raw_data;
 
     bool decodeFromJSON(const string& data);
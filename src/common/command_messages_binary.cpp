@@ -0,0 +1,63 @@
+#include "command_messages.h"
+#include "utils/byte_codec.h"
+
+static void encode_state(string& out, const CommandEndpointState& state)
+{
+    put_array(out, state.fwd_targets);
+    put_array(out, state.subs_sources);
+    put_array(out, state.rej_sources);
+    put_array(out, state.subs_messages);
+    put_array(out, state.rej_messages);
+    put_array(out, state.conflated_messages);
+    put_value<uint32_t>(out, state.filters.size());
+    for (auto& [msg_type, filter] : state.filters) {
+        put_value<msg_type_t>(out, msg_type);
+        put_string(out, filter);
+    }
+}
+
+static bool decode_state(const char*& data, const char* end, CommandEndpointState& state)
+{
+    uint32_t n_filters = 0;
+    if (! get_array(data, end, state.fwd_targets) ||
+            ! get_array(data, end, state.subs_sources) ||
+            ! get_array(data, end, state.rej_sources) ||
+            ! get_array(data, end, state.subs_messages) ||
+            ! get_array(data, end, state.rej_messages) ||
+            ! get_array(data, end, state.conflated_messages) ||
+            ! get_value(data, end, n_filters)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < n_filters; i++) {
+        msg_type_t msg_type = 0;
+        string filter;
+        if (! get_value(data, end, msg_type) || ! get_string(data, end, filter)) {
+            return false;
+        }
+        state.filters[msg_type] = std::move(filter);
+    }
+    return true;
+}
+
+bool CommandSubscriptionState::decodeFromBinary(const string& data) {
+    _raw_data = data;
+    const char* cursor = _raw_data.data();
+    const char* end = cursor + _raw_data.size();
+
+    uint8_t version = 0;
+    uint8_t full = 0;
+    if (! get_value(cursor, end, version) || version != ENCODING_VERSION || ! get_value(cursor, end, full)) {
+        return false;
+    }
+    is_full = full != 0;
+    return decode_state(cursor, end, add) && decode_state(cursor, end, remove) && cursor == end;
+}
+
+string CommandSubscriptionState::encodeToBinary() {
+    _raw_data.clear();
+    put_value<uint8_t>(_raw_data, ENCODING_VERSION);
+    put_value<uint8_t>(_raw_data, is_full ? 1 : 0);
+    encode_state(_raw_data, add);
+    encode_state(_raw_data, remove);
+    return _raw_data;
+}
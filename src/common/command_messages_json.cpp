@@ -1,27 +1,163 @@
 #include "command_messages.h"
 #include <cassert>
+#include <charconv>
+#include <type_traits>
 
 #include "nlohmann/json.hpp"
 using json = nlohmann::json;
 
-bool CommandRegister::decodeFromJSON(const string& data) {
-    _raw_data = data;
-    json params = json::parse(_raw_data);
+// The decoders never throw, a payload of client is untrusted: it must be a JSON object,
+// and a field of unexpected type fails the decoding instead of raising json::type_error.
+namespace {
+
+bool parse_object(const string& data, json& params)
+{
+    params = json::parse(data, nullptr, false);  // discarded value instead of exception
+    return params.is_object();
+}
+
+template <typename T>
+struct json_decoder {
+    static bool decode(const json& j, T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            if (! j.is_boolean()) {
+                return false;
+            }
+        } else if constexpr (std::is_integral_v<T>) {
+            if (! j.is_number_integer()) {
+                return false;
+            }
+        } else {
+            static_assert(std::is_same_v<T, string>, "unsupported type of JSON field");
+            if (! j.is_string()) {
+                return false;
+            }
+        }
+        value = j.template get<T>();
+        return true;
+    }
+};
+
+template <typename T>
+struct json_decoder<vector<T>> {
+    static bool decode(const json& j, vector<T>& value) {
+        if (! j.is_array()) {
+            return false;
+        }
+        value.clear();
+        value.reserve(j.size());
+        for (auto& elem : j) {
+            T v;
+            if (! json_decoder<T>::decode(elem, v)) {
+                return false;
+            }
+            value.push_back(std::move(v));
+        }
+        return true;
+    }
+};
+
+// an object, the keys of integral type are written as strings
+template <typename K, typename V>
+struct json_decoder<map<K, V>> {
+    static bool decode(const json& j, map<K, V>& value) {
+        if (! j.is_object()) {
+            return false;
+        }
+        value.clear();
+        for (auto& [key_str, elem] : j.items()) {
+            K key;
+            if constexpr (std::is_same_v<K, string>) {
+                key = key_str;
+            } else {
+                auto end = key_str.data() + key_str.size();
+                auto [ptr, ec] = std::from_chars(key_str.data(), end, key);
+                if (ec != std::errc() || ptr != end) {
+                    return false;
+                }
+            }
+            if (! json_decoder<V>::decode(elem, value[key])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
 
-    if (params.contains("id")) {
-        id = params["id"];
+// an absent or null field is left untouched
+template <typename T>
+bool get_field(const json& params, const char* key, T& value)
+{
+    auto iter = params.find(key);
+    if (iter == params.end() || iter->is_null()) {
+        return true;
     }
-    if (params.contains("role")) {
-        role = params["role"];
+    return json_decoder<T>::decode(*iter, value);
+}
+
+const json& get_object(const json& params, const char* key)
+{
+    static const json empty_object = json::object();
+    auto iter = params.find(key);
+    return iter != params.end() && iter->is_object() ? *iter : empty_object;
+}
+
+bool get_endpoint_state(const json& params, CommandEndpointState& state)
+{
+    return get_field(params, "fwd_targets", state.fwd_targets) &&
+        get_field(params, "subs_sources", state.subs_sources) &&
+        get_field(params, "rej_sources", state.rej_sources) &&
+        get_field(params, "subs_messages", state.subs_messages) &&
+        get_field(params, "rej_messages", state.rej_messages) &&
+        get_field(params, "conflated_messages", state.conflated_messages) &&
+        get_field(params, "filters", state.filters) &&
+        get_field(params, "groups", state.groups);
+}
+
+bool get_message_stats(const json& params, vector<CommandEndpointInfo::MessageStats>& top_messages)
+{
+    auto iter = params.find("top_messages");
+    if (iter == params.end() || iter->is_null()) {
+        return true;
+    }
+    if (! iter->is_array()) {
+        return false;
     }
-    if (params.contains("access_code")) {
-        access_code = params["access_code"];
+    for (auto& item : *iter) {
+        CommandEndpointInfo::MessageStats msg_stats;
+        if (! item.is_object() ||
+                ! get_field(item, "msg_type", msg_stats.msg_type) ||
+                ! get_field(item, "in", msg_stats.in) ||
+                ! get_field(item, "out", msg_stats.out)) {
+            return false;
+        }
+        top_messages.push_back(msg_stats);
+    }
+    return true;
+}
+
+}  // namespace
+
+bool CommandRegister::decodeFromJSON(const string& data) {
+    _raw_data = data;
+    json params;
+    if (! parse_object(_raw_data, params)) {
+        return false;
     }
-    if (params.contains("token")) {
-        token = params["token"];
+    if (! get_field(params, "id", id) ||
+            ! get_field(params, "role", role) ||
+            ! get_field(params, "access_code", access_code) ||
+            ! get_field(params, "token", token) ||
+            ! get_field(params, "svc_type", svc_type) ||
+            ! get_field(params, "compressions", compressions)) {
+        return false;
     }
-    if (params.contains("svc_type")) {
-        svc_type = params["svc_type"];
+    auto iter = params.find("state");
+    if (iter != params.end() && iter->is_object()) {
+        with_state = true;
+        if (! get_endpoint_state(*iter, state)) {
+            return false;
+        }
     }
     return true;
 }
@@ -41,24 +177,50 @@ string CommandRegister::encodeToJSON() {
     if (svc_type > 0) {
         json_obj["svc_type"] = svc_type;
     }
+    if (with_state) {
+        json_obj["state"] = json::object();
+        if (! state.fwd_targets.empty()) {
+            json_obj["state"]["fwd_targets"] = state.fwd_targets;
+        }
+        if (! state.subs_sources.empty()) {
+            json_obj["state"]["subs_sources"] = state.subs_sources;
+        }
+        if (! state.rej_sources.empty()) {
+            json_obj["state"]["rej_sources"] = state.rej_sources;
+        }
+        if (! state.subs_messages.empty()) {
+            json_obj["state"]["subs_messages"] = state.subs_messages;
+        }
+        if (! state.rej_messages.empty()) {
+            json_obj["state"]["rej_messages"] = state.rej_messages;
+        }
+        if (! state.conflated_messages.empty()) {
+            json_obj["state"]["conflated_messages"] = state.conflated_messages;
+        }
+        for (auto& [msg_type, filter] : state.filters) {
+            json_obj["state"]["filters"][std::to_string(msg_type)] = filter;
+        }
+        if (! state.groups.empty()) {
+            json_obj["state"]["groups"] = state.groups;
+        }
+    }
+    if (! compressions.empty()) {
+        json_obj["compressions"] = compressions;
+    }
     _raw_data = json_obj.dump();
     return _raw_data;
 }
 
 bool CommandResultRegister::decodeFromJSON(const string& data) {
     _raw_data = data;
-    json params = json::parse(_raw_data);
-
-    if (params.contains("id")) {
-        id = params["id"];
-    }
-    if (params.contains("token")) {
-        token = params["token"];
-    }
-    if (params.contains("role")) {
-        role = params["role"];
+    json params;
+    if (! parse_object(_raw_data, params)) {
+        return false;
     }
-    return true;
+    return get_field(params, "id", id) &&
+        get_field(params, "token", token) &&
+        get_field(params, "role", role) &&
+        get_field(params, "compression", compression);
 }
 
 string CommandResultRegister::encodeToJSON() {
@@ -70,19 +232,20 @@ string CommandResultRegister::encodeToJSON() {
     if (role > 0) {
         json_obj["role"] = role;
     }
+    if (! compression.empty()) {
+        json_obj["compression"] = compression;
+    }
     _raw_data = json_obj.dump();
     return _raw_data;
 }
 
 bool CommandForward::decodeFromJSON(const string& data) {
     _raw_data = data;
-    json params = json::parse(_raw_data);
-
-    if (!params["targets"].is_array()) {
+    json params;
+    if (! parse_object(_raw_data, params)) {
         return false;
     }
-    targets = params["targets"].template get<std::vector<ep_id_t>>();
-    return true;
+    return get_field(params, "targets", targets);
 }
 
 string CommandForward::encodeToJSON() {
@@ -96,18 +259,14 @@ string CommandForward::encodeToJSON() {
 
 bool CommandSubUnsubRejUnrej::decodeFromJSON(const string& data) {
     _raw_data = data;
-    json params = json::parse(_raw_data);
-
-    if (params["sources"].is_array()) {
-        sources = params["sources"].template get<std::vector<ep_id_t>>();
-    }
-    if (params["messages"].is_array()) {
-        messages = params["messages"].template get<std::vector<msg_type_t>>();
-    }
-    if (sources.empty() && messages.empty()) {
+    json params;
+    if (! parse_object(_raw_data, params)) {
         return false;
     }
-    return true;
+    return get_field(params, "sources", sources) &&
+        get_field(params, "messages", messages) &&
+        get_field(params, "conflate", conflate) &&
+        get_field(params, "filter", filter);
 }
 
 string CommandSubUnsubRejUnrej::encodeToJSON() {
@@ -118,21 +277,42 @@ string CommandSubUnsubRejUnrej::encodeToJSON() {
     if (! messages.empty()) {
         json_obj["messages"] = messages;
     }
+    if (conflate) {
+        json_obj["conflate"] = conflate;
+    }
+    if (! filter.empty()) {
+        json_obj["filter"] = filter;
+    }
     _raw_data = json_obj.dump();
     return _raw_data;
 }
 
-bool CommandInfoReq::decodeFromJSON(const string& data) {
+bool CommandJoinLeave::decodeFromJSON(const string& data) {
     _raw_data = data;
-    json params = json::parse(_raw_data);
+    json params;
+    if (! parse_object(_raw_data, params)) {
+        return false;
+    }
+    return get_field(params, "groups", groups);
+}
 
-    if (params.contains("is_details")) {
-        is_details = params["is_details"];
+string CommandJoinLeave::encodeToJSON() {
+    json json_obj;
+    if (! groups.empty()) {
+        json_obj["groups"] = groups;
     }
-    if (params.contains("endpoint_id")) {
-        endpoint_id = params["endpoint_id"];
+    _raw_data = json_obj.dump();
+    return _raw_data;
+}
+
+bool CommandInfoReq::decodeFromJSON(const string& data) {
+    _raw_data = data;
+    json params;
+    if (! parse_object(_raw_data, params)) {
+        return false;
     }
-    return true;
+    return get_field(params, "is_details", is_details) &&
+        get_field(params, "endpoint_id", endpoint_id);
 }
 
 string CommandInfoReq::encodeToJSON() {
@@ -147,75 +327,38 @@ string CommandInfoReq::encodeToJSON() {
 
 bool CommandInfo::decodeFromJSON(const string& data) {
     _raw_data = data;
-    json params = json::parse(_raw_data);
-
-    if (params.contains("id")) {
-        id = params["id"];
-    }
-    if (params.contains("uptime")) {
-        uptime = params["uptime"];
-    }
-    if (params.contains("mode")) {
-        serving_mode = params["mode"];
-    }
-    if (params.contains("access_code")) {
-        access_code = params["access_code"];
-    }
-    if (params.contains("admin_code")) {
-        admin_code = params["admin_code"];
-    }
-    if (params.contains("endpoints")) {
-        auto params_endpoints = params["endpoints"];
-        if (params_endpoints.contains("total")) {
-            endpoints.total = params_endpoints["total"];
-        }
-        if (params_endpoints.contains("rx_bytes")) {
-            endpoints.rx_bytes = params_endpoints["rx_bytes"];
-        }
-        if (params_endpoints.contains("tx_bytes")) {
-            endpoints.tx_bytes = params_endpoints["tx_bytes"];
-        }
-        endpoints.eps = params_endpoints["eps"];
-    }
-    if (params.contains("normal_endpoints")) {
-        auto params_normal_endpoints = params["normal_endpoints"];
-        normal_endpoints.total = params_normal_endpoints["total"];
-        //normal_endpoints.eps = params_normal_endpoints["eps"];
-        for (auto v : params_normal_endpoints["eps"]) {
-            normal_endpoints.eps.push_back(v);
-        }
-    }
-    if (params.contains("admin_endpoints")) {
-        auto params_admin_endpoints = params["admin_endpoints"];
-        admin_endpoints.total = params_admin_endpoints["total"];
-        //admin_endpoints.eps = params_admin_endpoints["eps"];
-        for (auto v : params_admin_endpoints["eps"]) {
-            admin_endpoints.eps.push_back(v);
-        }
+    json params;
+    if (! parse_object(_raw_data, params)) {
+        return false;
     }
-    if (params.contains("service_endpoints")) {
-        auto params_service_endpoints = params["service_endpoints"];
-        service_endpoints.svc_type_total = params_service_endpoints["svc_type_total"];
-        service_endpoints.svc_ep_total = params_service_endpoints["svc_ep_total"];
-        service_endpoints.eps = params_service_endpoints["eps"];
-        //for (auto v : params_service_endpoints["eps"]) {
-        //    service_endpoints.eps.push_back(v);
-        //}
-    }
-    if (params.contains("message_subscribers")) {
-        auto params_message_subscribers = params["message_subscribers"];
-        message_subscribers.msg_type_total = params_message_subscribers["msg_type_total"];
-        message_subscribers.msg_ep_total = params_message_subscribers["msg_ep_total"];
-        message_subscribers.eps = params_message_subscribers["eps"];
-        //for (auto v : params_message_subscribers["eps"]) {
-        //    message_subscribers.eps.push_back(v);
-        //}
-    }
-    if (params.contains("pending_clients")) {
-        auto params_pending_clients = params["pending_clients"];
-        pending_clients.total = params_pending_clients["total"];
+    if (! get_field(params, "id", id) ||
+            ! get_field(params, "uptime", uptime) ||
+            ! get_field(params, "mode", serving_mode) ||
+            ! get_field(params, "access_code", access_code) ||
+            ! get_field(params, "admin_code", admin_code)) {
+        return false;
     }
-    return true;
+    auto& params_endpoints = get_object(params, "endpoints");
+    auto& params_normal_endpoints = get_object(params, "normal_endpoints");
+    auto& params_admin_endpoints = get_object(params, "admin_endpoints");
+    auto& params_service_endpoints = get_object(params, "service_endpoints");
+    auto& params_message_subscribers = get_object(params, "message_subscribers");
+    auto& params_pending_clients = get_object(params, "pending_clients");
+    return get_field(params_endpoints, "total", endpoints.total) &&
+        get_field(params_endpoints, "rx_bytes", endpoints.rx_bytes) &&
+        get_field(params_endpoints, "tx_bytes", endpoints.tx_bytes) &&
+        get_field(params_endpoints, "eps", endpoints.eps) &&
+        get_field(params_normal_endpoints, "total", normal_endpoints.total) &&
+        get_field(params_normal_endpoints, "eps", normal_endpoints.eps) &&
+        get_field(params_admin_endpoints, "total", admin_endpoints.total) &&
+        get_field(params_admin_endpoints, "eps", admin_endpoints.eps) &&
+        get_field(params_service_endpoints, "svc_type_total", service_endpoints.svc_type_total) &&
+        get_field(params_service_endpoints, "svc_ep_total", service_endpoints.svc_ep_total) &&
+        get_field(params_service_endpoints, "eps", service_endpoints.eps) &&
+        get_field(params_message_subscribers, "msg_type_total", message_subscribers.msg_type_total) &&
+        get_field(params_message_subscribers, "msg_ep_total", message_subscribers.msg_ep_total) &&
+        get_field(params_message_subscribers, "eps", message_subscribers.eps) &&
+        get_field(params_pending_clients, "total", pending_clients.total);
 }
 
 string CommandInfo::encodeToJSON() {
@@ -272,44 +415,36 @@ string CommandInfo::encodeToJSON() {
 
 bool CommandEndpointInfo::decodeFromJSON(const string& data) {
     _raw_data = data;
-    json params = json::parse(_raw_data);
-
-    if (params.contains("id")) {
-        id = params["id"];
-    }
-    if (params.contains("uptime")) {
-        uptime = params["uptime"];
-    }
-    if (params.contains("role")) {
-        role = params["role"];
-    }
-    if (params.contains("svc_type")) {
-        svc_type = params["svc_type"];
-    }
-
-    if (params.contains("fwd_targets") && params["fwd_targets"].is_array()) {
-        fwd_targets = params["fwd_targets"].template get<std::vector<ep_id_t>>();
-    }
-    if (params.contains("subs_sources") && params["subs_sources"].is_array()) {
-        subs_sources = params["subs_sources"].template get<std::vector<ep_id_t>>();
-    }
-    if (params.contains("rej_sources") && params["rej_sources"].is_array()) {
-        rej_sources = params["rej_sources"].template get<std::vector<ep_id_t>>();
-    }
-    if (params.contains("subs_messages") && params["subs_messages"].is_array()) {
-        subs_messages = params["subs_messages"].template get<std::vector<msg_type_t>>();
-    }
-    if (params.contains("rej_messages") && params["rej_messages"].is_array()) {
-        rej_messages = params["rej_messages"].template get<std::vector<msg_type_t>>();
-    }
-
-    if (params.contains("rx_bytes")) {
-        rx_bytes = params["rx_bytes"];
-    }
-    if (params.contains("tx_bytes")) {
-        tx_bytes = params["tx_bytes"];
+    json params;
+    if (! parse_object(_raw_data, params)) {
+        return false;
     }
-    return true;
+    return get_field(params, "id", id) &&
+        get_field(params, "uptime", uptime) &&
+        get_field(params, "role", role) &&
+        get_field(params, "svc_type", svc_type) &&
+        get_field(params, "fwd_targets", fwd_targets) &&
+        get_field(params, "subs_sources", subs_sources) &&
+        get_field(params, "rej_sources", rej_sources) &&
+        get_field(params, "subs_messages", subs_messages) &&
+        get_field(params, "rej_messages", rej_messages) &&
+        get_field(params, "conflated_messages", conflated_messages) &&
+        get_field(params, "filters", filters) &&
+        get_field(params, "groups", groups) &&
+        get_field(params, "rx_bytes", rx_bytes) &&
+        get_field(params, "tx_bytes", tx_bytes) &&
+        get_field(params, "msgs_in", msgs_in) &&
+        get_field(params, "msgs_out", msgs_out) &&
+        get_field(params, "rejected_msgs", rejected_msgs) &&
+        get_field(params, "expired_frames", expired_frames) &&
+        get_field(params, "conflated_frames", conflated_frames) &&
+        get_field(params, "queued_frames", queued_frames) &&
+        get_field(params, "max_queued_frames", max_queued_frames) &&
+        get_field(params, "queued_bytes", queued_bytes) &&
+        get_field(params, "max_queued_bytes", max_queued_bytes) &&
+        get_field(params, "fwd_latency_avg", fwd_latency_avg) &&
+        get_field(params, "fwd_latency_max", fwd_latency_max) &&
+        get_message_stats(params, top_messages);
 }
 
 string CommandEndpointInfo::encodeToJSON() {
@@ -335,27 +470,70 @@ string CommandEndpointInfo::encodeToJSON() {
     if (! rej_messages.empty()) {
         rsp["rej_messages"] = rej_messages;
     }
+    if (! conflated_messages.empty()) {
+        rsp["conflated_messages"] = conflated_messages;
+    }
+    for (auto& [msg_type, filter] : filters) {
+        rsp["filters"][std::to_string(msg_type)] = filter;
+    }
+    if (! groups.empty()) {
+        rsp["groups"] = groups;
+    }
 
     rsp["rx_bytes"] = rx_bytes;
     rsp["tx_bytes"] = tx_bytes;
+    rsp["msgs_in"] = msgs_in;
+    rsp["msgs_out"] = msgs_out;
+    rsp["rejected_msgs"] = rejected_msgs;
+    rsp["expired_frames"] = expired_frames;
+    rsp["conflated_frames"] = conflated_frames;
+    rsp["queued_frames"] = queued_frames;
+    rsp["max_queued_frames"] = max_queued_frames;
+    rsp["queued_bytes"] = queued_bytes;
+    rsp["max_queued_bytes"] = max_queued_bytes;
+    rsp["fwd_latency_avg"] = fwd_latency_avg;
+    rsp["fwd_latency_max"] = fwd_latency_max;
+    for (auto& msg_stats : top_messages) {
+        json item;
+        item["msg_type"] = msg_stats.msg_type;
+        item["in"] = msg_stats.in;
+        item["out"] = msg_stats.out;
+        rsp["top_messages"].push_back(item);
+    }
 
     return rsp.dump();
 };
 
 bool CommandSetup::decodeFromJSON(const string& data) {
     _raw_data = data;
-    json params = json::parse(_raw_data);
-    if (params.contains("access_code")) {
-        access_code = params["access_code"];
-    }
-    if (params.contains("new_admin_code")) {
-        new_admin_code = params["new_admin_code"];
+    json params;
+    if (! parse_object(_raw_data, params)) {
+        return false;
     }
-    if (params.contains("new_access_code")) {
-        new_access_code = params["new_access_code"];
+    if (! get_field(params, "access_code", access_code) ||
+            ! get_field(params, "new_admin_code", new_admin_code) ||
+            ! get_field(params, "new_access_code", new_access_code) ||
+            ! get_field(params, "mode", mode) ||
+            ! get_field(params, "rate_limit_policy", rate_limit_policy)) {
+        return false;
     }
-    if (params.contains("mode")) {
-        mode = params["mode"];
+    auto iter = params.find("rate_limits");
+    if (iter != params.end() && ! iter->is_null()) {
+        if (! iter->is_array()) {
+            return false;
+        }
+        for (auto& item : *iter) {
+            CommandRateLimit limit;
+            if (! item.is_object() ||
+                    ! get_field(item, "role", limit.role) ||
+                    ! get_field(item, "endpoint", limit.endpoint) ||
+                    ! get_field(item, "msgs_per_sec", limit.msgs_per_sec) ||
+                    ! get_field(item, "bytes_per_sec", limit.bytes_per_sec) ||
+                    ! get_field(item, "reset", limit.reset)) {
+                return false;
+            }
+            rate_limits.push_back(limit);
+        }
     }
     return true;
 }
@@ -374,18 +552,34 @@ string CommandSetup::encodeToJSON() {
     if (! mode.empty()) {
         json_obj["mode"] = mode;
     }
+    for (auto& limit : rate_limits) {
+        json item;
+        if (! limit.role.empty()) {
+            item["role"] = limit.role;
+        } else {
+            item["endpoint"] = limit.endpoint;
+        }
+        item["msgs_per_sec"] = limit.msgs_per_sec;
+        item["bytes_per_sec"] = limit.bytes_per_sec;
+        if (limit.reset) {
+            item["reset"] = true;
+        }
+        json_obj["rate_limits"].push_back(item);
+    }
+    if (! rate_limit_policy.empty()) {
+        json_obj["rate_limit_policy"] = rate_limit_policy;
+    }
     _raw_data = json_obj.dump();
     return _raw_data;
 }
 
 bool CommandKickout::decodeFromJSON(const string& data) {
     _raw_data = data;
-    json params = json::parse(_raw_data);
-
-    if (params.contains("targets") && params["targets"].is_array()) {
-        targets = params["targets"].template get<std::vector<ep_id_t>>();
+    json params;
+    if (! parse_object(_raw_data, params)) {
+        return false;
     }
-    return true;
+    return get_field(params, "targets", targets);
 }
 
 string CommandKickout::encodeToJSON() {
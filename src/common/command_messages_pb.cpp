@@ -2,9 +2,8 @@
 #include <cassert>
 
 bool CommandRegister::decodeFromPB(const string& data) {
-    assert(false && "Not implemented");
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandRegister::encodeToPB() {
@@ -13,9 +12,8 @@ string CommandRegister::encodeToPB() {
 }
 
 bool CommandResultRegister::decodeFromPB(const string& data) {
-    assert(false && "Not implemented");
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandResultRegister::encodeToPB() {
@@ -24,9 +22,8 @@ string CommandResultRegister::encodeToPB() {
 }
 
 bool CommandForward::decodeFromPB(const string& data) {
-    assert(false && "Not implemented");
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandForward::encodeToPB() {
@@ -35,9 +32,8 @@ string CommandForward::encodeToPB() {
 }
 
 bool CommandSubUnsubRejUnrej::decodeFromPB(const string& data) {
-    assert(false && "Not implemented");
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandSubUnsubRejUnrej::encodeToPB() {
@@ -45,10 +41,19 @@ string CommandSubUnsubRejUnrej::encodeToPB() {
     return "";
 }
 
-bool CommandInfoReq::decodeFromPB(const string& data) {
+bool CommandJoinLeave::decodeFromPB(const string& data) {
+    _raw_data = data;
+    return false;  // not implemented
+}
+
+string CommandJoinLeave::encodeToPB() {
     assert(false && "Not implemented");
+    return "";
+}
+
+bool CommandInfoReq::decodeFromPB(const string& data) {
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandInfoReq::encodeToPB() {
@@ -57,9 +62,8 @@ string CommandInfoReq::encodeToPB() {
 }
 
 bool CommandInfo::decodeFromPB(const string& data) {
-    assert(false && "Not implemented");
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandInfo::encodeToPB() {
@@ -68,9 +72,8 @@ string CommandInfo::encodeToPB() {
 }
 
 bool CommandEndpointInfo::decodeFromPB(const string& data) {
-    assert(false && "Not implemented");
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandEndpointInfo::encodeToPB() {
@@ -79,9 +82,8 @@ string CommandEndpointInfo::encodeToPB() {
 }
 
 bool CommandSetup::decodeFromPB(const string& data) {
-    assert(false && "Not implemented");
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandSetup::encodeToPB() {
@@ -90,9 +92,8 @@ string CommandSetup::encodeToPB() {
 }
 
 bool CommandKickout::decodeFromPB(const string& data) {
-    assert(false && "Not implemented");
     _raw_data = data;
-    return false;
+    return false;  // not implemented
 }
 
 string CommandKickout::encodeToPB() {
@@ -0,0 +1,189 @@
+#include "compression.h"
+#include "utils/byte_codec.h"
+#include <cstdio>
+#include <limits>
+#include <fstream>
+#include <sstream>
+#if USE_LZ4
+#include <lz4.h>
+#endif
+#if USE_ZSTD
+#include <zstd.h>
+#endif
+
+#define ZSTD_COMPRESSION_LEVEL 3
+
+#if USE_ZSTD
+static ZSTD_CDict* zstd_cdict = nullptr;
+static ZSTD_DDict* zstd_ddict = nullptr;
+
+static ZSTD_CCtx* zstd_cctx()
+{
+    static thread_local ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    return cctx;
+}
+
+static ZSTD_DCtx* zstd_dctx()
+{
+    static thread_local ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    return dctx;
+}
+#endif
+
+bool IsCompressionSupported(ECompression compression)
+{
+    switch (compression) {
+        case ECompression::None:
+            return true;
+#if USE_LZ4
+        case ECompression::LZ4:
+            return true;
+#endif
+#if USE_ZSTD
+        case ECompression::ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+bool LoadCompressionDictionary(const string& dict_file)
+{
+#if USE_ZSTD
+    std::ifstream ifs(dict_file, std::ios::binary);
+    if (! ifs) {
+        fprintf(stderr, "[LoadCompressionDictionary] Error: can not open %s\n", dict_file.c_str());
+        return false;
+    }
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    string dict = ss.str();
+
+    auto cdict = ZSTD_createCDict(dict.data(), dict.size(), ZSTD_COMPRESSION_LEVEL);
+    auto ddict = ZSTD_createDDict(dict.data(), dict.size());
+    if (! cdict || ! ddict) {
+        fprintf(stderr, "[LoadCompressionDictionary] Error: invalid dictionary %s\n", dict_file.c_str());
+        ZSTD_freeCDict(cdict);
+        ZSTD_freeDDict(ddict);
+        return false;
+    }
+    // loaded once at startup, before any message is handled
+    ZSTD_freeCDict(zstd_cdict);
+    ZSTD_freeDDict(zstd_ddict);
+    zstd_cdict = cdict;
+    zstd_ddict = ddict;
+    printf("[LoadCompressionDictionary] loaded %s, size: %ld, id: %u\n",
+            dict_file.c_str(), dict.size(), ZSTD_getDictID_fromDDict(ddict));
+    return true;
+#else
+    fprintf(stderr, "[LoadCompressionDictionary] Error: zstd is not built in, rebuild with USE_ZSTD=1\n");
+    return false;
+#endif
+}
+
+bool CompressContent(ECompression compression, const char* data, size_t len, string& out)
+{
+    out.clear();
+    if (len > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+    put_value<uint32_t>(out, len);
+    [[maybe_unused]] size_t offset = out.size();
+    switch (compression) {
+#if USE_LZ4
+        case ECompression::LZ4:
+            {
+                out.resize(offset + LZ4_compressBound(len));
+                int n = LZ4_compress_default(data, out.data() + offset, len, out.size() - offset);
+                if (n <= 0) {
+                    return false;
+                }
+                out.resize(offset + n);
+            }
+            return true;
+#endif
+#if USE_ZSTD
+        case ECompression::ZSTD:
+            {
+                out.resize(offset + ZSTD_compressBound(len));
+                size_t n = zstd_cdict ?
+                    ZSTD_compress_usingCDict(zstd_cctx(), out.data() + offset, out.size() - offset, data, len, zstd_cdict) :
+                    ZSTD_compressCCtx(zstd_cctx(), out.data() + offset, out.size() - offset, data, len, ZSTD_COMPRESSION_LEVEL);
+                if (ZSTD_isError(n)) {
+                    return false;
+                }
+                out.resize(offset + n);
+            }
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+bool DecompressContent(ECompression compression, const char* data, size_t len, string& out)
+{
+    const char* end = data + len;
+    uint32_t raw_len = 0;
+    if (! get_value(data, end, raw_len) || raw_len > std::numeric_limits<payload_size_t>::max()) {
+        return false;  // never larger than a frame
+    }
+    out.resize(raw_len);
+    switch (compression) {
+#if USE_LZ4
+        case ECompression::LZ4:
+            return LZ4_decompress_safe(data, out.data(), end - data, raw_len) == (int)raw_len;
+#endif
+#if USE_ZSTD
+        case ECompression::ZSTD:
+            {
+                size_t n = zstd_ddict ?
+                    ZSTD_decompress_usingDDict(zstd_dctx(), out.data(), raw_len, data, end - data, zstd_ddict) :
+                    ZSTD_decompressDCtx(zstd_dctx(), out.data(), raw_len, data, end - data);
+                return ! ZSTD_isError(n) && n == raw_len;
+            }
+#endif
+        default:
+            return false;
+    }
+}
+
+bool CompressFrame(const CommandMessage* cmdMsg, ECompression compression, size_t min_bytes, string& frame)
+{
+    auto [content, content_len] = cmdMsg->Payload();
+    if (compression == ECompression::None || cmdMsg->Compression() != ECompression::None || content_len < min_bytes) {
+        return false;
+    }
+    string compressed;
+    if (! CompressContent(compression, content, content_len, compressed) || compressed.size() >= content_len) {
+        return false;
+    }
+    size_t headers_len = content - cmdMsg->Data();  // the header and routing headers
+    frame.assign(cmdMsg->Data(), headers_len);
+    frame.append(compressed);
+    auto msg = (CommandMessage*)frame.data();
+    msg->SetCompression(compression);
+    msg->SetPayloadLen(frame.size() - CommandMessage::HeaderSize());
+    return true;
+}
+
+bool DecompressFrame(const CommandMessage* cmdMsg, string& frame)
+{
+    auto [content, content_len] = cmdMsg->Payload();
+    string raw;
+    if (! DecompressContent(cmdMsg->Compression(), content, content_len, raw)) {
+        return false;
+    }
+    size_t headers_len = content - cmdMsg->Data();
+    size_t max_payload_len = std::numeric_limits<payload_size_t>::max() - CommandMessage::PayloadLenBytes();
+    if (headers_len - CommandMessage::HeaderSize() + raw.size() > max_payload_len) {
+        return false;
+    }
+    frame.assign(cmdMsg->Data(), headers_len);
+    frame.append(raw);
+    auto msg = (CommandMessage*)frame.data();
+    msg->SetCompression(ECompression::None);
+    msg->SetPayloadLen(frame.size() - CommandMessage::HeaderSize());
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef _COMPRESSION_H
+#define _COMPRESSION_H
+
+#include <string>
+#include "switch_message.h"
+
+using std::string;
+
+// Compression of message content, the codecs are built in with: make USE_LZ4=1 USE_ZSTD=1
+// Only the content after the routing headers (ServiceMessage, PublishingMessage with its
+// targets and extension) is compressed, so Switch routes a compressed frame without
+// touching it. The compressed content is: [raw length(u32)][compressed bytes]
+
+bool IsCompressionSupported(ECompression compression);
+
+// The zstd dictionary trained from the typical payloads (zstd --train), both sides must load the same one
+bool LoadCompressionDictionary(const string& dict_file);
+
+bool CompressContent(ECompression compression, const char* data, size_t len, string& out);
+bool DecompressContent(ECompression compression, const char* data, size_t len, string& out);
+
+// Build a copy of the frame with compressed/decompressed content, both are in host byte order.
+// CompressFrame returns false if the content is shorter than min_bytes or does not shrink.
+bool CompressFrame(const CommandMessage* cmdMsg, ECompression compression, size_t min_bytes, string& frame);
+bool DecompressFrame(const CommandMessage* cmdMsg, string& frame);
+
+#endif  // _COMPRESSION_H
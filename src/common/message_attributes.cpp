@@ -0,0 +1,151 @@
+#include "message_attributes.h"
+#include "utils/byte_codec.h"
+#include <cstddef>
+#include <sstream>
+
+AttributeValue AttributeValue::FromInt(int64_t value)
+{
+    AttributeValue attr;
+    attr.type = Int;
+    attr.i = value;
+    return attr;
+}
+
+AttributeValue AttributeValue::FromDouble(double value)
+{
+    AttributeValue attr;
+    attr.type = Double;
+    attr.d = value;
+    return attr;
+}
+
+AttributeValue AttributeValue::FromString(const string& value)
+{
+    AttributeValue attr;
+    attr.type = String;
+    attr.s = value;
+    return attr;
+}
+
+string AttributeValue::ToString() const
+{
+    std::stringstream ss;
+    switch (type) {
+        case Int:
+            ss << i;
+            break;
+        case Double:
+            ss << d;
+            break;
+        case String:
+            ss << '"' << s << '"';
+            break;
+    }
+    return ss.str();
+}
+
+static void put_short_string(string& out, const string& value)
+{
+    put_value<uint8_t>(out, value.size());
+    out.append(value);
+}
+
+static bool get_short_string(const char*& data, const char* end, string& value)
+{
+    uint8_t len = 0;
+    if (! get_value(data, end, len) || end - data < len) {
+        return false;
+    }
+    value.assign(data, len);
+    data += len;
+    return true;
+}
+
+bool EncodeMessageAttributes(const MessageAttributes& attrs, string& out)
+{
+    out.clear();
+    if (attrs.size() > UINT8_MAX) {
+        return false;
+    }
+    for (auto& [name, value] : attrs) {
+        if (name.empty() || name.size() > UINT8_MAX || value.s.size() > UINT8_MAX) {
+            return false;
+        }
+        put_short_string(out, name);
+        put_value<uint8_t>(out, value.type);
+        switch (value.type) {
+            case AttributeValue::Int:
+                put_value<int64_t>(out, value.i);
+                break;
+            case AttributeValue::Double:
+                put_value<double>(out, value.d);
+                break;
+            case AttributeValue::String:
+                put_short_string(out, value.s);
+                break;
+            default:
+                return false;
+        }
+    }
+    return out.size() <= MAX_ATTRIBUTES_BYTES;
+}
+
+bool DecodeMessageAttributes(const char* data, const char* end, uint8_t n_attrs, MessageAttributes& attrs)
+{
+    attrs.clear();
+    attrs.reserve(n_attrs);
+    for (int n = 0; n < n_attrs; n++) {
+        MessageAttribute attr;
+        auto& [name, value] = attr;
+        uint8_t type = 0;
+        if (! get_short_string(data, end, name) || ! get_value(data, end, type)) {
+            attrs.clear();
+            return false;
+        }
+        value.type = (AttributeValue::Type)type;
+        bool is_decoded = false;
+        switch (value.type) {
+            case AttributeValue::Int:
+                is_decoded = get_value(data, end, value.i);
+                break;
+            case AttributeValue::Double:
+                is_decoded = get_value(data, end, value.d);
+                break;
+            case AttributeValue::String:
+                is_decoded = get_short_string(data, end, value.s);
+                break;
+        }
+        if (! is_decoded) {
+            attrs.clear();
+            return false;
+        }
+        attrs.push_back(std::move(attr));
+    }
+    return true;
+}
+
+bool GetPublishingAttributes(const CommandMessage* cmdMsg, const char* end, MessageAttributes& attrs)
+{
+    auto pub_ext = cmdMsg->GetPublishingExtension();
+    if (! pub_ext || (const char*)pub_ext >= end ||
+            pub_ext->ext_len < offsetof(PublishingExtension, n_attrs) + sizeof(pub_ext->n_attrs) ||
+            pub_ext->n_attrs == 0) {
+        return false;
+    }
+    const char* data = (const char*)pub_ext + sizeof(PublishingExtension);
+    const char* ext_end = (const char*)pub_ext + pub_ext->ext_len;
+    if (ext_end > end || data > ext_end) {
+        return false;
+    }
+    return DecodeMessageAttributes(data, ext_end, pub_ext->n_attrs, attrs);
+}
+
+const AttributeValue* FindAttribute(const MessageAttributes& attrs, const string& name)
+{
+    for (auto& [attr_name, value] : attrs) {
+        if (attr_name == name) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,52 @@
+#ifndef _MESSAGE_ATTRIBUTES_H
+#define _MESSAGE_ATTRIBUTES_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "switch_message.h"
+
+using std::string;
+using std::vector;
+
+// Typed attributes of a published message, attached by the publisher after the fixed fields
+// of PublishingExtension (n_attrs of them, covered by ext_len), and matched by the content
+// filters of subscriptions on Switch. In host byte order, each attribute is:
+//   [name length(u8)][name][type(u8)][value]
+// value: Int: int64, Double: double, String: [length(u8)][bytes]
+struct AttributeValue {
+    enum Type : uint8_t {
+        Int = 1,
+        Double = 2,
+        String = 3,
+    };
+    Type    type = Int;
+    int64_t i = 0;
+    double  d = 0;
+    string  s;
+
+    static AttributeValue FromInt(int64_t value);
+    static AttributeValue FromDouble(double value);
+    static AttributeValue FromString(const string& value);
+    bool IsNumber() const { return type == Int || type == Double; }
+    string ToString() const;
+};
+
+using MessageAttribute = std::pair<string, AttributeValue>;
+using MessageAttributes = vector<MessageAttribute>;
+
+// the attributes share the u8 ext_len with the fixed fields of extension
+static const size_t MAX_ATTRIBUTES_BYTES = UINT8_MAX - sizeof(PublishingExtension);
+
+// returns false if a name or a string is longer than 255 bytes, or the total exceeds MAX_ATTRIBUTES_BYTES
+bool EncodeMessageAttributes(const MessageAttributes& attrs, string& out);
+bool DecodeMessageAttributes(const char* data, const char* end, uint8_t n_attrs, MessageAttributes& attrs);
+
+// Decode the attributes of a PUBLISH_2 frame, either in host or network byte order (the extension
+// is not converted). end: the end of frame. Returns false if the frame has none or they are malformed.
+bool GetPublishingAttributes(const CommandMessage* cmdMsg, const char* end, MessageAttributes& attrs);
+
+const AttributeValue* FindAttribute(const MessageAttributes& attrs, const string& name);
+
+#endif  // _MESSAGE_ATTRIBUTES_H
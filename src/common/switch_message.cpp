@@ -3,6 +3,7 @@
 #include <arpa/inet.h>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 
 const char* CommandToTag(ECommand cmd) {
     const char* cmd_tag = "UNDEFINED";
@@ -58,6 +59,15 @@ const char* CommandToTag(ECommand cmd) {
         case ECommand::RELOAD:
             cmd_tag = "RELOAD";
             break;
+        case ECommand::SUBSTATE:
+            cmd_tag = "SUBSTATE";
+            break;
+        case ECommand::JOIN:
+            cmd_tag = "JOIN";
+            break;
+        case ECommand::LEAVE:
+            cmd_tag = "LEAVE";
+            break;
         case ECommand::RESULT:
             cmd_tag = "RESULT";
             break;
@@ -68,6 +78,51 @@ const char* CommandToTag(ECommand cmd) {
     return cmd_tag;
 }
 
+const char* PriorityToTag(EMessagePriority priority) {
+    const char* tag = "normal";
+    switch (priority) {
+        case EMessagePriority::Low:
+            tag = "low";
+            break;
+        case EMessagePriority::High:
+            tag = "high";
+            break;
+        case EMessagePriority::Urgent:
+            tag = "urgent";
+            break;
+        default:
+            tag = "normal";
+            break;
+    }
+    return tag;
+}
+
+const char* CompressionToTag(ECompression compression) {
+    const char* tag = "none";
+    switch (compression) {
+        case ECompression::LZ4:
+            tag = "lz4";
+            break;
+        case ECompression::ZSTD:
+            tag = "zstd";
+            break;
+        default:
+            tag = "none";
+            break;
+    }
+    return tag;
+}
+
+ECompression TagToCompression(const std::string& tag) {
+    ECompression compression = ECompression::None;
+    if (tag == "lz4") {
+        compression = ECompression::LZ4;
+    } else if (tag == "zstd") {
+        compression = ECompression::ZSTD;
+    }
+    return compression;
+}
+
 std::pair<const char*, payload_size_t>
 CommandMessage::Payload() const
 {
@@ -78,10 +133,16 @@ CommandMessage::Payload() const
             if (! HasResponseFlag()) {  // is not response
                 payload += sizeof(PublishingMessage);
                 payload_len -= sizeof(PublishingMessage);
-                auto pub_msg = (PublishingMessage*)payload;
-                size_t targets_bytes = pub_msg->n_targets * sizeof(PublishingMessage::targets);
+                auto pub_msg = (PublishingMessage*)payload_;
+                size_t targets_bytes = pub_msg->n_targets * sizeof(PublishingMessage::targets[0]);
                 payload += targets_bytes;
                 payload_len -= targets_bytes;
+                if (HasExtendedFlag() && payload_len > 0) {
+                    auto pub_ext = (PublishingExtension*)payload;
+                    size_t ext_len = std::min<size_t>(pub_ext->ext_len, payload_len);
+                    payload += ext_len;
+                    payload_len -= ext_len;
+                }
             }
             break;
         case ECommand::SVC:
@@ -94,6 +155,45 @@ CommandMessage::Payload() const
     return { payload, payload_len };
 }
 
+bool CommandMessage::IsWellFormed(size_t frame_size) const
+{
+    if (frame_size < HeaderSize() || frame_size - HeaderSize() < payload_len_) {
+        return false;
+    }
+    switch ((ECommand)(cmd_)) {
+        case ECommand::PUBLISH_2:
+            if (! HasResponseFlag()) {
+                if (payload_len_ < sizeof(PublishingMessage)) {
+                    return false;
+                }
+                auto pub_msg = (const PublishingMessage*)payload_;
+                size_t routing_len = sizeof(PublishingMessage) + pub_msg->n_targets * sizeof(PublishingMessage::targets[0]);
+                if (routing_len > payload_len_) {
+                    return false;
+                }
+                if (HasExtendedFlag()) {
+                    if (routing_len + sizeof(PublishingExtension::ext_len) > payload_len_) {
+                        return false;
+                    }
+                    auto pub_ext = (const PublishingExtension*)(payload_ + routing_len);
+                    if (pub_ext->ext_len < sizeof(pub_ext->ext_len) || routing_len + pub_ext->ext_len > payload_len_) {
+                        return false;
+                    }
+                }
+            }
+            break;
+        case ECommand::SVC:
+            // a response carries the ResultMessage after the routing header
+            if (payload_len_ < sizeof(ServiceMessage) + (HasResponseFlag() ? sizeof(ResultMessage) : 0)) {
+                return false;
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
 payload_size_t CommandMessage::PayloadLen() const
 {
     auto [_, payload_len] = Payload();
@@ -103,7 +203,18 @@ payload_size_t CommandMessage::PayloadLen() const
 const PublishingMessage*
 CommandMessage::GetPublishingMessage() const
 {
-    return ECommand(cmd_) == ECommand::PUBLISH_2 ? (const PublishingMessage*)(payload_) : nullptr;
+    // a response carries a ResultMessage, without the routing headers, see IsWellFormed
+    return ECommand(cmd_) == ECommand::PUBLISH_2 && ! HasResponseFlag() ? (const PublishingMessage*)(payload_) : nullptr;
+}
+
+const PublishingExtension*
+CommandMessage::GetPublishingExtension() const
+{
+    auto pub_msg = GetPublishingMessage();
+    if (! pub_msg || ! HasExtendedFlag()) {
+        return nullptr;
+    }
+    return (const PublishingExtension*)((const char*)pub_msg->targets + pub_msg->n_targets * sizeof(pub_msg->targets[0]));
 }
 
 const ServiceMessage*
@@ -131,7 +242,7 @@ size_t CommandMessage::GetResultMessageContentSize() const
     if (HasResponseFlag()) {
         auto payload_len = PayloadLen();
         //auto payload_len = payload_len_;
-        return payload_len - sizeof(ResultMessage);
+        return payload_len > sizeof(ResultMessage) ? payload_len - sizeof(ResultMessage) : 0;
     } else {
         return 0;
     }
@@ -162,7 +273,17 @@ CommandMessage::ConvertToNetworkMessage(bool isMsgPayloadLengthIncludingSelf)
 CommandMessage*
 CommandMessage::FromNetworkMessage(const Message* msg, bool isMsgPayloadLengthIncludingSelf)
 {
-    CommandMessage* cmdMsg = (CommandMessage*)(msg->Data().data());
+    auto& data = msg->Data();
+    return FromNetworkData((char*)data.data(), data.size(), isMsgPayloadLengthIncludingSelf);
+}
+
+CommandMessage*
+CommandMessage::FromNetworkData(char* data, size_t size, bool isMsgPayloadLengthIncludingSelf)
+{
+    if (size < HeaderSize()) {
+        return nullptr;
+    }
+    CommandMessage* cmdMsg = (CommandMessage*)data;
     int payload_len_bytes = sizeof(cmdMsg->payload_len_);
     auto payload_len = cmdMsg->payload_len_;
     cmdMsg->payload_len_ =
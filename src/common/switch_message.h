@@ -36,11 +36,34 @@ enum class ECommand : command_t {
     KICKOUT,
     EXIT,
     RELOAD,
+    SUBSTATE,   // set the subscription state in bulk, binary payload
+    JOIN,       // join groups, addressed by PUBLISH_2 as a whole
+    LEAVE,
     HEARTBEAT = 254,
     RESULT = 255,
 };
 const char* CommandToTag(ECommand cmd);
 
+// Priority class of message, carried in the flag of CommandMessage.
+// 0 is Normal, so the messages of older clients keep their behavior.
+enum class EMessagePriority : uint8_t {
+    Normal,
+    Low,        // bulk traffic
+    High,       // service requests and responses
+    Urgent,     // control results, kickout notices
+};
+const char* PriorityToTag(EMessagePriority priority);
+
+// Compression of the content of message, carried in the flag of CommandMessage,
+// negotiated per connection at REG. See compression.h
+enum class ECompression : uint8_t {
+    None,
+    LZ4,        // for latency
+    ZSTD,       // for ratio, with the shared dictionary if configured
+};
+const char* CompressionToTag(ECompression compression);
+ECompression TagToCompression(const std::string& tag);
+
 // for CommandMessage.cmd equals ECommand::SVC
 #pragma pack(1)
 struct ServiceMessage {
@@ -61,6 +84,26 @@ struct PublishingMessage {
 };
 #pragma pack()
 
+// A target with the high bit set addresses the members of a group (see JOIN) rather than
+// an endpoint, the endpoint ids never have it. Switch sends the frame to a member once,
+// even if it is addressed by several targets.
+const ep_id_t GROUP_TARGET_FLAG = 0x80000000;
+const group_id_t MAX_GROUP_ID = 0x7fffffff;
+inline bool IsGroupTarget(ep_id_t target) { return target & GROUP_TARGET_FLAG; }
+inline ep_id_t GroupTarget(group_id_t group) { return GROUP_TARGET_FLAG | group; }
+inline group_id_t TargetGroup(ep_id_t target) { return target & ~GROUP_TARGET_FLAG; }
+
+// Optional extension of PublishingMessage, follows the targets if CommandMessage has the extended flag.
+// New fields are appended, a receiver only reads the fields covered by ext_len.
+#pragma pack(1)
+struct PublishingExtension {
+    uint8_t    ext_len = sizeof(PublishingExtension);   // size of extension, including self
+    uint32_t   ttl_ms  = 0;       // time to live in milliseconds, 0: unlimited
+    uint32_t   key     = 0;       // key of the value within msg_type, for last-value cache, 0: none
+    uint8_t    n_attrs = 0;       // number of typed attributes following the extension, see message_attributes.h
+};
+#pragma pack()
+
 #pragma pack(1)
 struct ResultMessage {
     int8_t errcode = 0;
@@ -74,7 +117,9 @@ struct CommandMessage {
     // Fields
     command_t cmd_ = 0;         // ECommand
     struct {
-        uint8_t unused:5 = 0;
+        uint8_t compression:2 = 0; // 2 bits, ECompression of the content after the routing headers
+        uint8_t extended:1 = 0; // 1 bit,  has PublishingExtension, for PUBLISH_2
+        uint8_t priority:2 = 0; // 2 bits, EMessagePriority
         uint8_t codec:2 = 0;    // 2 bits, codec of above layer, 0: undefined, 1: json, 2: protobuf, 3: unused
         uint8_t req_rsp:1 = 0;  // 1 bit,  request or response,  0: request, 1: response
     } flag_;
@@ -98,6 +143,15 @@ struct CommandMessage {
 
     void ResetCodec() { flag_.codec = 0; }
 
+    void SetPriority(EMessagePriority priority) { flag_.priority = (uint8_t)priority; }
+    EMessagePriority Priority() const { return (EMessagePriority)flag_.priority; }
+
+    void SetCompression(ECompression compression) { flag_.compression = (uint8_t)compression; }
+    ECompression Compression() const { return (ECompression)flag_.compression; }
+
+    void SetExtendedFlag() { flag_.extended = 1; }
+    bool HasExtendedFlag() const { return flag_.extended; }
+
     void SetPayloadLen(payload_size_t length) { payload_len_ = length; }
     std::pair<const char*, payload_size_t> Payload() const;
     payload_size_t PayloadLen() const;
@@ -112,7 +166,11 @@ struct CommandMessage {
         return data;
     }
 
+    // the routing headers fit in the frame, checked before any accessor below is trusted
+    bool IsWellFormed(size_t frame_size) const;
+
     const PublishingMessage* GetPublishingMessage() const;
+    const PublishingExtension* GetPublishingExtension() const;
     const ServiceMessage* GetServiceMessage() const;
     const ResultMessage* GetResultMessage() const;
     size_t GetResultMessageContentSize() const;
@@ -123,7 +181,9 @@ struct CommandMessage {
     static size_t HeaderSize() { return sizeof(CommandMessage); }
     static size_t PayloadLenBytes() { return sizeof(CommandMessage::payload_len_); }
     static size_t OffsetOfPayloadLen() { return offsetof(CommandMessage, payload_len_); }
+    // converts the header of frame in place, nullptr if the frame is shorter than the header
     static CommandMessage* FromNetworkMessage(const Message* msg, bool isMsgPayloadLengthIncludingSelf);
+    static CommandMessage* FromNetworkData(char* data, size_t size, bool isMsgPayloadLengthIncludingSelf);
     static CommandMessage CreateHeartbeatRequest();
     static CommandMessage CreateHeartbeatResponse();
 };
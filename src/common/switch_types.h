@@ -32,4 +32,7 @@ using ServiceType = svc_type_t;
 using msg_type_t = uint16_t;
 using MessageId = msg_type_t;
 
+using group_id_t = uint32_t;
+using GroupId = group_id_t;
+
 #endif  // _SWITCH_TYPES_H
@@ -1,4 +1,8 @@
 g++ -D__UNITTEST__ -o crypto crypto.cpp -lcrypto
 g++ -D__UNITTEST__ -o random random.cpp
+g++ -D__UNITTEST__ -o siphash siphash.cpp
 g++ -D__UNITTEST__ -o time time.cpp
 g++ -D__UNITTEST__ -o md5_test md5_test.cpp md5.cpp
+g++ -D__UNITTEST__ -o mpsc_queue_test mpsc_queue_test.cpp -lpthread
+g++ -D__UNITTEST__ -o work_stealing_pool work_stealing_pool.cpp -lpthread
+g++ -D__UNITTEST__ -o timer_wheel_test timer_wheel_test.cpp
@@ -0,0 +1,72 @@
+#ifndef _UTILS_BYTE_CODEC_H
+#define _UTILS_BYTE_CODEC_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+using std::string;
+using std::vector;
+
+// Helpers for the compact binary records of Switch (session snapshot, upgrade handoff),
+// integers are in host byte order, the data is not meant to move between hosts.
+
+template<typename T>
+inline void put_value(string& out, T value)
+{
+    out.append((const char*)&value, sizeof(value));
+}
+
+template<typename T>
+inline bool get_value(const char*& data, const char* end, T& value)
+{
+    if (end - data < (ptrdiff_t)sizeof(T)) {
+        return false;
+    }
+    memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return true;
+}
+
+template<typename T>
+inline void put_array(string& out, const vector<T>& values)
+{
+    put_value<uint32_t>(out, values.size());
+    out.append((const char*)values.data(), values.size() * sizeof(T));
+}
+
+template<typename T>
+inline bool get_array(const char*& data, const char* end, vector<T>& values)
+{
+    uint32_t count = 0;
+    if (! get_value(data, end, count) || (size_t)(end - data) / sizeof(T) < count) {
+        return false;
+    }
+    values.resize(count);
+    if (count > 0) {
+        memcpy(values.data(), data, count * sizeof(T));  // data() of an empty vector may be null
+    }
+    data += count * sizeof(T);
+    return true;
+}
+
+inline void put_string(string& out, const string& value)
+{
+    put_value<uint32_t>(out, value.size());
+    out.append(value);
+}
+
+inline bool get_string(const char*& data, const char* end, string& value)
+{
+    uint32_t len = 0;
+    if (! get_value(data, end, len) || (size_t)(end - data) < len) {
+        return false;
+    }
+    value.assign(data, len);
+    data += len;
+    return true;
+}
+
+#endif  // _UTILS_BYTE_CODEC_H
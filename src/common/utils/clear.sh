@@ -1 +1 @@
-rm crypto random time md5_test
+rm crypto random siphash time md5_test mpsc_queue_test work_stealing_pool timer_wheel_test
@@ -0,0 +1,48 @@
+#if defined(__UNITTEST__)
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include "mpsc_queue.h"
+
+using std::cout; using std::endl;
+
+int main(int argc, char *argv[])
+{
+    const int n_producers = 4;
+    const int n_items = 100000;
+
+    MpscQueue<int> queue;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < n_producers; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < n_items; ++i) {
+                queue.Push(p * n_items + i);
+            }
+        });
+    }
+
+    std::vector<int> last_seen(n_producers, -1);
+    int n_popped = 0;
+    while (n_popped < n_producers * n_items) {
+        int value;
+        if (! queue.Pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        int p = value / n_items;
+        int i = value % n_items;
+        assert(i > last_seen[p] && "items of one producer must keep FIFO order");
+        last_seen[p] = i;
+        ++n_popped;
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    assert(queue.Empty());
+    cout << "mpsc queue: popped " << n_popped << " items from " << n_producers << " producers" << endl;
+    return 0;
+}
+
+#endif
@@ -1,12 +1,80 @@
+#include "random.h"
 #include <random>
+#include <cstring>
 #include <iostream>
 
-unsigned int generate_random_integer(unsigned int begin=1, unsigned int end=65535)
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t& x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+struct Xoshiro256 {
+    uint64_t s[4];
+
+    Xoshiro256() {
+        uint64_t seed = 0;
+        generate_random_bytes(&seed, sizeof(seed));
+        for (auto& elem : s) {
+            elem = splitmix64(seed);    // never all zero
+        }
+    }
+
+    uint64_t Next() {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+};
+
+uint64_t fast_random()
+{
+    static thread_local Xoshiro256 prng;
+    return prng.Next();
+}
+
+unsigned int generate_random_integer(unsigned int begin, unsigned int end)
+{
+    // unbiased mapping onto the range by multiplication (Lemire), without division in the common case
+    uint64_t range = (uint64_t)end - begin + 1;
+    uint64_t x = fast_random() >> 32;
+    uint64_t m = x * range;
+    uint64_t low = m & 0xffffffff;
+    if (low < range) {
+        uint64_t threshold = (0x100000000 - range) % range;
+        while (low < threshold) {
+            x = fast_random() >> 32;
+            m = x * range;
+            low = m & 0xffffffff;
+        }
+    }
+    return begin + (unsigned int)(m >> 32);
+}
+
+void generate_random_bytes(void* buf, size_t len)
 {
     std::random_device rd;
-    std::mt19937 mt(rd());
-    std::uniform_int_distribution<unsigned int> dist(begin, end);
-    return dist(mt);
+    auto data = (unsigned char*)buf;
+    while (len > 0) {
+        unsigned int value = rd();
+        size_t n = std::min(len, sizeof(value));
+        memcpy(data, &value, n);
+        data += n;
+        len -= n;
+    }
 }
 
 #if defined(__UNITTEST__)
@@ -15,6 +83,8 @@ int main()
     for (int i=0; i<16; ++i) {
         std::cout << generate_random_integer() << std::endl;
     }
+    std::cout << generate_random_integer(7, 7) << std::endl;
+    std::cout << generate_random_integer(0, 0xffffffff) << std::endl;
     return 0;
 }
 #endif
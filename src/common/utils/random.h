@@ -1,6 +1,16 @@
-#ifndef _RANDOM_H
-#define _RANDOM_H
+#ifndef _UTILS_RANDOM_H
+#define _UTILS_RANDOM_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Fast PRNG (xoshiro256**), one state per thread seeded once from std::random_device.
+// NOT for secrets, use generate_random_bytes() for keys.
+uint64_t fast_random();
 
 unsigned int generate_random_integer(unsigned int begin=1, unsigned int end=65535);
 
-#endif  // _RANDOM_H
+// from std::random_device (the OS entropy source), for keys
+void generate_random_bytes(void* buf, size_t len);
+
+#endif  // _UTILS_RANDOM_H
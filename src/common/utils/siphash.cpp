@@ -0,0 +1,86 @@
+#include "siphash.h"
+#include <cstring>
+#include <iostream>
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND \
+    do { \
+        v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+    } while (0)
+
+static inline uint64_t load64_le(const uint8_t* p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+uint64_t siphash24(const uint8_t key[16], const void* data, size_t len)
+{
+    uint64_t k0 = load64_le(key);
+    uint64_t k1 = load64_le(key + 8);
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    auto in = (const uint8_t*)data;
+    const uint8_t* end = in + len - (len % 8);
+    for (; in != end; in += 8) {
+        uint64_t m = load64_le(in);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    uint64_t b = ((uint64_t)len) << 56;
+    for (int i = len % 8 - 1; i >= 0; i--) {
+        b |= ((uint64_t)in[i]) << (8 * i);
+    }
+    v3 ^= b;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+#if defined(__UNITTEST__)
+int main()
+{
+    // the test vectors of the reference implementation: key 00..0f, message 00..(len-1)
+    uint8_t key[16];
+    uint8_t msg[64];
+    for (int i = 0; i < 16; i++) {
+        key[i] = i;
+    }
+    for (int i = 0; i < 64; i++) {
+        msg[i] = i;
+    }
+    const uint64_t expected[] = {
+        0x726fdb47dd0e0e31ULL,  // len 0
+        0x74f839c593dc67fdULL,  // len 1
+        0xa129ca6149be45e5ULL,  // len 15
+    };
+    const size_t lens[] = { 0, 1, 15 };
+    int failed = 0;
+    for (int i = 0; i < 3; i++) {
+        uint64_t h = siphash24(key, msg, lens[i]);
+        std::cout << "len " << lens[i] << ": " << std::hex << h << (h == expected[i] ? " ok" : " FAILED") << std::endl;
+        failed += h != expected[i];
+    }
+    return failed;
+}
+#endif
@@ -0,0 +1,11 @@
+#ifndef _UTILS_SIPHASH_H
+#define _UTILS_SIPHASH_H
+
+#include <cstdint>
+#include <cstddef>
+
+// SipHash-2-4, a keyed 64-bit hash (Aumasson & Bernstein), cheap enough for a
+// handful of bytes and unpredictable without the 128-bit key.
+uint64_t siphash24(const uint8_t key[16], const void* data, size_t len);
+
+#endif  // _UTILS_SIPHASH_H
@@ -1,4 +1,6 @@
 #include "time.h"
+#include <chrono>
+#include <time.h>
 
 #define DAY (24 * 60 * 60)
 #define HOUR (60 * 60)
@@ -18,11 +20,26 @@ string readable_seconds_delta(time_t value)
     return string(buf);
 }
 
+int64_t monotonic_milliseconds()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
+int64_t coarse_monotonic_milliseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 #if defined(__UNITTEST__)
 #include <iostream>
 int main()
 {
     auto result = readable_seconds_delta(DAY + HOUR + 120);
     std::cout << result << std::endl;
+    std::cout << "monotonic ms: " << monotonic_milliseconds() << std::endl;
+    std::cout << "coarse monotonic ms: " << coarse_monotonic_milliseconds() << std::endl;
 }
 #endif
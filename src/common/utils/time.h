@@ -2,8 +2,11 @@
 #define _UTILS_TIME_H
 
 #include <string>
+#include <cstdint>
 using std::string;
 
 string readable_seconds_delta(time_t value);
+int64_t monotonic_milliseconds();
+int64_t coarse_monotonic_milliseconds();  // cheaper, at the resolution of a scheduler tick
 
 #endif // _UTILS_TIME_H
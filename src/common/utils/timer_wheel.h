@@ -0,0 +1,95 @@
+#ifndef _UTILS_TIMER_WHEEL_H
+#define _UTILS_TIMER_WHEEL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+// Hierarchical timer wheel (Varghese & Lauck) for many coarse timers driven by one periodic tick.
+// LEVELS wheels of SLOTS slots, a level covers SLOTS times the span of the level below; a timer
+// is placed by its distance from now and moves down a level when the slot of its level comes up,
+// so Schedule() is O(1) and Advance() is O(1) per tick plus the timers expired or cascaded.
+// There is no cancellation, the owner of a timer checks at expiry if it still holds (lazy deletion),
+// which spares the hot paths any bookkeeping. T is the payload carried to the expiry callback.
+template<typename T>
+class TimerWheel
+{
+public:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr size_t SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+    static constexpr uint64_t MAX_TICKS = (1ULL << (SLOT_BITS * LEVELS)) - 1;  // the longer delays are capped
+
+    TimerWheel(uint64_t now_tick=0) : now_(now_tick) {}
+
+    uint64_t Now() const { return now_; }
+    size_t Size() const { return size_; }
+
+    // expires after delay ticks, at least one
+    void Schedule(uint64_t delay, T payload) {
+        delay = delay == 0 ? 1 : (delay > MAX_TICKS ? MAX_TICKS : delay);
+        Place(Timer{ now_ + delay, std::move(payload) });
+        size_++;
+    }
+
+    // moves to now_tick tick by tick, calls on_expired(T&) for each timer due; it may Schedule() again
+    template<typename F>
+    void Advance(uint64_t now_tick, F&& on_expired) {
+        while (now_ < now_tick) {
+            now_++;
+            // the higher levels first, their timers fall into the slots about to be fired
+            for (int level = LEVELS - 1; level > 0; level--) {
+                if ((now_ & ((1ULL << (SLOT_BITS * level)) - 1)) == 0) {
+                    Cascade(level, (now_ >> (SLOT_BITS * level)) & (SLOTS - 1));
+                }
+            }
+            auto& slot = wheels_[0][now_ & (SLOTS - 1)];
+            if (slot.empty()) {
+                continue;
+            }
+            expiring_.swap(slot);
+            size_ -= expiring_.size();
+            for (auto& timer : expiring_) {
+                on_expired(timer.payload);
+            }
+            expiring_.clear();
+        }
+    }
+
+private:
+    struct Timer {
+        uint64_t expires;
+        T payload;
+    };
+
+    void Place(Timer&& timer) {
+        uint64_t delta = timer.expires - now_;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1)))) {
+            level++;
+        }
+        wheels_[level][(timer.expires >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(std::move(timer));
+    }
+
+    void Cascade(int level, size_t index) {
+        auto& slot = wheels_[level][index];
+        if (slot.empty()) {
+            return;
+        }
+        cascading_.swap(slot);
+        for (auto& timer : cascading_) {
+            Place(std::move(timer));
+        }
+        cascading_.clear();
+    }
+
+private:
+    std::vector<Timer> wheels_[LEVELS][SLOTS];
+    std::vector<Timer> expiring_;   // reused, the slots keep their capacity too
+    std::vector<Timer> cascading_;
+    uint64_t now_;
+    size_t size_ = 0;
+};
+
+#endif  // _UTILS_TIMER_WHEEL_H
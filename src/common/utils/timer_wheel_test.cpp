@@ -0,0 +1,51 @@
+#if defined(__UNITTEST__)
+
+#include <iostream>
+#include <random>
+#include <cassert>
+#include "timer_wheel.h"
+
+using std::cout; using std::endl;
+
+struct TestTimer {
+    uint64_t id;
+    uint64_t expires;
+};
+
+int main(int argc, char *argv[])
+{
+    TimerWheel<TestTimer> wheel;
+    std::mt19937_64 rng(1);
+    uint64_t n_scheduled = 0;
+    uint64_t n_expired = 0;
+    uint64_t n_rescheduled = 0;
+
+    // the delays of all levels, and the capped ones
+    for (uint64_t i = 0; i < 100000; i++) {
+        uint64_t delay = rng() % (1ULL << (rng() % 26));
+        auto expected = wheel.Now() + std::max<uint64_t>(1, std::min(delay, TimerWheel<TestTimer>::MAX_TICKS));
+        wheel.Schedule(delay, TestTimer{ i, expected });
+        n_scheduled++;
+    }
+    auto on_expired = [&](TestTimer& timer) {
+        assert(timer.expires == wheel.Now() && "a timer must fire at its tick, neither early nor late");
+        n_expired++;
+        // some are renewed from the callback, like the heartbeat checks
+        if (timer.id % 10 == 0 && n_rescheduled < 10000) {
+            uint64_t delay = 1 + rng() % 5000;
+            wheel.Schedule(delay, TestTimer{ timer.id, wheel.Now() + delay });
+            n_scheduled++;
+            n_rescheduled++;
+        }
+    };
+    // in uneven steps, as the ticks of a busy loop arrive late
+    while (wheel.Size() > 0) {
+        wheel.Advance(wheel.Now() + 1 + rng() % 1000, on_expired);
+    }
+    assert(n_expired == n_scheduled);
+    cout << "timer wheel: " << n_expired << " timers expired on time, " << n_rescheduled << " renewed, at tick "
+        << wheel.Now() << endl;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "work_stealing_pool.h"
+
+WorkStealingPool::WorkStealingPool(size_t n_workers)
+{
+    if (n_workers == 0) {
+        n_workers = 1;
+    }
+    for (size_t i = 0; i < n_workers; i++) {
+        queues_.emplace_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < n_workers; i++) {
+        workers_.emplace_back(&WorkStealingPool::Run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    Stop();
+}
+
+void WorkStealingPool::Submit(Task task)
+{
+    auto& queue = *queues_[next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    pending_.fetch_add(1, std::memory_order_release);
+    {
+        // a worker is either before its check of pending_, or waiting already
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    idle_cond_.notify_one();
+}
+
+void WorkStealingPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        stopping_ = true;
+    }
+    idle_cond_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+bool WorkStealingPool::Take(size_t index, Task& task)
+{
+    size_t n = queues_.size();
+    for (size_t k = 0; k < n; k++) {
+        auto& queue = *queues_[(index + k) % n];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        // the oldest of its own, the newest of the others
+        if (k == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::Run(size_t index)
+{
+    Task task;
+    while (true) {
+        if (Take(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        idle_cond_.wait(lock, [this]() { return stopping_ || pending_.load(std::memory_order_acquire) > 0; });
+        if (stopping_ && pending_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+#if defined(__UNITTEST__)
+#include <iostream>
+#include <chrono>
+#include <cassert>
+
+int main()
+{
+    const int n_tasks = 100000;
+    std::atomic<int> done{0};
+    std::atomic<bool> is_released{false};
+    {
+        WorkStealingPool pool(4);
+        // a stalled task holds up its worker only, the others steal the tasks queued behind it,
+        // it is released after all of them ran
+        pool.Submit([&is_released]() {
+            while (! is_released) {
+                std::this_thread::yield();
+            }
+        });
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < n_tasks; i++) {
+            pool.Submit([&done]() { done++; });
+        }
+        while (done < n_tasks) {
+            std::this_thread::yield();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        is_released = true;
+        std::cout << "work stealing pool: " << done << " tasks in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() << " us" << std::endl;
+
+        pool.Submit([&done]() { done++; });
+    }   // Stop() runs the submitted tasks
+    assert(done == n_tasks + 1);
+    return 0;
+}
+#endif
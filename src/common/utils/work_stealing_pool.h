@@ -0,0 +1,52 @@
+#ifndef _UTILS_WORK_STEALING_POOL_H
+#define _UTILS_WORK_STEALING_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <functional>
+
+// Fixed pool of worker threads, each with its own queue of tasks. The tasks are spread
+// over the queues round-robin, a worker takes from the front of its own queue and, when
+// it runs dry, steals from the back of the others, so one slow task holds up only its worker.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void ()>;
+
+    WorkStealingPool(size_t n_workers);
+    ~WorkStealingPool();    // Stop()
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void Submit(Task task);     // from any thread
+    void Stop();                // runs the tasks submitted already, then joins the workers
+    size_t Workers() const { return queues_.size(); }
+    size_t Pending() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+    struct WorkerQueue {
+        std::mutex          mutex;
+        std::deque<Task>    tasks;
+    };
+
+    void Run(size_t index);
+    bool Take(size_t index, Task& task);
+
+private:
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread>    workers_;
+    std::atomic<size_t>         next_queue_{0};
+    std::atomic<size_t>         pending_{0};     // submitted and not taken yet
+    std::mutex                  idle_mutex_;
+    std::condition_variable     idle_cond_;
+    bool                        stopping_ = false;   // guarded by idle_mutex_
+};
+
+#endif  // _UTILS_WORK_STEALING_POOL_H
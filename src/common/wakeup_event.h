@@ -0,0 +1,33 @@
+#ifndef _WAKEUP_EVENT_H
+#define _WAKEUP_EVENT_H
+
+#include <unistd.h>
+#include <functional>
+#include <eventloop/el.h>
+
+// Watch an eventfd kicked to run work on the event loop, by other threads handing it over,
+// or by the loop itself to defer work to the next iteration
+class WakeupEvent : public evt_loop::IOEvent {
+public:
+    WakeupEvent(int fd, const std::function<void ()>& cb) :
+        IOEvent(IOEvent::READ), cb_(cb)
+    {
+        SetFD(fd);
+        EV_Singleton->AddEvent(this);
+    }
+    ~WakeupEvent() {
+        EV_Singleton->DeleteEvent(this);
+    }
+
+protected:
+    void OnEvents(uint32_t events) {
+        uint64_t counter;
+        while (read(FD(), &counter, sizeof(counter)) > 0) {}
+        cb_();
+    }
+
+private:
+    std::function<void ()> cb_;
+};
+
+#endif  // _WAKEUP_EVENT_H
@@ -0,0 +1,9 @@
+# libFuzzer targets, requires clang, e.g.: sh build.sh && ./fuzz_command_frame -max_len=4096 corpus_frame/
+# fuzz_command_frame runs the server on the in-memory EventLoop of ../sim, which comes first in the include paths
+ThirdParty=../../thirdparty
+CXX="clang++ -std=c++20 -g -O1 -fsanitize=fuzzer,address,undefined"
+CXXFLAGS="-I../common -I../server -I$ThirdParty/json/include"
+SIM_CXXFLAGS="-I../sim $CXXFLAGS -I$ThirdParty/argparse/include -I$ThirdParty/toml11/include"
+SERVER=$(ls ../server/*.cpp ../common/*.cpp ../common/utils/*.cpp | grep -v -e '/switch\.cpp$' -e '_test\.cpp$')
+$CXX $SIM_CXXFLAGS -o fuzz_command_frame fuzz_command_frame.cpp $SERVER -lcrypto
+$CXX $CXXFLAGS -o fuzz_json_decoders fuzz_json_decoders.cpp ../common/command_messages_json.cpp
@@ -0,0 +1 @@
+rm fuzz_command_frame fuzz_json_decoders
@@ -0,0 +1,122 @@
+// libFuzzer target over raw frames, fed to CommandHandler::handleCommand of a SwitchServer
+// running on the in-memory EventLoop of ../sim/eventloop. The first byte picks the sender:
+// a connection not registered yet, or a registered normal, admin or service endpoint, so
+// the handlers behind REG are reached too. The rest is the frame, as read from the network.
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include "switch_server.h"
+#include "switch_context.h"
+#include "command_messages.h"
+
+using namespace evt_loop;
+
+struct FuzzEndpoint {
+    EndpointId      id;
+    EEndpointRole   role;
+    const char*     access_code;
+    TcpConnection*  conn = nullptr;
+};
+
+static SwitchServer* switch_server = nullptr;
+static SwitchConfigPtr initial_config;
+static TcpConnection* unregistered_conn = nullptr;
+static FuzzEndpoint endpoints[] = {
+    { 1, EEndpointRole::Normal, DEFAULT_ACCESS_TOKEN },
+    { 2, EEndpointRole::Admin, DEFAULT_ADMIN_TOKEN },
+    { 3, EEndpointRole::Service, DEFAULT_SERVICE_ACCESS_TOKEN },
+};
+
+static void receive_frame(TcpConnection* conn, ECommand cmd, const string& payload)
+{
+    CommandMessage cmdMsg;
+    cmdMsg.SetCommand(cmd);
+    cmdMsg.SetToJSON();
+    cmdMsg.SetPayloadLen(payload.size());
+    cmdMsg.ConvertToNetworkMessage(switch_server->IsMessagePayloadLengthIncludingSelf());
+
+    string frame((char*)&cmdMsg, sizeof(cmdMsg));
+    frame.append(payload);
+    conn->Receive(frame);
+}
+
+// taking the tx data drains the output queue into it, until both are empty
+static void discard_tx_data(TcpConnection* conn)
+{
+    while (! conn->TakeTxData().empty()) {
+    }
+}
+
+static bool is_registered(const FuzzEndpoint& ep)
+{
+    auto& context_endpoints = switch_server->GetContext()->endpoints;
+    auto iter = context_endpoints.find(ep.id);
+    return ep.conn && ! ep.conn->IsClosed() && iter != context_endpoints.end() &&
+        iter->second->Connection() == ep.conn;
+}
+
+// undo what the last input changed: the config set by SETUP, the endpoints kicked out or
+// taken over by a REG of the same id, and the connection it registered
+static void reset_switch()
+{
+    switch_server->GetContext()->UpdateConfig(initial_config);
+    auto network = SimNetwork::Instance().Server();
+    if (! unregistered_conn || unregistered_conn->IsClosed() || unregistered_conn->ID() != 0) {
+        if (unregistered_conn) {
+            unregistered_conn->Disconnect();
+        }
+        unregistered_conn = network->Accept();
+    }
+
+    bool is_all_registered = true;
+    for (auto& ep : endpoints) {
+        is_all_registered = is_all_registered && is_registered(ep);
+    }
+    if (is_all_registered) {
+        return;
+    }
+    for (auto& ep : endpoints) {
+        if (ep.conn) {
+            ep.conn->Disconnect();
+        }
+    }
+    for (auto& ep : endpoints) {
+        ep.conn = network->Accept();
+        CommandRegister reg_cmd;
+        reg_cmd.id = ep.id;
+        reg_cmd.role = (role_id_t)ep.role;
+        reg_cmd.access_code = ep.access_code;
+        reg_cmd.svc_type = 1;
+        receive_frame(ep.conn, ECommand::REG, reg_cmd.encodeToJSON());
+        discard_tx_data(ep.conn);
+    }
+}
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+    // the handlers log each frame, keep the errors only
+    if (! freopen("/dev/null", "w", stdout)) {
+        perror("freopen");
+    }
+    switch_server = new SwitchServer("127.0.0.1", 0);
+    initial_config = switch_server->GetContext()->Config();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size < 1) {
+        return 0;
+    }
+    reset_switch();
+
+    size_t sender = data[0] % (std::size(endpoints) + 1);
+    auto conn = sender == 0 ? unregistered_conn : endpoints[sender - 1].conn;
+    conn->Receive(string((const char*)data + 1, size - 1));
+
+    discard_tx_data(unregistered_conn);
+    for (auto& ep : endpoints) {
+        discard_tx_data(ep.conn);
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+// libFuzzer target over each decodeFromJSON, the first byte selects the decoder.
+// A decoder must return false on malformed input, never throw.
+#include <cstdint>
+#include "command_messages.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size < 1) {
+        return 0;
+    }
+    string payload((const char*)data + 1, size - 1);
+    switch (data[0] % 10) {
+        case 0: { CommandRegister cmd; cmd.decodeFromJSON(payload); break; }
+        case 1: { CommandResultRegister cmd; cmd.decodeFromJSON(payload); break; }
+        case 2: { CommandForward cmd; cmd.decodeFromJSON(payload); break; }
+        case 3: { CommandSubUnsubRejUnrej cmd; cmd.decodeFromJSON(payload); break; }
+        case 4: { CommandInfoReq cmd; cmd.decodeFromJSON(payload); break; }
+        case 5: { CommandInfo cmd; cmd.decodeFromJSON(payload); break; }
+        case 6: { CommandEndpointInfo cmd; cmd.decodeFromJSON(payload); break; }
+        case 7: { CommandSetup cmd; cmd.decodeFromJSON(payload); break; }
+        case 8: { CommandKickout cmd; cmd.decodeFromJSON(payload); break; }
+        case 9: { CommandJoinLeave cmd; cmd.decodeFromJSON(payload); break; }
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+#include "sc_blocking_client.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <eventloop/el.h>
+#include "command_messages.h"
+#include "sc_command_handler.h"
+#include "switch_client.h"
+#include "sc_context.h"
+#include "wakeup_event.h"
+
+using namespace evt_loop;
+
+static const char* MOD_NAME = "blocking_client";
+static const size_t MAX_COALESCED_BYTES = 64 * 1024;   // flush the batch of frames if more than this
+
+SCBlockingClient::SCBlockingClient(const SCOptions& options) :
+    options_(options)
+{
+    options_.enable_console = false;  // the console takes over stdin, it is not for embedding
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+SCBlockingClient::~SCBlockingClient()
+{
+    Stop();
+    close(wakeup_fd_);
+}
+
+bool SCBlockingClient::Start(int timeout_ms)
+{
+    if (io_thread_.joinable()) {
+        return is_registered_;
+    }
+    stopping_ = false;
+    io_thread_ = std::thread(&SCBlockingClient::Run, this);
+
+    std::unique_lock<std::mutex> lock(reg_mutex_);
+    reg_cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return is_registered_.load(); });
+    return is_registered_;
+}
+
+void SCBlockingClient::Stop()
+{
+    if (! io_thread_.joinable()) {
+        return;
+    }
+    {
+        // under the lock, or a Receive() between its check and its wait misses the notification
+        std::lock_guard<std::mutex> lock(inbound_mutex_);
+        stopping_ = true;
+    }
+    inbound_cond_.notify_all();
+    Wakeup();
+    io_thread_.join();
+
+    is_registered_ = false;
+}
+
+void SCBlockingClient::Publish(const string& data, const vector<EndpointId>& targets, MessageId msg_type,
+        EMessagePriority priority, uint32_t ttl_ms, uint32_t key, const MessageAttributes& attrs)
+{
+    OutboundRequest req;
+    req.cmd = ECommand::PUBLISH;
+    req.data = data;
+    req.targets = targets;
+    req.msg_type = msg_type;
+    req.priority = priority;
+    req.ttl_ms = ttl_ms;
+    req.key = key;
+    req.attrs = attrs;
+    outbound_queue_.Push(std::move(req));
+    Wakeup();
+}
+
+std::pair<int, string>
+SCBlockingClient::CallService(const string& data, ServiceType svc_type, MessageId svc_cmd, int timeout_ms)
+{
+    if (stopping_) {
+        return { 1, "Client is stopped" };
+    }
+    OutboundRequest req;
+    req.cmd = ECommand::SVC;
+    req.data = data;
+    req.msg_type = svc_cmd;
+    req.svc_type = svc_type;
+    req.timeout_ms = timeout_ms;
+    req.result = std::make_shared<std::promise<ServiceResult>>();
+    auto result = req.result->get_future();
+    outbound_queue_.Push(std::move(req));
+    Wakeup();
+
+    // the call times out on the I/O thread, this wait only covers a request that raced with Stop()
+    if (result.wait_for(std::chrono::milliseconds(timeout_ms)) != std::future_status::ready) {
+        return { 1, "Timeout of waiting service response" };
+    }
+    return result.get();
+}
+
+bool SCBlockingClient::Receive(SCInboundMessage& msg, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(inbound_mutex_);
+    auto is_ready = [this]() { return ! inbound_queue_.empty() || stopping_.load(); };
+    if (timeout_ms < 0) {
+        inbound_cond_.wait(lock, is_ready);
+    } else {
+        inbound_cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), is_ready);
+    }
+    if (inbound_queue_.empty()) {
+        return false;
+    }
+    msg = std::move(inbound_queue_.front());
+    inbound_queue_.pop_front();
+    return true;
+}
+
+void SCBlockingClient::Wakeup()
+{
+    // only the first producer after a drain pays for the syscall
+    if (! wakeup_pending_.exchange(true)) {
+        uint64_t one = 1;
+        ssize_t n = write(wakeup_fd_, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+void SCBlockingClient::Run()
+{
+    client_ = new SwitchClient(&options_);
+    auto cmd_handler = client_->GetCommandHandler();
+    cmd_handler->SetRegisterResultHandlerCallback(
+            MOD_NAME,
+            std::bind(&SCBlockingClient::OnRegisterResult, this, std::placeholders::_1));
+    cmd_handler->SetPublishingDataHandlerCallback(
+            MOD_NAME,
+            std::bind(&SCBlockingClient::OnPublishingData, this,
+                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    wakeup_event_ = new WakeupEvent(wakeup_fd_, std::bind(&SCBlockingClient::OnWakeup, this));
+
+    client_->Start();  // run event loop until Stop()
+
+    // the calls in flight, and those queued after the last drain, never get a response
+    cmd_handler->AbortServiceCalls("Client is stopped");
+    OutboundRequest req;
+    while (outbound_queue_.Pop(req)) {
+        if (req.result) {
+            req.result->set_value({ 1, "Client is stopped" });
+        }
+    }
+
+    delete wakeup_event_;
+    wakeup_event_ = nullptr;
+    delete client_;
+    client_ = nullptr;
+}
+
+void SCBlockingClient::OnWakeup()
+{
+    // clear the flag before draining, so a push racing with the drain kicks us again
+    wakeup_pending_ = false;
+
+    auto cmd_handler = client_->GetCommandHandler();
+    bool is_ready = client_->IsConnected() && client_->GetContext()->is_registered;
+    string frames;
+    OutboundRequest req;
+    while (outbound_queue_.Pop(req)) {
+        switch (req.cmd) {
+            case ECommand::PUBLISH:
+                if (! is_ready) {
+                    cmd_handler->Publish(req.data, req.targets, req.msg_type);  // goes to outbox
+                    break;
+                }
+                frames.append(cmd_handler->EncodePublishMessage(req.data, req.targets, req.msg_type, req.priority,
+                            req.ttl_ms, req.key, req.attrs));
+                break;
+            case ECommand::SVC: {
+                if (! client_->IsConnected()) {
+                    req.result->set_value({ 1, "Not connected to Switch" });
+                    break;
+                }
+                // in the one table of pipelined calls of the handler, completed by its response, its
+                // deadline or the close of the connection
+                auto result = req.result;
+                uint32_t sess_id = cmd_handler->AddServiceCall(
+                        [result](int8_t errcode, const char* data, size_t data_len, int64_t) {
+                            result->set_value({ errcode, string(data ? data : "", data ? data_len : 0) });
+                        }, req.timeout_ms);
+                frames.append(cmd_handler->EncodeServiceRequest(req.data, req.svc_type, req.msg_type, sess_id));
+                break;
+            }
+            default:
+                break;
+        }
+        if (frames.size() >= MAX_COALESCED_BYTES) {
+            cmd_handler->SendRawData(frames);
+            frames.clear();
+        }
+    }
+    if (! frames.empty()) {
+        cmd_handler->SendRawData(frames);
+    }
+
+    if (stopping_) {
+        client_->Stop();
+    }
+}
+
+void SCBlockingClient::OnRegisterResult(const CommandResultRegister* reg_result)
+{
+    endpoint_id_ = reg_result->id;
+    {
+        std::lock_guard<std::mutex> lock(reg_mutex_);
+        is_registered_ = true;
+    }
+    reg_cond_.notify_all();
+}
+
+void SCBlockingClient::OnPublishingData(const PublishingMessage* pub_msg, const char* data, size_t data_len)
+{
+    SCInboundMessage msg;
+    if (pub_msg) {
+        msg.source = pub_msg->source;
+        msg.msg_type = pub_msg->msg_type;
+    }
+    msg.data.assign(data, data_len);
+    {
+        std::lock_guard<std::mutex> lock(inbound_mutex_);
+        inbound_queue_.push_back(std::move(msg));
+    }
+    inbound_cond_.notify_one();
+}
@@ -0,0 +1,98 @@
+#ifndef _SC_BLOCKING_CLIENT_H
+#define _SC_BLOCKING_CLIENT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <future>
+#include "switch_message.h"
+#include "message_attributes.h"
+#include "sc_options.h"
+#include "utils/mpsc_queue.h"
+
+using std::string;
+using std::vector;
+
+class SwitchClient;
+class WakeupEvent;
+class CommandResultRegister;
+
+// The message published by other endpoints, handed to application threads by Receive()
+struct SCInboundMessage {
+    EndpointId  source = 0;
+    MessageId   msg_type = 0;
+    string      data;
+};
+
+// Thread-safe facade of SwitchClient for plain multithreaded applications.
+// The event loop runs on a dedicated I/O thread, any application thread can publish or
+// call services, the requests are pushed onto a lock-free queue and the I/O thread drains
+// them, coalescing the frames into one write. The service calls are the pipelined calls of
+// SCCommandHandler, completed on the I/O thread.
+class SCBlockingClient {
+public:
+    SCBlockingClient(const SCOptions& options);
+    ~SCBlockingClient();
+
+    // start the I/O thread and wait until the client registered to Switch
+    bool Start(int timeout_ms=5000);
+    void Stop();
+    bool IsRegistered() const { return is_registered_; }
+    EndpointId ID() const { return endpoint_id_; }
+
+    // thread-safe
+    void Publish(const string& data, const vector<EndpointId>& targets={}, MessageId msg_type=0,
+            EMessagePriority priority=EMessagePriority::Normal, uint32_t ttl_ms=0, uint32_t key=0,
+            const MessageAttributes& attrs={});
+    std::pair<int, string> CallService(const string& data, ServiceType svc_type, MessageId svc_cmd, int timeout_ms=5000);
+    bool Receive(SCInboundMessage& msg, int timeout_ms=-1);  // -1: wait forever
+
+private:
+    using ServiceResult = std::pair<int, string>;
+    struct OutboundRequest {
+        ECommand            cmd = ECommand::UNDEFINED;
+        string              data;
+        vector<EndpointId>  targets;
+        MessageId           msg_type = 0;   // message type of PUBLISH_2, or svc_cmd of SVC
+        ServiceType         svc_type = 0;
+        EMessagePriority    priority = EMessagePriority::Normal;
+        uint32_t            ttl_ms = 0;
+        uint32_t            key = 0;        // key of value, for last-value cache of Switch
+        MessageAttributes   attrs;          // for the content filters of subscribers
+        uint32_t            timeout_ms = 0; // of SVC
+        std::shared_ptr<std::promise<ServiceResult>> result;   // of SVC, completed on the I/O thread
+    };
+
+    void Run();
+    void Wakeup();
+    void OnWakeup();
+    void OnRegisterResult(const CommandResultRegister* reg_result);
+    void OnPublishingData(const PublishingMessage* pub_msg, const char* data, size_t data_len);
+
+private:
+    SCOptions               options_;
+    SwitchClient*           client_ = nullptr;      // owned by I/O thread
+    WakeupEvent*            wakeup_event_ = nullptr;
+    int                     wakeup_fd_ = -1;
+    std::atomic<bool>       wakeup_pending_{false};
+    std::atomic<bool>       stopping_{false};
+    std::thread             io_thread_;
+
+    std::atomic<bool>       is_registered_{false};
+    std::atomic<EndpointId> endpoint_id_{0};
+    std::mutex              reg_mutex_;
+    std::condition_variable reg_cond_;
+
+    MpscQueue<OutboundRequest> outbound_queue_;
+
+    std::mutex                  inbound_mutex_;
+    std::condition_variable     inbound_cond_;
+    std::deque<SCInboundMessage> inbound_queue_;
+};
+
+#endif  // _SC_BLOCKING_CLIENT_H
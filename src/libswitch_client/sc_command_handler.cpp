@@ -1,14 +1,50 @@
 #include "sc_command_handler.h"
 #include <cassert>
 #include <limits.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include <eventloop/tcp_connection.h>
 #include "command_messages.h"
 #include "switch_client.h"
 #include "sc_context.h"
+#include "sc_options.h"
+#include "compression.h"
+#include "wakeup_event.h"
 #include "utils/random.h"
+#include "utils/work_stealing_pool.h"
 
 using namespace evt_loop;
 
+// the sess_ids of CallService, RequestService picks them below INT_MAX
+const uint32_t PIPELINED_SESS_ID_FLAG = 0x80000000;
+static const size_t MAX_COALESCED_BYTES = 64 * 1024;   // flush the batch of responses if more than this
+
+SCCommandHandler::~SCCommandHandler()
+{
+    if (svc_workers_) {
+        delete svc_workers_;    // joins the workers, before the queue they post to is gone
+        svc_workers_ = nullptr;
+        delete svc_rsp_event_;
+        svc_rsp_event_ = nullptr;
+        close(svc_rsp_fd_);
+    }
+}
+
+void SCCommandHandler::EnableServiceWorkers(size_t n_workers)
+{
+    if (svc_workers_ || n_workers == 0) {
+        return;
+    }
+    svc_rsp_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (svc_rsp_fd_ < 0) {
+        fprintf(stderr, "[SCCommandHandler] Error: eventfd: %s, service requests are handled inline\n", strerror(errno));
+        return;
+    }
+    svc_rsp_event_ = new WakeupEvent(svc_rsp_fd_, std::bind(&SCCommandHandler::FlushServiceResponses, this));
+    svc_workers_ = new WorkStealingPool(n_workers);
+    printf("[SCCommandHandler] service requests are handled by %ld workers\n", n_workers);
+}
+
 void SCCommandHandler::Echo(const char* content)
 {
     size_t sent_bytes = SendCommandMessage(ECommand::ECHO, content);
@@ -19,7 +55,7 @@ void SCCommandHandler::Echo(const char* content)
 }
 
 void SCCommandHandler::Register(EndpointId ep_id, EEndpointRole ep_role,
-        const string& access_code, bool with_token, ServiceType svc_type)
+        const string& access_code, bool with_token, ServiceType svc_type, bool with_state)
 {
     CommandRegister reg_cmd;
     reg_cmd.id = ep_id > 0 ? ep_id : client_->GetContext()->endpoint_id;
@@ -33,6 +69,29 @@ void SCCommandHandler::Register(EndpointId ep_id, EEndpointRole ep_role,
         reg_cmd.token = token;
     }
     reg_cmd.svc_type = (ServiceType)svc_type;
+    if (with_state) {
+        // replay the forwarding and subscription state along with REG
+        auto context = client_->GetContext();
+        reg_cmd.with_state = true;
+        reg_cmd.state.fwd_targets.assign(context->fwd_targets.begin(), context->fwd_targets.end());
+        reg_cmd.state.subs_sources.assign(context->subs_sources.begin(), context->subs_sources.end());
+        reg_cmd.state.rej_sources.assign(context->rej_sources.begin(), context->rej_sources.end());
+        reg_cmd.state.subs_messages.assign(context->subs_messages.begin(), context->subs_messages.end());
+        reg_cmd.state.rej_messages.assign(context->rej_messages.begin(), context->rej_messages.end());
+        reg_cmd.state.conflated_messages.assign(context->conflated_messages.begin(), context->conflated_messages.end());
+        reg_cmd.state.filters.insert(context->message_filters.begin(), context->message_filters.end());
+        reg_cmd.state.groups.assign(context->groups.begin(), context->groups.end());
+    }
+    auto options = client_->GetOptions();
+    if (options) {
+        // offer the built in ones, Switch selects one of them
+        for (auto& tag : options->compressions) {
+            auto compression = TagToCompression(tag);
+            if (compression != ECompression::None && IsCompressionSupported(compression)) {
+                reg_cmd.compressions.push_back(tag);
+            }
+        }
+    }
 
     // change service type and/or endpoint role
     client_->GetContext()->role = ep_role;
@@ -68,6 +127,8 @@ void SCCommandHandler::GetInfo(bool is_details, EndpointId ep_id)
 void SCCommandHandler::ForwardTargets(const vector<EndpointId>& targets)
 {
     //string content(R"({"targets": [1, 2]})");
+    client_->GetContext()->SetForwardTargets(targets);
+
     CommandForward cmd_fwd;
     cmd_fwd.targets = targets;
     auto content = cmd_fwd.encodeToJSON();
@@ -77,8 +138,36 @@ void SCCommandHandler::ForwardTargets(const vector<EndpointId>& targets)
     }
 }
 
+void SCCommandHandler::JoinGroups(const vector<GroupId>& groups)
+{
+    client_->GetContext()->SetJoinedGroups(groups);
+
+    CommandJoin cmd_join;
+    cmd_join.groups = groups;
+    auto content = cmd_join.encodeToJSON();
+    size_t sent_bytes = SendCommandMessage(ECommand::JOIN, content);
+    if (sent_bytes > 0) {
+        printf("Sent JOIN message, content: %s\n", content.c_str());
+    }
+}
+
+void SCCommandHandler::LeaveGroups(const vector<GroupId>& groups)
+{
+    client_->GetContext()->RemoveJoinedGroups(groups);
+
+    CommandLeave cmd_leave;
+    cmd_leave.groups = groups;
+    auto content = cmd_leave.encodeToJSON();
+    size_t sent_bytes = SendCommandMessage(ECommand::LEAVE, content);
+    if (sent_bytes > 0) {
+        printf("Sent LEAVE message, content: %s\n", content.c_str());
+    }
+}
+
 void SCCommandHandler::UnforwardTargets(const vector<EndpointId>& targets)
 {
+    client_->GetContext()->RemoveForwardTargets(targets);
+
     CommandUnforward cmd_unfwd;
     cmd_unfwd.targets = targets;
     auto content = cmd_unfwd.encodeToJSON();
@@ -88,32 +177,68 @@ void SCCommandHandler::UnforwardTargets(const vector<EndpointId>& targets)
     }
 }
 
-void SCCommandHandler::Subscribe(const vector<EndpointId>& sources, const vector<MessageId>& messages)
+void SCCommandHandler::Subscribe(const vector<EndpointId>& sources, const vector<MessageId>& messages, bool conflate,
+        const string& filter)
 {
-    SubUnsubRejUnrej<CommandSubscribe>(ECommand::SUB, sources, messages);
+    client_->GetContext()->SetSubscribedSources(sources);
+    client_->GetContext()->SetSubscribedMessages(messages);
+    if (conflate) {
+        client_->GetContext()->SetConflatedMessages(messages);
+    } else {
+        client_->GetContext()->RemoveConflatedMessages(messages);
+    }
+    client_->GetContext()->SetMessageFilter(messages, filter);
+    SubUnsubRejUnrej<CommandSubscribe>(ECommand::SUB, sources, messages, conflate, filter);
 }
 
 void SCCommandHandler::Unsubscribe(const vector<EndpointId>& sources, const vector<MessageId>& messages)
 {
+    client_->GetContext()->RemoveSubscribedSources(sources);
+    client_->GetContext()->RemoveSubscribedMessages(messages);
+    client_->GetContext()->RemoveConflatedMessages(messages);
+    client_->GetContext()->SetMessageFilter(messages, "");
     SubUnsubRejUnrej<CommandUnsubscribe>(ECommand::UNSUB, sources, messages);
 }
 
 void SCCommandHandler::Reject(const vector<EndpointId>& sources, const vector<MessageId>& messages)
 {
+    client_->GetContext()->SetRejectedSources(sources);
+    client_->GetContext()->SetRejectedMessages(messages);
     SubUnsubRejUnrej<CommandReject>(ECommand::REJECT, sources, messages);
 }
 
 void SCCommandHandler::Unreject(const vector<EndpointId>& sources, const vector<MessageId>& messages)
 {
+    client_->GetContext()->RemoveRejectedSources(sources);
+    client_->GetContext()->RemoveRejectedMessages(messages);
     SubUnsubRejUnrej<CommandUnreject>(ECommand::UNREJECT, sources, messages);
 }
 
+void SCCommandHandler::SetSubscriptionState(CommandSubscriptionState& cmd_state)
+{
+    client_->GetContext()->ApplySubscriptionState(cmd_state);
+    if (! client_->IsConnected()) {
+        printf("The connection was disconnected! Do nothing.\n");
+        return;
+    }
+    string frame = EncodeCommandMessage(ECommand::SUBSTATE, cmd_state.encodeToBinary());
+    ((CommandMessage*)frame.data())->ResetCodec();  // binary payload
+    size_t sent_bytes = SendRawData(frame);
+    if (sent_bytes > 0) {
+        printf("Sent SUBSTATE message, %s, subscribed messages: %ld, size: %ld\n",
+                cmd_state.is_full ? "full" : "delta", cmd_state.add.subs_messages.size(), sent_bytes);
+    }
+}
+
 template<typename T>
-void SCCommandHandler::SubUnsubRejUnrej(ECommand cmd, const vector<EndpointId>& sources, const vector<MessageId>& messages)
+void SCCommandHandler::SubUnsubRejUnrej(ECommand cmd, const vector<EndpointId>& sources, const vector<MessageId>& messages,
+        bool conflate, const string& filter)
 {
     T cmd_obj;
     cmd_obj.sources = sources;
     cmd_obj.messages = messages;
+    cmd_obj.conflate = conflate;
+    cmd_obj.filter = filter;
     auto content = cmd_obj.encodeToJSON();
     size_t sent_bytes = SendCommandMessage(cmd, content);
     if (sent_bytes > 0) {
@@ -123,40 +248,110 @@ void SCCommandHandler::SubUnsubRejUnrej(ECommand cmd, const vector<EndpointId>&
 
 void SCCommandHandler::Publish(const string& data, const vector<EndpointId> targets, MessageId msg_type)
 {
-    auto cmd = ECommand::PUBLISH;
-    string pub_msg_bytes;
-    if (! targets.empty() || msg_type > 0) {
-        cmd = ECommand::PUBLISH_2;
-        PublishingMessage pub_msg;
-        pub_msg.msg_type = msg_type;
-        pub_msg.source = client_->GetContext()->endpoint_id;
-        pub_msg.n_targets = targets.size();
-
-        pub_msg_bytes.append((char*)&pub_msg, sizeof(pub_msg));
-        pub_msg_bytes.append((char*)targets.data(), targets.size() * sizeof(targets[0]));
+    if (! client_->IsConnected() || ! client_->GetContext()->is_registered) {
+        auto options = client_->GetOptions();
+        size_t outbox_size = options ? options->outbox_size : 0;
+        if (outbox_size == 0) {
+            printf("The connection was disconnected! Do nothing.\n");
+            return;
+        }
+        if (outbox_.size() >= outbox_size) {
+            outbox_.pop_front();  // drop the oldest
+            outbox_dropped_++;
+        }
+        outbox_.push_back({ data, targets, msg_type });
+        printf("Not registered yet, put PUBLISH message to outbox, outbox size: %ld, dropped: %ld\n",
+                outbox_.size(), outbox_dropped_);
+        return;
     }
 
-    size_t sent_bytes = SendCommandMessage(cmd, data, pub_msg_bytes);
+    size_t sent_bytes = SendRawData(EncodePublishMessage(data, targets, msg_type));
     if (sent_bytes > 0) {
         printf("Sent PUBLISH/PUBLISH_2 message, content size(%ld):\n", data.size());
         cout << DumpHexWithChars(data, evt_loop::DUMP_MAX_BYTES) << endl;
     }
 }
 
-void SCCommandHandler::RequestService(const string& data, ServiceType svc_type, MessageId svc_cmd, uint32_t sess_id)
+uint32_t SCCommandHandler::RequestService(const string& data, ServiceType svc_type, MessageId svc_cmd, uint32_t sess_id)
 {
-    ServiceMessage svc_msg;
-    svc_msg.svc_type = svc_type;
-    svc_msg.svc_cmd = svc_cmd;
-    svc_msg.sess_id = sess_id > 0 ? sess_id : generate_random_integer(1, INT_MAX);
-    svc_msg.source = client_->GetContext()->endpoint_id;
-    //svc_msg.svc_type = svc_type > 0 ? svc_type : client_->GetContext()->svc_type;
-    string svc_msg_bytes((char*)&svc_msg, sizeof(svc_msg));
-    size_t sent_bytes = SendCommandMessage(ECommand::SVC, data, svc_msg_bytes);
+    if (sess_id == 0) {
+        sess_id = generate_random_integer(1, INT_MAX);
+    }
+    size_t sent_bytes = SendRawData(EncodeServiceRequest(data, svc_type, svc_cmd, sess_id));
     printf("Sent SVC message, content size(%ld):\n", data.size());
     if (sent_bytes > 0) {
         cout << DumpHexWithChars(data, evt_loop::DUMP_MAX_BYTES) << endl;
     }
+    return sess_id;
+}
+
+uint32_t SCCommandHandler::CallService(const string& data, ServiceType svc_type, MessageId svc_cmd,
+        const ServiceCompletionCallback& cb, uint32_t timeout_ms)
+{
+    if (! client_->IsConnected()) {
+        return 0;
+    }
+    uint32_t sess_id = AddServiceCall(cb, timeout_ms);
+    // no logging per call, at full pipeline depth it would cost more than the call
+    client_->Connection()->Send(EncodeServiceRequest(data, svc_type, svc_cmd, sess_id));
+    return sess_id;
+}
+
+uint32_t SCCommandHandler::AddServiceCall(const ServiceCompletionCallback& cb, uint32_t timeout_ms)
+{
+    uint32_t sess_id;
+    do {
+        next_call_id_ = (next_call_id_ + 1) & ~PIPELINED_SESS_ID_FLAG;
+        sess_id = PIPELINED_SESS_ID_FLAG | next_call_id_;
+    } while (inflight_calls_.count(sess_id) > 0);
+
+    auto now = std::chrono::steady_clock::now();
+    auto& call = inflight_calls_[sess_id];
+    call.cb = cb;
+    call.sent_at = now;
+    call.deadline = call_deadlines_.emplace(now + std::chrono::milliseconds(timeout_ms), sess_id);
+    return sess_id;
+}
+
+void SCCommandHandler::CompleteServiceCall(uint32_t sess_id, int8_t errcode, const char* data, size_t data_len)
+{
+    auto iter = inflight_calls_.find(sess_id);
+    if (iter == inflight_calls_.end()) {
+        return;  // expired already
+    }
+    auto elapsed = std::chrono::steady_clock::now() - iter->second.sent_at;
+    auto cb = std::move(iter->second.cb);
+    call_deadlines_.erase(iter->second.deadline);
+    inflight_calls_.erase(iter);
+    // the callback may call services again
+    if (cb) {
+        cb(errcode, data, data_len, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+}
+
+void SCCommandHandler::ExpireServiceCalls()
+{
+    static const char reason[] = "Timeout of waiting service response";
+    auto now = std::chrono::steady_clock::now();
+    while (! call_deadlines_.empty() && call_deadlines_.begin()->first <= now) {
+        CompleteServiceCall(call_deadlines_.begin()->second, 1, reason, sizeof(reason) - 1);
+    }
+}
+
+void SCCommandHandler::AbortServiceCalls(const char* reason)
+{
+    if (inflight_calls_.empty()) {
+        return;
+    }
+    printf("[SCCommandHandler] aborted %ld service calls: %s\n", inflight_calls_.size(), reason);
+    vector<uint32_t> sess_ids;
+    sess_ids.reserve(inflight_calls_.size());
+    for (auto& [sess_id, _] : inflight_calls_) {
+        sess_ids.push_back(sess_id);
+    }
+    for (auto sess_id : sess_ids) {
+        CompleteServiceCall(sess_id, 1, reason, strlen(reason));
+    }
 }
 
 void SCCommandHandler::Setup(const string& access_code, const string& new_admin_code,
@@ -207,32 +402,115 @@ size_t SCCommandHandler::SendCommandMessage(TcpConnection* conn, ECommand cmd, c
         return 0;
     }
 
-    CommandMessage cmdMsg;
-    cmdMsg.SetCommand(cmd);
-    cmdMsg.SetToJSON();
-    cmdMsg.SetPayloadLen(payload.size() + hdr_ext.size());
-    cmdMsg.ConvertToNetworkMessage(is_payload_len_including_self_);
-    cout << "Send command message bytes size: " << sizeof(cmdMsg) << endl;
+    string frame = EncodeCommandMessage(cmd, payload, hdr_ext);
+    cout << "Send command message bytes size: " << CommandMessage::HeaderSize() << endl;
     cout << "Send command message bytes:" << endl;
-    cout << DumpHex(string((char*)&cmdMsg, sizeof(cmdMsg))) << endl;
-
-    conn->Send((char*)&cmdMsg, sizeof(cmdMsg));
-    size_t sent_bytes = sizeof(cmdMsg);
+    cout << DumpHex(frame.substr(0, CommandMessage::HeaderSize())) << endl;
     if (! hdr_ext.empty()) {
-        conn->Send(hdr_ext);
-        sent_bytes += hdr_ext.size();
         cout << DumpHex(hdr_ext) << endl;
     }
     if (! payload.empty()) {
-        conn->Send(payload);
-        sent_bytes += payload.size();
         cout << DumpHex(payload) << endl;
     }
+
+    conn->Send(frame);
+    size_t sent_bytes = frame.size();
     cout << "Send command message total bytes size: " << sent_bytes << endl;
 
     return sent_bytes;
 }
 
+string SCCommandHandler::EncodeCommandMessage(ECommand cmd, const string& payload, const string& hdr_ext,
+        EMessagePriority priority) const
+{
+    CommandMessage cmdMsg;
+    cmdMsg.SetCommand(cmd);
+    cmdMsg.SetToJSON();
+    cmdMsg.SetPriority(priority);
+    cmdMsg.SetPayloadLen(payload.size() + hdr_ext.size());
+    cmdMsg.ConvertToNetworkMessage(is_payload_len_including_self_);
+
+    string frame;
+    frame.reserve(sizeof(cmdMsg) + hdr_ext.size() + payload.size());
+    frame.append((char*)&cmdMsg, sizeof(cmdMsg));
+    frame.append(hdr_ext);
+    frame.append(payload);
+    return frame;
+}
+
+string SCCommandHandler::EncodePublishMessage(const string& data, const vector<EndpointId>& targets, MessageId msg_type,
+        EMessagePriority priority, uint32_t ttl_ms, uint32_t key, const MessageAttributes& attrs) const
+{
+    string attrs_bytes;
+    if (! attrs.empty() && ! EncodeMessageAttributes(attrs, attrs_bytes)) {
+        fprintf(stderr, "[EncodePublishMessage] Error: attributes exceed %ld bytes, dropped\n", MAX_ATTRIBUTES_BYTES);
+        attrs_bytes.clear();
+    }
+    bool is_extended = ttl_ms > 0 || key > 0 || ! attrs_bytes.empty();
+
+    auto cmd = ECommand::PUBLISH;
+    string pub_msg_bytes;
+    if (! targets.empty() || msg_type > 0 || is_extended) {
+        cmd = ECommand::PUBLISH_2;
+        PublishingMessage pub_msg;
+        pub_msg.msg_type = msg_type;
+        pub_msg.source = client_->GetContext()->endpoint_id;
+        pub_msg.n_targets = targets.size();
+
+        pub_msg_bytes.append((char*)&pub_msg, sizeof(pub_msg));
+        pub_msg_bytes.append((char*)targets.data(), targets.size() * sizeof(targets[0]));
+    }
+    if (is_extended) {
+        PublishingExtension pub_ext;
+        pub_ext.ext_len = sizeof(pub_ext) + attrs_bytes.size();
+        pub_ext.ttl_ms = ttl_ms;
+        pub_ext.key = key;
+        pub_ext.n_attrs = attrs_bytes.empty() ? 0 : attrs.size();
+        pub_msg_bytes.append((char*)&pub_ext, sizeof(pub_ext));
+        pub_msg_bytes.append(attrs_bytes);
+    }
+
+    // compress the content by the compression negotiated at REG, if it's worth
+    auto compression = client_->GetContext()->compression;
+    auto options = client_->GetOptions();
+    size_t min_bytes = options ? options->compress_min_bytes : 0;
+    string compressed;
+    if (compression == ECompression::None || data.size() < min_bytes ||
+            ! CompressContent(compression, data.data(), data.size(), compressed) || compressed.size() >= data.size()) {
+        compression = ECompression::None;
+    }
+
+    string frame = EncodeCommandMessage(cmd, compression == ECompression::None ? data : compressed, pub_msg_bytes, priority);
+    auto cmdMsg = (CommandMessage*)frame.data();
+    if (is_extended) {
+        cmdMsg->SetExtendedFlag();
+    }
+    cmdMsg->SetCompression(compression);
+    return frame;
+}
+
+string SCCommandHandler::EncodeServiceRequest(const string& data, ServiceType svc_type, MessageId svc_cmd, uint32_t sess_id) const
+{
+    ServiceMessage svc_msg;
+    svc_msg.svc_type = svc_type;
+    svc_msg.svc_cmd = svc_cmd;
+    svc_msg.sess_id = sess_id;
+    svc_msg.source = client_->GetContext()->endpoint_id;
+    //svc_msg.svc_type = svc_type > 0 ? svc_type : client_->GetContext()->svc_type;
+    string svc_msg_bytes((char*)&svc_msg, sizeof(svc_msg));
+    return EncodeCommandMessage(ECommand::SVC, data, svc_msg_bytes);
+}
+
+size_t SCCommandHandler::SendRawData(const string& frames)
+{
+    if (! client_->IsConnected()) {
+        printf("The connection was disconnected! Do nothing.\n");
+        return 0;
+    }
+    client_->Connection()->Send(frames);
+    return frames.size();
+}
+
 void SCCommandHandler::HandleCommandMessage(TcpConnection* conn, CommandMessage* cmdMsg)
 {
     if (cmdMsg->HasResponseFlag()) {
@@ -250,6 +528,14 @@ void SCCommandHandler::HandleCommandMessage(TcpConnection* conn, CommandMessage*
 void SCCommandHandler::HandleCommandResult(TcpConnection* conn, CommandMessage* cmdMsg)
 {
     ECommand cmd = cmdMsg->Command();
+    if (cmd == ECommand::SVC) {
+        auto svc_msg = cmdMsg->GetServiceMessage();
+        if (svc_msg && (svc_msg->sess_id & PIPELINED_SESS_ID_FLAG)) {
+            CompleteServiceCall(svc_msg->sess_id, cmdMsg->GetResultMessage()->errcode,
+                    cmdMsg->GetResultMessageContent(), cmdMsg->GetResultMessageContentSize());
+            return;
+        }
+    }
     printf("Command result:\n");
     printf("cmd: %s(%d)\n", CommandToTag(cmd), command_t(cmd));
 
@@ -304,9 +590,7 @@ void SCCommandHandler::HandleCommandResult(TcpConnection* conn, CommandMessage*
             }
             break;
         case ECommand::SVC:
-            if (errcode == 0) {
-                HandleServiceResult(cmdMsg);
-            }
+            HandleServiceResult(cmdMsg);
             break;
         default:
             break;
@@ -333,6 +617,14 @@ void SCCommandHandler::HandleRegisterResult(CommandMessage* cmdMsg, const string
     if (reg_result.role > 0) {
         context->role = (EEndpointRole)reg_result.role;
     }
+    context->compression = TagToCompression(reg_result.compression);
+
+    // the groups are in the state of a resumed session, joining again is a no-op for Switch,
+    // but a registration without state or session starts with no membership
+    if (! context->groups.empty()) {
+        JoinGroups(vector<GroupId>(context->groups.begin(), context->groups.end()));
+    }
+    FlushOutbox();
 
     for (auto [_, cb] : reg_result_handler_cbs_) {
         if (cb) {
@@ -341,6 +633,20 @@ void SCCommandHandler::HandleRegisterResult(CommandMessage* cmdMsg, const string
     }
 }
 
+void SCCommandHandler::FlushOutbox()
+{
+    if (outbox_.empty()) {
+        return;
+    }
+    string frames;
+    for (auto& pending : outbox_) {
+        frames.append(EncodePublishMessage(pending.data, pending.targets, pending.msg_type));
+    }
+    printf("Flush outbox, messages: %ld, bytes: %ld\n", outbox_.size(), frames.size());
+    outbox_.clear();
+    SendRawData(frames);
+}
+
 void SCCommandHandler::HandleGetInfoResult(CommandMessage* cmdMsg, const string& data)
 {
     CommandInfo cmd_info;
@@ -398,6 +704,17 @@ void SCCommandHandler::HandlePublishData(TcpConnection* conn, CommandMessage* cm
         printf("\n");
     }
 
+    string content;
+    if (cmdMsg->Compression() != ECompression::None) {
+        if (! DecompressContent(cmdMsg->Compression(), payload, payload_len, content)) {
+            fprintf(stderr, "Error: failed to decompress the content, compression: %s\n",
+                    CompressionToTag(cmdMsg->Compression()));
+            return;
+        }
+        payload = content.data();
+        payload_len = content.size();
+    }
+
     for (auto [_, cb] : pub_data_handler_cbs_) {
         if (cb) {
             cb(pub_msg, payload, payload_len);
@@ -436,30 +753,81 @@ void SCCommandHandler::HandleServiceRequest(TcpConnection* conn, CommandMessage*
         printf("source: %d\n", svc_msg->source);
     }
 
-    ResultMessage result_msg;
-    string rsp_payload;
-
-    if (! svc_req_handler_cbs_.empty()) {
-        for (auto [_, cb] : svc_req_handler_cbs_) {
-            if (cb) {
-                auto [errcode, rsp_data] = cb(svc_msg, payload, payload_len);
-                result_msg.errcode = errcode;
-                rsp_payload = rsp_data;
+    if (svc_workers_) {
+        // the frame is the event loop's, the worker takes copies
+        CommandMessage req = *cmdMsg;
+        ServiceMessage svc = svc_msg ? *svc_msg : ServiceMessage();
+        svc_workers_->Submit([this, req, svc, data = string(payload, payload_len)]() {
+            auto [errcode, rsp_payload] = RunServiceRequestHandlers(&svc, data.data(), data.size());
+            svc_responses_.Push(EncodeServiceResponse(&req, &svc, errcode, rsp_payload));
+            if (! svc_rsp_pending_.exchange(true)) {
+                uint64_t one = 1;
+                if (write(svc_rsp_fd_, &one, sizeof(one)) < 0) {
+                    fprintf(stderr, "[SCCommandHandler] Error: failed to wake up the event loop: %s\n", strerror(errno));
+                }
             }
+        });
+        return;
+    }
+
+    auto [errcode, rsp_payload] = RunServiceRequestHandlers(svc_msg, payload, payload_len);
+    conn->Send(EncodeServiceResponse(cmdMsg, svc_msg, errcode, rsp_payload));
+}
+
+std::pair<int8_t, string>
+SCCommandHandler::RunServiceRequestHandlers(const ServiceMessage* svc_msg, const char* data, size_t data_len)
+{
+    if (svc_req_handler_cbs_.empty()) {
+        return { 0, R"({"svc_result": "do nothing"})" };
+    }
+    int8_t errcode = 0;
+    string rsp_payload;
+    for (auto& [_, cb] : svc_req_handler_cbs_) {
+        if (cb) {
+            auto [cb_errcode, rsp_data] = cb(svc_msg, data, data_len);
+            errcode = cb_errcode;
+            rsp_payload = std::move(rsp_data);
         }
-    } else {
-        result_msg.errcode = 0;
-        rsp_payload = R"({"svc_result": "do nothing"})";
     }
+    return { errcode, rsp_payload };
+}
 
-    cmdMsg->SetResponseFlag();
-    cmdMsg->SetPayloadLen(sizeof(ServiceMessage) + sizeof(ResultMessage) + rsp_payload.size());
-    cmdMsg->ConvertToNetworkMessage(is_payload_len_including_self_);
+string SCCommandHandler::EncodeServiceResponse(const CommandMessage* req, const ServiceMessage* svc_msg, int8_t errcode,
+        const string& rsp_payload) const
+{
+    // the header of request, with the response flag
+    CommandMessage cmdMsg = *req;
+    ResultMessage result_msg;
+    result_msg.errcode = errcode;
+    cmdMsg.SetResponseFlag();
+    cmdMsg.SetPayloadLen(sizeof(ServiceMessage) + sizeof(ResultMessage) + rsp_payload.size());
+    cmdMsg.ConvertToNetworkMessage(is_payload_len_including_self_);
 
-    conn->Send(cmdMsg->Data(), cmdMsg->HeaderSize());
-    conn->Send((char*)svc_msg, sizeof(ServiceMessage));
-    conn->Send((char*)&result_msg, sizeof(result_msg));
-    conn->Send(rsp_payload);
+    string frame;
+    frame.reserve(cmdMsg.HeaderSize() + sizeof(ServiceMessage) + sizeof(result_msg) + rsp_payload.size());
+    frame.append(cmdMsg.Data(), cmdMsg.HeaderSize());
+    frame.append((const char*)svc_msg, sizeof(ServiceMessage));
+    frame.append((const char*)&result_msg, sizeof(result_msg));
+    frame.append(rsp_payload);
+    return frame;
+}
+
+void SCCommandHandler::FlushServiceResponses()
+{
+    // cleared before taking, a response pushed after that kicks the eventfd again
+    svc_rsp_pending_ = false;
+    string frames;
+    string frame;
+    while (svc_responses_.Pop(frame)) {
+        frames.append(frame);
+        if (frames.size() >= MAX_COALESCED_BYTES) {
+            SendRawData(frames);
+            frames.clear();
+        }
+    }
+    if (! frames.empty()) {
+        SendRawData(frames);
+    }
 }
 
 // service response
@@ -478,11 +846,19 @@ void SCCommandHandler::HandleServiceResult(CommandMessage* cmdMsg)
         printf("source: %d\n", svc_msg->source);
     }
 
+    int8_t errcode = cmdMsg->GetResultMessage()->errcode;
     const char* content = cmdMsg->GetResultMessageContent();
     size_t content_len = cmdMsg->GetResultMessageContentSize();
-    for (auto [_, cb] : svc_req_result_handler_cbs_) {
+    if (errcode == 0) {
+        for (auto [_, cb] : svc_req_result_handler_cbs_) {
+            if (cb) {
+                cb(svc_msg, content, content_len);
+            }
+        }
+    }
+    for (auto [_, cb] : svc_rsp_handler_cbs_) {
         if (cb) {
-            cb(svc_msg, content, content_len);
+            cb(svc_msg, errcode, content, content_len);
         }
     }
 }
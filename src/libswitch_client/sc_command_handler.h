@@ -2,12 +2,18 @@
 #define _SC_COMMAND_HANDLER_H
 
 #include "switch_message.h"
+#include "message_attributes.h"
 #include "endpoint_role.h"
+#include "utils/mpsc_queue.h"
 
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <unordered_map>
 #include <functional>
+#include <chrono>
+#include <atomic>
 using std::string;
 using std::vector;
 using std::map;
@@ -25,6 +31,9 @@ class PublishingMessage;
 class ServiceMessage;
 
 class SwitchClient;
+class WakeupEvent;
+class WorkStealingPool;
+struct CommandSubscriptionState;
 
 using CommandSuccessHandlerCallback = std::function<void (ECommand, const char*, size_t)>;
 using CommandFailHandlerCallback = std::function<void (ECommand, const char*, size_t)>;
@@ -38,29 +47,70 @@ using PublishingResultHandlerCallback = std::function<void (const ResultMessage*
 
 using ServiceRequestHandlerCallback = std::function<std::pair<int, string> (const ServiceMessage*, const char*, size_t)>;
 using ServiceRequestResultHandlerCallback = std::function<void (const ServiceMessage*, const char*, size_t)>;
+// like ServiceRequestResultHandlerCallback, but also called for failed requests, with errcode of result
+using ServiceResponseHandlerCallback = std::function<void (const ServiceMessage*, int8_t, const char*, size_t)>;
+// completion of one call of CallService: errcode and content of the response, or errcode 1 with the reason
+// if it timed out or the connection closed; elapsed_us is from sending the request to the completion
+using ServiceCompletionCallback = std::function<void (int8_t, const char*, size_t, int64_t elapsed_us)>;
 
 class SCCommandHandler {
     public:
     SCCommandHandler(SwitchClient* client, bool is_payload_len_including_self)
         : client_(client), is_payload_len_including_self_(is_payload_len_including_self)
     {}
+    ~SCCommandHandler();
+
+    // run the service request handlers on a pool of n_workers threads instead of the event loop, so a
+    // slow one does not stall the I/O; the responses are sent by the event loop in batches. The handlers
+    // are called concurrently then, they must be thread-safe and set before the event loop starts
+    void EnableServiceWorkers(size_t n_workers);
 
     void Echo(const char* content);
-    void Register(EndpointId ep_id, EEndpointRole ep_role, const string& access_code, bool with_token=false, ServiceType svc_type=0);
+    void Register(EndpointId ep_id, EEndpointRole ep_role, const string& access_code, bool with_token=false,
+            ServiceType svc_type=0, bool with_state=false);
     void GetInfo(bool is_details, EndpointId ep_id=0);
     void ForwardTargets(const vector<EndpointId>& targets);
     void UnforwardTargets(const vector<EndpointId>& targets);
-    void Subscribe(const vector<EndpointId>& sources, const vector<MessageId>& messages);
+    // the members of a group receive the frames published to GroupTarget(group)
+    void JoinGroups(const vector<GroupId>& groups);
+    void LeaveGroups(const vector<GroupId>& groups);
+    // conflate: deliver only the latest value per (msg_type, key) while the messages queue up on Switch
+    // filter: content filter over the attributes of messages, e.g. symbol in ("AAPL", "MSFT") and price > 100
+    void Subscribe(const vector<EndpointId>& sources, const vector<MessageId>& messages, bool conflate=false,
+            const string& filter="");
     void Unsubscribe(const vector<EndpointId>& sources, const vector<MessageId>& messages);
     void Reject(const vector<EndpointId>& sources, const vector<MessageId>& messages);
     void Unreject(const vector<EndpointId>& sources, const vector<MessageId>& messages);
+    // set the whole state or a delta of it in one binary SUBSTATE command, instead of one command per change
+    void SetSubscriptionState(CommandSubscriptionState& cmd_state);
     void Publish(const string& data, const vector<EndpointId> targets={}, MessageId msg_type=0);
-    void RequestService(const string& data, ServiceType svc_type, MessageId svc_cmd, uint32_t sess_id=0);
+    uint32_t RequestService(const string& data, ServiceType svc_type, MessageId svc_cmd, uint32_t sess_id=0);
+    // pipelined: any number of calls share the connection, each completes by its own callback as its
+    // response arrives, in whatever order, or at its deadline. Returns the sess_id, 0 if not connected.
+    // The responses of these calls skip the global result callbacks above.
+    uint32_t CallService(const string& data, ServiceType svc_type, MessageId svc_cmd,
+            const ServiceCompletionCallback& cb, uint32_t timeout_ms=5000);
+    // registers a call like CallService without sending the request, for callers batching it with other
+    // frames by EncodeServiceRequest with the returned sess_id
+    uint32_t AddServiceCall(const ServiceCompletionCallback& cb, uint32_t timeout_ms=5000);
+    size_t InflightServiceCalls() const { return inflight_calls_.size(); }
+    void ExpireServiceCalls();                  // by the timer of SwitchClient
+    void AbortServiceCalls(const char* reason); // the connection closed, the responses never arrive
     void Setup(const string& admin_code, const string& new_admin_code,
             const string& new_access_code, const string& mode);
     void Kickout(const vector<EndpointId>& targets);
     void Reload();
 
+    // encode whole frames, for callers batching several frames into one write
+    string EncodeCommandMessage(ECommand cmd, const string& payload, const string& hdr_ext="",
+            EMessagePriority priority=EMessagePriority::Normal) const;
+    // attrs: typed attributes matched by the content filters of subscribers
+    string EncodePublishMessage(const string& data, const vector<EndpointId>& targets={}, MessageId msg_type=0,
+            EMessagePriority priority=EMessagePriority::Normal, uint32_t ttl_ms=0, uint32_t key=0,
+            const MessageAttributes& attrs={}) const;
+    string EncodeServiceRequest(const string& data, ServiceType svc_type, MessageId svc_cmd, uint32_t sess_id) const;
+    size_t SendRawData(const string& frames);
+
     void HandleCommandMessage(TcpConnection* conn, CommandMessage* cmdMsg);
     void HandleCommandResult(TcpConnection* conn, CommandMessage* cmdMsg);
     void HandlePublishData(TcpConnection* conn, CommandMessage* cmdMsg);
@@ -93,6 +143,9 @@ class SCCommandHandler {
     void SetServiceRequestResultHandlerCallback(const char* caller, const ServiceRequestResultHandlerCallback& cb) {
         svc_req_result_handler_cbs_[caller] = cb;
     }
+    void SetServiceResponseHandlerCallback(const char* caller, const ServiceResponseHandlerCallback& cb) {
+        svc_rsp_handler_cbs_[caller] = cb;
+    }
 
     private:
     size_t SendCommandMessage(ECommand cmd, const string& payload, const string& hdr_ext="");
@@ -104,14 +157,50 @@ class SCCommandHandler {
 
     void HandlePublishingResult(CommandMessage* cmdMsg);
     void HandleServiceResult(CommandMessage* cmdMsg);
+    std::pair<int8_t, string> RunServiceRequestHandlers(const ServiceMessage* svc_msg, const char* data, size_t data_len);
+    string EncodeServiceResponse(const CommandMessage* req, const ServiceMessage* svc_msg, int8_t errcode,
+            const string& rsp_payload) const;
+    void FlushServiceResponses();
 
     template<typename T>
-    void SubUnsubRejUnrej(ECommand cmd, const vector<EndpointId>& sources, const vector<MessageId>& messages);
+    void SubUnsubRejUnrej(ECommand cmd, const vector<EndpointId>& sources, const vector<MessageId>& messages,
+            bool conflate=false, const string& filter="");
+
+    void FlushOutbox();
+    void CompleteServiceCall(uint32_t sess_id, int8_t errcode, const char* data, size_t data_len);
 
     private:
     SwitchClient* client_;
     bool is_payload_len_including_self_;
 
+    // the messages published while disconnected, sent after registered again
+    struct PendingPublishing {
+        string data;
+        vector<EndpointId> targets;
+        MessageId msg_type = 0;
+    };
+    std::deque<PendingPublishing> outbox_;
+    size_t outbox_dropped_ = 0;
+
+    // the calls of CallService waiting for response, their sess_ids have the high bit set, unlike the
+    // random ones of RequestService, so a response arriving after its deadline is recognized and dropped
+    using SteadyTime = std::chrono::steady_clock::time_point;
+    struct InflightCall {
+        ServiceCompletionCallback cb;
+        SteadyTime sent_at;
+        std::multimap<SteadyTime, uint32_t>::iterator deadline;
+    };
+    std::unordered_map<uint32_t, InflightCall>  inflight_calls_;    // sess_id -> call
+    std::multimap<SteadyTime, uint32_t>         call_deadlines_;    // deadline -> sess_id
+    uint32_t next_call_id_ = 0;
+
+    // the service requests handled by workers, see EnableServiceWorkers
+    WorkStealingPool*   svc_workers_ = nullptr;
+    WakeupEvent*        svc_rsp_event_ = nullptr;
+    int                 svc_rsp_fd_ = -1;
+    std::atomic<bool>   svc_rsp_pending_{false};
+    MpscQueue<string>   svc_responses_;         // the frames of responses, from workers to event loop
+
     map<const char*, CommandSuccessHandlerCallback>       cmd_success_handler_cbs_;
     map<const char*, CommandFailHandlerCallback>          cmd_fail_handler_cbs_;
 
@@ -124,6 +213,7 @@ class SCCommandHandler {
 
     map<const char*, ServiceRequestHandlerCallback>       svc_req_handler_cbs_;
     map<const char*, ServiceRequestResultHandlerCallback> svc_req_result_handler_cbs_;
+    map<const char*, ServiceResponseHandlerCallback>      svc_rsp_handler_cbs_;
 };
 
 #endif // _SC_COMMAND_HANDLER_H
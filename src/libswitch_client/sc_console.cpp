@@ -1,6 +1,7 @@
 #include "sc_console.h"
 #include <stdio.h>
 #include <functional>
+#include <algorithm>
 #include "command_messages.h"
 #include "sc_command_handler.h"
 #include "sc_options.h"
@@ -125,6 +126,16 @@ void SCConsole::registerCommands()
             "Send unforwarding targets command by Switch server",
             std::bind(&SCConsole::handleConsoleCommand_UnforwardTargets, this, std::placeholders::_1)
             );
+    REGISTER_COMMAND(
+            "ss_join",
+            "Send join groups command by Switch server",
+            std::bind(&SCConsole::handleConsoleCommand_JoinGroups, this, std::placeholders::_1)
+            );
+    REGISTER_COMMAND(
+            "ss_leave",
+            "Send leave groups command by Switch server",
+            std::bind(&SCConsole::handleConsoleCommand_LeaveGroups, this, std::placeholders::_1)
+            );
     REGISTER_COMMAND(
             "ss_sub",
             "Send subscribe command by Switch server",
@@ -394,6 +405,13 @@ void SCConsole::onGetEndpointInfoResult(const CommandEndpointInfo* cmd_ep_info)
     PUT_LINE_P("cmd_ep_info.uptime: ", readable_seconds_delta(cmd_ep_info->uptime));
     PUT_LINE_P("cmd_ep_info.id: ", cmd_ep_info->id);
     PUT_LINE_P("cmd_ep_info.role: ", EndpointRoleToTag((EEndpointRole)cmd_ep_info->role));
+    PUT_LINE_P("cmd_ep_info.msgs_in: ", cmd_ep_info->msgs_in);
+    PUT_LINE_P("cmd_ep_info.msgs_out: ", cmd_ep_info->msgs_out);
+    PUT_LINE_P("cmd_ep_info.queued_frames: ", cmd_ep_info->queued_frames);
+    PUT_LINE_P("cmd_ep_info.fwd_latency_max: ", cmd_ep_info->fwd_latency_max);
+    for (auto& msg_stats : cmd_ep_info->top_messages) {
+        PUT_LINE_P("cmd_ep_info.msg_type ", msg_stats.msg_type, ": in: ", msg_stats.in, ", out: ", msg_stats.out);
+    }
     PUT_LINE_P("...");
 }
 
@@ -442,11 +460,52 @@ int SCConsole::handleConsoleCommand_SetTargets(const vector<string>& argv, const
     duplicate(targets);
     cmd_handler_callback(targets);
 
-    if (argv[0] == "ss_fwd") {
-        client_->GetContext()->SetForwardTargets(targets);
-    } else if (argv[0] == "ss_unfwd") {
-        client_->GetContext()->RemoveForwardTargets(targets);
+    return 0;
+}
+
+int SCConsole::handleConsoleCommand_JoinGroups(const vector<string>& argv)
+{
+    return handleConsoleCommand_JoinLeave(argv, "Join",
+            std::bind(&SCCommandHandler::JoinGroups, cmd_handler_, std::placeholders::_1));
+}
+
+int SCConsole::handleConsoleCommand_LeaveGroups(const vector<string>& argv)
+{
+    return handleConsoleCommand_JoinLeave(argv, "Leave",
+            std::bind(&SCCommandHandler::LeaveGroups, cmd_handler_, std::placeholders::_1));
+}
+
+int SCConsole::handleConsoleCommand_JoinLeave(const vector<string>& argv, const char* desc,
+        const JoinLeaveCommandCallback& cmd_handler_callback)
+{
+    // ss_join --groups <ID#1 ID#2 ...>
+    argparse::ArgumentParser cmd_ap(argv[0], "1.0", argparse::default_arguments::help, false);
+
+    char help[128];
+    snprintf(help, sizeof(help), "%s the groups", desc);
+    cmd_ap.add_argument("--groups")
+        .help(help)
+        .scan<'i', GroupId>()
+        .nargs(argparse::nargs_pattern::at_least_one);
+
+    try {
+        cmd_ap.parse_args(argv);
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << cmd_ap;
+        return -1;
+    }
+    if (cmd_ap.is_used("--help")) {
+        return 1;
+    }
+
+    auto groups = cmd_ap.get<vector<GroupId>>("--groups");
+    if (groups.empty()) {
+        PUT_LINE("Wrong argument! the --groups must be more than one value");
+        return -1;
     }
+    duplicate(groups);
+    cmd_handler_callback(groups);
 
     return 0;
 }
@@ -454,7 +513,7 @@ int SCConsole::handleConsoleCommand_SetTargets(const vector<string>& argv, const
 int SCConsole::handleConsoleCommand_Subscribe(const vector<string>& argv)
 {
     return handleConsoleCommand_SubUnsubRejUnrej(argv, "Subscribe",
-            std::bind(&SCCommandHandler::Subscribe, cmd_handler_, std::placeholders::_1, std::placeholders::_2));
+            std::bind(&SCCommandHandler::Subscribe, cmd_handler_, std::placeholders::_1, std::placeholders::_2, false, ""));
 }
 
 int SCConsole::handleConsoleCommand_Unsubscribe(const vector<string>& argv)
@@ -513,36 +572,6 @@ int SCConsole::handleConsoleCommand_SubUnsubRejUnrej(
         return -1;
     }
 
-    if (argv[0] == "ss_sub") {
-        if (! sources.empty()) {
-            client_->GetContext()->SetSubscribedSources(sources);
-        }
-        if (! messages.empty()) {
-            client_->GetContext()->SetSubscribedMessages(messages);
-        }
-    } else if (argv[0] == "ss_unsub") {
-        if (! sources.empty()) {
-            client_->GetContext()->RemoveSubscribedSources(sources);
-        }
-        if (! messages.empty()) {
-            client_->GetContext()->RemoveSubscribedMessages(messages);
-        }
-    } else if (argv[0] == "ss_reject") {
-        if (! sources.empty()) {
-            client_->GetContext()->SetRejectedSources(sources);
-        }
-        if (! messages.empty()) {
-            client_->GetContext()->SetRejectedMessages(messages);
-        }
-    } else if (argv[0] == "ss_unrej") {
-        if (! sources.empty()) {
-            client_->GetContext()->RemoveRejectedSources(sources);
-        }
-        if (! messages.empty()) {
-            client_->GetContext()->RemoveRejectedMessages(messages);
-        }
-    }
-
     cmd_handler_callback(sources, messages);
     return 0;
 }
@@ -561,6 +590,10 @@ int SCConsole::handleConsoleCommand_Publish(const vector<string>& argv)
         .help("The target endpoints to send")
         .scan<'i', EndpointId>()
         .nargs(argparse::nargs_pattern::at_least_one);
+    cmd_ap.add_argument("--groups")
+        .help("The groups to send, to all of their members")
+        .scan<'i', GroupId>()
+        .nargs(argparse::nargs_pattern::at_least_one);
     cmd_ap.add_argument("--msg_type")
         .help("The message type of data")
         .scan<'i', int>()
@@ -584,6 +617,13 @@ int SCConsole::handleConsoleCommand_Publish(const vector<string>& argv)
             duplicate(targets);
         }
     }
+    if (cmd_ap.is_used("--groups")) {
+        auto groups = cmd_ap.get<vector<GroupId>>("--groups");
+        duplicate(groups);
+        for (auto group : groups) {
+            targets.push_back(GroupTarget(group));
+        }
+    }
     MessageId msg_type = 0;
     if (cmd_ap.is_used("--msg_type")) {
         msg_type = cmd_ap.get<int>("--msg_type");
@@ -645,6 +685,15 @@ int SCConsole::handleConsoleCommand_RequestService(const vector<string>& argv)
         .help("The service command to request")
         .scan<'i', MessageId>()
         .nargs(1);
+    cmd_ap.add_argument("--count")
+        .help("Pipeline so many calls on the connection, reports the latencies of calls")
+        .scan<'i', uint32_t>()
+        .nargs(1);
+    cmd_ap.add_argument("--timeout")
+        .help("The timeout of a pipelined call in milliseconds")
+        .default_value(5000U)
+        .scan<'i', uint32_t>()
+        .nargs(1);
 
     try {
         cmd_ap.parse_args(argv);
@@ -669,6 +718,10 @@ int SCConsole::handleConsoleCommand_RequestService(const vector<string>& argv)
     if (cmd_ap.is_used("--svc_cmd")) {
         svc_cmd = cmd_ap.get<MessageId>("--svc_cmd");
     }
+    if (cmd_ap.is_used("--count")) {
+        callServicePipelined(data, svc_type, svc_cmd, cmd_ap.get<uint32_t>("--count"), cmd_ap.get<uint32_t>("--timeout"));
+        return 0;
+    }
 
     cmd_handler_->SetServiceRequestResultHandlerCallback(
             MOD_NAME,
@@ -682,6 +735,43 @@ int SCConsole::handleConsoleCommand_RequestService(const vector<string>& argv)
 
     return 0;
 }
+void SCConsole::callServicePipelined(const string& data, ServiceType svc_type, MessageId svc_cmd,
+        uint32_t count, uint32_t timeout_ms)
+{
+    struct PipelineStats {
+        uint32_t pending = 0;
+        uint32_t failed = 0;
+        vector<int64_t> latencies;
+    };
+    auto stats = std::make_shared<PipelineStats>();
+    stats->latencies.reserve(count);
+
+    auto on_completion = [stats](int8_t errcode, const char* data, size_t data_len, int64_t elapsed_us) {
+        if (errcode != 0) {
+            stats->failed++;
+        }
+        stats->latencies.push_back(elapsed_us);
+        if (--stats->pending > 0) {
+            return;
+        }
+        auto& latencies = stats->latencies;
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, (size_t)(p / 100 * latencies.size()))]; };
+        PUT_LINE_P("calls: ", latencies.size());
+        PUT_LINE_P("failed: ", stats->failed);
+        PUT_LINE_P("latency p50 (us): ", percentile(50));
+        PUT_LINE_P("latency p99 (us): ", percentile(99));
+        PUT_LINE_P("latency max (us): ", latencies.back());
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        if (cmd_handler_->CallService(data, svc_type, svc_cmd, on_completion, timeout_ms) == 0) {
+            PUT_LINE("ss_svc: ", "the connection was disconnected");
+            break;
+        }
+        stats->pending++;
+    }
+}
+
 void SCConsole::onRequestServiceResult(const ServiceMessage* svc_msg, const char* data, size_t data_len)
 {
     if (svc_msg) {
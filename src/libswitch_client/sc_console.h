@@ -38,6 +38,8 @@ class SCConsole {
     int handleConsoleCommand_RequestService(const vector<string>& argv);
     int handleConsoleCommand_ForwardTargets(const vector<string>& argv);
     int handleConsoleCommand_UnforwardTargets(const vector<string>& argv);
+    int handleConsoleCommand_JoinGroups(const vector<string>& argv);
+    int handleConsoleCommand_LeaveGroups(const vector<string>& argv);
     int handleConsoleCommand_Subscribe(const vector<string>& argv);
     int handleConsoleCommand_Unsubscribe(const vector<string>& argv);
     int handleConsoleCommand_Reject(const vector<string>& argv);
@@ -50,6 +52,10 @@ class SCConsole {
     int handleConsoleCommand_SetTargets(const vector<string>& argv, const char* desc,
             const SetTargetsCommandCallback& cmd_handler_callback);
 
+    using JoinLeaveCommandCallback = std::function<void (const vector<GroupId>&)>;
+    int handleConsoleCommand_JoinLeave(const vector<string>& argv, const char* desc,
+            const JoinLeaveCommandCallback& cmd_handler_callback);
+
     using SubUnsubRejUnrejCommandCallback = std::function<void (const vector<EndpointId>&, const vector<MessageId>&)>;
     int handleConsoleCommand_SubUnsubRejUnrej(const vector<string>& argv, const char* desc,
             const SubUnsubRejUnrejCommandCallback& cmd_handler_callback);
@@ -63,6 +69,8 @@ class SCConsole {
     void onGetEndpointInfoResult(const CommandEndpointInfo* cmd_ep_info);
     void onPublishingResult(const ResultMessage* result_msg, const char* data, size_t data_len);
     void onRequestServiceResult(const ServiceMessage* svc_msg, const char* data, size_t data_len);
+    void callServicePipelined(const string& data, ServiceType svc_type, MessageId svc_cmd,
+            uint32_t count, uint32_t timeout_ms);
 
     private:
     SwitchClient* client_;
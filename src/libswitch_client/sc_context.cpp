@@ -5,6 +5,7 @@
 #include "sc_context.h"
 #include "switch_client.h"
 #include "sc_peer.h"
+#include "command_messages.h"
 
 SCContext::SCContext(SwitchClient* client) :
     switch_client(client), born_time(evt_loop::Now()), svc_type(0), is_registered(false), endpoint_id(0)
@@ -49,6 +50,14 @@ string SCContext::ToString() const
     ss << "rej_messages: [";
     std::copy(rej_messages.begin(), rej_messages.end(), std::ostream_iterator<MessageId>(ss, ","));
     ss << "], ";
+    ss << "conflated_messages: [";
+    std::copy(conflated_messages.begin(), conflated_messages.end(), std::ostream_iterator<MessageId>(ss, ","));
+    ss << "], ";
+    ss << "message_filters: {";
+    for (auto& [msg_type, filter] : message_filters) {
+        ss << msg_type << ": " << filter << ",";
+    }
+    ss << "}, ";
     ss << "}";
     return ss.str();
 }
@@ -64,6 +73,17 @@ void SCContext::RemoveForwardTargets(const vector<EndpointId>& targets)
     }
 }
 
+void SCContext::SetJoinedGroups(const vector<GroupId>& groups)
+{
+    this->groups.insert(groups.begin(), groups.end());
+}
+void SCContext::RemoveJoinedGroups(const vector<GroupId>& groups)
+{
+    for (auto elem : groups) {
+        this->groups.erase(elem);
+    }
+}
+
 void SCContext::SetSubscribedSources(const vector<EndpointId>& sources)
 {
     subs_sources.insert(sources.begin(), sources.end());
@@ -107,3 +127,67 @@ void SCContext::RemoveRejectedMessages(const vector<MessageId>& messages)
         rej_messages.erase(elem);
     }
 }
+
+void SCContext::SetConflatedMessages(const vector<MessageId>& messages)
+{
+    conflated_messages.insert(messages.begin(), messages.end());
+}
+void SCContext::RemoveConflatedMessages(const vector<MessageId>& messages)
+{
+    for (auto elem : messages) {
+        conflated_messages.erase(elem);
+    }
+}
+
+void SCContext::SetMessageFilter(const vector<MessageId>& messages, const string& filter)
+{
+    for (auto elem : messages) {
+        if (filter.empty()) {
+            message_filters.erase(elem);
+        } else {
+            message_filters[elem] = filter;
+        }
+    }
+}
+
+template<typename T>
+static void apply_delta(set<T>& current, const vector<T>& add, const vector<T>& remove, bool is_full)
+{
+    if (is_full) {
+        current.clear();
+    }
+    current.insert(add.begin(), add.end());
+    if (! is_full) {
+        for (auto elem : remove) {
+            current.erase(elem);
+        }
+    }
+}
+
+void SCContext::ApplySubscriptionState(const CommandSubscriptionState& cmd_state)
+{
+    auto& add = cmd_state.add;
+    auto& remove = cmd_state.remove;
+    bool is_full = cmd_state.is_full;
+    apply_delta(fwd_targets, add.fwd_targets, remove.fwd_targets, is_full);
+    apply_delta(subs_sources, add.subs_sources, remove.subs_sources, is_full);
+    apply_delta(rej_sources, add.rej_sources, remove.rej_sources, is_full);
+    apply_delta(subs_messages, add.subs_messages, remove.subs_messages, is_full);
+    apply_delta(rej_messages, add.rej_messages, remove.rej_messages, is_full);
+    apply_delta(conflated_messages, add.conflated_messages, remove.conflated_messages, is_full);
+
+    if (is_full) {
+        message_filters.clear();
+    } else {
+        for (auto& [msg_type, _] : remove.filters) {
+            message_filters.erase(msg_type);
+        }
+    }
+    for (auto& [msg_type, filter] : add.filters) {
+        message_filters[msg_type] = filter;
+    }
+
+    // the mode of subscription only applies to the subscribed messages
+    std::erase_if(conflated_messages, [this](auto msg_type) { return ! subs_messages.contains(msg_type); });
+    std::erase_if(message_filters, [this](auto& elem) { return ! subs_messages.contains(elem.first); });
+}
@@ -8,6 +8,7 @@
 #include <memory>
 #include "endpoint_role.h"
 #include "switch_types.h"
+#include "switch_message.h"
 
 using std::map;
 using std::set;
@@ -15,6 +16,7 @@ using std::vector;
 using std::string;
 
 class SwitchClient;
+struct CommandSubscriptionState;
 
 struct SCContext
 {
@@ -28,18 +30,24 @@ struct SCContext
     string register_errmsg;
     EndpointId endpoint_id;
     string token;
+    ECompression compression = ECompression::None;    // negotiated at REG
 
     set<EndpointId> fwd_targets;
     set<EndpointId> subs_sources;
     set<EndpointId> rej_sources;
     set<MessageId> subs_messages;
     set<MessageId> rej_messages;
+    set<MessageId> conflated_messages;
+    map<MessageId, string> message_filters;     // content filters of subscribed messages
+    set<GroupId> groups;                        // joined groups, joined again at every REG
 
     SCContext(SwitchClient* server);
     string ToString() const;
 
     void SetForwardTargets(const vector<EndpointId>& targets);
     void RemoveForwardTargets(const vector<EndpointId>& targets);
+    void SetJoinedGroups(const vector<GroupId>& groups);
+    void RemoveJoinedGroups(const vector<GroupId>& groups);
     void SetSubscribedSources(const vector<EndpointId>& sources);
     void RemoveSubscribedSources(const vector<EndpointId>& sources);
     void SetRejectedSources(const vector<EndpointId>& sources);
@@ -48,6 +56,10 @@ struct SCContext
     void RemoveSubscribedMessages(const vector<MessageId>& messages);
     void SetRejectedMessages(const vector<MessageId>& messages);
     void RemoveRejectedMessages(const vector<MessageId>& messages);
+    void SetConflatedMessages(const vector<MessageId>& messages);
+    void RemoveConflatedMessages(const vector<MessageId>& messages);
+    void SetMessageFilter(const vector<MessageId>& messages, const string& filter);  // empty filter to remove
+    void ApplySubscriptionState(const CommandSubscriptionState& cmd_state);  // as Switch applies SUBSTATE
 };
 typedef std::shared_ptr<SCContext> SCContextPtr;
 
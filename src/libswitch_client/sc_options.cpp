@@ -176,6 +176,52 @@ int SCOptions::ParseConfiguration(const string& _config_file)
             console_sub_prompt = client_config.at("console_sub_prompt").as_string();
             cout << "> config.client.console_sub_prompt: " << console_sub_prompt << endl;
         }
+
+        if (client_config.contains("auto_reconnect")) {
+            auto_reconnect = client_config.at("auto_reconnect").as_boolean();
+            cout << "> config.client.auto_reconnect: " << auto_reconnect << endl;
+        }
+
+        if (client_config.contains("reconnect_min_delay")) {
+            reconnect_min_delay = client_config.at("reconnect_min_delay").as_integer();
+            cout << "> config.client.reconnect_min_delay: " << reconnect_min_delay << endl;
+        }
+
+        if (client_config.contains("reconnect_max_delay")) {
+            reconnect_max_delay = client_config.at("reconnect_max_delay").as_integer();
+            cout << "> config.client.reconnect_max_delay: " << reconnect_max_delay << endl;
+        }
+
+        if (client_config.contains("outbox_size")) {
+            outbox_size = client_config.at("outbox_size").as_integer();
+            cout << "> config.client.outbox_size: " << outbox_size << endl;
+        }
+
+        if (client_config.contains("svc_workers")) {
+            svc_workers = client_config.at("svc_workers").as_integer();
+            cout << "> config.client.svc_workers: " << svc_workers << endl;
+        }
+    }
+    if (config.contains("compression")) {
+        auto compression_config = config.at("compression");
+
+        if (compression_config.contains("codecs")) {
+            cout << "> config.compression.codecs: " << compression_config.at("codecs") << endl;
+            compressions.clear();
+            for (auto& codec : compression_config.at("codecs").as_array()) {
+                compressions.push_back(codec.as_string());
+            }
+        }
+
+        if (compression_config.contains("min_bytes")) {
+            compress_min_bytes = compression_config.at("min_bytes").as_integer();
+            cout << "> config.compression.min_bytes: " << compress_min_bytes << endl;
+        }
+
+        if (compression_config.contains("zstd_dictionary")) {
+            zstd_dictionary = compression_config.at("zstd_dictionary").as_string();
+            cout << "> config.compression.zstd_dictionary: " << zstd_dictionary << endl;
+        }
     }
 
     return 0;
@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <sstream>
+#include <vector>
 
 #define N_A "N/A"
 
@@ -19,6 +20,14 @@ struct SCOptions
     uint16_t    svc_type;               // if role is Service, 0: serve all service
     bool        enable_console = false;
     string      console_sub_prompt;
+    bool        auto_reconnect = true;
+    uint32_t    reconnect_min_delay = 500;      // milliseconds, the delay of first reconnecting
+    uint32_t    reconnect_max_delay = 30000;    // milliseconds, the cap of exponential backoff
+    uint32_t    outbox_size = 1024;             // max number of messages published while disconnected
+    uint32_t    svc_workers = 0;                // threads handling service requests, 0: on the event loop
+    std::vector<string> compressions;           // offered at REG, lz4, zstd, in order of preference
+    uint32_t    compress_min_bytes = 256;       // the shorter content is sent uncompressed
+    string      zstd_dictionary;                // must be the same one as Switch loaded
     string      logfile;
     string      config_file;
 
@@ -34,6 +43,18 @@ struct SCOptions
         ss << "svc_type: " << svc_type << ", ";
         ss << "enable_console: " << enable_console << ", ";
         ss << "console_sub_prompt: " << console_sub_prompt << ", ";
+        ss << "auto_reconnect: " << auto_reconnect << ", ";
+        ss << "reconnect_min_delay: " << reconnect_min_delay << ", ";
+        ss << "reconnect_max_delay: " << reconnect_max_delay << ", ";
+        ss << "outbox_size: " << outbox_size << ", ";
+        ss << "svc_workers: " << svc_workers << ", ";
+        ss << "compressions: [";
+        for (auto& compression : compressions) {
+            ss << compression << ", ";
+        }
+        ss << "], ";
+        ss << "compress_min_bytes: " << compress_min_bytes << ", ";
+        ss << "zstd_dictionary: " << zstd_dictionary << ", ";
         ss << "logfile: " << logfile << ", ";
         ss << "config_file: " << config_file << ", ";
         ss << "}";
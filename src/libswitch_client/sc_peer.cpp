@@ -57,6 +57,10 @@ void SCPeer::OnMessageRecvd(TcpConnection* conn, const Message* msg)
 
     auto cmdMsg = CommandMessage::FromNetworkMessage(msg,
             client_->GetMessageHeaderDescription()->is_payload_len_including_self);
+    if (! cmdMsg || ! cmdMsg->IsWellFormed(msg->Data().size())) {
+        fprintf(stderr, "[OnMessageRecvd] Error: malformed frame, size: %lu\n", msg->Data().size());
+        return;
+    }
     msg_cb_(conn, cmdMsg);
 }
 
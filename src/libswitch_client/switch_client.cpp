@@ -6,6 +6,9 @@
 #include "sc_options.h"
 #include "sc_context.h"
 #include "sc_peer.h"
+#include "compression.h"
+#include "utils/random.h"
+#include <algorithm>
 
 SwitchClient::SwitchClient(const char* host, uint16_t port, EndpointId ep_id,
         bool enable_console, const char* console_sub_prompt)
@@ -25,6 +28,9 @@ SwitchClient::SwitchClient(SCOptions* options)
     }
     enable_console_ = options->enable_console; 
     console_sub_prompt_ = options->console_sub_prompt;
+    if (! options->zstd_dictionary.empty()) {
+        LoadCompressionDictionary(options->zstd_dictionary);
+    }
 
     peer_ = new SCPeer(options->server_host.c_str(), options->server_port);
     peer_->SetClosedCallback(std::bind(&SwitchClient::OnPeerClosed, this));
@@ -39,11 +45,25 @@ SwitchClient::SwitchClient(SCOptions* options)
                 std::placeholders::_1,
                 std::placeholders::_2)
             );
-    peer_->Connect();
+    if (! peer_->Connect() && options->auto_reconnect) {
+        ScheduleReconnect();
+    }
 }
 
 void SwitchClient::Cleanup()
 {
+    is_stopping_ = true;
+    if (reconnect_timer_) {
+        reconnect_timer_->Stop();
+        delete reconnect_timer_;
+        reconnect_timer_ = nullptr;
+    }
+    if (svc_call_timer_) {
+        svc_call_timer_->Stop();
+        delete svc_call_timer_;
+        svc_call_timer_ = nullptr;
+    }
+
     if (console_) {
         console_->Destory();
         delete console_;
@@ -77,19 +97,71 @@ void SwitchClient::CreateComponents()
     cout << "Context: " << context_->ToString() << endl;
 
     cmd_handler_ = new SCCommandHandler(this, peer_->GetMessageHeaderDescription()->is_payload_len_including_self);
+    if (options_ && options_->svc_workers > 0) {
+        cmd_handler_->EnableServiceWorkers(options_->svc_workers);
+    }
     if (enable_console_) {
         console_ = new SCConsole(this, cmd_handler_, console_sub_prompt_.c_str());
         console_->registerCommands();
     }
+
+    // 10ms is the resolution of the deadlines of service calls
+    svc_call_timer_ = new PeriodicTimer(TimeVal(0, 10000), [this](auto*) { OnServiceCallTimer(); });
+    svc_call_timer_->Start();
 }
 
 void SwitchClient::OnPeerConnected()
 {
+    reconnect_attempts_ = 0;
     RegisterSelf();
 }
 
 void SwitchClient::OnPeerClosed()
 {
+    context_->is_registered = false;
+    cmd_handler_->AbortServiceCalls("Connection closed");
+    if (options_ && options_->auto_reconnect && !is_stopping_) {
+        ScheduleReconnect();
+    }
+}
+
+void SwitchClient::ScheduleReconnect()
+{
+    if (reconnect_timer_ && reconnect_timer_->IsRunning()) {
+        return;
+    }
+
+    // exponential backoff with full jitter, so the clients of a restarted Switch
+    // spread their reconnecting over the window instead of arriving at once
+    uint32_t min_delay = std::max<uint32_t>(options_->reconnect_min_delay, 1);
+    uint32_t max_delay = std::max(options_->reconnect_max_delay, min_delay);
+    uint64_t ceiling = std::min<uint64_t>(max_delay, (uint64_t)min_delay << std::min<uint32_t>(reconnect_attempts_, 16));
+    uint32_t delay = generate_random_integer(min_delay / 2, ceiling);
+    reconnect_attempts_++;
+
+    printf("[SwitchClient] reconnect after %u ms, attempts: %u\n", delay, reconnect_attempts_);
+    TimeVal interval(delay / 1000, (delay % 1000) * 1000);
+    if (! reconnect_timer_) {
+        reconnect_timer_ = new OneshotTimer(interval, [this](auto*) { OnReconnectTimer(); });
+    } else {
+        reconnect_timer_->SetInterval(interval);
+    }
+    reconnect_timer_->Start();
+}
+
+void SwitchClient::OnReconnectTimer()
+{
+    if (is_stopping_ || peer_->IsConnected()) {
+        return;
+    }
+    if (! peer_->Reconnect()) {
+        ScheduleReconnect();
+    }
+}
+
+void SwitchClient::OnServiceCallTimer()
+{
+    cmd_handler_->ExpireServiceCalls();
 }
 
 TcpConnectionPtr SwitchClient::Connection()
@@ -123,6 +195,7 @@ void SwitchClient::RegisterSelf()
     EEndpointRole role = context_->role;
     ServiceType svc_type = context_->svc_type;
     string access_code(context_->access_code);
-    bool with_token = false;
-    cmd_handler_->Register(ep_id, role, access_code, with_token, svc_type);
+    // resume the last session if any, the Switch restores the state replayed with REG
+    bool is_resuming = ! context_->token.empty();
+    cmd_handler_->Register(ep_id, role, access_code, is_resuming, svc_type, is_resuming);
 }
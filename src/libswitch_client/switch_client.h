@@ -39,6 +39,9 @@ protected:
     void RegisterSelf();
     void OnPeerConnected();
     void OnPeerClosed();
+    void ScheduleReconnect();
+    void OnReconnectTimer();
+    void OnServiceCallTimer();
 
 private:
     SCPeer* peer_ = nullptr;
@@ -50,4 +53,9 @@ private:
     SCCommandHandler* cmd_handler_ = nullptr;
     SCConsole* console_ = nullptr;
     string console_sub_prompt_;
+
+    OneshotTimer* reconnect_timer_ = nullptr;
+    PeriodicTimer* svc_call_timer_ = nullptr;     // the deadlines of pipelined service calls
+    uint32_t reconnect_attempts_ = 0;
+    bool is_stopping_ = false;
 };
@@ -1,5 +1,4 @@
 #include "argparse/argparse.hpp"
-#include "toml.hpp"
 #include "switch_server.h"
 #include "switch_options.h"
 #include "version.h"
@@ -38,6 +37,10 @@ int parse_arguments(int argc, char **argv, OptionsPtr& options) {
         .help("access code for services");
     program.add_argument("-f", "--config")
         .help("configuration file");
+    program.add_argument("-U", "--upgrade")
+        .help("take over the listening socket and connections from the running switch")
+        .default_value(false)
+        .implicit_value(true);
 
     try {
         program.parse_args(argc, argv);
@@ -75,69 +78,8 @@ int parse_arguments(int argc, char **argv, OptionsPtr& options) {
         options->config_file = program.get<std::string>("--config");
         cout << "> arguments.config: " << options->config_file << endl;
     }
-
-    return 0;
-}
-
-int parse_configuration(const string& config_file, OptionsPtr& options) {
-    const toml::value config = toml::parse(config_file);
-
-    if (config.contains("logfile")) {
-        auto logfile = config.at("logfile").as_string();
-        cout << "> config.logfile: " << logfile << endl;
-        if (! logfile.empty()) {
-            options->logfile = logfile;
-        }
-    }
-
-    if (config.contains("server")) {
-        auto server_config = config.at("server");
-
-        if (server_config.contains("host")) {
-            auto host = server_config.at("host").as_string();
-            cout << "> config.server.host: " << host << endl;
-            options->host = host;
-        }
-
-        if (server_config.contains("port")) {
-            auto port = server_config.at("port").as_integer();
-            cout << "> config.server.port: " << port << endl;
-            options->port = port;
-        }
-
-        if (server_config.contains("node_id")) {
-            auto node_id = server_config.at("node_id").as_integer();
-            cout << "> config.server.node_id: " << node_id << endl;
-            options->node_id = node_id;
-        }
-
-        if (server_config.contains("mode")) {
-            auto serving_mode = server_config.at("mode").as_string();
-            cout << "> config.server.mode: " << serving_mode << endl;
-            options->serving_mode = serving_mode;
-        }
-    }
-    if (config.contains("auth")) {
-        auto auth_config = config.at("auth");
-
-        if (auth_config.contains("access_code")) {
-            auto access_code = auth_config.at("access_code").as_string();
-            cout << "> config.auth.access_code: " << access_code << endl;
-            options->access_code = access_code;
-        }
-
-        if (auth_config.contains("admin_code")) {
-            auto admin_code = auth_config.at("admin_code").as_string();
-            cout << "> config.auth.admin_code: " << admin_code << endl;
-            options->admin_code = admin_code;
-        }
-
-        if (auth_config.contains("service_access_code")) {
-            auto service_access_code = auth_config.at("service_access_code").as_string();
-            cout << "> config.auth.service_access_code: " << service_access_code << endl;
-            options->service_access_code = service_access_code;
-        }
-    }
+    options->upgrade = program.get<bool>("--upgrade");
+    cout << "> arguments.upgrade: " << options->upgrade << endl;
 
     return 0;
 }
@@ -155,7 +97,7 @@ int main(int argc, char **argv) {
           fprintf(stderr, "Error: the configuration file does not exist: %s\n", options->config_file.c_str());
           return 1;
       }
-      int status = parse_configuration(options->config_file, options);
+      int status = options->ParseConfiguration(options->config_file);
       if (status != 0) {
           return 1;
       }
@@ -165,6 +107,7 @@ int main(int argc, char **argv) {
 
   SwitchServer switch_server(options);
   SignalHandler sh(SignalEvent::INT, std::bind(&SwitchServer::OnSignal, &switch_server, std::placeholders::_1, std::placeholders::_2));
+  SignalHandler sh_hup(SignalEvent::HUP, std::bind(&SwitchServer::OnSignal, &switch_server, std::placeholders::_1, std::placeholders::_2));
 
   EV_Singleton->StartLoop();
 
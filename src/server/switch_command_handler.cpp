@@ -1,19 +1,30 @@
 #include <sstream>
+#include <optional>
+#include <algorithm>
+#include <unordered_set>
 #include "switch_command_handler.h"
 #include "switch_server.h"
 #include "command_messages.h"
+#include "compression.h"
+#include "message_attributes.h"
+#include "switch_frame_variants.h"
+#include "utils/time.h"
 
 #define _DECODE_COMMAND_MESSAGE(func_name, cmd_msg, cmd_obj, conn) { \
     auto [_payload, _payload_len] = cmd_msg->Payload(); \
     if (_payload_len > 0) { \
         string payload(_payload, _payload_len); \
+        bool _is_decoded = false; \
+        const char* errmsg = "Unsupported codec of message payload"; \
         if (cmd_msg->IsJSON()) { \
-            cmd_obj.decodeFromJSON(payload); \
+            _is_decoded = cmd_obj.decodeFromJSON(payload); \
+            errmsg = "Malformed payload of message"; \
         } else if (cmd_msg->IsPB()) { \
-            cmd_obj.decodeFromPB(payload); \
-        } else { \
+            _is_decoded = cmd_obj.decodeFromPB(payload); \
+            errmsg = "Malformed payload of message"; \
+        } \
+        if (! _is_decoded) { \
             int8_t errcode = 1; \
-            const char* errmsg = "Unsupported codec of message payload"; \
             fprintf(stderr, "[%s] Error: %s\n", func_name, errmsg); \
             sendResultMessage(conn, cmd, errcode, errmsg); \
             return errcode; \
@@ -39,6 +50,15 @@ void CommandHandler::handleCommand(TcpConnection* conn, const Message* msg)
     const string& msgData = msg->Data();
     auto cmdMsg = CommandMessage::FromNetworkMessage(msg,
             context_->switch_server->IsMessagePayloadLengthIncludingSelf());
+    if (! cmdMsg || ! cmdMsg->IsWellFormed(msgData.size())) {
+        // the routing headers of a malformed frame would be read past its end, drop it
+        ECommand cmd = cmdMsg ? cmdMsg->Command() : ECommand::UNDEFINED;
+        fprintf(stderr, "[CommandHandler::HandleCommand] Error: malformed frame, cmd: %s(%d), id: %d, size: %lu\n",
+                CommandToTag(cmd), (command_t)cmd, conn->ID(), msgData.size());
+        int8_t errcode = 1;
+        sendResultMessage(conn, cmd, errcode, string("Malformed frame"));
+        return;
+    }
 
     ECommand cmd = cmdMsg->Command();
     printf("[CommandHandler::HandleCommand] id: %d\n", conn->ID());
@@ -91,6 +111,15 @@ void CommandHandler::handleCommand(TcpConnection* conn, const Message* msg)
         case ECommand::UNREJECT:
             handleUnreject(ep, cmdMsg, msgData);
             break;
+        case ECommand::SUBSTATE:
+            handleSubscriptionState(ep, cmdMsg, msgData);
+            break;
+        case ECommand::JOIN:
+            handleJoin(ep, cmdMsg, msgData);
+            break;
+        case ECommand::LEAVE:
+            handleLeave(ep, cmdMsg, msgData);
+            break;
         case ECommand::PUBLISH:
             handlePublishData(ep, cmdMsg, msgData);
             break;
@@ -211,6 +240,9 @@ int CommandHandler::handleSubscribe(EndpointPtr ep, const CommandMessage* cmdMsg
     }
 
     sendResultMessage(ep->Connection(), cmd, errcode, errmsg);
+    if (errcode == 0) {
+        sendCachedValues(ep.get(), cmd_sub.messages);
+    }
 
     return errcode;
 }
@@ -232,6 +264,40 @@ int CommandHandler::handleUnsubscribe(EndpointPtr ep, const CommandMessage* cmdM
     return errcode;
 }
 
+int CommandHandler::handleJoin(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData)
+{
+    const ECommand cmd = cmdMsg->Command();
+
+    CommandJoin cmd_join;
+    _DECODE_COMMAND_MESSAGE("handleJoin", cmdMsg, cmd_join, ep->Connection());
+
+    auto [errcode, errmsg] = service_->join_groups(ep.get(), cmd_join);
+    if (! errmsg.empty()) {
+        cerr << "[handleJoin] Error: " << errmsg << endl;
+    }
+
+    sendResultMessage(ep->Connection(), cmd, errcode, errmsg);
+
+    return errcode;
+}
+
+int CommandHandler::handleLeave(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData)
+{
+    const ECommand cmd = cmdMsg->Command();
+
+    CommandLeave cmd_leave;
+    _DECODE_COMMAND_MESSAGE("handleLeave", cmdMsg, cmd_leave, ep->Connection());
+
+    auto [errcode, errmsg] = service_->leave_groups(ep.get(), cmd_leave);
+    if (! errmsg.empty()) {
+        cerr << "[handleLeave] Error: " << errmsg << endl;
+    }
+
+    sendResultMessage(ep->Connection(), cmd, errcode, errmsg);
+
+    return errcode;
+}
+
 int CommandHandler::handleReject(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData)
 {
     const ECommand cmd = cmdMsg->Command();
@@ -266,6 +332,34 @@ int CommandHandler::handleUnreject(EndpointPtr ep, const CommandMessage* cmdMsg,
     return errcode;
 }
 
+int CommandHandler::handleSubscriptionState(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData)
+{
+    const ECommand cmd = cmdMsg->Command();
+
+    // binary only, see CommandSubscriptionState
+    CommandSubscriptionState cmd_state;
+    auto [payload, payload_len] = cmdMsg->Payload();
+    if (cmdMsg->IsJSON() || cmdMsg->IsPB() || ! cmd_state.decodeFromBinary(string(payload, payload_len))) {
+        int8_t errcode = 1;
+        const char* errmsg = "Invalid payload of SUBSTATE";
+        fprintf(stderr, "[handleSubscriptionState] Error: %s\n", errmsg);
+        sendResultMessage(ep->Connection(), cmd, errcode, errmsg);
+        return errcode;
+    }
+
+    auto [errcode, errmsg, added_messages] = service_->set_subscription_state(ep.get(), cmd_state);
+    if (! errmsg.empty()) {
+        cerr << "[handleSubscriptionState] Error: " << errmsg << endl;
+    }
+
+    sendResultMessage(ep->Connection(), cmd, errcode, errmsg);
+    if (errcode == 0) {
+        sendCachedValues(ep.get(), added_messages);
+    }
+
+    return errcode;
+}
+
 int CommandHandler::handlePublishData(EndpointPtr ep, const CommandMessage* cmdMsg, const string& data)
 {
     const ECommand cmd = cmdMsg->Command();
@@ -296,10 +390,20 @@ int CommandHandler::handlePublishData(EndpointPtr ep, const CommandMessage* cmdM
         }
     }
 
-    ((CommandMessage*)cmdMsg)->ConvertToNetworkMessage(context_->switch_server->IsMessagePayloadLengthIncludingSelf());
+    auto priority = cmdMsg->Priority();
+    bool is_including_self = context_->switch_server->IsMessagePayloadLengthIncludingSelf();
+    FrameVariants variants(cmdMsg, context_->Config()->compress_min_bytes);
+    for (auto target_ep : targets) {
+        variants.Prepare(target_ep->GetCompression(), is_including_self);
+    }
+    ((CommandMessage*)cmdMsg)->ConvertToNetworkMessage(is_including_self);
+    // one line per frame, the fan-out below is kept free of logging
+    printf("[handlePublishData] forward message: source: %d, targets: %ld, size: %ld\n",
+            ep->Id(), targets.size(), data.size());
     for (auto target_ep : targets) {
-        printf("[handlePublishData] forward message: size: %ld\n", data.size());
-        target_ep->Connection()->Send(data);
+        auto& frame = variants.Select(target_ep->GetCompression(), data);
+        sendToEndpoint(target_ep.get(), priority, frame, variants.Shared(target_ep->GetCompression()));
+        context_->ApplyBackpressure(ep.get(), target_ep.get());
     }
 
     int8_t errcode = 0;
@@ -330,18 +434,55 @@ int CommandHandler::handlePublishDataToTargets(EndpointPtr ep, const CommandMess
     MessageId msg_type = pub_msg->msg_type;
     vector<EndpointPtr> targets;
 
+    // the attributes are decoded once, for the first subscriber with a content filter
+    std::optional<MessageAttributes> attrs;
+    auto is_filtered_out = [&](const Endpoint* target_ep) {
+        auto filter = target_ep->GetMessageFilter(msg_type);
+        if (! filter) {
+            return false;
+        }
+        if (! attrs) {
+            attrs.emplace();
+            GetPublishingAttributes(cmdMsg, data.data() + data.size(), *attrs);
+        }
+        return ! filter->Match(*attrs);
+    };
+
+    if (pub_msg->n_targets == 0 && context_->Config()->cached_messages.contains(msg_type)) {
+        updateCachedValue(ep.get(), cmdMsg, data);
+    }
+
     if (pub_msg->n_targets > 0) {
+        // a member of several groups addressed, or also addressed by id, gets the frame once
+        const ep_id_t* targets_end = pub_msg->targets + pub_msg->n_targets;
+        bool is_deduplicated = pub_msg->n_targets > 1 && std::any_of(pub_msg->targets, targets_end, IsGroupTarget);
+        std::unordered_set<EndpointId> selected;
+        auto add_target = [&](const EndpointPtr& target_ep) {
+            if (! service_->is_forwarding_allowed(ep.get(), target_ep.get(), msg_type)) {
+                return;
+            }
+            if (is_deduplicated && ! selected.insert(target_ep->Id()).second) {
+                return;
+            }
+            targets.push_back(target_ep);
+        };
         for (int i=0; i<pub_msg->n_targets; i++) {
             auto ep_id = pub_msg->targets[i];
-            auto iter = context_->endpoints.find(ep_id);
-            if (iter == context_->endpoints.end()) {
+            if (IsGroupTarget(ep_id)) {
+                auto iter = context_->group_members.find(TargetGroup(ep_id));
+                if (iter != context_->group_members.end()) {
+                    targets.reserve(targets.size() + iter->second.size());
+                    for (auto& member_ep : iter->second) {
+                        add_target(member_ep);
+                    }
+                }
                 continue;
             }
-            auto target_ep = iter->second;
-            if (! service_->is_forwarding_allowed(ep.get(), target_ep.get(), msg_type)) {
+            auto iter = context_->endpoints.find(ep_id);
+            if (iter == context_->endpoints.end()) {
                 continue;
             }
-            targets.push_back(target_ep);
+            add_target(iter->second);
         }
     } else if (! context_->message_subscribers.empty()) {
         auto iter = context_->message_subscribers.find(msg_type);
@@ -351,7 +492,8 @@ int CommandHandler::handlePublishDataToTargets(EndpointPtr ep, const CommandMess
                 auto iter2 = context_->endpoints.find(ep_id);
                 if (iter2 != context_->endpoints.end()) {
                     auto target_ep = iter2->second;
-                    if (! service_->is_forwarding_allowed(ep.get(), target_ep.get(), msg_type)) {
+                    if (! service_->is_forwarding_allowed(ep.get(), target_ep.get(), msg_type) ||
+                            is_filtered_out(target_ep.get())) {
                         continue;
                     }
                     targets.push_back(target_ep);
@@ -362,11 +504,24 @@ int CommandHandler::handlePublishDataToTargets(EndpointPtr ep, const CommandMess
         return handlePublishData(ep, cmdMsg, data);
     }
 
-    ((CommandMessage*)cmdMsg)->ConvertToNetworkMessage(context_->switch_server->IsMessagePayloadLengthIncludingSelf());
+    auto priority = cmdMsg->Priority();
+    auto deadline = publishingDeadline(cmdMsg, msg_type);
+    auto conflation_key = OutputQueue::ConflationKey(msg_type, publishingKey(cmdMsg));
+    bool is_including_self = context_->switch_server->IsMessagePayloadLengthIncludingSelf();
+    FrameVariants variants(cmdMsg, context_->Config()->compress_min_bytes);
+    for (auto target_ep : targets) {
+        variants.Prepare(target_ep->GetCompression(), is_including_self);
+    }
+    ((CommandMessage*)cmdMsg)->ConvertToNetworkMessage(is_including_self);
+    ep->GetStats().CountPublished(msg_type);
+    printf("[handlePublishDataToTargets] forward message: source: %d, msg_type: %d, targets: %ld, size: %ld\n",
+            ep->Id(), msg_type, targets.size(), data.size());
     for (auto target_ep : targets) {
-        printf("[handlePublishDataToTargets] forward message: source: %d -> target: %d, size: %ld\n",
-                ep->Id(), target_ep->Id(), data.size());
-        target_ep->Connection()->Send(data);
+        target_ep->GetStats().CountDelivered(msg_type);
+        auto& frame = variants.Select(target_ep->GetCompression(), data);
+        sendToEndpoint(target_ep.get(), priority, frame, variants.Shared(target_ep->GetCompression()), deadline,
+                target_ep->IsConflatedMessage(msg_type) ? conflation_key : 0);
+        context_->ApplyBackpressure(ep.get(), target_ep.get());
     }
 
     int8_t errcode = 0;
@@ -411,10 +566,11 @@ int CommandHandler::handleServiceRequest(EndpointPtr ep, const CommandMessage* c
         }
     }
 
+    auto priority = servicePriority(cmdMsg);
     if (svc_ep) {
         ((CommandMessage*)cmdMsg)->ConvertToNetworkMessage(context_->switch_server->IsMessagePayloadLengthIncludingSelf());
         printf("[handleServiceRequest] forward message: size: %ld\n", data.size());
-        svc_ep->Connection()->Send(data);
+        sendToEndpoint(svc_ep.get(), priority, data);
     } else {
         // respond error message
         ResultMessage result_msg;
@@ -426,10 +582,11 @@ int CommandHandler::handleServiceRequest(EndpointPtr ep, const CommandMessage* c
         rspCmdMsg->SetPayloadLen(sizeof(ServiceMessage) + sizeof(ResultMessage) + errmsg.size());
         rspCmdMsg->ConvertToNetworkMessage(context_->switch_server->IsMessagePayloadLengthIncludingSelf());
 
-        ep->Connection()->Send(rspCmdMsg->Data(), rspCmdMsg->HeaderSize());
-        ep->Connection()->Send((char*)svc_msg, sizeof(ServiceMessage));
-        ep->Connection()->Send((char*)&result_msg, sizeof(result_msg));
-        ep->Connection()->Send(errmsg);
+        string frame(rspCmdMsg->Data(), rspCmdMsg->HeaderSize());
+        frame.append((char*)svc_msg, sizeof(ServiceMessage));
+        frame.append((char*)&result_msg, sizeof(result_msg));
+        frame.append(errmsg);
+        sendToEndpoint(ep.get(), priority, frame);
     }
     return 0;
 }
@@ -442,11 +599,13 @@ int CommandHandler::handleServiceResponse(EndpointPtr ep, const CommandMessage*
     printf("[handleServiceResponse] sess_id: %d\n", svc_msg->sess_id);
     printf("[handleServiceResponse] source: %d\n", svc_msg->source);
 
-    auto iter = context_->endpoints.find(svc_msg->source);
+    EndpointId source = svc_msg->source;  // a copy, the field of the packed header is unaligned
+    auto iter = context_->endpoints.find(source);
     if (iter != context_->endpoints.end()) {
         auto source_ep = iter->second;
+        auto priority = servicePriority(cmdMsg);
         ((CommandMessage*)cmdMsg)->ConvertToNetworkMessage(context_->switch_server->IsMessagePayloadLengthIncludingSelf());
-        source_ep->Connection()->Send(data);
+        sendToEndpoint(source_ep.get(), priority, data);
     } else {
         printf("[handleServiceResponse] Error: can not find service request source: %d\n", svc_msg->source);
     }
@@ -565,7 +724,12 @@ int CommandHandler::handleReload(EndpointPtr ep, const CommandMessage* cmdMsg, c
         return errcode;
     }
 
-    return 0;
+    auto [errcode, errmsg] = context_->switch_server->ReloadConfiguration();
+    if (errcode != 0) {
+        cerr << "[handleReload] Error: " << errmsg << endl;
+    }
+    sendResultMessage(ep->Connection(), cmd, errcode, errmsg);
+    return errcode;
 }
 
 size_t CommandHandler::sendResultMessage(TcpConnection* conn, ECommand cmd, int8_t errcode, const string& data)
@@ -591,14 +755,126 @@ size_t CommandHandler::sendResultMessage(TcpConnection* conn, ECommand cmd, int8
     ResultMessage resultMsg;
     resultMsg.errcode = errcode;
 
-    conn->Send((char*)&cmdMsg, sizeof(cmdMsg));
-    size_t sent_bytes = sizeof(cmdMsg);
-    conn->Send((char*)&resultMsg, sizeof(resultMsg));
-    sent_bytes += sizeof(resultMsg);
+    string frame;
+    frame.reserve(sizeof(cmdMsg) + sizeof(resultMsg) + payload_len);
+    frame.append((char*)&cmdMsg, sizeof(cmdMsg));
+    frame.append((char*)&resultMsg, sizeof(resultMsg));
     if (payload && payload_len > 0) {
-        conn->Send(payload, payload_len);
-        sent_bytes += sizeof(payload_len);
+        frame.append(payload, payload_len);
+    }
+
+    // the result of control command overtakes the queued data
+    auto iter = context_->endpoints.find(conn->ID());
+    if (iter != context_->endpoints.end() && iter->second->Connection() == conn) {
+        sendToEndpoint(iter->second.get(), EMessagePriority::Urgent, frame);
+    } else {
+        conn->Send(frame);  // not registered
+    }
+
+    return frame.size();
+}
+
+void CommandHandler::sendToEndpoint(Endpoint* ep, EMessagePriority priority, const string& frame,
+        int64_t deadline, uint64_t conflation_key)
+{
+    ep->GetOutputQueue().Push(priority, frame, *context_->Config(), deadline, conflation_key);
+}
+
+void CommandHandler::sendToEndpoint(Endpoint* ep, EMessagePriority priority, const string& frame, FramePtr& shared,
+        int64_t deadline, uint64_t conflation_key)
+{
+    ep->GetOutputQueue().Push(priority, frame, shared, *context_->Config(), deadline, conflation_key);
+}
+
+int64_t CommandHandler::publishingDeadline(const CommandMessage* cmdMsg, MessageId msg_type) const
+{
+    // ttl of the message, or the default ttl of message type
+    uint32_t ttl_ms = 0;
+    auto pub_ext = cmdMsg->GetPublishingExtension();
+    if (pub_ext && pub_ext->ext_len >= offsetof(PublishingExtension, ttl_ms) + sizeof(pub_ext->ttl_ms)) {
+        ttl_ms = pub_ext->ttl_ms;
+    }
+    if (ttl_ms == 0) {
+        auto& config = context_->Config();
+        auto iter = config->message_ttl.find(msg_type);
+        if (iter != config->message_ttl.end()) {
+            ttl_ms = iter->second;
+        }
+    }
+    return ttl_ms > 0 ? monotonic_milliseconds() + ttl_ms : 0;
+}
+
+uint32_t CommandHandler::publishingKey(const CommandMessage* cmdMsg)
+{
+    auto pub_ext = cmdMsg->GetPublishingExtension();
+    if (pub_ext && pub_ext->ext_len >= offsetof(PublishingExtension, key) + sizeof(pub_ext->key)) {
+        return pub_ext->key;
+    }
+    return 0;
+}
+
+void CommandHandler::updateCachedValue(Endpoint* ep, const CommandMessage* cmdMsg, const string& data)
+{
+    auto pub_msg = cmdMsg->GetPublishingMessage();
+    auto key = publishingKey(cmdMsg);
+
+    // keep the frame in the form of forwarding, uncompressed, so any subscriber can read it
+    string frame;
+    if (cmdMsg->Compression() == ECompression::None || ! DecompressFrame(cmdMsg, frame)) {
+        frame = data;
     }
+    ((CommandMessage*)frame.data())->ConvertToNetworkMessage(context_->switch_server->IsMessagePayloadLengthIncludingSelf());
+
+    auto& config = context_->Config();
+    auto deadline = publishingDeadline(cmdMsg, pub_msg->msg_type);
+    auto& value_cache = context_->value_cache;
+    bool was_full = value_cache.IsFull();
+    size_t refused_values = value_cache.RefusedValues();
+    bool is_cached = value_cache.Update(pub_msg->msg_type, key, ep->Id(), frame, deadline, config->value_cache_max_bytes);
+    // once per transition, a publisher of many keys would otherwise log each of them
+    if (! is_cached && ! was_full) {
+        fprintf(stderr, "[updateCachedValue] Warning: value cache is full, %ld bytes, new keys are not cached, "
+                "first msg_type: %d, key: %u\n", value_cache.CachedBytes(), pub_msg->msg_type, key);
+    } else if (is_cached && was_full && ! value_cache.IsFull()) {
+        printf("[updateCachedValue] value cache has room again, refused keys while full: %ld\n", refused_values);
+    }
+}
 
-    return sent_bytes;
+void CommandHandler::sendCachedValues(Endpoint* ep, const vector<MessageId>& messages)
+{
+    int64_t now = monotonic_milliseconds();
+    for (auto msg_type : messages) {
+        for (auto value : context_->value_cache.Lookup(msg_type, now)) {
+            if (value->source == ep->Id() || ep->IsRejectedSource(value->source) || ep->IsRejectedMessage(msg_type)) {
+                continue;
+            }
+            auto iter = context_->endpoints.find(value->source);
+            if (iter != context_->endpoints.end() &&
+                    ! service_->is_forwarding_allowed(iter->second.get(), ep, msg_type)) {
+                continue;
+            }
+            auto filter = ep->GetMessageFilter(msg_type);
+            if (filter) {
+                MessageAttributes attrs;
+                GetPublishingAttributes((const CommandMessage*)value->frame.data(),
+                        value->frame.data() + value->frame.size(), attrs);
+                if (! filter->Match(attrs)) {
+                    continue;
+                }
+            }
+            auto priority = ((const CommandMessage*)value->frame.data())->Priority();
+            printf("[sendCachedValues] snapshot message: msg_type: %d, source: %d -> target: %d, size: %ld\n",
+                    msg_type, value->source, ep->Id(), value->frame.size());
+            ep->GetStats().CountDelivered(msg_type);
+            sendToEndpoint(ep, priority, value->frame, value->deadline,
+                    ep->IsConflatedMessage(msg_type) ? OutputQueue::ConflationKey(msg_type, value->key) : 0);
+        }
+    }
+}
+
+EMessagePriority CommandHandler::servicePriority(const CommandMessage* cmdMsg)
+{
+    // service requests and responses are latency critical, unless the requester lowered it
+    auto priority = cmdMsg->Priority();
+    return priority == EMessagePriority::Normal ? EMessagePriority::High : priority;
 }
@@ -34,6 +34,9 @@ public:
     int handleUnsubscribe(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData);
     int handleReject(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData);
     int handleUnreject(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData);
+    int handleSubscriptionState(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData);
+    int handleJoin(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData);
+    int handleLeave(EndpointPtr ep, const CommandMessage* cmdMsg, const string& msgData);
     int handlePublishData(EndpointPtr ep, const CommandMessage* cmdMsg, const string& data);
     int handlePublishDataToTargets(EndpointPtr ep, const CommandMessage* cmdMsg, const string& data);
     int handleServiceRequest(EndpointPtr ep, const CommandMessage* cmdMsg, const string& data);
@@ -48,6 +51,18 @@ public:
     size_t sendResultMessage(TcpConnection* conn, ECommand cmd, int8_t errcode, const string& data);
     size_t sendResultMessage(TcpConnection* conn, ECommand cmd, int8_t errcode,
             const char* data = NULL, size_t data_len = 0);
+    void sendToEndpoint(Endpoint* ep, EMessagePriority priority, const string& frame,
+            int64_t deadline=0, uint64_t conflation_key=0);
+    // for the frames forwarded to many endpoints, shared: see OutputQueue::Push
+    void sendToEndpoint(Endpoint* ep, EMessagePriority priority, const string& frame, FramePtr& shared,
+            int64_t deadline=0, uint64_t conflation_key=0);
+
+private:
+    static EMessagePriority servicePriority(const CommandMessage* cmdMsg);
+    int64_t publishingDeadline(const CommandMessage* cmdMsg, MessageId msg_type) const;
+    static uint32_t publishingKey(const CommandMessage* cmdMsg);
+    void updateCachedValue(Endpoint* ep, const CommandMessage* cmdMsg, const string& data);
+    void sendCachedValues(Endpoint* ep, const vector<MessageId>& messages);
 
 private:
     SwitchContextPtr context_;
@@ -0,0 +1,113 @@
+#include <sstream>
+#include <algorithm>
+#include "switch_config.h"
+#include "switch_options.h"
+
+std::shared_ptr<SwitchConfig> SwitchConfig::FromOptions(const Options& options)
+{
+    auto config = std::make_shared<SwitchConfig>();
+    if (! options.access_code.empty()) {
+        config->access_code = options.access_code;
+    }
+    if (! options.admin_code.empty()) {
+        config->admin_code = options.admin_code;
+    }
+    if (! options.service_access_code.empty()) {
+        config->service_access_code = options.service_access_code;
+    }
+    if (! options.serving_mode.empty()) {
+        config->serving_mode = TagToServingMode(options.serving_mode);
+    }
+    if (options.tx_watermark > 0) {
+        config->tx_watermark = options.tx_watermark;
+    }
+    if (! options.lane_weights.empty()) {
+        config->lane_weights = options.lane_weights;
+    }
+    config->bp_high_watermark = options.bp_high_watermark;
+    config->bp_low_watermark = std::min(options.bp_low_watermark > 0 ? options.bp_low_watermark : options.bp_high_watermark / 2,
+            options.bp_high_watermark);
+    config->message_ttl = options.message_ttl;
+    config->cached_messages = options.cached_messages;
+    if (options.value_cache_max_bytes > 0) {
+        config->value_cache_max_bytes = options.value_cache_max_bytes;
+    }
+    for (auto& tag : options.compressions) {
+        auto compression = TagToCompression(tag);
+        if (compression != ECompression::None) {
+            config->compressions.push_back(compression);
+        }
+    }
+    if (options.compress_min_bytes > 0) {
+        config->compress_min_bytes = options.compress_min_bytes;
+    }
+    for (auto& [role_tag, limit] : options.rate_limits) {
+        auto role = TagToEndpointRole(role_tag);
+        if (role != EEndpointRole::Undefined) {
+            config->role_rate_limits[(size_t)role] = limit;
+        }
+    }
+    TagToRateLimitPolicy(options.rate_limit_policy, config->rate_limit_policy);
+    if (options.rate_limit_burst_ms > 0) {
+        config->rate_limit_burst_ms = options.rate_limit_burst_ms;
+    }
+    config->register_timeout = options.register_timeout;
+    config->heartbeat_timeout = options.heartbeat_timeout;
+    config->idle_timeout = options.idle_timeout;
+    return config;
+}
+
+string SwitchConfig::ToString() const
+{
+    std::stringstream ss;
+    ss << "{";
+    ss << "access_code: " << access_code << ", ";
+    ss << "admin_code: " << admin_code << ", ";
+    ss << "service_access_code: " << service_access_code << ", ";
+    ss << "serving_mode: " << ServingModeToTag(serving_mode) << ", ";
+    ss << "tx_watermark: " << tx_watermark << ", ";
+    ss << "lane_weights: [";
+    for (auto weight : lane_weights) {
+        ss << weight << ", ";
+    }
+    ss << "], ";
+    ss << "bp_high_watermark: " << bp_high_watermark << ", ";
+    ss << "bp_low_watermark: " << bp_low_watermark << ", ";
+    ss << "message_ttl: {";
+    for (auto [msg_type, ttl_ms] : message_ttl) {
+        ss << msg_type << ": " << ttl_ms << ", ";
+    }
+    ss << "}, ";
+    ss << "cached_messages: [";
+    for (auto msg_type : cached_messages) {
+        ss << msg_type << ", ";
+    }
+    ss << "], ";
+    ss << "value_cache_max_bytes: " << value_cache_max_bytes << ", ";
+    ss << "compressions: [";
+    for (auto compression : compressions) {
+        ss << CompressionToTag(compression) << ", ";
+    }
+    ss << "], ";
+    ss << "compress_min_bytes: " << compress_min_bytes << ", ";
+    ss << "role_rate_limits: {";
+    for (size_t role = 0; role < role_rate_limits.size(); role++) {
+        auto& limit = role_rate_limits[role];
+        if (! limit.IsUnlimited()) {
+            ss << EndpointRoleToTag((EEndpointRole)role) << ": [" << limit.msgs_per_sec << ", " << limit.bytes_per_sec << "], ";
+        }
+    }
+    ss << "}, ";
+    ss << "endpoint_rate_limits: {";
+    for (auto& [ep_id, limit] : endpoint_rate_limits) {
+        ss << ep_id << ": [" << limit.msgs_per_sec << ", " << limit.bytes_per_sec << "], ";
+    }
+    ss << "}, ";
+    ss << "rate_limit_policy: " << RateLimitPolicyToTag(rate_limit_policy) << ", ";
+    ss << "rate_limit_burst_ms: " << rate_limit_burst_ms << ", ";
+    ss << "register_timeout: " << register_timeout << ", ";
+    ss << "heartbeat_timeout: " << heartbeat_timeout << ", ";
+    ss << "idle_timeout: " << idle_timeout << ", ";
+    ss << "}";
+    return ss.str();
+}
@@ -0,0 +1,55 @@
+#ifndef _SWITCH_CONFIG_H
+#define _SWITCH_CONFIG_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <array>
+#include <memory>
+#include "switch_types.h"
+#include "switch_message.h"
+#include "endpoint_role.h"
+#include "switch_rate_limiter.h"
+
+#define DEFAULT_ACCESS_TOKEN "Hello World"
+#define DEFAULT_ADMIN_TOKEN "Foobar2000"
+#define DEFAULT_SERVICE_ACCESS_TOKEN "GOE works"
+
+using std::string;
+
+struct Options;
+struct SwitchConfig;
+using SwitchConfigPtr = std::shared_ptr<const SwitchConfig>;
+
+// The settings which can be changed at runtime (by SETUP, RELOAD or SIGHUP).
+// A snapshot is immutable once published, changes are made on a copy and swapped
+// into SwitchContext as a whole, so readers never see a half-updated config.
+struct SwitchConfig
+{
+    string access_code = DEFAULT_ACCESS_TOKEN;
+    string admin_code = DEFAULT_ADMIN_TOKEN;
+    string service_access_code = DEFAULT_SERVICE_ACCESS_TOKEN;
+    EServingMode serving_mode = EServingMode::Normal;
+    size_t tx_watermark = 64 * 1024;                    // bytes buffered by connection before queuing in lanes
+    std::vector<uint32_t> lane_weights = { 8, 4, 1 };   // weights of lanes high, normal and low
+    size_t bp_high_watermark = 0;                       // bytes queued by a target to pause its publishers, 0: disabled
+    size_t bp_low_watermark = 0;                        // bytes queued by the target to resume them
+    std::map<MessageId, uint32_t> message_ttl;          // default ttl in milliseconds of message types
+    std::set<MessageId> cached_messages;                // message types of last-value cache
+    size_t value_cache_max_bytes = 16 * 1024 * 1024;    // bytes of all cached values
+    std::vector<ECompression> compressions;             // enabled for negotiation, in order of preference
+    size_t compress_min_bytes = 256;                    // the shorter content is sent uncompressed
+    std::array<RateLimit, (size_t)EEndpointRole::COUNT> role_rate_limits;   // default limits per role
+    std::map<EndpointId, RateLimit> endpoint_rate_limits;   // overrides of endpoints, by SETUP
+    ERateLimitPolicy rate_limit_policy = ERateLimitPolicy::Reject;
+    uint32_t rate_limit_burst_ms = 1000;                // capacity of token buckets, in milliseconds of rate
+    uint32_t register_timeout = 30;                     // seconds to register after connected, 0: unlimited
+    uint32_t heartbeat_timeout = 0;                     // seconds receiving nothing, heartbeats included, 0: unlimited
+    uint32_t idle_timeout = 0;                          // seconds an endpoint sends no message, 0: unlimited
+
+    static std::shared_ptr<SwitchConfig> FromOptions(const Options& options);
+    string ToString() const;
+};
+
+#endif  // _SWITCH_CONFIG_H
@@ -67,7 +67,6 @@ int SwitchConsole::handleConsoleCommand_Context(const vector<string>& argv)
 }
 int SwitchConsole::handleConsoleCommand_Stats(const vector<string>& argv)
 {
-    // TODO: add sub commands: [--endpoint EP_ID]
     argparse::ArgumentParser cmd_ap(argv[0], "1.0", argparse::default_arguments::help, false);
 
     cmd_ap.add_argument("--is_details")
@@ -107,6 +106,16 @@ int SwitchConsole::handleConsoleCommand_Stats(const vector<string>& argv)
             string cmd_ep_info_json = cmd_ep_info->encodeToJSON();
             PUT_LINE("* stats: ", cmd_ep_info_json);
             PUT_LINE("* uptime: ", readable_seconds_delta(cmd_ep_info->uptime));
+            PUT_LINE("* messages: in: ", cmd_ep_info->msgs_in, ", out: ", cmd_ep_info->msgs_out,
+                    ", rejected: ", cmd_ep_info->rejected_msgs, ", expired: ", cmd_ep_info->expired_frames,
+                    ", conflated: ", cmd_ep_info->conflated_frames);
+            PUT_LINE("* queue: frames: ", cmd_ep_info->queued_frames, " (max ", cmd_ep_info->max_queued_frames,
+                    "), bytes: ", cmd_ep_info->queued_bytes, " (max ", cmd_ep_info->max_queued_bytes, ")");
+            PUT_LINE("* forward latency (ms): avg: ", cmd_ep_info->fwd_latency_avg,
+                    ", max: ", cmd_ep_info->fwd_latency_max);
+            for (auto& msg_stats : cmd_ep_info->top_messages) {
+                PUT_LINE("* msg_type ", msg_stats.msg_type, ": in: ", msg_stats.in, ", out: ", msg_stats.out);
+            }
         }
     } else {
         auto cmd_info = service->get_stats(cmd_info_req);
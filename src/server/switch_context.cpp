@@ -1,4 +1,5 @@
 #include <sstream>
+#include <algorithm>
 #include <iomanip>  // for std::put_time
 #include "switch_context.h"
 #include "switch_server.h"
@@ -7,18 +8,7 @@ SwitchContext::SwitchContext(SwitchServer* server) :
     switch_server(server), born_time(evt_loop::Now())
 {
     auto options = switch_server->GetOptions();
-    if (! options->access_code.empty()) {
-        access_code = options->access_code;
-    }
-    if (! options->admin_code.empty()) {
-        admin_code = options->admin_code;
-    }
-    if (! options->service_access_code.empty()) {
-        service_access_code = options->service_access_code;
-    }
-    if (! options->serving_mode.empty()) {
-        serving_mode = TagToServingMode(options->serving_mode);
-    }
+    UpdateConfig(options ? SwitchConfig::FromOptions(*options) : std::make_shared<SwitchConfig>());
 }
 
 string SwitchContext::ToString() const
@@ -27,10 +17,7 @@ string SwitchContext::ToString() const
     ss << "{";
     ss << "born_time: " << std::put_time(localtime(&born_time), "%Y-%m-%d %I:%M:%S") << ", ";
     ss << "node_id: " << switch_server->NodeId() << ", ";
-    ss << "access_code: " << access_code << ", ";
-    ss << "admin_code: " << admin_code << ", ";
-    ss << "service_access_code: " << service_access_code << ", ";
-    ss << "serving_mode: " << ServingModeToTag(serving_mode) << ", ";
+    ss << "config: " << Config()->ToString() << ", ";
     ss << "message_header_description: " << switch_server->GetMessageHeaderDescription()->ToString() << ", ";
     ss << "}";
     return ss.str();
@@ -61,5 +48,90 @@ void SwitchContext::RemoveEndpoint(EndpointId ep_id)
         default:
             break;
     }
+    for (auto msg_type : ep->GetSubscriedMessages()) {
+        auto subs_iter = message_subscribers.find(msg_type);
+        if (subs_iter != message_subscribers.end()) {
+            subs_iter->second.erase(ep_id);
+            if (subs_iter->second.empty()) {
+                message_subscribers.erase(subs_iter);
+            }
+        }
+    }
+    for (auto group : ep->GetGroups()) {
+        RemoveGroupMember(group, ep.get());
+    }
+    ReleaseBackpressure(ep.get(), true);
+    for (auto target_id : ep->GetBackpressuringTargets()) {
+        auto target_iter = endpoints.find(target_id);
+        if (target_iter != endpoints.end()) {
+            target_iter->second->GetBackpressuredSources().erase(ep_id);
+        }
+    }
+    auto session_store = switch_server->GetSessionStore();
+    if (session_store) {
+        session_store->RemoveEndpoint(ep_id);
+    }
     endpoints.erase(iter);
 }
+
+void SwitchContext::RemoveGroupMember(GroupId group, const Endpoint* ep)
+{
+    auto iter = group_members.find(group);
+    if (iter == group_members.end()) {
+        return;
+    }
+    auto& members = iter->second;
+    auto member_iter = std::find_if(members.begin(), members.end(),
+            [ep](const EndpointPtr& member) { return member.get() == ep; });
+    if (member_iter != members.end()) {
+        // the order of members does not matter, swap with the last instead of shifting the rest
+        *member_iter = std::move(members.back());
+        members.pop_back();
+    }
+    if (members.empty()) {
+        group_members.erase(iter);
+    }
+}
+
+void SwitchContext::ApplyBackpressure(Endpoint* source, Endpoint* target)
+{
+    auto& config = Config();
+    if (config->bp_high_watermark == 0 || source == target ||
+            target->GetOutputQueue().QueuedBytes() < config->bp_high_watermark) {
+        return;
+    }
+    // by the set of source, a target may still list the id of an earlier endpoint of the source
+    auto& targets = source->GetBackpressuringTargets();
+    if (! targets.insert(target->Id()).second) {
+        return;
+    }
+    target->GetBackpressuredSources().insert(source->Id());
+    if (targets.size() == 1) {
+        printf("[SwitchContext::ApplyBackpressure] pause reading, source: %d, target: %d, queued bytes: %lu\n",
+                source->Id(), target->Id(), target->GetOutputQueue().QueuedBytes());
+        source->PauseReading(Endpoint::PAUSED_BY_BACKPRESSURE);
+    }
+}
+
+void SwitchContext::ReleaseBackpressure(Endpoint* target, bool is_forced)
+{
+    auto& sources = target->GetBackpressuredSources();
+    if (sources.empty() ||
+            (! is_forced && target->GetOutputQueue().QueuedBytes() > Config()->bp_low_watermark)) {
+        return;
+    }
+    for (auto source_id : sources) {
+        auto iter = endpoints.find(source_id);
+        if (iter == endpoints.end()) {
+            continue;
+        }
+        auto source = iter->second.get();
+        auto& targets = source->GetBackpressuringTargets();
+        if (targets.erase(target->Id()) > 0 && targets.empty()) {
+            printf("[SwitchContext::ReleaseBackpressure] resume reading, source: %d, target: %d\n",
+                    source_id, target->Id());
+            source->ResumeReading(Endpoint::PAUSED_BY_BACKPRESSURE);
+        }
+    }
+    sources.clear();
+}
@@ -5,10 +5,8 @@
 #include <string>
 #include "switch_endpoint.h"
 #include "switch_types.h"
-
-#define DEFAULT_ACCESS_TOKEN "Hello World"
-#define DEFAULT_ADMIN_TOKEN "Foobar2000"
-#define DEFAULT_SERVICE_ACCESS_TOKEN "GOE works"
+#include "switch_config.h"
+#include "switch_value_cache.h"
 
 using std::map;
 using std::string;
@@ -27,17 +25,29 @@ struct SwitchContext
     //map<EndpointId, EndpointPtr>    rproxy_endpoints;
 
     map<MessageId, set<EndpointId>>    message_subscribers;
+    map<GroupId, vector<EndpointPtr>>  group_members;  // contiguous, a publish to a group scans them once
+    ValueCache                         value_cache;
 
     time_t born_time;
-    string access_code = DEFAULT_ACCESS_TOKEN;
-    string admin_code = DEFAULT_ADMIN_TOKEN;
-    string service_access_code = DEFAULT_SERVICE_ACCESS_TOKEN;
-    EServingMode serving_mode;
 
     SwitchContext(SwitchServer* server);
     string ToString() const;
 
+    // the current config snapshot, read and replaced on the loop thread only, so no atomics;
+    // the reference is valid until the next UpdateConfig, copy the pointer to keep a snapshot
+    const SwitchConfigPtr& Config() const { return config_; }
+    void UpdateConfig(const SwitchConfigPtr& config) { config_ = config; }
+
     void RemoveEndpoint(EndpointId ep_id);
+    void RemoveGroupMember(GroupId group, const Endpoint* ep);
+
+    // Read backpressure: once the output queue of target passes the high watermark, stop reading
+    // from the publishers feeding it, and resume them when it drains to the low watermark.
+    void ApplyBackpressure(Endpoint* source, Endpoint* target);
+    void ReleaseBackpressure(Endpoint* target, bool is_forced=false);
+
+private:
+    SwitchConfigPtr config_;
 };
 typedef std::shared_ptr<SwitchContext> SwitchContextPtr;
 
@@ -1,12 +1,33 @@
 #include "switch_endpoint.h"
 #include "eventloop/eventloop.h"
+#include "utils/time.h"
 
 Endpoint::Endpoint(EndpointId id, TcpConnection* conn)
-    : role_(EEndpointRole::Undefined), conn_(conn), born_time_(evt_loop::Now()), svc_type_(0)
+    : role_(EEndpointRole::Undefined), conn_(conn), born_time_(evt_loop::Now()),
+    last_message_ms_(coarse_monotonic_milliseconds()), svc_type_(0),
+    output_queue_(conn)
 {
     conn_->SetID(id);
 }
 
+void Endpoint::PauseReading(ReadPauseReason reason)
+{
+    if (read_pause_reasons_ == 0) {
+        conn_->DisableReading();
+    }
+    read_pause_reasons_ |= reason;
+}
+void Endpoint::ResumeReading(ReadPauseReason reason)
+{
+    if (read_pause_reasons_ == 0) {
+        return;
+    }
+    read_pause_reasons_ &= ~reason;
+    if (read_pause_reasons_ == 0) {
+        conn_->EnableReading();
+    }
+}
+
 void Endpoint::SetForwardTargets(const vector<EndpointId>& targets)
 {
     fwd_targets_.insert(targets.begin(), targets.end());
@@ -104,3 +125,65 @@ bool Endpoint::IsRejectedMessage(MessageId msg_id) const
     }
     return false;
 }
+
+void Endpoint::ConflateMessages(const vector<MessageId>& messages)
+{
+    conflated_messages_.insert(messages.begin(), messages.end());
+}
+void Endpoint::UnconflateMessages(const vector<MessageId>& messages)
+{
+    for (auto elem : messages) {
+        conflated_messages_.erase(elem);
+    }
+}
+
+void Endpoint::SetMessageFilter(const vector<MessageId>& messages, MessageFilterPtr filter)
+{
+    for (auto elem : messages) {
+        if (filter) {
+            msg_filters_[elem] = filter;
+        } else {
+            msg_filters_.erase(elem);
+        }
+    }
+}
+const MessageFilter* Endpoint::GetMessageFilter(MessageId msg_id) const
+{
+    if (msg_filters_.empty()) {
+        return nullptr;
+    }
+    auto iter = msg_filters_.find(msg_id);
+    return iter != msg_filters_.end() ? iter->second.get() : nullptr;
+}
+
+void Endpoint::ReplaceForwardTargets(set<EndpointId>&& targets)
+{
+    fwd_targets_ = std::move(targets);
+}
+void Endpoint::ReplaceSources(set<EndpointId>&& subs_sources, set<EndpointId>&& rej_sources)
+{
+    subs_sources_ = std::move(subs_sources);
+    rej_sources_ = std::move(rej_sources);
+}
+void Endpoint::ReplaceMessages(set<MessageId>&& subs_messages, set<MessageId>&& rej_messages,
+        set<MessageId>&& conflated_messages)
+{
+    subs_messages_ = std::move(subs_messages);
+    rej_messages_ = std::move(rej_messages);
+    conflated_messages_ = std::move(conflated_messages);
+}
+void Endpoint::ReplaceMessageFilters(map<MessageId, MessageFilterPtr>&& filters)
+{
+    msg_filters_ = std::move(filters);
+}
+
+void Endpoint::ClearState()
+{
+    fwd_targets_.clear();
+    subs_sources_.clear();
+    rej_sources_.clear();
+    subs_messages_.clear();
+    rej_messages_.clear();
+    conflated_messages_.clear();
+    msg_filters_.clear();
+}
@@ -3,14 +3,20 @@
 
 #include <vector>
 #include <set>
+#include <map>
 #include <memory>
 #include <eventloop/tcp_connection.h>
 #include "switch_message.h"
 #include "endpoint_role.h"
 #include "switch_types.h"
+#include "switch_output_queue.h"
+#include "switch_message_filter.h"
+#include "switch_rate_limiter.h"
+#include "switch_endpoint_stats.h"
 
 using std::vector;
 using std::set;
+using std::map;
 using std::shared_ptr;
 
 namespace evt_loop {
@@ -31,8 +37,29 @@ public:
     void SetToken(const string& token) { token_ = token; }
 
     TcpConnection* Connection() { return conn_; }
-    void SetConnection(TcpConnection* conn) { conn_ = conn; }
+    void SetConnection(TcpConnection* conn) { conn_ = conn; output_queue_.SetConnection(conn); }
+    OutputQueue& GetOutputQueue() { return output_queue_; }
+    RateLimiter& GetRateLimiter() { return rate_limiter_; }
+    EndpointStats& GetStats() { return stats_; }
+
+    // the reading of connection stays paused while any of the reasons holds
+    enum ReadPauseReason : uint8_t {
+        PAUSED_BY_RATE_LIMIT    = 0x01,
+        PAUSED_BY_BACKPRESSURE  = 0x02,
+    };
+    void PauseReading(ReadPauseReason reason);
+    void ResumeReading(ReadPauseReason reason);
+    bool IsReadingPaused() const { return read_pause_reasons_ != 0; }
+
+    // read backpressure, see SwitchContext::ApplyBackpressure
+    set<EndpointId>& GetBackpressuredSources() { return bp_sources_; }
+    set<EndpointId>& GetBackpressuringTargets() { return bp_targets_; }
     time_t GetBornTime() const { return born_time_; }
+    // of the last message received from it, by coarse_monotonic_milliseconds(), for idle_timeout
+    int64_t GetLastMessageTime() const { return last_message_ms_; }
+    void SetLastMessageTime(int64_t now_ms) { last_message_ms_ = now_ms; }
+    ECompression GetCompression() const { return compression_; }
+    void SetCompression(ECompression compression) { compression_ = compression; }
     void SetServiceType(uint8_t svc_type) { svc_type_ = svc_type; }
     uint8_t GetServiceType() const { return svc_type_; }
 
@@ -58,20 +85,55 @@ public:
     bool IsSubscribedMessage(MessageId msg_id) const;
     bool IsRejectedMessage(MessageId msg_id) const;
 
+    void ConflateMessages(const vector<MessageId>& messages);
+    void UnconflateMessages(const vector<MessageId>& messages);
+    const set<MessageId>& GetConflatedMessages() const { return conflated_messages_; }
+    bool IsConflatedMessage(MessageId msg_id) const { return conflated_messages_.contains(msg_id); }
+
+    // filter: nullptr to remove the content filters of messages
+    void SetMessageFilter(const vector<MessageId>& messages, MessageFilterPtr filter);
+    const map<MessageId, MessageFilterPtr>& GetMessageFilters() const { return msg_filters_; }
+    const MessageFilter* GetMessageFilter(MessageId msg_id) const;
+
+    // replace the whole sets at once, for SUBSTATE
+    void ReplaceForwardTargets(set<EndpointId>&& targets);
+    void ReplaceSources(set<EndpointId>&& subs_sources, set<EndpointId>&& rej_sources);
+    void ReplaceMessages(set<MessageId>&& subs_messages, set<MessageId>&& rej_messages,
+            set<MessageId>&& conflated_messages);
+    void ReplaceMessageFilters(map<MessageId, MessageFilterPtr>&& filters);
+
+    // membership of groups, the members of a group are kept in SwitchContext.group_members
+    bool JoinGroup(GroupId group) { return groups_.insert(group).second; }
+    bool LeaveGroup(GroupId group) { return groups_.erase(group) > 0; }
+    const set<GroupId>& GetGroups() const { return groups_; }
+
+    void ClearState();  // clear forwarding targets, subscribed, rejected and conflated sources/messages, filters
+
 private:
     EEndpointRole       role_;
     string              token_;
     TcpConnection*      conn_;
     time_t              born_time_;
+    int64_t             last_message_ms_;
     ServiceType         svc_type_;           // service type, if role is Service
+    ECompression        compression_ = ECompression::None;  // negotiated at REG, for the frames sent to it
+    OutputQueue         output_queue_;
+    RateLimiter         rate_limiter_;      // admission control of the frames received from it
+    EndpointStats       stats_;             // for EP_INFO
+    uint8_t             read_pause_reasons_ = 0;    // ReadPauseReason bits
+    set<EndpointId>     bp_sources_;        // as a congested target, the publishers paused for it
+    set<EndpointId>     bp_targets_;        // as a publisher, the congested targets pausing it
 
     set<EndpointId>     fwd_targets_;
+    set<GroupId>        groups_;            // joined groups
 
     set<EndpointId>     subs_sources_;      // subscribed sources
     set<EndpointId>     rej_sources_;       // rejected sources
 
     set<MessageId>      subs_messages_;     // subscribed messages
     set<MessageId>      rej_messages_;      // rejected messages
+    set<MessageId>      conflated_messages_;    // subscribed messages in conflation mode
+    map<MessageId, MessageFilterPtr>    msg_filters_;   // content filters of subscribed messages
 
     //map<SessionID, EndpointId> sess_sources_;
 };
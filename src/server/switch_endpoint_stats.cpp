@@ -0,0 +1,39 @@
+#include <algorithm>
+#include "switch_endpoint_stats.h"
+
+EndpointStats::MessageCounters& EndpointStats::Slot(MessageId msg_type)
+{
+    // a linear scan of a few cache lines, no hashing or allocation
+    int min_slot = 0;
+    for (int i = 0; i < n_slots_; i++) {
+        if (slots_[i].msg_type == msg_type) {
+            return slots_[i];
+        }
+        if (slots_[i].Weight() < slots_[min_slot].Weight()) {
+            min_slot = i;
+        }
+    }
+    if (n_slots_ < TOP_SLOTS) {
+        auto& slot = slots_[n_slots_++];
+        slot.msg_type = msg_type;
+        return slot;
+    }
+    auto& slot = slots_[min_slot];
+    uint64_t error = slot.Weight();
+    slot = MessageCounters();
+    slot.msg_type = msg_type;
+    slot.error = error;
+    return slot;
+}
+
+vector<EndpointStats::MessageCounters> EndpointStats::TopMessages(size_t n) const
+{
+    vector<MessageCounters> top(slots_, slots_ + n_slots_);
+    std::sort(top.begin(), top.end(), [](const MessageCounters& a, const MessageCounters& b) {
+        return a.Weight() > b.Weight();
+    });
+    if (top.size() > n) {
+        top.resize(n);
+    }
+    return top;
+}
@@ -0,0 +1,48 @@
+#ifndef _SWITCH_ENDPOINT_STATS_H
+#define _SWITCH_ENDPOINT_STATS_H
+
+#include <cstdint>
+#include <vector>
+#include "switch_types.h"
+
+using std::vector;
+
+// Counters of an endpoint for EP_INFO, of fixed size, so the message path only increments.
+// The breakdown by msg_type keeps the TOP_SLOTS busiest types of the endpoint by space-saving
+// (Metwally et al.): a type not tracked takes over the slot of the least busy one, inheriting
+// its weight as the error, so a busy type is never crowded out by many rare ones. The in/out
+// of a slot count from when its type took it over.
+class EndpointStats {
+public:
+    static const int TOP_SLOTS = 16;
+
+    struct MessageCounters {
+        MessageId msg_type = 0;
+        uint64_t  in = 0;       // published by the endpoint
+        uint64_t  out = 0;      // routed to the endpoint
+        uint64_t  error = 0;    // weight inherited at the takeover
+        uint64_t Weight() const { return in + out + error; }
+    };
+
+    void CountReceived() { msgs_in_++; }
+    void CountRejected() { rejected_msgs_++; }
+    void CountPublished(MessageId msg_type) { Slot(msg_type).in++; }
+    void CountDelivered(MessageId msg_type) { Slot(msg_type).out++; }
+
+    uint64_t ReceivedMessages() const { return msgs_in_; }
+    uint64_t RejectedMessages() const { return rejected_msgs_; }
+
+    // the n busiest types, the busiest first
+    vector<MessageCounters> TopMessages(size_t n) const;
+
+private:
+    MessageCounters& Slot(MessageId msg_type);
+
+private:
+    uint64_t        msgs_in_ = 0;           // admitted frames, of all commands
+    uint64_t        rejected_msgs_ = 0;     // over the rate limit
+    int             n_slots_ = 0;           // in use, from the front
+    MessageCounters slots_[TOP_SLOTS];
+};
+
+#endif  // _SWITCH_ENDPOINT_STATS_H
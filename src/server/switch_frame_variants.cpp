@@ -0,0 +1,53 @@
+#include "switch_frame_variants.h"
+#include "compression.h"
+#include <cstdio>
+
+ECompression FrameVariants::VariantOf(ECompression target_compression) const
+{
+    auto source_compression = cmd_msg_->Compression();
+    if (target_compression == source_compression) {
+        return source_compression;
+    }
+    return source_compression == ECompression::None ? target_compression : ECompression::None;
+}
+
+void FrameVariants::Prepare(ECompression target_compression, bool isMsgPayloadLengthIncludingSelf)
+{
+    auto compression = VariantOf(target_compression);
+    if (compression == cmd_msg_->Compression() || variants_.contains(compression)) {
+        return;
+    }
+    string frame;
+    bool is_built = compression == ECompression::None ?
+        DecompressFrame(cmd_msg_, frame) :
+        CompressFrame(cmd_msg_, compression, min_bytes_, frame);
+    if (! is_built) {
+        if (compression == ECompression::None) {
+            fprintf(stderr, "[FrameVariants] Error: failed to decompress the content, compression: %s\n",
+                    CompressionToTag(cmd_msg_->Compression()));
+        }
+        // not worth compressing, the plain source frame is used
+        variants_[compression] = nullptr;
+        return;
+    }
+    ((CommandMessage*)frame.data())->ConvertToNetworkMessage(isMsgPayloadLengthIncludingSelf);
+    variants_[compression] = std::make_shared<const string>(std::move(frame));
+}
+
+const string& FrameVariants::Select(ECompression target_compression, const string& frame) const
+{
+    auto iter = variants_.find(VariantOf(target_compression));
+    if (iter == variants_.end() || ! iter->second) {
+        return frame;
+    }
+    return *iter->second;
+}
+
+FramePtr& FrameVariants::Shared(ECompression target_compression)
+{
+    auto iter = variants_.find(VariantOf(target_compression));
+    if (iter == variants_.end() || ! iter->second) {
+        return source_;
+    }
+    return iter->second;
+}
@@ -0,0 +1,43 @@
+#ifndef _SWITCH_FRAME_VARIANTS_H
+#define _SWITCH_FRAME_VARIANTS_H
+
+#include <map>
+#include <string>
+#include "switch_message.h"
+#include "switch_output_queue.h"
+
+using std::map;
+using std::string;
+
+// The variants of a frame forwarded to many endpoints, by the compression of content.
+// An endpoint negotiated the compression of the source frame gets it untouched, the
+// others get a variant which is built once per message rather than once per target:
+// a plain frame is compressed by the compression of target, a compressed frame is
+// decompressed (every endpoint accepts plain frames).
+// The variants and the source frame are kept in shared buffers for the output queues
+// of targets, the source frame is copied into one only if a target has to queue it.
+class FrameVariants {
+public:
+    // cmdMsg: the source frame in host byte order
+    FrameVariants(const CommandMessage* cmdMsg, size_t min_bytes) :
+        cmd_msg_(cmdMsg), min_bytes_(min_bytes)
+    {}
+
+    // build the variant for a target, MUST be called before the source frame is converted to network byte order
+    void Prepare(ECompression target_compression, bool isMsgPayloadLengthIncludingSelf);
+    // frame: the source frame in network byte order, returned if no variant is needed or it can't be built
+    const string& Select(ECompression target_compression, const string& frame) const;
+    // the shared buffer of the frame selected for a target, for OutputQueue::Push
+    FramePtr& Shared(ECompression target_compression);
+
+private:
+    ECompression VariantOf(ECompression target_compression) const;
+
+private:
+    const CommandMessage*       cmd_msg_;
+    size_t                      min_bytes_;
+    map<ECompression, FramePtr> variants_;  // compression of variant -> frame in network byte order, null: source frame
+    FramePtr                    source_;    // the source frame, once queued by a target
+};
+
+#endif  // _SWITCH_FRAME_VARIANTS_H
@@ -0,0 +1,17 @@
+#include "switch_id_allocator.h"
+#include "utils/random.h"
+
+EndpointIdAllocator::EndpointIdAllocator() :
+    next_id_(generate_random_integer(MIN_GENERATED_ID, MAX_GENERATED_ID))
+{
+}
+
+EndpointId EndpointIdAllocator::Allocate(const std::function<bool (EndpointId)>& is_used)
+{
+    EndpointId ep_id;
+    do {
+        ep_id = next_id_;
+        next_id_ = next_id_ < MAX_GENERATED_ID ? next_id_ + 1 : MIN_GENERATED_ID;
+    } while (is_used(ep_id));
+    return ep_id;
+}
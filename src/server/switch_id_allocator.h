@@ -0,0 +1,26 @@
+#ifndef _SWITCH_ID_ALLOCATOR_H
+#define _SWITCH_ID_ALLOCATOR_H
+
+#include <functional>
+#include "switch_types.h"
+
+// The endpoint ids generated by Switch. A cursor walks the id space from a random start,
+// skipping the ids in use, so an allocation costs O(1) however many endpoints are live,
+// and an id is not handed out again until the space wraps around (the frames addressed
+// to a left endpoint never reach a newcomer). The ids below MIN_GENERATED_ID are left
+// to the endpoints configured with a fixed id.
+class EndpointIdAllocator {
+public:
+    static const EndpointId MIN_GENERATED_ID = 0x10000;
+    static const EndpointId MAX_GENERATED_ID = 0x7fffffff;  // printed as int all over
+
+    EndpointIdAllocator();
+
+    // is_used: whether the id is taken, by a live endpoint or a dormant session
+    EndpointId Allocate(const std::function<bool (EndpointId)>& is_used);
+
+private:
+    EndpointId next_id_;
+};
+
+#endif  // _SWITCH_ID_ALLOCATOR_H
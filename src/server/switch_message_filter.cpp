@@ -0,0 +1,458 @@
+#include "switch_message_filter.h"
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+// Recursive descent compiler of the filter expression, emits the postfix bytecode
+class FilterCompiler {
+public:
+    FilterCompiler(const string& expression, MessageFilter& filter) :
+        expr_(expression), filter_(filter)
+    {}
+
+    string Compile();
+
+private:
+    enum class TokenType { End, Name, Number, String, Operator, LParen, RParen, Comma };
+    struct Token {
+        TokenType   type = TokenType::End;
+        string      text;
+        size_t      pos = 0;
+    };
+
+    bool NextToken();
+    bool Expect(TokenType type, const char* what);
+    bool IsKeyword(const char* keyword) const;
+    bool IsOperator(const char* op) const { return token_.type == TokenType::Operator && token_.text == op; }
+
+    bool ParseOr();
+    bool ParseAnd();
+    bool ParseUnary();
+    bool ParseComparison();
+    bool ParseLiteral(AttributeValue& value);
+
+    bool Emit(MessageFilter::Instruction ins);
+    uint16_t AttributeIndex(const string& name);
+    bool Fail(const string& errmsg);
+
+private:
+    const string&   expr_;
+    MessageFilter&  filter_;
+    size_t          pos_ = 0;
+    Token           token_;
+    string          errmsg_;
+    size_t          depth_ = 0;     // of the evaluation stack
+    size_t          max_depth_ = 0;
+    size_t          nesting_ = 0;   // of parentheses and "not", bounds the recursion
+};
+
+bool FilterCompiler::Fail(const string& errmsg)
+{
+    if (errmsg_.empty()) {
+        std::stringstream ss;
+        ss << errmsg << " at position " << token_.pos;
+        errmsg_ = ss.str();
+    }
+    return false;
+}
+
+bool FilterCompiler::NextToken()
+{
+    while (pos_ < expr_.size() && isspace((unsigned char)expr_[pos_])) {
+        pos_++;
+    }
+    token_ = Token();
+    token_.pos = pos_;
+    if (pos_ >= expr_.size()) {
+        return true;
+    }
+
+    char c = expr_[pos_];
+    if (isalpha((unsigned char)c) || c == '_') {
+        size_t start = pos_;
+        while (pos_ < expr_.size() && (isalnum((unsigned char)expr_[pos_]) || expr_[pos_] == '_' || expr_[pos_] == '.')) {
+            pos_++;
+        }
+        token_.type = TokenType::Name;
+        token_.text = expr_.substr(start, pos_ - start);
+    } else if (isdigit((unsigned char)c) || ((c == '-' || c == '+' || c == '.') && pos_ + 1 < expr_.size() &&
+                (isdigit((unsigned char)expr_[pos_ + 1]) || expr_[pos_ + 1] == '.'))) {
+        size_t start = pos_++;
+        while (pos_ < expr_.size() && (isalnum((unsigned char)expr_[pos_]) || expr_[pos_] == '.' ||
+                    ((expr_[pos_] == '-' || expr_[pos_] == '+') && (expr_[pos_ - 1] == 'e' || expr_[pos_ - 1] == 'E')))) {
+            pos_++;
+        }
+        token_.type = TokenType::Number;
+        token_.text = expr_.substr(start, pos_ - start);
+    } else if (c == '"' || c == '\'') {
+        pos_++;
+        while (pos_ < expr_.size() && expr_[pos_] != c) {
+            if (expr_[pos_] == '\\' && pos_ + 1 < expr_.size()) {
+                pos_++;
+            }
+            token_.text.push_back(expr_[pos_++]);
+        }
+        if (pos_ >= expr_.size()) {
+            return Fail("Unterminated string");
+        }
+        pos_++;
+        token_.type = TokenType::String;
+    } else if (c == '(' || c == ')' || c == ',') {
+        pos_++;
+        token_.type = c == '(' ? TokenType::LParen : (c == ')' ? TokenType::RParen : TokenType::Comma);
+        token_.text = c;
+    } else {
+        static const char* operators[] = { "==", "!=", "<=", ">=", "&&", "||", "<", ">", "!", "=" };
+        for (auto op : operators) {
+            if (expr_.compare(pos_, strlen(op), op) == 0) {
+                pos_ += strlen(op);
+                token_.type = TokenType::Operator;
+                token_.text = strcmp(op, "=") == 0 ? "==" : op;
+                return true;
+            }
+        }
+        return Fail(string("Unexpected character '") + c + "'");
+    }
+    return true;
+}
+
+bool FilterCompiler::Expect(TokenType type, const char* what)
+{
+    if (token_.type != type) {
+        return Fail(string("Expected ") + what);
+    }
+    return NextToken();
+}
+
+bool FilterCompiler::IsKeyword(const char* keyword) const
+{
+    if (token_.type != TokenType::Name || token_.text.size() != strlen(keyword)) {
+        return false;
+    }
+    return std::equal(token_.text.begin(), token_.text.end(), keyword,
+            [](char a, char b) { return tolower((unsigned char)a) == b; });
+}
+
+bool FilterCompiler::Emit(MessageFilter::Instruction ins)
+{
+    if (filter_.code_.size() >= MessageFilter::MAX_INSTRUCTIONS) {
+        return Fail("Expression is too complex");
+    }
+    switch (ins.op) {
+        case MessageFilter::OpCode::Compare:
+        case MessageFilter::OpCode::In:
+        case MessageFilter::OpCode::Exists:
+            depth_++;
+            break;
+        case MessageFilter::OpCode::And:
+        case MessageFilter::OpCode::Or:
+            depth_--;
+            break;
+        case MessageFilter::OpCode::Not:
+            break;
+    }
+    max_depth_ = std::max(max_depth_, depth_);
+    if (max_depth_ > MessageFilter::MAX_STACK_DEPTH) {
+        return Fail("Expression is too deep");
+    }
+    filter_.code_.push_back(ins);
+    return true;
+}
+
+uint16_t FilterCompiler::AttributeIndex(const string& name)
+{
+    auto iter = std::find(filter_.attr_names_.begin(), filter_.attr_names_.end(), name);
+    if (iter != filter_.attr_names_.end()) {
+        return iter - filter_.attr_names_.begin();
+    }
+    filter_.attr_names_.push_back(name);
+    return filter_.attr_names_.size() - 1;
+}
+
+string FilterCompiler::Compile()
+{
+    if (expr_.size() > MessageFilter::MAX_EXPRESSION_LEN) {
+        return "Expression is too long";
+    }
+    if (! NextToken()) {
+        return errmsg_;
+    }
+    if (token_.type == TokenType::End) {
+        return "Empty expression";
+    }
+    if (! ParseOr()) {
+        return errmsg_;
+    }
+    if (token_.type != TokenType::End) {
+        Fail("Unexpected '" + token_.text + "'");
+        return errmsg_;
+    }
+    return "";
+}
+
+bool FilterCompiler::ParseOr()
+{
+    if (! ParseAnd()) {
+        return false;
+    }
+    while (IsKeyword("or") || IsOperator("||")) {
+        if (! NextToken() || ! ParseAnd() || ! Emit({ MessageFilter::OpCode::Or })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FilterCompiler::ParseAnd()
+{
+    if (! ParseUnary()) {
+        return false;
+    }
+    while (IsKeyword("and") || IsOperator("&&")) {
+        if (! NextToken() || ! ParseUnary() || ! Emit({ MessageFilter::OpCode::And })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FilterCompiler::ParseUnary()
+{
+    if (++nesting_ > MessageFilter::MAX_STACK_DEPTH) {
+        return Fail("Expression is too deep");
+    }
+    bool is_parsed = false;
+    if (IsKeyword("not") || IsOperator("!")) {
+        is_parsed = NextToken() && ParseUnary() && Emit({ MessageFilter::OpCode::Not });
+    } else if (token_.type == TokenType::LParen) {
+        is_parsed = NextToken() && ParseOr() && Expect(TokenType::RParen, "')'");
+    } else {
+        is_parsed = ParseComparison();
+    }
+    nesting_--;
+    return is_parsed;
+}
+
+bool FilterCompiler::ParseComparison()
+{
+    if (token_.type != TokenType::Name || IsKeyword("and") || IsKeyword("or") || IsKeyword("in")) {
+        return Fail("Expected attribute name");
+    }
+    MessageFilter::Instruction ins = { MessageFilter::OpCode::Compare };
+    ins.attr = AttributeIndex(token_.text);
+    if (! NextToken()) {
+        return false;
+    }
+
+    if (IsKeyword("exists")) {
+        ins.op = MessageFilter::OpCode::Exists;
+        return NextToken() && Emit(ins);
+    }
+
+    bool is_negated = false;
+    if (IsKeyword("not")) {
+        is_negated = true;
+        if (! NextToken()) {
+            return false;
+        }
+        if (! IsKeyword("in")) {
+            return Fail("Expected 'in'");
+        }
+    }
+    if (IsKeyword("in")) {
+        if (! NextToken() || ! Expect(TokenType::LParen, "'('")) {
+            return false;
+        }
+        vector<AttributeValue> values;
+        while (true) {
+            AttributeValue value;
+            if (! ParseLiteral(value)) {
+                return false;
+            }
+            values.push_back(std::move(value));
+            if (token_.type != TokenType::Comma) {
+                break;
+            }
+            if (! NextToken()) {
+                return false;
+            }
+        }
+        if (! Expect(TokenType::RParen, "')'")) {
+            return false;
+        }
+        ins.op = MessageFilter::OpCode::In;
+        ins.operand = filter_.sets_.size();
+        filter_.sets_.push_back(std::move(values));
+        return Emit(ins) && (! is_negated || Emit({ MessageFilter::OpCode::Not }));
+    }
+
+    static const std::pair<const char*, MessageFilter::CompareOp> compare_ops[] = {
+        { "==", MessageFilter::CompareOp::EQ }, { "!=", MessageFilter::CompareOp::NE },
+        { "<",  MessageFilter::CompareOp::LT }, { "<=", MessageFilter::CompareOp::LE },
+        { ">",  MessageFilter::CompareOp::GT }, { ">=", MessageFilter::CompareOp::GE },
+    };
+    auto iter = std::find_if(std::begin(compare_ops), std::end(compare_ops),
+            [this](auto& elem) { return IsOperator(elem.first); });
+    if (iter == std::end(compare_ops)) {
+        return Fail("Expected comparison operator");
+    }
+    ins.cmp = iter->second;
+    if (! NextToken()) {
+        return false;
+    }
+    AttributeValue value;
+    if (! ParseLiteral(value)) {
+        return false;
+    }
+    ins.operand = filter_.constants_.size();
+    filter_.constants_.push_back(std::move(value));
+    return Emit(ins);
+}
+
+bool FilterCompiler::ParseLiteral(AttributeValue& value)
+{
+    if (token_.type == TokenType::String) {
+        value = AttributeValue::FromString(token_.text);
+    } else if (token_.type == TokenType::Number) {
+        const char* str = token_.text.c_str();
+        char* str_end = nullptr;
+        errno = 0;
+        long long i = strtoll(str, &str_end, 10);
+        if (*str_end == '\0' && errno == 0) {
+            value = AttributeValue::FromInt(i);
+        } else {
+            errno = 0;
+            double d = strtod(str, &str_end);
+            if (*str_end != '\0' || errno != 0) {
+                return Fail("Invalid number '" + token_.text + "'");
+            }
+            value = AttributeValue::FromDouble(d);
+        }
+    } else {
+        return Fail("Expected number or string");
+    }
+    return NextToken();
+}
+
+tuple<MessageFilterPtr, string> MessageFilter::Compile(const string& expression)
+{
+    auto filter = std::make_shared<MessageFilter>();
+    filter->expression_ = expression;
+    FilterCompiler compiler(expression, *filter);
+    string errmsg = compiler.Compile();
+    if (! errmsg.empty()) {
+        return { nullptr, errmsg };
+    }
+    return { filter, "" };
+}
+
+bool MessageFilter::Compare(const AttributeValue& value, CompareOp cmp, const AttributeValue& constant)
+{
+    int result = 0;
+    if (value.type == AttributeValue::String && constant.type == AttributeValue::String) {
+        result = value.s.compare(constant.s);
+    } else if (value.type == AttributeValue::Int && constant.type == AttributeValue::Int) {
+        result = value.i < constant.i ? -1 : (value.i > constant.i ? 1 : 0);
+    } else if (value.IsNumber() && constant.IsNumber()) {
+        double a = value.type == AttributeValue::Int ? value.i : value.d;
+        double b = constant.type == AttributeValue::Int ? constant.i : constant.d;
+        if (a != a || b != b) {
+            return false;   // NaN
+        }
+        result = a < b ? -1 : (a > b ? 1 : 0);
+    } else {
+        return false;
+    }
+    switch (cmp) {
+        case CompareOp::EQ: return result == 0;
+        case CompareOp::NE: return result != 0;
+        case CompareOp::LT: return result < 0;
+        case CompareOp::LE: return result <= 0;
+        case CompareOp::GT: return result > 0;
+        case CompareOp::GE: return result >= 0;
+    }
+    return false;
+}
+
+bool MessageFilter::Match(const MessageAttributes& attrs) const
+{
+    bool stack[MAX_STACK_DEPTH];
+    size_t top = 0;
+    for (auto& ins : code_) {
+        switch (ins.op) {
+            case OpCode::Compare:
+                {
+                    auto value = FindAttribute(attrs, attr_names_[ins.attr]);
+                    stack[top++] = value && Compare(*value, ins.cmp, constants_[ins.operand]);
+                }
+                break;
+            case OpCode::In:
+                {
+                    auto value = FindAttribute(attrs, attr_names_[ins.attr]);
+                    bool is_matched = false;
+                    if (value) {
+                        for (auto& elem : sets_[ins.operand]) {
+                            if (Compare(*value, CompareOp::EQ, elem)) {
+                                is_matched = true;
+                                break;
+                            }
+                        }
+                    }
+                    stack[top++] = is_matched;
+                }
+                break;
+            case OpCode::Exists:
+                stack[top++] = FindAttribute(attrs, attr_names_[ins.attr]) != nullptr;
+                break;
+            case OpCode::And:
+                top--;
+                stack[top - 1] = stack[top - 1] && stack[top];
+                break;
+            case OpCode::Or:
+                top--;
+                stack[top - 1] = stack[top - 1] || stack[top];
+                break;
+            case OpCode::Not:
+                stack[top - 1] = ! stack[top - 1];
+                break;
+        }
+    }
+    return top == 1 && stack[0];
+}
+
+string MessageFilter::Disassemble() const
+{
+    static const char* compare_ops[] = { "==", "!=", "<", "<=", ">", ">=" };
+    std::stringstream ss;
+    for (auto& ins : code_) {
+        switch (ins.op) {
+            case OpCode::Compare:
+                ss << "CMP " << attr_names_[ins.attr] << " " << compare_ops[(int)ins.cmp]
+                   << " " << constants_[ins.operand].ToString() << "\n";
+                break;
+            case OpCode::In:
+                ss << "IN " << attr_names_[ins.attr] << " (";
+                for (size_t i = 0; i < sets_[ins.operand].size(); i++) {
+                    ss << (i > 0 ? ", " : "") << sets_[ins.operand][i].ToString();
+                }
+                ss << ")\n";
+                break;
+            case OpCode::Exists:
+                ss << "EXISTS " << attr_names_[ins.attr] << "\n";
+                break;
+            case OpCode::And:
+                ss << "AND\n";
+                break;
+            case OpCode::Or:
+                ss << "OR\n";
+                break;
+            case OpCode::Not:
+                ss << "NOT\n";
+                break;
+        }
+    }
+    return ss.str();
+}
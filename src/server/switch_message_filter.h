@@ -0,0 +1,73 @@
+#ifndef _SWITCH_MESSAGE_FILTER_H
+#define _SWITCH_MESSAGE_FILTER_H
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <memory>
+#include "message_attributes.h"
+
+using std::string;
+using std::vector;
+using std::tuple;
+
+class MessageFilter;
+using MessageFilterPtr = std::shared_ptr<const MessageFilter>;
+
+// Content filter of a subscription, over the typed attributes attached by publishers.
+// The expression is compiled once at SUB into a postfix bytecode, Match() runs it on
+// the attributes of each published message during fan-out. Syntax:
+//   expr       := and_expr { ("or" | "||") and_expr }
+//   and_expr   := unary { ("and" | "&&") unary }
+//   unary      := ("not" | "!") unary | "(" expr ")" | comparison
+//   comparison := name ("==" | "!=" | "<" | "<=" | ">" | ">=") literal
+//               | name ["not"] "in" "(" literal { "," literal } ")"
+//               | name "exists"
+//   literal    := integer | float | "string" | 'string'
+// e.g. symbol in ("AAPL", "MSFT") and price > 100.5
+// A comparison is false if the message has no such attribute or the types do not compare
+// (numbers compare with numbers, strings with strings).
+class MessageFilter {
+public:
+    static const size_t MAX_EXPRESSION_LEN = 1024;
+    static const size_t MAX_INSTRUCTIONS = 256;
+    static const size_t MAX_STACK_DEPTH = 32;
+
+    // returns the compiled filter, or nullptr and the error message
+    static tuple<MessageFilterPtr, string> Compile(const string& expression);
+
+    bool Match(const MessageAttributes& attrs) const;
+    const string& Expression() const { return expression_; }
+    string Disassemble() const;
+
+private:
+    friend class FilterCompiler;
+
+    enum class OpCode : uint8_t {
+        Compare,    // push: attribute <cmp> constant
+        In,         // push: attribute in set
+        Exists,     // push: has attribute
+        And,        // pop 2, push
+        Or,         // pop 2, push
+        Not,        // pop 1, push
+    };
+    enum class CompareOp : uint8_t { EQ, NE, LT, LE, GT, GE };
+
+    struct Instruction {
+        OpCode      op;
+        CompareOp   cmp = CompareOp::EQ;
+        uint16_t    attr = 0;       // index of attr_names_
+        uint16_t    operand = 0;    // index of constants_ for Compare, of sets_ for In
+    };
+
+    static bool Compare(const AttributeValue& value, CompareOp cmp, const AttributeValue& constant);
+
+private:
+    string                          expression_;
+    vector<Instruction>             code_;
+    vector<string>                  attr_names_;
+    vector<AttributeValue>          constants_;
+    vector<vector<AttributeValue>>  sets_;
+};
+
+#endif  // _SWITCH_MESSAGE_FILTER_H
@@ -0,0 +1,114 @@
+#if defined(__UNITTEST__)
+
+#include <iostream>
+#include <cassert>
+#include "switch_message_filter.h"
+
+using std::cout; using std::endl;
+
+static MessageFilterPtr compile(const string& expression)
+{
+    auto [filter, errmsg] = MessageFilter::Compile(expression);
+    if (! filter) {
+        cout << "compile error: " << expression << ": " << errmsg << endl;
+    }
+    return filter;
+}
+
+static bool match(const string& expression, const MessageAttributes& attrs)
+{
+    auto filter = compile(expression);
+    assert(filter);
+    return filter->Match(attrs);
+}
+
+static bool is_rejected(const string& expression)
+{
+    auto [filter, errmsg] = MessageFilter::Compile(expression);
+    return ! filter && ! errmsg.empty();
+}
+
+static string repeat(const string& s, size_t n)
+{
+    string result;
+    for (size_t i = 0; i < n; i++) {
+        result += s;
+    }
+    return result;
+}
+
+int main()
+{
+    MessageAttributes attrs = {
+        { "symbol", AttributeValue::FromString("AAPL") },
+        { "price", AttributeValue::FromDouble(101.25) },
+        { "qty", AttributeValue::FromInt(300) },
+        { "side", AttributeValue::FromInt(1) },
+    };
+
+    // precedence: not > and > or, parentheses override
+    assert(match("qty == 0 or side == 1 and symbol == 'AAPL'", attrs));
+    assert(! match("(qty == 0 or side == 1) and symbol == 'MSFT'", attrs));
+    assert(match("qty == 0 and side == 2 or side == 1", attrs));
+    assert(! match("qty == 0 and (side == 2 or side == 1)", attrs));
+    assert(! match("not side == 1 and qty == 300", attrs));
+    assert(match("not (side == 1 and qty == 0)", attrs));
+    assert(match("! side == 2 && qty > 0 || price < 0", attrs));
+
+    // in, not in, over mixed types
+    assert(match("symbol in ('MSFT', \"AAPL\")", attrs));
+    assert(! match("symbol not in ('MSFT', 'AAPL')", attrs));
+    assert(match("symbol not in ('MSFT', 1)", attrs));
+    assert(match("qty in (100, 300.0)", attrs));
+    assert(! match("qty in ('300')", attrs));
+
+    // int and double compare as numbers, strings lexicographically, not with each other
+    assert(match("price > 101 and price < 101.5 and price >= 1.0125e2", attrs));
+    assert(match("qty == 300.0 and qty != 299 and qty <= 300 and qty > -1", attrs));
+    assert(match("symbol < 'AAPM' and symbol >= 'AAPL' and symbol != 'aapl'", attrs));
+    assert(! match("symbol > 1", attrs));
+    assert(! match("qty == '300'", attrs));
+    assert(match("not symbol > 1", attrs));
+
+    // a comparison on a missing attribute is false, its negation true
+    assert(! match("venue == 'X'", attrs));
+    assert(! match("venue in ('X')", attrs));
+    assert(match("venue not in ('X')", attrs));
+    assert(match("not venue == 'X'", attrs));
+    assert(match("symbol exists and not venue exists", attrs));
+    assert(! match("qty > 0", {}));
+
+    // keywords are case insensitive, = is ==
+    assert(match("side = 1 AND symbol IN ('AAPL') Or qty == 0", attrs));
+
+    // syntax errors
+    assert(is_rejected(""));
+    assert(is_rejected("qty >"));
+    assert(is_rejected("qty > 1 and"));
+    assert(is_rejected("(qty > 1"));
+    assert(is_rejected("qty > 1)"));
+    assert(is_rejected("qty ~ 1"));
+    assert(is_rejected("symbol == 'AAPL"));
+    assert(is_rejected("qty in ()"));
+    assert(is_rejected("qty not == 1"));
+    assert(is_rejected("qty > 1e"));
+    assert(is_rejected("and == 1"));
+
+    // limits: length (the quotes and "symbol == " take 12), nesting, instructions
+    assert(compile("symbol == '" + string(MessageFilter::MAX_EXPRESSION_LEN - 12, 'x') + "'"));
+    assert(is_rejected("symbol == '" + string(MessageFilter::MAX_EXPRESSION_LEN - 11, 'x') + "'"));
+    size_t max_parens = MessageFilter::MAX_STACK_DEPTH - 1;
+    assert(compile(repeat("(", max_parens) + "qty > 0" + repeat(")", max_parens)));
+    assert(is_rejected(repeat("(", max_parens + 1) + "qty > 0" + repeat(")", max_parens + 1)));
+    assert(compile(repeat("not ", max_parens) + "qty > 0"));
+    assert(is_rejected(repeat("not ", max_parens + 1) + "qty > 0"));
+    assert(match(repeat("side == 2 or (", max_parens) + "qty > 0" + repeat(")", max_parens), attrs));
+    size_t max_terms = (MessageFilter::MAX_INSTRUCTIONS + 1) / 2;   // n comparisons and n - 1 ors
+    assert(compile("qty>0" + repeat("||qty>0", max_terms - 1)));
+    assert(is_rejected("qty>0" + repeat("||qty>0", max_terms)));
+
+    cout << "message filter: ok" << endl;
+    return 0;
+}
+
+#endif
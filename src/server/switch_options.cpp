@@ -0,0 +1,251 @@
+#include <iostream>
+#include "toml.hpp"
+#include "switch_options.h"
+
+using std::cout;
+using std::endl;
+
+int Options::ParseConfiguration(const string& config_file)
+{
+    const toml::value config = toml::parse(config_file);
+
+    if (config.contains("logfile")) {
+        auto logfile = config.at("logfile").as_string();
+        cout << "> config.logfile: " << logfile << endl;
+        if (! logfile.empty()) {
+            this->logfile = logfile;
+        }
+    }
+
+    if (config.contains("server")) {
+        auto server_config = config.at("server");
+
+        if (server_config.contains("host")) {
+            auto host = server_config.at("host").as_string();
+            cout << "> config.server.host: " << host << endl;
+            this->host = host;
+        }
+
+        if (server_config.contains("port")) {
+            auto port = server_config.at("port").as_integer();
+            cout << "> config.server.port: " << port << endl;
+            this->port = port;
+        }
+
+        if (server_config.contains("node_id")) {
+            auto node_id = server_config.at("node_id").as_integer();
+            cout << "> config.server.node_id: " << node_id << endl;
+            this->node_id = node_id;
+        }
+
+        if (server_config.contains("mode")) {
+            auto serving_mode = server_config.at("mode").as_string();
+            cout << "> config.server.mode: " << serving_mode << endl;
+            this->serving_mode = serving_mode;
+        }
+
+        if (server_config.contains("busy_poll")) {
+            auto busy_poll = server_config.at("busy_poll").as_boolean();
+            cout << "> config.server.busy_poll: " << busy_poll << endl;
+            this->busy_poll = busy_poll;
+        }
+
+        if (server_config.contains("busy_poll_cpu")) {
+            auto busy_poll_cpu = server_config.at("busy_poll_cpu").as_integer();
+            cout << "> config.server.busy_poll_cpu: " << busy_poll_cpu << endl;
+            this->busy_poll_cpu = busy_poll_cpu;
+        }
+
+        if (server_config.contains("busy_poll_usecs")) {
+            auto busy_poll_usecs = server_config.at("busy_poll_usecs").as_integer();
+            cout << "> config.server.busy_poll_usecs: " << busy_poll_usecs << endl;
+            this->busy_poll_usecs = busy_poll_usecs;
+        }
+    }
+    if (config.contains("auth")) {
+        auto auth_config = config.at("auth");
+
+        if (auth_config.contains("access_code")) {
+            auto access_code = auth_config.at("access_code").as_string();
+            cout << "> config.auth.access_code: " << access_code << endl;
+            this->access_code = access_code;
+        }
+
+        if (auth_config.contains("admin_code")) {
+            auto admin_code = auth_config.at("admin_code").as_string();
+            cout << "> config.auth.admin_code: " << admin_code << endl;
+            this->admin_code = admin_code;
+        }
+
+        if (auth_config.contains("service_access_code")) {
+            auto service_access_code = auth_config.at("service_access_code").as_string();
+            cout << "> config.auth.service_access_code: " << service_access_code << endl;
+            this->service_access_code = service_access_code;
+        }
+    }
+    if (config.contains("session")) {
+        auto session_config = config.at("session");
+
+        if (session_config.contains("store")) {
+            auto session_store = session_config.at("store").as_string();
+            cout << "> config.session.store: " << session_store << endl;
+            this->session_store = session_store;
+        }
+
+        if (session_config.contains("snapshot_interval")) {
+            auto snapshot_interval = session_config.at("snapshot_interval").as_integer();
+            cout << "> config.session.snapshot_interval: " << snapshot_interval << endl;
+            this->snapshot_interval = snapshot_interval;
+        }
+
+        if (session_config.contains("ttl")) {
+            auto session_ttl = session_config.at("ttl").as_integer();
+            cout << "> config.session.ttl: " << session_ttl << endl;
+            this->session_ttl = session_ttl;
+        }
+    }
+    if (config.contains("output")) {
+        auto output_config = config.at("output");
+
+        if (output_config.contains("tx_watermark")) {
+            auto tx_watermark = output_config.at("tx_watermark").as_integer();
+            cout << "> config.output.tx_watermark: " << tx_watermark << endl;
+            this->tx_watermark = tx_watermark;
+        }
+
+        if (output_config.contains("lane_weights")) {
+            auto lane_weights = output_config.at("lane_weights").as_array();
+            cout << "> config.output.lane_weights: " << output_config.at("lane_weights") << endl;
+            this->lane_weights.clear();
+            for (auto& weight : lane_weights) {
+                this->lane_weights.push_back(weight.as_integer());
+            }
+        }
+
+        if (output_config.contains("backpressure_high")) {
+            auto bp_high_watermark = output_config.at("backpressure_high").as_integer();
+            cout << "> config.output.backpressure_high: " << bp_high_watermark << endl;
+            this->bp_high_watermark = bp_high_watermark;
+        }
+
+        if (output_config.contains("backpressure_low")) {
+            auto bp_low_watermark = output_config.at("backpressure_low").as_integer();
+            cout << "> config.output.backpressure_low: " << bp_low_watermark << endl;
+            this->bp_low_watermark = bp_low_watermark;
+        }
+    }
+    if (config.contains("message_ttl")) {
+        auto ttl_config = config.at("message_ttl").as_table();
+        this->message_ttl.clear();
+        for (auto& [msg_type, ttl_ms] : ttl_config) {
+            cout << "> config.message_ttl." << msg_type << ": " << ttl_ms.as_integer() << endl;
+            this->message_ttl[std::stoi(msg_type)] = ttl_ms.as_integer();
+        }
+    }
+    if (config.contains("value_cache")) {
+        auto cache_config = config.at("value_cache");
+
+        if (cache_config.contains("messages")) {
+            auto messages = cache_config.at("messages").as_array();
+            cout << "> config.value_cache.messages: " << cache_config.at("messages") << endl;
+            this->cached_messages.clear();
+            for (auto& msg_type : messages) {
+                this->cached_messages.insert(msg_type.as_integer());
+            }
+        }
+
+        if (cache_config.contains("max_bytes")) {
+            auto max_bytes = cache_config.at("max_bytes").as_integer();
+            cout << "> config.value_cache.max_bytes: " << max_bytes << endl;
+            this->value_cache_max_bytes = max_bytes;
+        }
+    }
+    if (config.contains("compression")) {
+        auto compression_config = config.at("compression");
+
+        if (compression_config.contains("codecs")) {
+            auto codecs = compression_config.at("codecs").as_array();
+            cout << "> config.compression.codecs: " << compression_config.at("codecs") << endl;
+            this->compressions.clear();
+            for (auto& codec : codecs) {
+                this->compressions.push_back(codec.as_string());
+            }
+        }
+
+        if (compression_config.contains("min_bytes")) {
+            auto min_bytes = compression_config.at("min_bytes").as_integer();
+            cout << "> config.compression.min_bytes: " << min_bytes << endl;
+            this->compress_min_bytes = min_bytes;
+        }
+
+        if (compression_config.contains("zstd_dictionary")) {
+            auto zstd_dictionary = compression_config.at("zstd_dictionary").as_string();
+            cout << "> config.compression.zstd_dictionary: " << zstd_dictionary << endl;
+            this->zstd_dictionary = zstd_dictionary;
+        }
+    }
+    if (config.contains("rate_limit")) {
+        auto rate_limit_config = config.at("rate_limit");
+
+        if (rate_limit_config.contains("policy")) {
+            auto policy = rate_limit_config.at("policy").as_string();
+            cout << "> config.rate_limit.policy: " << policy << endl;
+            this->rate_limit_policy = policy;
+        }
+
+        if (rate_limit_config.contains("burst_ms")) {
+            auto burst_ms = rate_limit_config.at("burst_ms").as_integer();
+            cout << "> config.rate_limit.burst_ms: " << burst_ms << endl;
+            this->rate_limit_burst_ms = burst_ms;
+        }
+
+        for (auto role : { "normal", "admin", "service" }) {
+            if (! rate_limit_config.contains(role)) {
+                continue;
+            }
+            auto role_config = rate_limit_config.at(role);
+            RateLimit limit;
+            if (role_config.contains("msgs_per_sec")) {
+                limit.msgs_per_sec = role_config.at("msgs_per_sec").as_integer();
+                cout << "> config.rate_limit." << role << ".msgs_per_sec: " << limit.msgs_per_sec << endl;
+            }
+            if (role_config.contains("bytes_per_sec")) {
+                limit.bytes_per_sec = role_config.at("bytes_per_sec").as_integer();
+                cout << "> config.rate_limit." << role << ".bytes_per_sec: " << limit.bytes_per_sec << endl;
+            }
+            this->rate_limits[role] = limit;
+        }
+    }
+    if (config.contains("connection")) {
+        auto connection_config = config.at("connection");
+
+        if (connection_config.contains("register_timeout")) {
+            auto register_timeout = connection_config.at("register_timeout").as_integer();
+            cout << "> config.connection.register_timeout: " << register_timeout << endl;
+            this->register_timeout = register_timeout;
+        }
+
+        if (connection_config.contains("heartbeat_timeout")) {
+            auto heartbeat_timeout = connection_config.at("heartbeat_timeout").as_integer();
+            cout << "> config.connection.heartbeat_timeout: " << heartbeat_timeout << endl;
+            this->heartbeat_timeout = heartbeat_timeout;
+        }
+
+        if (connection_config.contains("idle_timeout")) {
+            auto idle_timeout = connection_config.at("idle_timeout").as_integer();
+            cout << "> config.connection.idle_timeout: " << idle_timeout << endl;
+            this->idle_timeout = idle_timeout;
+        }
+    }
+    if (config.contains("upgrade")) {
+        auto upgrade_config = config.at("upgrade");
+
+        if (upgrade_config.contains("socket")) {
+            auto upgrade_socket = upgrade_config.at("socket").as_string();
+            cout << "> config.upgrade.socket: " << upgrade_socket << endl;
+            this->upgrade_socket = upgrade_socket;
+        }
+    }
+
+    return 0;
+}
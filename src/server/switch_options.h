@@ -4,6 +4,11 @@
 #include <string>
 #include <memory>
 #include <sstream>
+#include <vector>
+#include <map>
+#include <set>
+#include "switch_types.h"
+#include "switch_rate_limiter.h"
 
 using std::string;
 
@@ -16,10 +21,39 @@ struct Options
     string      admin_code;
     string      service_access_code;
     string      serving_mode;
+    bool        busy_poll;              // spin on the sockets instead of sleeping, for latency over CPU
+    int         busy_poll_cpu;          // the core to pin the reactor to, -1 for no pinning
+    uint32_t    busy_poll_usecs;        // SO_BUSY_POLL of connections, microseconds
     string      logfile;
     string      config_file;
+    string      session_store;          // path prefix of session snapshot/journal, empty to disable
+    uint32_t    snapshot_interval;      // seconds
+    uint32_t    session_ttl;            // seconds, how long a dormant session is kept
+    string      upgrade_socket;         // unix socket for handing over to a new process, empty to disable
+    bool        upgrade;                // take over from the running process
+    size_t      tx_watermark;           // bytes, 0 for default
+    std::vector<uint32_t> lane_weights; // weights of output lanes high, normal and low
+    size_t      bp_high_watermark;      // bytes queued by a target to pause reading its publishers, 0 to disable
+    size_t      bp_low_watermark;       // bytes queued by the target to resume them, 0 for half of high
+    std::map<MessageId, uint32_t> message_ttl;  // msg_type -> default ttl in milliseconds
+    std::set<MessageId> cached_messages;        // message types of last-value cache
+    size_t      value_cache_max_bytes;          // bytes, 0 for default
+    std::vector<string> compressions;           // lz4, zstd, in order of preference
+    size_t      compress_min_bytes;             // bytes, 0 for default
+    string      zstd_dictionary;                // path of the shared dictionary of zstd
+    std::map<string, RateLimit> rate_limits;    // role tag -> default limits of the role
+    string      rate_limit_policy;              // reject, delay or disconnect
+    uint32_t    rate_limit_burst_ms;            // milliseconds, 0 for default
+    uint32_t    register_timeout;               // seconds to register after connected, 0 to disable
+    uint32_t    heartbeat_timeout;              // seconds receiving nothing, heartbeats included, 0 to disable
+    uint32_t    idle_timeout;                   // seconds an endpoint sends no message, 0 to disable
 
-    Options() : port(0), node_id(0) {}
+    Options() : port(0), node_id(0), busy_poll(false), busy_poll_cpu(-1), busy_poll_usecs(50),
+        snapshot_interval(60), session_ttl(300), upgrade(false), tx_watermark(0),
+        bp_high_watermark(0), bp_low_watermark(0),
+        value_cache_max_bytes(0), compress_min_bytes(0), rate_limit_burst_ms(0),
+        register_timeout(30), heartbeat_timeout(0), idle_timeout(0) {}
+    int ParseConfiguration(const string& config_file);  // overrides the fields given in the file
     string ToString() const {
         std::stringstream ss;
         ss << "{";
@@ -30,8 +64,52 @@ struct Options
         ss << "admin_code: " << admin_code << ", ";
         ss << "service_access_code: " << service_access_code << ", ";
         ss << "serving_mode: " << serving_mode << ", ";
+        ss << "busy_poll: " << busy_poll << ", ";
+        ss << "busy_poll_cpu: " << busy_poll_cpu << ", ";
+        ss << "busy_poll_usecs: " << busy_poll_usecs << ", ";
         ss << "logfile: " << logfile << ", ";
         ss << "config_file: " << config_file << ", ";
+        ss << "session_store: " << session_store << ", ";
+        ss << "snapshot_interval: " << snapshot_interval << ", ";
+        ss << "session_ttl: " << session_ttl << ", ";
+        ss << "upgrade_socket: " << upgrade_socket << ", ";
+        ss << "upgrade: " << upgrade << ", ";
+        ss << "tx_watermark: " << tx_watermark << ", ";
+        ss << "lane_weights: [";
+        for (auto weight : lane_weights) {
+            ss << weight << ", ";
+        }
+        ss << "], ";
+        ss << "bp_high_watermark: " << bp_high_watermark << ", ";
+        ss << "bp_low_watermark: " << bp_low_watermark << ", ";
+        ss << "message_ttl: {";
+        for (auto [msg_type, ttl_ms] : message_ttl) {
+            ss << msg_type << ": " << ttl_ms << ", ";
+        }
+        ss << "}, ";
+        ss << "cached_messages: [";
+        for (auto msg_type : cached_messages) {
+            ss << msg_type << ", ";
+        }
+        ss << "], ";
+        ss << "value_cache_max_bytes: " << value_cache_max_bytes << ", ";
+        ss << "compressions: [";
+        for (auto& compression : compressions) {
+            ss << compression << ", ";
+        }
+        ss << "], ";
+        ss << "compress_min_bytes: " << compress_min_bytes << ", ";
+        ss << "zstd_dictionary: " << zstd_dictionary << ", ";
+        ss << "rate_limits: {";
+        for (auto& [role, limit] : rate_limits) {
+            ss << role << ": [" << limit.msgs_per_sec << ", " << limit.bytes_per_sec << "], ";
+        }
+        ss << "}, ";
+        ss << "rate_limit_policy: " << rate_limit_policy << ", ";
+        ss << "rate_limit_burst_ms: " << rate_limit_burst_ms << ", ";
+        ss << "register_timeout: " << register_timeout << ", ";
+        ss << "heartbeat_timeout: " << heartbeat_timeout << ", ";
+        ss << "idle_timeout: " << idle_timeout << ", ";
         ss << "}";
         return ss.str();
     }
@@ -0,0 +1,148 @@
+#include "switch_output_queue.h"
+#include "switch_config.h"
+#include <eventloop/tcp_connection.h>
+#include "utils/time.h"
+#include <algorithm>
+
+static int priority_to_lane(EMessagePriority priority)
+{
+    switch (priority) {
+        case EMessagePriority::Urgent:
+            return 0;
+        case EMessagePriority::High:
+            return 1;
+        case EMessagePriority::Low:
+            return 3;
+        default:
+            return 2;
+    }
+}
+
+void OutputQueue::Push(EMessagePriority priority, const char* data, size_t len, const SwitchConfig& config,
+        int64_t deadline, uint64_t conflation_key)
+{
+    FramePtr shared;
+    Push(priority, data, len, shared, config, deadline, conflation_key);
+}
+
+void OutputQueue::Push(EMessagePriority priority, const char* data, size_t len, FramePtr& shared,
+        const SwitchConfig& config, int64_t deadline, uint64_t conflation_key)
+{
+    if (conflation_key != 0) {
+        auto iter = conflation_index_.find(conflation_key);
+        if (iter != conflation_index_.end()) {
+            // the queued value is not sent yet, replace it with the newer one
+            if (! shared) {
+                shared = std::make_shared<const string>(data, len);
+            }
+            auto frame = iter->second;
+            queued_bytes_ = queued_bytes_ - frame->data->size() + len;
+            frame->data = shared;
+            frame->deadline = deadline;
+            conflated_frames_++;
+            return;
+        }
+    }
+    if (queued_frames_ == 0 && conn_->TxBufferSize() < config.tx_watermark) {
+        conn_->Send(data, len);  // fast path, nothing to overtake
+        sent_frames_++;
+        return;
+    }
+    if (! shared) {
+        shared = std::make_shared<const string>(data, len);
+    }
+    int64_t now = monotonic_milliseconds();
+    auto& lane = lanes_[priority_to_lane(priority)];
+    lane.push_back({ shared, deadline, conflation_key, now });
+    if (conflation_key != 0) {
+        conflation_index_[conflation_key] = &lane.back();
+    }
+    queued_frames_++;
+    queued_bytes_ += len;
+    max_queued_frames_ = std::max(max_queued_frames_, queued_frames_);
+    max_queued_bytes_ = std::max(max_queued_bytes_, queued_bytes_);
+    Drain(config, now);
+}
+
+void OutputQueue::Drain(const SwitchConfig& config)
+{
+    Drain(config, monotonic_milliseconds());
+}
+
+void OutputQueue::Drain(const SwitchConfig& config, int64_t now)
+{
+    while (queued_frames_ > 0 && conn_->TxBufferSize() < config.tx_watermark) {
+        int lane = NextLane(config);
+        if (lane < 0) {
+            break;
+        }
+        SendFront(lane, now);
+    }
+}
+
+void OutputQueue::Flush()
+{
+    int64_t now = monotonic_milliseconds();
+    for (int lane = 0; lane < N_LANES; lane++) {
+        while (! lanes_[lane].empty()) {
+            SendFront(lane, now);
+        }
+    }
+}
+
+void OutputQueue::Clear()
+{
+    for (auto& lane : lanes_) {
+        lane.clear();
+    }
+    conflation_index_.clear();
+    queued_frames_ = 0;
+    queued_bytes_ = 0;
+}
+
+int OutputQueue::NextLane(const SwitchConfig& config)
+{
+    if (! lanes_[0].empty()) {
+        return 0;  // urgent, strict priority
+    }
+    for (int round = 0; round < 2; round++) {
+        for (int lane = 1; lane < N_LANES; lane++) {
+            if (! lanes_[lane].empty() && credits_[lane] > 0) {
+                credits_[lane]--;
+                return lane;
+            }
+        }
+        // the non-empty lanes used up their credits, start a new round
+        for (int lane = 1; lane < N_LANES; lane++) {
+            size_t i = lane - 1;
+            credits_[lane] = std::max<uint32_t>(1, i < config.lane_weights.size() ? config.lane_weights[i] : 1);
+        }
+    }
+    return -1;
+}
+
+void OutputQueue::SendFront(int lane, int64_t now)
+{
+    auto& frame = lanes_[lane].front();
+    if (frame.deadline > 0 && frame.deadline <= now) {
+        expired_frames_++;  // worthless for receiver, skip it
+    } else {
+        conn_->Send(*frame.data);
+        sent_frames_++;
+        int64_t wait_ms = now - frame.enqueued;
+        total_wait_ms_ += wait_ms;
+        max_wait_ms_ = std::max(max_wait_ms_, wait_ms);
+    }
+    PopFront(lane);
+}
+
+void OutputQueue::PopFront(int lane)
+{
+    auto& frame = lanes_[lane].front();
+    if (frame.conflation_key != 0) {
+        conflation_index_.erase(frame.conflation_key);
+    }
+    queued_frames_--;
+    queued_bytes_ -= frame.data->size();
+    lanes_[lane].pop_front();
+}
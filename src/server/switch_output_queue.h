@@ -0,0 +1,107 @@
+#ifndef _SWITCH_OUTPUT_QUEUE_H
+#define _SWITCH_OUTPUT_QUEUE_H
+
+#include <deque>
+#include <unordered_map>
+#include <string>
+#include <memory>
+#include "switch_message.h"
+
+using std::deque;
+using std::unordered_map;
+using std::string;
+
+namespace evt_loop {
+    class TcpConnection;
+}
+using evt_loop::TcpConnection;
+
+struct SwitchConfig;
+
+// A frame in a refcounted buffer, queued by many endpoints without a copy per queue
+using FramePtr = std::shared_ptr<const string>;
+
+// Per-endpoint output queues, one lane per priority class.
+// Frames are handed to the connection only while its tx buffer is below the watermark,
+// the rest wait in the lanes, so a frame of higher priority overtakes the queued bulk
+// traffic at frame boundaries. Urgent lane is always drained first, the others are
+// drained by weighted round robin (SwitchConfig.lane_weights).
+// A frame may have a deadline, if it is expired when dequeued, it is skipped without writing.
+// A frame may have a conflation key, while it is queued, a newer frame with the same key
+// replaces it in place, so the queue is bounded by the number of keys instead of the rate.
+// A frame handed to the connection is written from the buffer of caller, only a frame which
+// has to wait is kept, in a shared buffer (FramePtr) that the caller can pass to the other
+// queues of the same frame, so a fan-out costs at most one copy however many targets queue it.
+class OutputQueue {
+public:
+    static const int N_LANES = 4;
+
+    OutputQueue(TcpConnection* conn) : conn_(conn) {}
+
+    void SetConnection(TcpConnection* conn) { conn_ = conn; }
+
+    // deadline: monotonic milliseconds, 0 for never expire
+    // conflation_key: see ConflationKey(), 0 for no conflation
+    void Push(EMessagePriority priority, const char* data, size_t len, const SwitchConfig& config,
+            int64_t deadline=0, uint64_t conflation_key=0);
+    void Push(EMessagePriority priority, const string& frame, const SwitchConfig& config,
+            int64_t deadline=0, uint64_t conflation_key=0)
+    {
+        Push(priority, frame.data(), frame.size(), config, deadline, conflation_key);
+    }
+    // shared: the frame in a shared buffer, made from data when it is queued first
+    // and reused as is afterwards, pass the same one for all targets of the frame
+    void Push(EMessagePriority priority, const char* data, size_t len, FramePtr& shared,
+            const SwitchConfig& config, int64_t deadline=0, uint64_t conflation_key=0);
+    void Push(EMessagePriority priority, const string& frame, FramePtr& shared, const SwitchConfig& config,
+            int64_t deadline=0, uint64_t conflation_key=0)
+    {
+        Push(priority, frame.data(), frame.size(), shared, config, deadline, conflation_key);
+    }
+    void Drain(const SwitchConfig& config);     // called when the connection wrote out its buffer
+    void Flush();                               // hand over all queued frames, regardless of the watermark
+    void Clear();
+
+    bool Empty() const { return queued_frames_ == 0; }
+    size_t QueuedFrames() const { return queued_frames_; }
+    size_t QueuedBytes() const { return queued_bytes_; }
+    size_t ExpiredFrames() const { return expired_frames_; }
+    size_t ConflatedFrames() const { return conflated_frames_; }
+    size_t SentFrames() const { return sent_frames_; }
+    size_t MaxQueuedFrames() const { return max_queued_frames_; }
+    size_t MaxQueuedBytes() const { return max_queued_bytes_; }
+    // milliseconds from Push to the handover to the connection, 0 on the fast path
+    int64_t AverageWait() const { return sent_frames_ > 0 ? total_wait_ms_ / (int64_t)sent_frames_ : 0; }
+    int64_t MaxWait() const { return max_wait_ms_; }
+
+    static uint64_t ConflationKey(MessageId msg_type, uint32_t key) { return ((uint64_t)msg_type << 32) | key; }
+
+private:
+    struct QueuedFrame {
+        FramePtr data;
+        int64_t  deadline;
+        uint64_t conflation_key;
+        int64_t  enqueued;  // monotonic milliseconds
+    };
+    void Drain(const SwitchConfig& config, int64_t now);
+    int NextLane(const SwitchConfig& config);
+    void SendFront(int lane, int64_t now);
+    void PopFront(int lane);
+
+private:
+    TcpConnection*  conn_;
+    deque<QueuedFrame> lanes_[N_LANES];         // indexed by lane, 0 is the most urgent
+    uint32_t        credits_[N_LANES] = { 0 };  // remaining sends of current round
+    size_t          queued_frames_ = 0;
+    size_t          queued_bytes_ = 0;
+    size_t          expired_frames_ = 0;
+    size_t          conflated_frames_ = 0;
+    size_t          sent_frames_ = 0;
+    size_t          max_queued_frames_ = 0;
+    size_t          max_queued_bytes_ = 0;
+    int64_t         total_wait_ms_ = 0;
+    int64_t         max_wait_ms_ = 0;
+    unordered_map<uint64_t, QueuedFrame*> conflation_index_;  // the references stay valid on push_back/pop_front
+};
+
+#endif  // _SWITCH_OUTPUT_QUEUE_H
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <eventloop/el.h>
+#include "switch_rate_limiter.h"
+#include "switch_config.h"
+
+const char* RateLimitPolicyToTag(ERateLimitPolicy policy)
+{
+    switch (policy) {
+        case ERateLimitPolicy::Reject:
+            return "reject";
+        case ERateLimitPolicy::Delay:
+            return "delay";
+        case ERateLimitPolicy::Disconnect:
+            return "disconnect";
+    }
+    return "undefined";
+}
+
+bool TagToRateLimitPolicy(const string& tag, ERateLimitPolicy& policy)
+{
+    if (tag == "reject") {
+        policy = ERateLimitPolicy::Reject;
+    } else if (tag == "delay") {
+        policy = ERateLimitPolicy::Delay;
+    } else if (tag == "disconnect") {
+        policy = ERateLimitPolicy::Disconnect;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void TokenBucket::Configure(uint32_t rate_per_sec, uint32_t burst_ms, int64_t now_ms)
+{
+    rate_ = rate_per_sec;
+    capacity_ = (int64_t)rate_per_sec * std::max<uint32_t>(burst_ms, 1);
+    balance_ = capacity_;
+    last_ms_ = now_ms;
+}
+
+void TokenBucket::Refill(int64_t now_ms)
+{
+    int64_t elapsed_ms = now_ms - last_ms_;
+    if (elapsed_ms <= 0) {
+        return;
+    }
+    last_ms_ = now_ms;
+    // no need to count beyond the time it takes to fill up from empty, also keeps it from overflow
+    int64_t fill_ms = capacity_ / rate_ + 1;
+    int64_t refill = std::min(elapsed_ms, fill_ms - std::min<int64_t>(balance_, 0) / rate_) * rate_;
+    balance_ = std::min(capacity_, balance_ + refill);
+}
+
+bool TokenBucket::HasTokens(uint64_t tokens, int64_t now_ms)
+{
+    if (rate_ == 0) {
+        return true;
+    }
+    Refill(now_ms);
+    return balance_ >= std::min<int64_t>(tokens * 1000, capacity_);
+}
+
+void TokenBucket::Consume(uint64_t tokens, int64_t now_ms)
+{
+    if (rate_ == 0) {
+        return;
+    }
+    Refill(now_ms);
+    balance_ -= tokens * 1000;
+}
+
+int64_t TokenBucket::MillisecondsToRefill() const
+{
+    if (rate_ == 0 || balance_ >= 0) {
+        return 0;
+    }
+    return (-balance_ + rate_ - 1) / rate_;
+}
+
+RateLimiter::~RateLimiter()
+{
+    if (resume_timer_) {
+        resume_timer_->Stop();
+        delete resume_timer_;
+    }
+}
+
+void RateLimiter::Configure(const SwitchConfigPtr& config, EndpointId ep_id, EEndpointRole role, int64_t now_ms)
+{
+    config_ = config;
+
+    RateLimit limit;
+    auto iter = config->endpoint_rate_limits.find(ep_id);
+    if (iter != config->endpoint_rate_limits.end()) {
+        limit = iter->second;
+    } else if ((size_t)role < config->role_rate_limits.size()) {
+        limit = config->role_rate_limits[(size_t)role];
+    }
+    // keep the balances if the limits of endpoint not changed
+    if (limit == limit_) {
+        return;
+    }
+    limit_ = limit;
+    msgs_bucket_.Configure(limit.msgs_per_sec, config->rate_limit_burst_ms, now_ms);
+    bytes_bucket_.Configure(limit.bytes_per_sec, config->rate_limit_burst_ms, now_ms);
+}
+
+bool RateLimiter::Admit(const SwitchConfigPtr& config, EndpointId ep_id, EEndpointRole role, size_t frame_bytes, int64_t now_ms)
+{
+    if (config != config_) {
+        Configure(config, ep_id, role, now_ms);
+    }
+    if (limit_.IsUnlimited()) {
+        return true;
+    }
+
+    if (config_->rate_limit_policy != ERateLimitPolicy::Delay &&
+            (! msgs_bucket_.HasTokens(1, now_ms) || ! bytes_bucket_.HasTokens(frame_bytes, now_ms))) {
+        limited_frames_++;
+        rejected_in_row_++;
+        return false;
+    }
+    rejected_in_row_ = 0;
+    msgs_bucket_.Consume(1, now_ms);
+    bytes_bucket_.Consume(frame_bytes, now_ms);
+    if (IsThrottled()) {
+        limited_frames_++;
+    }
+    return true;
+}
+
+bool RateLimiter::IsThrottled() const
+{
+    return MillisecondsToResume() > 0;
+}
+
+int64_t RateLimiter::MillisecondsToResume() const
+{
+    return std::max(msgs_bucket_.MillisecondsToRefill(), bytes_bucket_.MillisecondsToRefill());
+}
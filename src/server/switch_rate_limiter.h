@@ -0,0 +1,96 @@
+#ifndef _SWITCH_RATE_LIMITER_H
+#define _SWITCH_RATE_LIMITER_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include "endpoint_role.h"
+#include "switch_types.h"
+
+using std::string;
+
+namespace evt_loop {
+    class OneshotTimer;
+}
+
+struct SwitchConfig;
+using SwitchConfigPtr = std::shared_ptr<const SwitchConfig>;
+
+// What to do with a frame of an endpoint over its rate limit
+enum class ERateLimitPolicy : uint8_t {
+    Reject,     // drop the frame, answer with a RESULT
+    Delay,      // handle the frame, then stop reading the connection until the tokens refilled
+    Disconnect, // close the connection
+};
+const char* RateLimitPolicyToTag(ERateLimitPolicy policy);
+bool TagToRateLimitPolicy(const string& tag, ERateLimitPolicy& policy);
+
+// Limits of an endpoint, 0: unlimited
+struct RateLimit {
+    uint32_t msgs_per_sec = 0;
+    uint32_t bytes_per_sec = 0;
+
+    bool IsUnlimited() const { return msgs_per_sec == 0 && bytes_per_sec == 0; }
+    bool operator==(const RateLimit&) const = default;
+};
+
+// Token bucket refilled by elapsed milliseconds, in milli-tokens so that integer
+// arithmetic works for low rates. The balance may go negative for the Delay policy.
+class TokenBucket {
+public:
+    void Configure(uint32_t rate_per_sec, uint32_t burst_ms, int64_t now_ms);
+    bool IsUnlimited() const { return rate_ == 0; }
+
+    // a frame larger than the burst is allowed once the bucket is full, leaving the balance negative
+    bool HasTokens(uint64_t tokens, int64_t now_ms);
+    void Consume(uint64_t tokens, int64_t now_ms);
+    int64_t MillisecondsToRefill() const;    // until the balance is not negative
+
+private:
+    void Refill(int64_t now_ms);
+
+private:
+    uint32_t rate_ = 0;             // tokens per second, milli-tokens per millisecond
+    int64_t  capacity_ = 0;         // milli-tokens
+    int64_t  balance_ = 0;          // milli-tokens
+    int64_t  last_ms_ = 0;
+};
+
+// Admission control of the frames received from an endpoint, O(1) per frame.
+// The limits are resolved from the config snapshot, and again only when it's replaced.
+class RateLimiter {
+public:
+    RateLimiter() = default;
+    ~RateLimiter();
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    // returns true if the frame is admitted, with the Delay policy it is always
+    // admitted and IsThrottled() tells whether the reading should be paused
+    bool Admit(const SwitchConfigPtr& config, EndpointId ep_id, EEndpointRole role, size_t frame_bytes, int64_t now_ms);
+    bool IsThrottled() const;
+    int64_t MillisecondsToResume() const;
+
+    const RateLimit& Limit() const { return limit_; }
+    uint64_t LimitedFrames() const { return limited_frames_; }
+    // the frames rejected since the last admitted one, 1 at the transition into the limited state
+    uint64_t RejectedInRow() const { return rejected_in_row_; }
+
+    // the timer resuming the reading of connection with the Delay policy, owned by limiter
+    evt_loop::OneshotTimer* ResumeTimer() const { return resume_timer_; }
+    void SetResumeTimer(evt_loop::OneshotTimer* timer) { resume_timer_ = timer; }
+
+private:
+    void Configure(const SwitchConfigPtr& config, EndpointId ep_id, EEndpointRole role, int64_t now_ms);
+
+private:
+    SwitchConfigPtr config_;        // the snapshot which limits are resolved from
+    RateLimit       limit_;
+    TokenBucket     msgs_bucket_;
+    TokenBucket     bytes_bucket_;
+    uint64_t        limited_frames_ = 0;
+    uint64_t        rejected_in_row_ = 0;
+    evt_loop::OneshotTimer* resume_timer_ = nullptr;
+};
+
+#endif  // _SWITCH_RATE_LIMITER_H
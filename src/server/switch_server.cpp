@@ -1,6 +1,16 @@
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include "switch_server.h"
 #include "switch_command_handler.h"
+#include "compression.h"
+#include "utils/time.h"
 
 SwitchServer::SwitchServer(const char* host, uint16_t port) :
     server_(nullptr), node_id_(0)
@@ -19,21 +29,104 @@ SwitchServer::SwitchServer(const OptionsPtr& options) :
 
 void SwitchServer::OnSignal(SignalHandler* sh, uint32_t signo)
 {
+    if (signo == SIGHUP) {
+        auto [errcode, errmsg] = ReloadConfiguration();
+        if (errcode != 0) {
+            fprintf(stderr, "[SwitchServer::OnSignal] Error: %s\n", errmsg.c_str());
+        }
+        return;
+    }
     Exit();
 }
 
+tuple<int, string> SwitchServer::ReloadConfiguration()
+{
+    if (! options_ || options_->config_file.empty()) {
+        return { 1, "No configuration file to reload" };
+    }
+
+    // parse into a copy, the running options are untouched if the file is broken
+    auto options = std::make_shared<Options>(*options_);
+    try {
+        options->ParseConfiguration(options->config_file);
+    } catch (const std::exception& e) {
+        return { 1, string("Failed to parse configuration: ") + e.what() };
+    }
+
+    auto config = SwitchConfig::FromOptions(*options);
+    if (config->serving_mode == EServingMode::Undefined) {
+        return { 1, "Has invalid parameter, mode: " + options->serving_mode };
+    }
+    ERateLimitPolicy policy;
+    if (! options->rate_limit_policy.empty() && ! TagToRateLimitPolicy(options->rate_limit_policy, policy)) {
+        return { 1, "Has invalid parameter, rate_limit.policy: " + options->rate_limit_policy };
+    }
+    // the overrides of endpoints are set at runtime, not in the file
+    config->endpoint_rate_limits = context_->Config()->endpoint_rate_limits;
+    if (options->host != options_->host || options->port != options_->port ||
+            options->node_id != options_->node_id || options->session_store != options_->session_store ||
+            options->zstd_dictionary != options_->zstd_dictionary ||
+            options->busy_poll != options_->busy_poll || options->busy_poll_cpu != options_->busy_poll_cpu ||
+            options->busy_poll_usecs != options_->busy_poll_usecs) {
+        printf("[SwitchServer::ReloadConfiguration] Warning: the changes of listen address, node id, "
+                "session store, busy poll and zstd dictionary take effect after restart\n");
+    }
+
+    options_ = options;
+    context_->UpdateConfig(config);
+    context_->value_cache.RetainOnly(config->cached_messages);
+    printf("[SwitchServer::ReloadConfiguration] reloaded, config: %s\n", config->ToString().c_str());
+    return { 0, "" };
+}
+
 void SwitchServer::Exit()
 {
     printf("SwitchServer::Shutdown\n");
     // XXX: MUST call destory of Console manually, otherwise the terminal will be silently always
     console_->Destory();
+    if (session_store_) {
+        session_store_->Close();
+    }
     EV_Singleton->StopLoop();
 }
 
+void SwitchServer::QuitForUpgrade()
+{
+    console_->Destory();
+    // skip destructors, the sockets must not be shutdown, the session store belongs to the new process
+    fflush(stdout);
+    _exit(0);
+}
+
 bool SwitchServer::init(const char* host, uint16_t port)
 {
+#if defined(USE_UPGRADE)
+    HandoffStatePtr handoff;
+    if (options_ && options_->upgrade && ! options_->upgrade_socket.empty()) {
+        handoff = SwitchUpgrade::TakeOver(options_->upgrade_socket);
+        if (! handoff) {
+            fprintf(stderr, "[SwitchServer] Error: failed to take over from the running process, start as new\n");
+        }
+    }
+
+    InitServer(host, port, handoff ? handoff->listen_fd : -1);
+    InitComponents();
+
+    if (handoff) {
+        SwitchUpgrade::Adopt(this, handoff);
+    }
+    if (options_ && ! options_->upgrade_socket.empty()) {
+        upgrade_ = std::make_shared<SwitchUpgrade>(this, options_->upgrade_socket);
+        upgrade_->Listen();
+    }
+#else
+    if (options_ && (options_->upgrade || ! options_->upgrade_socket.empty())) {
+        fprintf(stderr, "[SwitchServer] Warning: upgrade handoff is not built in (make USE_IO_URING=1 USE_UPGRADE=1), "
+                "start as new\n");
+    }
     InitServer(host, port);
     InitComponents();
+#endif
 
     return true;
 }
@@ -44,6 +137,20 @@ void SwitchServer::InitComponents()
 
     printf("Context: %s\n", context_->ToString().c_str());
 
+    // before any connection, the adopted ones included
+    watchdog_ = std::make_shared<ConnectionWatchdog>(context_.get());
+    watchdog_->Start();
+
+    if (options_ && ! options_->zstd_dictionary.empty()) {
+        LoadCompressionDictionary(options_->zstd_dictionary);
+    }
+
+    if (options_ && ! options_->session_store.empty()) {
+        session_store_ = std::make_shared<SessionStore>(options_->session_store,
+                options_->snapshot_interval, options_->session_ttl);
+        session_store_->Load();
+    }
+
     service_ = std::make_shared<SwitchService>(this);
     cmd_handler_ = std::make_shared<CommandHandler>(context_, service_);
 
@@ -51,17 +158,30 @@ void SwitchServer::InitComponents()
     console_->registerCommands();
 }
 
-void SwitchServer::InitServer(const char* host, uint16_t port)
+void SwitchServer::InitServer(const char* host, uint16_t port, int listen_fd)
 {
     auto msg_hdr_desc = CreateMessageHeaderDescription();
 
+    if (options_ && options_->busy_poll) {
+        EnableBusyPolling();
+    }
+
+#if defined(USE_UPGRADE)
+    if (listen_fd >= 0) {
+        server_ = std::make_shared<TcpServer>(listen_fd, MessageType::CUSTOM);  // taken over
+    } else {
+        server_ = std::make_shared<TcpServer>(host, port, MessageType::CUSTOM);
+    }
+#else
     server_ = std::make_shared<TcpServer>(host, port, MessageType::CUSTOM);
+#endif
     server_->SetMessageHeaderDescription(msg_hdr_desc);
 
     auto svr_cbs = std::make_shared<TcpCallbacks>();
     svr_cbs->on_msg_recvd_cb = std::bind(&SwitchServer::OnMessageRecvd, this, std::placeholders::_1, std::placeholders::_2);
     svr_cbs->on_conn_ready_cb = std::bind(&SwitchServer::OnConnectionReady, this, std::placeholders::_1);
     svr_cbs->on_closed_cb = std::bind(&SwitchServer::OnConnectionClosed, this, std::placeholders::_1);
+    svr_cbs->on_msg_sent_cb = std::bind(&SwitchServer::OnMessageSent, this, std::placeholders::_1, std::placeholders::_2);
     server_->SetTcpCallbacks(svr_cbs);
 }
 
@@ -79,10 +199,68 @@ HeaderDescriptionPtr SwitchServer::CreateMessageHeaderDescription() {
     return msg_hdr_desc;
 }
 
+void SwitchServer::EnableBusyPolling()
+{
+    if (options_->busy_poll_cpu >= 0) {
+        // the reactor owns the core, nothing else is scheduled there if the core is isolated
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(options_->busy_poll_cpu, &cpu_set);
+        if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) < 0) {
+            fprintf(stderr, "[SwitchServer] Error: failed to pin to cpu %d: %s\n",
+                    options_->busy_poll_cpu, strerror(errno));
+        } else {
+            printf("[SwitchServer] pinned to cpu %d\n", options_->busy_poll_cpu);
+        }
+    }
+#if defined(USE_IO_URING)
+    // the loop of ../uring spins on io_uring_enter without waiting
+    EV_Singleton->SetBusyPolling(true);
+    printf("[SwitchServer] busy polling, the loop spins, SO_BUSY_POLL: %u us\n", options_->busy_poll_usecs);
+#else
+    // the epoll loop of EventLoop keeps its timeout, only the kernel spins: in epoll_wait on the
+    // device queues of the ready sockets for net.core.busy_poll microseconds before it sleeps
+    uint32_t epoll_busy_poll_usecs = 0;
+    FILE* fp = fopen("/proc/sys/net/core/busy_poll", "r");
+    if (fp != nullptr) {
+        if (fscanf(fp, "%u", &epoll_busy_poll_usecs) != 1) {
+            epoll_busy_poll_usecs = 0;
+        }
+        fclose(fp);
+    }
+    if (epoll_busy_poll_usecs == 0) {
+        fprintf(stderr, "[SwitchServer] Warning: net.core.busy_poll is 0, epoll_wait sleeps, "
+                "only the reads of the sockets busy poll\n");
+    }
+    printf("[SwitchServer] busy polling, SO_BUSY_POLL: %u us, net.core.busy_poll: %u us\n",
+            options_->busy_poll_usecs, epoll_busy_poll_usecs);
+#endif
+}
+
+void SwitchServer::TuneConnection(TcpConnection* conn)
+{
+    int fd = conn->FD();
+    int nodelay = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) < 0) {
+        fprintf(stderr, "[SwitchServer::TuneConnection] Error: TCP_NODELAY, fd: %d: %s\n", fd, strerror(errno));
+    }
+    // the receive path spins in the driver for this long before it sleeps, needs CAP_NET_ADMIN
+    // to raise above net.core.busy_read
+    int busy_poll_usecs = options_->busy_poll_usecs;
+    if (busy_poll_usecs > 0 &&
+            setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_usecs, sizeof(busy_poll_usecs)) < 0) {
+        fprintf(stderr, "[SwitchServer::TuneConnection] Error: SO_BUSY_POLL, fd: %d: %s\n", fd, strerror(errno));
+    }
+}
+
 void SwitchServer::OnConnectionReady(TcpConnection* conn)
 {
     printf("[SwitchServer::OnConnectionReady] fd: %d\n", conn->FD());
+    if (options_ && options_->busy_poll) {
+        TuneConnection(conn);
+    }
     context_->pending_clients.insert(std::make_pair(conn->FD(), conn));
+    watchdog_->Watch(conn);
 }
 void SwitchServer::OnConnectionClosed(TcpConnection* conn)
 {
@@ -90,6 +268,7 @@ void SwitchServer::OnConnectionClosed(TcpConnection* conn)
     // clear endpoint
     context_->RemoveEndpoint(conn->ID());
     context_->pending_clients.erase(conn->FD());
+    watchdog_->Forget(conn);
 }
 void SwitchServer::OnMessageRecvd(TcpConnection* conn, const Message* msg)
 {
@@ -97,5 +276,83 @@ void SwitchServer::OnMessageRecvd(TcpConnection* conn, const Message* msg)
     printf("[SwitchServer::OnMessageRecvd] message bytes(%lu):\n", msg->Size());
     cout << msg->DumpHexWithChars(evt_loop::DUMP_MAX_BYTES) << endl;
 
+    if (! AdmitMessage(conn, msg)) {
+        return;
+    }
     cmd_handler_->handleCommand(conn, msg);
 }
+bool SwitchServer::AdmitMessage(TcpConnection* conn, const Message* msg)
+{
+    // the connections not registered yet can only send REG and ECHO
+    auto iter = context_->endpoints.find(conn->ID());
+    if (iter == context_->endpoints.end()) {
+        return true;
+    }
+    auto& ep = iter->second;
+    auto& config = context_->Config();
+    auto& limiter = ep->GetRateLimiter();
+    auto now_ms = coarse_monotonic_milliseconds();
+    ep->SetLastMessageTime(now_ms);
+    auto rejected_in_row = limiter.RejectedInRow();
+    if (limiter.Admit(config, ep->Id(), ep->GetRole(), msg->Size(), now_ms)) {
+        if (rejected_in_row > 0) {
+            printf("[SwitchServer::AdmitMessage] rate limit lifted, id: %d, rejected frames: %lu\n", ep->Id(), rejected_in_row);
+        }
+        if (config->rate_limit_policy == ERateLimitPolicy::Delay && limiter.IsThrottled()) {
+            PauseReading(ep.get(), limiter.MillisecondsToResume());
+        }
+        ep->GetStats().CountReceived();
+        return true;
+    }
+    ep->GetStats().CountRejected();
+
+    if (config->rate_limit_policy == ERateLimitPolicy::Disconnect) {
+        printf("[SwitchServer::AdmitMessage] rate limit exceeded, disconnect, id: %d\n", ep->Id());
+        conn->Disconnect();
+        return false;
+    }
+    if (limiter.RejectedInRow() > 1) {
+        return false;  // told at the first one, a flood is not answered by a flood of RESULTs
+    }
+    auto cmdMsg = CommandMessage::FromNetworkMessage(msg, IsMessagePayloadLengthIncludingSelf());
+    auto cmd = cmdMsg ? cmdMsg->Command() : ECommand::UNDEFINED;
+    printf("[SwitchServer::AdmitMessage] rate limit exceeded, reject %s and the frames until the bucket refills, id: %d\n",
+            CommandToTag(cmd), ep->Id());
+    if (cmd != ECommand::RESULT) {
+        int8_t errcode = 1;
+        cmd_handler_->sendResultMessage(conn, cmd, errcode, string("Rate limit exceeded"));
+    }
+    return false;
+}
+void SwitchServer::PauseReading(Endpoint* ep, int64_t pause_ms)
+{
+    auto& limiter = ep->GetRateLimiter();
+    auto timer = limiter.ResumeTimer();
+    TimeVal interval(pause_ms / 1000, pause_ms % 1000 * 1000);
+    if (! timer) {
+        EndpointId ep_id = ep->Id();
+        timer = new OneshotTimer(interval, [this, ep_id](auto*) { OnResumeReading(ep_id); });
+        limiter.SetResumeTimer(timer);
+    } else {
+        timer->Stop();
+        timer->SetInterval(interval);
+    }
+    ep->PauseReading(Endpoint::PAUSED_BY_RATE_LIMIT);
+    timer->Start();
+}
+void SwitchServer::OnResumeReading(EndpointId ep_id)
+{
+    auto iter = context_->endpoints.find(ep_id);
+    if (iter != context_->endpoints.end()) {
+        iter->second->ResumeReading(Endpoint::PAUSED_BY_RATE_LIMIT);
+    }
+}
+void SwitchServer::OnMessageSent(TcpConnection* conn, const Message* msg)
+{
+    // the tx buffer of connection drained, feed it from the priority lanes
+    auto iter = context_->endpoints.find(conn->ID());
+    if (iter != context_->endpoints.end() && iter->second->Connection() == conn) {
+        iter->second->GetOutputQueue().Drain(*context_->Config());
+        context_->ReleaseBackpressure(iter->second.get());
+    }
+}
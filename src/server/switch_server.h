@@ -6,6 +6,9 @@
 #include "switch_service.h"
 #include "switch_console.h"
 #include "switch_command_handler.h"
+#include "switch_session_store.h"
+#include "switch_upgrade.h"
+#include "switch_watchdog.h"
 #include <eventloop/el.h>
 
 using namespace evt_loop;
@@ -17,9 +20,11 @@ class SwitchServer
     SwitchServer(const OptionsPtr& options);
     bool init(const char* host, uint16_t port);
     void InitComponents();
-    void InitServer(const char* host, uint16_t port);
+    void InitServer(const char* host, uint16_t port, int listen_fd=-1);
     void OnSignal(SignalHandler* sh, uint32_t signo);
     void Exit();
+    void QuitForUpgrade();  // exit without closing connections, they are owned by the new process
+    tuple<int, string> ReloadConfiguration();
 
     HeaderDescriptionPtr GetMessageHeaderDescription() const
     {
@@ -34,15 +39,26 @@ class SwitchServer
     SwitchContextPtr GetContext() const { return context_; }
     SwitchServicePtr GetService() const { return service_; }
     CommandHandlerPtr GetCommandHandler() const { return cmd_handler_; }
+    SessionStorePtr GetSessionStore() const { return session_store_; }
+    ConnectionWatchdogPtr GetWatchdog() const { return watchdog_; }
 
     size_t GetClientsTotal() const { return server_->GetConnectionNumber(); }
+#if defined(USE_UPGRADE)
+    TcpServer* GetTcpServer() const { return server_.get(); }
+#endif
 
     private:
     HeaderDescriptionPtr CreateMessageHeaderDescription();
+    void EnableBusyPolling();
+    void TuneConnection(TcpConnection* conn);  // for busy polling, TCP_NODELAY and SO_BUSY_POLL
 
     void OnConnectionReady(TcpConnection* conn);
     void OnConnectionClosed(TcpConnection* conn);
     void OnMessageRecvd(TcpConnection* conn, const Message* msg);
+    void OnMessageSent(TcpConnection* conn, const Message* msg);
+    bool AdmitMessage(TcpConnection* conn, const Message* msg);
+    void PauseReading(Endpoint* ep, int64_t pause_ms);
+    void OnResumeReading(EndpointId ep_id);
 
     private:
     TcpServerPtr server_;
@@ -52,6 +68,9 @@ class SwitchServer
     SwitchServicePtr service_;
     SwitchConsolePtr console_;
     CommandHandlerPtr cmd_handler_;
+    SessionStorePtr session_store_;
+    SwitchUpgradePtr upgrade_;
+    ConnectionWatchdogPtr watchdog_;
 };
 
 #endif // _SWITCH_SERVER_H
@@ -1,9 +1,20 @@
 #include "switch_service.h"
 #include "switch_context.h"
 #include "switch_server.h"
-#include "utils/crypto.h"
+#include "compression.h"
 #include "utils/random.h"
+#include "utils/siphash.h"
 #include <sstream>
+#include <cinttypes>
+#include <algorithm>
+
+static const size_t TOP_MESSAGES = 10;     // of the breakdown by msg_type in EP_INFO
+
+SwitchService::SwitchService(const SwitchServer* switch_server) :
+    switch_server_(switch_server)
+{
+    generate_random_bytes(token_key_, sizeof(token_key_));
+}
 
 tuple<int, string, CommandResultRegisterPtr>
 SwitchService::register_endpoint(TcpConnection* conn, const CommandRegister& reg_cmd)
@@ -15,23 +26,24 @@ SwitchService::register_endpoint(TcpConnection* conn, const CommandRegister& reg
     }
 
     EEndpointRole role = (EEndpointRole)reg_cmd.role;
+    auto config = context->Config();
     int8_t errcode = 1;
     std::stringstream ss;
     ss << "Authentication failed, role: " << reg_cmd.role;
 
     switch (role) {
         case EEndpointRole::Normal:
-            if (reg_cmd.access_code.empty() || reg_cmd.access_code != context->access_code) {
+            if (reg_cmd.access_code.empty() || reg_cmd.access_code != config->access_code) {
                 return { errcode, ss.str(), nullptr };
             }
             break;
         case EEndpointRole::Admin:
-            if (reg_cmd.access_code.empty() || reg_cmd.access_code != context->admin_code) {
+            if (reg_cmd.access_code.empty() || reg_cmd.access_code != config->admin_code) {
                 return { errcode, ss.str(), nullptr };
             }
             break;
         case EEndpointRole::Service:
-            if (reg_cmd.access_code.empty() || reg_cmd.access_code != context->service_access_code) {
+            if (reg_cmd.access_code.empty() || reg_cmd.access_code != config->service_access_code) {
                 return { errcode, ss.str(), nullptr };
             }
             break;
@@ -47,16 +59,33 @@ SwitchService::register_endpoint(TcpConnection* conn, const CommandRegister& reg
     EndpointId ep_id = reg_cmd.id;
     if (ep_id == 0) {
         ep_id = allocate_endpoint_id();
+    } else if (IsGroupTarget(ep_id)) {
+        return { errcode, "Has invalid parameter, id: " + std::to_string(ep_id), nullptr };
+    }
+
+    // the session restored from the last run of Switch, resume it with the token
+    EndpointSession dormant_session;
+    bool is_resumed = false;
+    auto session_store = switch_server_->GetSessionStore();
+    if (session_store && session_store->IsDormant(ep_id)) {
+        if (! session_store->Resume(ep_id, reg_cmd.token, dormant_session)) {
+            int errcode = 1;
+            string errmsg("The endpoint id is reserved by a dormant session, provide the token of last registered");
+            return { errcode, errmsg, nullptr };
+        }
+        is_resumed = true;
     }
 
     auto regResult = std::make_shared<CommandResultRegister>();
     regResult->id = ep_id;
 
+    Endpoint* reg_ep = nullptr;
     auto& any_endpoints = context->endpoints;
     auto iter = any_endpoints.find(ep_id);
     if (iter == any_endpoints.end()) {
         // new
         auto ep = std::make_shared<Endpoint>(ep_id, conn);
+        reg_ep = ep.get();
         ep->SetRole(role);
         auto token = generate_token(ep.get());
         ep->SetToken(token);
@@ -82,6 +111,7 @@ SwitchService::register_endpoint(TcpConnection* conn, const CommandRegister& reg
     } else {
         // exists
         auto& exists_ep = iter->second;
+        reg_ep = exists_ep.get();
         auto exists_svc_type = exists_ep->GetServiceType();
         if (exists_ep->Connection()->FD() != conn->FD()) {
             if (! reg_cmd.token.empty() && reg_cmd.token == exists_ep->GetToken()) {
@@ -150,11 +180,39 @@ SwitchService::register_endpoint(TcpConnection* conn, const CommandRegister& reg
         }
     }
 
+    if (reg_cmd.with_state) {
+        // the client resumes the session, replay its state in one command
+        restore_endpoint_state(reg_ep, reg_cmd.state);
+    } else if (is_resumed) {
+        restore_endpoint_state(reg_ep, dormant_session.state);
+    }
+    reg_ep->SetCompression(negotiate_compression(reg_cmd.compressions));
+    if (reg_ep->GetCompression() != ECompression::None) {
+        regResult->compression = CompressionToTag(reg_ep->GetCompression());
+    }
+    save_endpoint_session(reg_ep);
+
     context->pending_clients.erase(conn->FD());
 
     return { 0, "", regResult };
 }
 
+ECompression SwitchService::negotiate_compression(const vector<string>& offered)
+{
+    // the first one offered by client which is enabled and built in
+    auto config = switch_server_->GetContext()->Config();
+    for (auto& tag : offered) {
+        auto compression = TagToCompression(tag);
+        if (compression == ECompression::None || ! IsCompressionSupported(compression)) {
+            continue;
+        }
+        if (std::find(config->compressions.begin(), config->compressions.end(), compression) != config->compressions.end()) {
+            return compression;
+        }
+    }
+    return ECompression::None;
+}
+
 int SwitchService::handle_service_point(const Endpoint* ep, const CommandRegister& reg_cmd)
 {
     /*
@@ -180,9 +238,10 @@ SwitchService::get_stats(const CommandInfoReq& cmd_info_req)
     auto cmd_info = std::make_shared<CommandInfo>();
     cmd_info->id = switch_server_->NodeId();
     cmd_info->uptime = Now() - context->born_time;
-    cmd_info->serving_mode = ServingModeToTag(context->serving_mode);
-    cmd_info->access_code = context->access_code;
-    cmd_info->admin_code = context->admin_code;
+    auto config = context->Config();
+    cmd_info->serving_mode = ServingModeToTag(config->serving_mode);
+    cmd_info->access_code = config->access_code;
+    cmd_info->admin_code = config->admin_code;
     cmd_info->endpoints.total = context->endpoints.size();
     cmd_info->endpoints.rx_bytes = rx_bytes;
     cmd_info->endpoints.tx_bytes = tx_bytes;
@@ -262,9 +321,33 @@ SwitchService::get_endpoint_stats(const CommandInfoReq& cmd_info_req)
           std::back_inserter(cmd_ep_info->subs_messages));
     std::copy(ep->GetRejectedMessages().begin(), ep->GetRejectedMessages().end(),
           std::back_inserter(cmd_ep_info->rej_messages));
+    std::copy(ep->GetConflatedMessages().begin(), ep->GetConflatedMessages().end(),
+          std::back_inserter(cmd_ep_info->conflated_messages));
+    for (auto& [msg_type, filter] : ep->GetMessageFilters()) {
+        cmd_ep_info->filters[msg_type] = filter->Expression();
+    }
+    std::copy(ep->GetGroups().begin(), ep->GetGroups().end(),
+          std::back_inserter(cmd_ep_info->groups));
 
     cmd_ep_info->rx_bytes += ep->Connection()->StatsRxBytes();
     cmd_ep_info->tx_bytes += ep->Connection()->StatsTxBytes();
+
+    auto& stats = ep->GetStats();
+    auto& output_queue = ep->GetOutputQueue();
+    cmd_ep_info->msgs_in = stats.ReceivedMessages();
+    cmd_ep_info->msgs_out = output_queue.SentFrames();
+    cmd_ep_info->rejected_msgs = stats.RejectedMessages();
+    cmd_ep_info->expired_frames = output_queue.ExpiredFrames();
+    cmd_ep_info->conflated_frames = output_queue.ConflatedFrames();
+    cmd_ep_info->queued_frames = output_queue.QueuedFrames();
+    cmd_ep_info->max_queued_frames = output_queue.MaxQueuedFrames();
+    cmd_ep_info->queued_bytes = output_queue.QueuedBytes();
+    cmd_ep_info->max_queued_bytes = output_queue.MaxQueuedBytes();
+    cmd_ep_info->fwd_latency_avg = output_queue.AverageWait();
+    cmd_ep_info->fwd_latency_max = output_queue.MaxWait();
+    for (auto& counters : stats.TopMessages(TOP_MESSAGES)) {
+        cmd_ep_info->top_messages.push_back({ counters.msg_type, counters.in, counters.out });
+    }
     return { 0, "", cmd_ep_info };
 }
 
@@ -278,6 +361,7 @@ SwitchService::forward(Endpoint* ep, const CommandForward& cmd_fwd)
     }
 
     ep->SetForwardTargets(cmd_fwd.targets);
+    save_endpoint_session(ep);
     return { 0, "" };
 }
 
@@ -291,6 +375,7 @@ SwitchService::unforward(Endpoint* ep, const CommandUnforward& cmd_unfwd)
     }
 
     ep->UnsetForwardTargets(cmd_unfwd.targets);
+    save_endpoint_session(ep);
     return { 0, "" };
 }
 
@@ -303,11 +388,31 @@ SwitchService::subscribe(Endpoint* ep, const CommandSubscribe& cmd_sub)
         return { errcode, errmsg };
     }
 
+    // compiled before any change, an invalid filter fails the whole SUB
+    MessageFilterPtr filter;
+    if (! cmd_sub.filter.empty()) {
+        if (cmd_sub.messages.empty()) {
+            return { 1, "The filter applies to messages only, missing messages" };
+        }
+        string errmsg;
+        std::tie(filter, errmsg) = MessageFilter::Compile(cmd_sub.filter);
+        if (! filter) {
+            return { 1, "Invalid filter: " + errmsg };
+        }
+    }
+
     if (!cmd_sub.sources.empty()) {
         ep->SubscribeSources(cmd_sub.sources);
     }
     if (!cmd_sub.messages.empty()) {
         ep->SubscribeMessages(cmd_sub.messages);
+        // the mode of the subscription is set by the latest SUB
+        if (cmd_sub.conflate) {
+            ep->ConflateMessages(cmd_sub.messages);
+        } else {
+            ep->UnconflateMessages(cmd_sub.messages);
+        }
+        ep->SetMessageFilter(cmd_sub.messages, filter);
     }
 
     for (auto msg_type : cmd_sub.messages) {
@@ -324,6 +429,7 @@ SwitchService::subscribe(Endpoint* ep, const CommandSubscribe& cmd_sub)
         //context->message_subscribers[msg_type].insert(ep->Id());
     }
 
+    save_endpoint_session(ep);
     return { 0, "" };
 }
 
@@ -341,6 +447,8 @@ SwitchService::unsubscribe(Endpoint* ep, const CommandUnsubscribe& cmd_unsub)
     }
     if (!cmd_unsub.messages.empty()) {
         ep->UnsubscribeMessages(cmd_unsub.messages);
+        ep->UnconflateMessages(cmd_unsub.messages);
+        ep->SetMessageFilter(cmd_unsub.messages, nullptr);
     }
 
     for (auto msg_type : cmd_unsub.messages) {
@@ -355,6 +463,7 @@ SwitchService::unsubscribe(Endpoint* ep, const CommandUnsubscribe& cmd_unsub)
         }
     }
 
+    save_endpoint_session(ep);
     return { 0, "" };
 }
 
@@ -373,6 +482,7 @@ SwitchService::reject(Endpoint* ep, const CommandReject& cmd_rej)
     if (!cmd_rej.messages.empty()) {
         ep->RejectMessages(cmd_rej.messages);
     }
+    save_endpoint_session(ep);
     return { 0, "" };
 }
 
@@ -391,9 +501,152 @@ SwitchService::unreject(Endpoint* ep, const CommandUnreject& cmd_unrej)
     if (!cmd_unrej.messages.empty()) {
         ep->UnrejectMessages(cmd_unrej.messages);
     }
+    save_endpoint_session(ep);
+    return { 0, "" };
+}
+
+tuple<int, string>
+SwitchService::join_groups(Endpoint* ep, const CommandJoin& cmd_join)
+{
+    if (cmd_join.groups.empty()) {
+        int8_t errcode = 1;
+        string errmsg("Missing required parameter or the parameter is invalid");
+        return { errcode, errmsg };
+    }
+    for (auto group : cmd_join.groups) {
+        if (group == 0 || group > MAX_GROUP_ID) {
+            return { 1, "Has invalid parameter, group: " + std::to_string(group) };
+        }
+    }
+
+    auto context = switch_server_->GetContext();
+    auto iter = context->endpoints.find(ep->Id());
+    if (iter == context->endpoints.end()) {
+        return { 1, "The endpoint is not registered" };
+    }
+    for (auto group : cmd_join.groups) {
+        if (ep->JoinGroup(group)) {
+            context->group_members[group].push_back(iter->second);
+        }
+    }
+    save_endpoint_session(ep);
     return { 0, "" };
 }
 
+tuple<int, string>
+SwitchService::leave_groups(Endpoint* ep, const CommandLeave& cmd_leave)
+{
+    if (cmd_leave.groups.empty()) {
+        int8_t errcode = 1;
+        string errmsg("Missing required parameter or the parameter is invalid");
+        return { errcode, errmsg };
+    }
+
+    auto context = switch_server_->GetContext();
+    for (auto group : cmd_leave.groups) {
+        if (ep->LeaveGroup(group)) {
+            context->RemoveGroupMember(group, ep);
+        }
+    }
+    save_endpoint_session(ep);
+    return { 0, "" };
+}
+
+// (current | add) - remove, by merging the sorted ranges, or the add only for a full state
+template<typename T>
+static set<T> merge_sorted(const set<T>& current, vector<T> add, vector<T> remove, bool is_full)
+{
+    std::sort(add.begin(), add.end());
+    if (is_full) {
+        return set<T>(add.begin(), add.end());  // linear for the sorted range
+    }
+    std::sort(remove.begin(), remove.end());
+    vector<T> merged;
+    merged.reserve(current.size() + add.size());
+    std::set_union(current.begin(), current.end(), add.begin(), add.end(), std::back_inserter(merged));
+    set<T> result;
+    std::set_difference(merged.begin(), merged.end(), remove.begin(), remove.end(),
+            std::inserter(result, result.end()));
+    return result;
+}
+
+tuple<int, string, vector<MessageId>>
+SwitchService::set_subscription_state(Endpoint* ep, const CommandSubscriptionState& cmd_state)
+{
+    auto& add = cmd_state.add;
+    auto& remove = cmd_state.remove;
+    bool is_full = cmd_state.is_full;
+
+    // compiled before any change, the command applies as a whole or not at all
+    map<MessageId, MessageFilterPtr> new_filters;
+    for (auto& [msg_type, expression] : add.filters) {
+        auto [filter, errmsg] = MessageFilter::Compile(expression);
+        if (! filter) {
+            std::stringstream ss;
+            ss << "Invalid filter of msg_type: " << msg_type << ", " << errmsg;
+            return { 1, ss.str(), {} };
+        }
+        new_filters[msg_type] = filter;
+    }
+
+    auto fwd_targets = merge_sorted(ep->GetForwardTargets(), add.fwd_targets, remove.fwd_targets, is_full);
+    auto subs_sources = merge_sorted(ep->GetSubscriedSources(), add.subs_sources, remove.subs_sources, is_full);
+    auto rej_sources = merge_sorted(ep->GetRejectedSources(), add.rej_sources, remove.rej_sources, is_full);
+    auto subs_messages = merge_sorted(ep->GetSubscriedMessages(), add.subs_messages, remove.subs_messages, is_full);
+    auto rej_messages = merge_sorted(ep->GetRejectedMessages(), add.rej_messages, remove.rej_messages, is_full);
+    auto conflated = merge_sorted(ep->GetConflatedMessages(),
+            add.conflated_messages, remove.conflated_messages, is_full);
+
+    // the mode of subscription only applies to the subscribed messages
+    set<MessageId> conflated_messages;
+    std::set_intersection(conflated.begin(), conflated.end(), subs_messages.begin(), subs_messages.end(),
+            std::inserter(conflated_messages, conflated_messages.end()));
+    map<MessageId, MessageFilterPtr> filters;
+    if (! is_full) {
+        filters = ep->GetMessageFilters();
+        for (auto& [msg_type, _] : remove.filters) {
+            filters.erase(msg_type);
+        }
+    }
+    for (auto& [msg_type, filter] : new_filters) {
+        filters[msg_type] = filter;
+    }
+    std::erase_if(filters, [&subs_messages](auto& elem) { return ! subs_messages.contains(elem.first); });
+
+    // update the routing index once, for the changed message types only
+    auto& old_messages = ep->GetSubscriedMessages();
+    vector<MessageId> added_messages;
+    vector<MessageId> removed_messages;
+    std::set_difference(subs_messages.begin(), subs_messages.end(), old_messages.begin(), old_messages.end(),
+            std::back_inserter(added_messages));
+    std::set_difference(old_messages.begin(), old_messages.end(), subs_messages.begin(), subs_messages.end(),
+            std::back_inserter(removed_messages));
+    auto context = switch_server_->GetContext();
+    for (auto msg_type : removed_messages) {
+        auto iter = context->message_subscribers.find(msg_type);
+        if (iter != context->message_subscribers.end()) {
+            iter->second.erase(ep->Id());
+            if (iter->second.empty()) {
+                context->message_subscribers.erase(iter);
+            }
+        }
+    }
+    for (auto msg_type : added_messages) {
+        context->message_subscribers[msg_type].insert(ep->Id());
+    }
+
+    ep->ReplaceForwardTargets(std::move(fwd_targets));
+    ep->ReplaceSources(std::move(subs_sources), std::move(rej_sources));
+    ep->ReplaceMessages(std::move(subs_messages), std::move(rej_messages), std::move(conflated_messages));
+    ep->ReplaceMessageFilters(std::move(filters));
+    save_endpoint_session(ep);
+
+    printf("[set_subscription_state] endpoint: %d, %s, subscribed messages: %ld (+%ld, -%ld)\n",
+            ep->Id(), is_full ? "full" : "delta", ep->GetSubscriedMessages().size(),
+            added_messages.size(), removed_messages.size());
+    return { 0, "", added_messages };
+}
+
 bool SwitchService::is_forwarding_allowed(const Endpoint* source_ep, const Endpoint* target_ep, MessageId msg_type)
 {
     if (source_ep->Id() == target_ep->Id()) {
@@ -435,19 +688,21 @@ tuple<int, string>
 SwitchService::setup(const CommandSetup& cmd_setup)
 {
     auto context = switch_server_->GetContext();
+    // modify a copy of current config, then publish it as a whole
+    auto config = std::make_shared<SwitchConfig>(*context->Config());
 
     if (! cmd_setup.new_admin_code.empty()) {
-        if (cmd_setup.access_code.empty() || cmd_setup.access_code != context->admin_code) {
+        if (cmd_setup.access_code.empty() || cmd_setup.access_code != config->admin_code) {
             int8_t errcode = 1;
             string errmsg("Authentication failed");
             return { errcode, errmsg };
         }
 
-        context->admin_code = cmd_setup.new_admin_code;
+        config->admin_code = cmd_setup.new_admin_code;
     }
 
     if (! cmd_setup.new_access_code.empty()) {
-        context->access_code = cmd_setup.new_access_code;
+        config->access_code = cmd_setup.new_access_code;
     }
 
     if (! cmd_setup.mode.empty()) {
@@ -458,9 +713,41 @@ SwitchService::setup(const CommandSetup& cmd_setup)
             ss << "Has invalid parameter, mode: " << cmd_setup.mode;
             return { errcode, ss.str() };
         }
-        context->serving_mode = mode;
+        config->serving_mode = mode;
     }
 
+    if (! cmd_setup.rate_limit_policy.empty() &&
+            ! TagToRateLimitPolicy(cmd_setup.rate_limit_policy, config->rate_limit_policy)) {
+        int8_t errcode = 1;
+        std::stringstream ss;
+        ss << "Has invalid parameter, rate_limit_policy: " << cmd_setup.rate_limit_policy;
+        return { errcode, ss.str() };
+    }
+    for (auto& cmd_limit : cmd_setup.rate_limits) {
+        RateLimit limit { cmd_limit.msgs_per_sec, cmd_limit.bytes_per_sec };
+        if (! cmd_limit.role.empty()) {
+            auto role = TagToEndpointRole(cmd_limit.role);
+            if (role == EEndpointRole::Undefined) {
+                int8_t errcode = 1;
+                std::stringstream ss;
+                ss << "Has invalid parameter, role of rate limit: " << cmd_limit.role;
+                return { errcode, ss.str() };
+            }
+            config->role_rate_limits[(size_t)role] = limit;
+        } else if (cmd_limit.endpoint != 0) {
+            if (cmd_limit.reset) {
+                config->endpoint_rate_limits.erase(cmd_limit.endpoint);
+            } else {
+                config->endpoint_rate_limits[cmd_limit.endpoint] = limit;
+            }
+        } else {
+            int8_t errcode = 1;
+            string errmsg("Missing required parameter, role or endpoint of rate limit");
+            return { errcode, errmsg };
+        }
+    }
+
+    context->UpdateConfig(config);
     return { 0, "" };
 }
 
@@ -487,21 +774,106 @@ SwitchService::kickout_endpoint(const CommandKickout& cmd_kickout)
     return { 0, "" };
 }
 
-EndpointId SwitchService::allocate_endpoint_id()
+void SwitchService::restore_endpoint_state(Endpoint* ep, const CommandEndpointState& state)
 {
-    EndpointId ep_id = generate_random_integer();
-    // to find out the generated ep_id whether exists
+    // the replayed state is the full state, applied the same way as a full SUBSTATE
+    CommandSubscriptionState cmd_state;
+    cmd_state.is_full = true;
+    cmd_state.add = state;
+    // a filter rejected by this version is dropped, rather than the whole state
+    for (auto iter = cmd_state.add.filters.begin(); iter != cmd_state.add.filters.end(); ) {
+        auto [filter, errmsg] = MessageFilter::Compile(iter->second);
+        if (! filter) {
+            fprintf(stderr, "[restore_endpoint_state] Error: invalid filter of msg_type: %d, %s\n", iter->first, errmsg.c_str());
+            iter = cmd_state.add.filters.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    auto [errcode, errmsg, _] = set_subscription_state(ep, cmd_state);
+    if (errcode != 0) {
+        fprintf(stderr, "[restore_endpoint_state] Error: %s\n", errmsg.c_str());
+    }
+
+    // the membership of groups is replaced as well, SUBSTATE does not carry it
     auto context = switch_server_->GetContext();
-    while (context->endpoints.find(ep_id) != context->endpoints.end()) {
-        ep_id = generate_random_integer();  // re-generate
+    auto iter = context->endpoints.find(ep->Id());
+    if (iter == context->endpoints.end()) {
+        return;
+    }
+    set<GroupId> groups;
+    for (auto group : state.groups) {
+        if (group == 0 || group > MAX_GROUP_ID) {
+            fprintf(stderr, "[restore_endpoint_state] Error: invalid group: %u\n", group);
+            continue;
+        }
+        groups.insert(group);
+    }
+    auto joined = ep->GetGroups();
+    for (auto group : joined) {
+        if (! groups.contains(group) && ep->LeaveGroup(group)) {
+            context->RemoveGroupMember(group, ep);
+        }
+    }
+    for (auto group : groups) {
+        if (ep->JoinGroup(group)) {
+            context->group_members[group].push_back(iter->second);
+        }
+    }
+}
+
+void SwitchService::adopt_endpoint(TcpConnection* conn, const EndpointSession& session)
+{
+    auto context = switch_server_->GetContext();
+    EEndpointRole role = (EEndpointRole)session.role;
+    conn->SetID(session.id);
+    auto ep = std::make_shared<Endpoint>(session.id, conn);
+    ep->SetRole(role);
+    ep->SetToken(session.token);
+    context->endpoints[session.id] = ep;
+    switch (role) {
+        case EEndpointRole::Normal:
+            context->normal_endpoints[session.id] = ep;
+            break;
+        case EEndpointRole::Admin:
+            context->admin_endpoints[session.id] = ep;
+            break;
+        case EEndpointRole::Service:
+            ep->SetServiceType(session.svc_type);
+            context->service_endpoints[session.svc_type].insert(ep);
+            break;
+        default:
+            printf("[Adopt] Unsupported endpoint role: %d\n", int(role));
+            break;
     }
-    return ep_id;
+    restore_endpoint_state(ep.get(), session.state);
+    save_endpoint_session(ep.get());
+}
+
+EndpointId SwitchService::allocate_endpoint_id()
+{
+    auto context = switch_server_->GetContext();
+    auto session_store = switch_server_->GetSessionStore();
+    return id_allocator_.Allocate([&](EndpointId ep_id) {
+        return context->endpoints.contains(ep_id) || (session_store && session_store->IsDormant(ep_id));
+    });
 }
 string SwitchService::generate_token(Endpoint* ep)
 {
-    stringstream ss;
-    ss << ep->Id() << ":" << generate_random_integer() << ":" << ep->Connection()->FD();
-    return md5(ss.str());
+    // keyed hash of (id, sequence), 128 bits from two SipHash outputs, unpredictable without the key
+#pragma pack(1)
+    struct {
+        EndpointId  id;
+        uint64_t    seq;
+        uint8_t     half;
+    } input = { ep->Id(), ++token_seq_, 0 };
+#pragma pack()
+    uint64_t h0 = siphash24(token_key_, &input, sizeof(input));
+    input.half = 1;
+    uint64_t h1 = siphash24(token_key_, &input, sizeof(input));
+    char token[33];
+    snprintf(token, sizeof(token), "%016" PRIx64 "%016" PRIx64, h0, h1);
+    return token;
 }
 void SwitchService::kickout_endpoint(Endpoint* ep)
 {
@@ -509,6 +881,14 @@ void SwitchService::kickout_endpoint(Endpoint* ep)
             ep->Id(), ep->Connection()->ID(), ep->Connection()->FD());
     auto cmd_handler = switch_server_->GetCommandHandler();
     cmd_handler->sendResultMessage(ep->Connection(), ECommand::KICKOUT, 0, "Kickout by admin or logged in at another device");
+    ep->GetOutputQueue().Flush();  // the queued frames belong to this connection
     // XXX: clear endpoints here? or clear them in SwitchServer::OnConnectionClosed?
     ep->Connection()->Disconnect(); // XXX: delay 1 second to do this?
 }
+void SwitchService::save_endpoint_session(const Endpoint* ep)
+{
+    auto session_store = switch_server_->GetSessionStore();
+    if (session_store) {
+        session_store->SaveEndpoint(ep);
+    }
+}
@@ -3,6 +3,8 @@
 
 #include "command_messages.h"
 #include "switch_types.h"
+#include "switch_message.h"
+#include "switch_id_allocator.h"
 #include <tuple>
 
 using std::tuple;
@@ -15,13 +17,12 @@ using evt_loop::TcpConnection;
 class CommandInfoReq;
 class SwitchServer;
 class Endpoint;
+struct EndpointSession;
 
 class SwitchService {
 
 public:
-    SwitchService(const SwitchServer* switch_server) :
-        switch_server_(switch_server)
-    {}
+    SwitchService(const SwitchServer* switch_server);
 
     tuple<int, string, CommandResultRegisterPtr> register_endpoint(TcpConnection* conn, const CommandRegister& cmd_reg);
     int handle_service_point(const Endpoint* ep, const CommandRegister& reg_cmd);
@@ -33,17 +34,28 @@ public:
     tuple<int, string> unsubscribe(Endpoint* ep, const CommandUnsubscribe& cmd_unsub);
     tuple<int, string> reject(Endpoint* ep, const CommandReject& cmd_rej);
     tuple<int, string> unreject(Endpoint* ep, const CommandUnreject& cmd_unrej);
+    tuple<int, string> join_groups(Endpoint* ep, const CommandJoin& cmd_join);
+    tuple<int, string> leave_groups(Endpoint* ep, const CommandLeave& cmd_leave);
+    // returns the newly subscribed messages, for the last-value cache
+    tuple<int, string, vector<MessageId>> set_subscription_state(Endpoint* ep, const CommandSubscriptionState& cmd_state);
     bool is_forwarding_allowed(const Endpoint* source_ep, const Endpoint* target_ep, MessageId msg_type=0);
     tuple<int, string> setup(const CommandSetup& cmd_setup);
     tuple<int, string> kickout_endpoint(const CommandKickout& cmd_kickout);
+    void restore_endpoint_state(Endpoint* ep, const CommandEndpointState& state);
+    void adopt_endpoint(TcpConnection* conn, const EndpointSession& session);
 
 private:
     EndpointId allocate_endpoint_id();
+    ECompression negotiate_compression(const vector<string>& offered);
     string generate_token(Endpoint* ep);
     void kickout_endpoint(Endpoint* ep);
+    void save_endpoint_session(const Endpoint* ep);
 
 private:
     const SwitchServer* switch_server_;
+    EndpointIdAllocator id_allocator_;
+    uint8_t             token_key_[16];     // the key of tokens, per process
+    uint64_t            token_seq_ = 0;
 };
 using SwitchServicePtr = std::shared_ptr<SwitchService>;
 
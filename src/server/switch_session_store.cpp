@@ -0,0 +1,417 @@
+#include "switch_session_store.h"
+#include "switch_endpoint.h"
+#include "utils/byte_codec.h"
+#include "wakeup_event.h"
+#include <eventloop/el.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+
+using namespace evt_loop;
+
+// snapshot: header, sessions...
+// journal:  header, records of { op(u8), length(u32), record }
+// both headers carry the version of the session encoding, bump it on any change of EncodeTo
+static const uint32_t SNAPSHOT_MAGIC = 0x5353574d;  // "MWSS"
+static const uint32_t JOURNAL_MAGIC = 0x4a53574d;   // "MWSJ"
+static const uint16_t STORE_VERSION = 1;
+
+#pragma pack(1)
+struct SnapshotHeader {
+    uint32_t magic = SNAPSHOT_MAGIC;
+    uint16_t version = STORE_VERSION;
+    uint16_t reserved = 0;
+    uint32_t n_sessions = 0;
+};
+struct JournalHeader {
+    uint32_t magic = JOURNAL_MAGIC;
+    uint16_t version = STORE_VERSION;
+    uint16_t reserved = 0;
+};
+struct JournalRecordHeader {
+    uint8_t  op = 0;
+    uint32_t length = 0;
+};
+#pragma pack()
+
+EndpointSession EndpointSession::FromEndpoint(const Endpoint* ep)
+{
+    EndpointSession session;
+    session.id = ep->Id();
+    session.role = (RoleId)ep->GetRole();
+    session.svc_type = ep->GetServiceType();
+    session.token = ep->GetToken();
+    auto& state = session.state;
+    state.fwd_targets.assign(ep->GetForwardTargets().begin(), ep->GetForwardTargets().end());
+    state.subs_sources.assign(ep->GetSubscriedSources().begin(), ep->GetSubscriedSources().end());
+    state.rej_sources.assign(ep->GetRejectedSources().begin(), ep->GetRejectedSources().end());
+    state.subs_messages.assign(ep->GetSubscriedMessages().begin(), ep->GetSubscriedMessages().end());
+    state.rej_messages.assign(ep->GetRejectedMessages().begin(), ep->GetRejectedMessages().end());
+    state.conflated_messages.assign(ep->GetConflatedMessages().begin(), ep->GetConflatedMessages().end());
+    for (auto& [msg_type, filter] : ep->GetMessageFilters()) {
+        state.filters[msg_type] = filter->Expression();
+    }
+    state.groups.assign(ep->GetGroups().begin(), ep->GetGroups().end());
+    return session;
+}
+
+void EndpointSession::EncodeTo(string& out) const
+{
+    put_value<uint32_t>(out, id);
+    put_value<uint8_t>(out, role);
+    put_value<uint8_t>(out, svc_type);
+    put_value<uint16_t>(out, token.size());
+    out.append(token);
+    put_array(out, state.fwd_targets);
+    put_array(out, state.subs_sources);
+    put_array(out, state.rej_sources);
+    put_array(out, state.subs_messages);
+    put_array(out, state.rej_messages);
+    put_array(out, state.conflated_messages);
+    put_value<uint32_t>(out, state.filters.size());
+    for (auto& [msg_type, filter] : state.filters) {
+        put_value<msg_type_t>(out, msg_type);
+        put_string(out, filter);
+    }
+    put_array(out, state.groups);
+}
+
+bool EndpointSession::DecodeFrom(const char*& data, const char* end)
+{
+    uint16_t token_len = 0;
+    if (! get_value(data, end, id) || ! get_value(data, end, role) ||
+            ! get_value(data, end, svc_type) || ! get_value(data, end, token_len)) {
+        return false;
+    }
+    if (end - data < token_len) {
+        return false;
+    }
+    token.assign(data, token_len);
+    data += token_len;
+    if (! get_array(data, end, state.fwd_targets) ||
+            ! get_array(data, end, state.subs_sources) ||
+            ! get_array(data, end, state.rej_sources) ||
+            ! get_array(data, end, state.subs_messages) ||
+            ! get_array(data, end, state.rej_messages) ||
+            ! get_array(data, end, state.conflated_messages)) {
+        return false;
+    }
+    uint32_t n_filters = 0;
+    if (! get_value(data, end, n_filters)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < n_filters; i++) {
+        msg_type_t msg_type = 0;
+        string filter;
+        if (! get_value(data, end, msg_type) || ! get_string(data, end, filter)) {
+            return false;
+        }
+        state.filters[msg_type] = std::move(filter);
+    }
+    return get_array(data, end, state.groups);
+}
+
+SessionStore::SessionStore(const string& path, uint32_t snapshot_interval, uint32_t session_ttl) :
+    snapshot_file_(path + ".snapshot"), journal_file_(path + ".journal"),
+    snapshot_interval_(snapshot_interval), session_ttl_(session_ttl)
+{
+}
+
+SessionStore::~SessionStore()
+{
+    Close();
+    delete snapshot_timer_;
+    delete flush_event_;
+    if (flush_fd_ >= 0) {
+        close(flush_fd_);
+    }
+}
+
+// mmap the file and call the parser on its content
+static size_t load_file(const string& file, const std::function<size_t (const char*, size_t)>& parser)
+{
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    size_t n = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            madvise(addr, st.st_size, MADV_SEQUENTIAL);
+            n = parser((const char*)addr, st.st_size);
+            munmap(addr, st.st_size);
+        }
+    }
+    close(fd);
+    return n;
+}
+
+size_t SessionStore::Load()
+{
+    size_t n_snapshot = load_file(snapshot_file_,
+            std::bind(&SessionStore::DecodeSessions, this, std::placeholders::_1, std::placeholders::_2));
+    size_t n_journal = load_file(journal_file_,
+            std::bind(&SessionStore::ReplayJournal, this, std::placeholders::_1, std::placeholders::_2));
+    printf("[SessionStore] restored sessions: %ld, from snapshot: %ld, journal records: %ld\n",
+            sessions_.size(), n_snapshot, n_journal);
+
+    time_t now = Now();
+    for (auto& [ep_id, _] : sessions_) {
+        dormant_sessions_[ep_id] = now;
+    }
+
+    // fold the journal into a fresh snapshot, and start a new journal
+    WriteSnapshot();
+
+    if (! flush_event_) {
+        flush_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        flush_event_ = new WakeupEvent(flush_fd_, std::bind(&SessionStore::FlushJournal, this));
+    }
+
+    if (snapshot_interval_ > 0 && ! snapshot_timer_) {
+        snapshot_timer_ = new PeriodicTimer(TimeVal(snapshot_interval_, 0),
+                [this](auto*) { OnSnapshotTimer(); });
+        snapshot_timer_->Start();
+    }
+    return sessions_.size();
+}
+
+void SessionStore::Close()
+{
+    if (is_closed_) {
+        return;
+    }
+    if (snapshot_timer_) {
+        snapshot_timer_->Stop();
+    }
+    FlushJournal();     // kept if the snapshot fails
+    WriteSnapshot();
+    if (journal_fd_ >= 0) {
+        close(journal_fd_);
+        journal_fd_ = -1;
+    }
+    // the connections closed on shutdown must not remove their sessions
+    is_closed_ = true;
+}
+
+void SessionStore::SaveEndpoint(const Endpoint* ep)
+{
+    if (is_closed_) {
+        return;
+    }
+    auto session = EndpointSession::FromEndpoint(ep);
+    dormant_sessions_.erase(session.id);  // the endpoint is live
+    unsynced_sessions_.insert(session.id);
+    sessions_[session.id] = std::move(session);
+    ScheduleFlush();
+}
+
+void SessionStore::RemoveEndpoint(EndpointId ep_id)
+{
+    if (is_closed_ || ! sessions_.contains(ep_id)) {
+        return;
+    }
+    // the upserts are flushed after the removes, an endpoint registered again stays
+    unsynced_sessions_.erase(ep_id);
+    string record;
+    put_value<uint32_t>(record, ep_id);
+    AppendJournal(JOURNAL_REMOVE, record);
+    sessions_.erase(ep_id);
+    dormant_sessions_.erase(ep_id);
+    ScheduleFlush();
+}
+
+bool SessionStore::Resume(EndpointId ep_id, const string& token, EndpointSession& session)
+{
+    if (! IsDormant(ep_id)) {
+        return false;
+    }
+    auto iter = sessions_.find(ep_id);
+    if (iter == sessions_.end() || token.empty() || iter->second.token != token) {
+        return false;
+    }
+    dormant_sessions_.erase(ep_id);
+    session = iter->second;
+    return true;
+}
+
+bool SessionStore::WriteSnapshot()
+{
+    if (is_closed_) {
+        return false;
+    }
+    string tmp_file = snapshot_file_ + ".tmp";
+    int fd = open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "[SessionStore] Error: can not open %s: %s\n", tmp_file.c_str(), strerror(errno));
+        return false;
+    }
+    string data = EncodeSessions();
+    bool success = write(fd, data.data(), data.size()) == (ssize_t)data.size() && fdatasync(fd) == 0;
+    close(fd);
+    if (! success || rename(tmp_file.c_str(), snapshot_file_.c_str()) != 0) {
+        fprintf(stderr, "[SessionStore] Error: failed to write snapshot %s: %s\n", snapshot_file_.c_str(), strerror(errno));
+        unlink(tmp_file.c_str());
+        return false;
+    }
+
+    // the snapshot covers all journaled changes and the unflushed ones, start over
+    journal_buffer_.clear();
+    unsynced_sessions_.clear();
+    if (journal_fd_ >= 0) {
+        close(journal_fd_);
+    }
+    journal_fd_ = open(journal_file_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+    JournalHeader journal_header;
+    if (journal_fd_ >= 0 && write(journal_fd_, &journal_header, sizeof(journal_header)) != sizeof(journal_header)) {
+        fprintf(stderr, "[SessionStore] Error: failed to write journal header: %s\n", strerror(errno));
+    }
+    journal_records_ = 0;
+    return true;
+}
+
+string SessionStore::EncodeSessions() const
+{
+    SnapshotHeader header;
+    header.n_sessions = sessions_.size();
+    string data((const char*)&header, sizeof(header));
+    for (auto& [_, session] : sessions_) {
+        session.EncodeTo(data);
+    }
+    return data;
+}
+
+size_t SessionStore::DecodeSessions(const char* data, size_t size)
+{
+    const char* end = data + size;
+    SnapshotHeader header;
+    if (! get_value(data, end, header) || header.magic != SNAPSHOT_MAGIC ||
+            header.version != STORE_VERSION) {
+        fprintf(stderr, "[SessionStore] Error: invalid snapshot, ignored\n");
+        return 0;
+    }
+    size_t n = 0;
+    for (; n < header.n_sessions; n++) {
+        EndpointSession session;
+        if (! session.DecodeFrom(data, end)) {
+            fprintf(stderr, "[SessionStore] Error: truncated snapshot, sessions: %d, decoded: %ld\n", header.n_sessions, n);
+            break;
+        }
+        sessions_[session.id] = std::move(session);
+    }
+    return n;
+}
+
+void SessionStore::AppendJournal(JournalOp op, const string& record)
+{
+    if (journal_fd_ < 0) {
+        return;
+    }
+    JournalRecordHeader header;
+    header.op = op;
+    header.length = record.size();
+    journal_buffer_.append((const char*)&header, sizeof(header));
+    journal_buffer_.append(record);
+    journal_records_++;
+}
+
+void SessionStore::ScheduleFlush()
+{
+    if (! flush_event_) {
+        FlushJournal();  // not loaded, no event loop to defer to
+        return;
+    }
+    if (! flush_pending_) {
+        flush_pending_ = true;
+        uint64_t one = 1;
+        ssize_t n = write(flush_fd_, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+void SessionStore::FlushJournal()
+{
+    flush_pending_ = false;
+    if (is_closed_) {
+        return;
+    }
+    for (auto ep_id : unsynced_sessions_) {
+        auto iter = sessions_.find(ep_id);
+        if (iter != sessions_.end()) {
+            string record;
+            iter->second.EncodeTo(record);
+            AppendJournal(JOURNAL_UPSERT, record);
+        }
+    }
+    unsynced_sessions_.clear();
+    if (journal_buffer_.empty() || journal_fd_ < 0) {
+        journal_buffer_.clear();
+        return;
+    }
+    // one write per iteration, a crash can only lose the iteration or truncate its tail record
+    if (write(journal_fd_, journal_buffer_.data(), journal_buffer_.size()) != (ssize_t)journal_buffer_.size()) {
+        fprintf(stderr, "[SessionStore] Error: failed to append journal: %s\n", strerror(errno));
+    }
+    journal_buffer_.clear();
+}
+
+size_t SessionStore::ReplayJournal(const char* data, size_t size)
+{
+    const char* end = data + size;
+    JournalHeader journal_header;
+    if (! get_value(data, end, journal_header) || journal_header.magic != JOURNAL_MAGIC ||
+            journal_header.version != STORE_VERSION) {
+        fprintf(stderr, "[SessionStore] Error: invalid journal, ignored\n");
+        return 0;
+    }
+    size_t n = 0;
+    JournalRecordHeader header;
+    while (get_value(data, end, header) && end - data >= (ptrdiff_t)header.length) {
+        const char* record = data;
+        const char* record_end = data + header.length;
+        data = record_end;
+        if (header.op == JOURNAL_UPSERT) {
+            EndpointSession session;
+            if (session.DecodeFrom(record, record_end)) {
+                sessions_[session.id] = std::move(session);
+            }
+        } else if (header.op == JOURNAL_REMOVE) {
+            uint32_t ep_id = 0;
+            if (get_value(record, record_end, ep_id)) {
+                sessions_.erase(ep_id);
+            }
+        }
+        n++;
+    }
+    return n;
+}
+
+void SessionStore::OnSnapshotTimer()
+{
+    ExpireDormantSessions();
+    if (journal_records_ > 0) {
+        WriteSnapshot();
+    }
+}
+
+void SessionStore::ExpireDormantSessions()
+{
+    time_t now = Now();
+    for (auto iter = dormant_sessions_.begin(); iter != dormant_sessions_.end(); ) {
+        if (now - iter->second < (time_t)session_ttl_) {
+            ++iter;
+            continue;
+        }
+        printf("[SessionStore] dormant session expired, endpoint id: %d\n", iter->first);
+        sessions_.erase(iter->first);
+        iter = dormant_sessions_.erase(iter);
+        journal_records_++;  // make sure the next snapshot drops it
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef _SWITCH_SESSION_STORE_H
+#define _SWITCH_SESSION_STORE_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <memory>
+#include "command_messages.h"
+#include "switch_types.h"
+
+using std::map;
+using std::set;
+using std::string;
+
+namespace evt_loop {
+    class PeriodicTimer;
+}
+
+class Endpoint;
+class WakeupEvent;
+
+// The routing state of an endpoint, survives restarts of Switch
+struct EndpointSession {
+    EndpointId  id = 0;
+    RoleId      role = 0;
+    ServiceType svc_type = 0;
+    string      token;
+    CommandEndpointState state;
+
+    static EndpointSession FromEndpoint(const Endpoint* ep);
+
+    void EncodeTo(string& out) const;
+    bool DecodeFrom(const char*& data, const char* end);
+};
+
+// Persist the sessions of endpoints to a compact binary snapshot and a journal of
+// changes (<path>.snapshot and <path>.journal). On startup the snapshot is mmap'ed
+// and the journal replayed, the restored sessions are kept dormant until their
+// endpoints register again with the token, or expire after ttl seconds.
+// The changes of a loop iteration are journaled together on the next one, so the burst
+// of SUBs at the start of a session costs one record per endpoint and one write.
+class SessionStore {
+public:
+    SessionStore(const string& path, uint32_t snapshot_interval, uint32_t session_ttl);
+    ~SessionStore();
+
+    size_t Load();
+    void Close();   // write the final snapshot and stop journaling
+
+    void SaveEndpoint(const Endpoint* ep);
+    void RemoveEndpoint(EndpointId ep_id);
+
+    bool IsDormant(EndpointId ep_id) const { return dormant_sessions_.contains(ep_id); }
+    bool Resume(EndpointId ep_id, const string& token, EndpointSession& session);
+    size_t DormantSessionsTotal() const { return dormant_sessions_.size(); }
+
+    bool WriteSnapshot();
+
+    // serialize/deserialize all sessions, shared with the snapshot file
+    string EncodeSessions() const;
+    size_t DecodeSessions(const char* data, size_t size);
+
+private:
+    enum JournalOp : uint8_t {
+        JOURNAL_UPSERT = 1,
+        JOURNAL_REMOVE = 2,
+    };
+    void AppendJournal(JournalOp op, const string& record);
+    void ScheduleFlush();
+    void FlushJournal();
+    size_t ReplayJournal(const char* data, size_t size);
+    void OnSnapshotTimer();
+    void ExpireDormantSessions();
+
+private:
+    string      snapshot_file_;
+    string      journal_file_;
+    uint32_t    snapshot_interval_;
+    uint32_t    session_ttl_;
+    int         journal_fd_ = -1;
+    size_t      journal_records_ = 0;
+    string      journal_buffer_;        // the records not written yet
+    set<EndpointId> unsynced_sessions_; // changed since the last flush, journaled on it
+    int         flush_fd_ = -1;         // eventfd, kicked by the first change of an iteration
+    WakeupEvent* flush_event_ = nullptr;
+    bool        flush_pending_ = false;
+    bool        is_closed_ = false;
+
+    map<EndpointId, EndpointSession>    sessions_;          // live and dormant
+    map<EndpointId, time_t>             dormant_sessions_;  // id -> restored time
+    evt_loop::PeriodicTimer*            snapshot_timer_ = nullptr;
+};
+using SessionStorePtr = std::shared_ptr<SessionStore>;
+
+#endif  // _SWITCH_SESSION_STORE_H
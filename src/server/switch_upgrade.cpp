@@ -0,0 +1,412 @@
+#include "switch_upgrade.h"
+
+#if defined(USE_UPGRADE)
+
+#include "switch_server.h"
+#include "utils/byte_codec.h"
+#include <eventloop/el.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+
+using namespace evt_loop;
+
+// handoff: [length(u32)][state], then the fds in batches of SCM_RIGHTS messages,
+// the listening socket first, then the client sockets in the order of state.conns
+static const uint32_t HANDOFF_MAGIC = 0x5055574d;  // "MWUP"
+static const uint16_t HANDOFF_VERSION = 1;
+static const size_t MAX_FDS_PER_MESSAGE = 64;
+static const int HANDOFF_TIMEOUT = 10;  // seconds
+static const int SUSPEND_CHECK_MS = 1;
+static const char HANDOFF_ACK = 'K';
+
+// Accept the connection of a new process on the upgrade socket
+class UpgradeListenEvent : public IOEvent {
+public:
+    UpgradeListenEvent(int fd, SwitchUpgrade* upgrade) :
+        IOEvent(IOEvent::READ), upgrade_(upgrade)
+    {
+        SetFD(fd);
+        EV_Singleton->AddEvent(this);
+    }
+    ~UpgradeListenEvent() {
+        EV_Singleton->DeleteEvent(this);
+        close(FD());
+    }
+
+protected:
+    void OnEvents(uint32_t events) {
+        upgrade_->OnTakeOverRequest();
+    }
+
+private:
+    SwitchUpgrade* upgrade_;
+};
+
+static bool write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool send_fds(int sock, const int* fds, size_t n)
+{
+    char byte = 'F';
+    struct iovec iov = { &byte, 1 };
+    char cbuf[CMSG_SPACE(sizeof(int) * MAX_FDS_PER_MESSAGE)];
+    memset(cbuf, 0, sizeof(cbuf));
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * n);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * n);
+
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+static ssize_t recv_fds(int sock, vector<int>& fds)
+{
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    char cbuf[CMSG_SPACE(sizeof(int) * MAX_FDS_PER_MESSAGE)];
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1 || (msg.msg_flags & MSG_CTRUNC)) {
+        return -1;
+    }
+    ssize_t n = 0;
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int* received = (const int*)CMSG_DATA(cmsg);
+        fds.insert(fds.end(), received, received + count);
+        n += count;
+    }
+    return n;
+}
+
+static int open_unix_socket(const string& path, struct sockaddr_un& addr)
+{
+    if (path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[SwitchUpgrade] Error: the path of upgrade socket is too long: %s\n", path.c_str());
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+}
+
+static void set_socket_timeout(int fd, int seconds)
+{
+    struct timeval tv = { seconds, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+HandoffState::~HandoffState()
+{
+    if (channel_fd >= 0) {
+        close(channel_fd);
+    }
+}
+
+void HandoffState::Ack()
+{
+    if (channel_fd >= 0) {
+        write_all(channel_fd, &HANDOFF_ACK, 1);
+        close(channel_fd);
+        channel_fd = -1;
+    }
+}
+
+SwitchUpgrade::SwitchUpgrade(SwitchServer* server, const string& socket_path) :
+    switch_server_(server), socket_path_(socket_path)
+{
+}
+
+SwitchUpgrade::~SwitchUpgrade()
+{
+    delete suspend_timer_;
+    delete listen_event_;
+    if (channel_fd_ >= 0) {
+        close(channel_fd_);
+    }
+}
+
+bool SwitchUpgrade::Listen()
+{
+    struct sockaddr_un addr;
+    int fd = open_unix_socket(socket_path_, addr);
+    if (fd < 0) {
+        return false;
+    }
+    unlink(socket_path_.c_str());  // left by the last process
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+        fprintf(stderr, "[SwitchUpgrade] Error: can not listen on %s: %s\n", socket_path_.c_str(), strerror(errno));
+        close(fd);
+        return false;
+    }
+    chmod(socket_path_.c_str(), 0600);
+    listen_event_ = new UpgradeListenEvent(fd, this);
+    printf("[SwitchUpgrade] listen on %s for upgrading\n", socket_path_.c_str());
+    return true;
+}
+
+void SwitchUpgrade::OnTakeOverRequest()
+{
+    int channel_fd = accept4(listen_event_->FD(), nullptr, nullptr, SOCK_CLOEXEC);
+    if (channel_fd < 0) {
+        return;
+    }
+    if (channel_fd_ >= 0) {
+        fprintf(stderr, "[SwitchUpgrade] Error: another new process is taking over, refused\n");
+        close(channel_fd);
+        return;
+    }
+    printf("[SwitchUpgrade] a new process requests to take over\n");
+    set_socket_timeout(channel_fd, HANDOFF_TIMEOUT);
+    channel_fd_ = channel_fd;
+
+    // no more accept, receive or send, what is not read yet stays in the kernel for the new
+    // process, the requests in flight complete in the next iterations of loop
+    switch_server_->GetTcpServer()->Suspend();
+    suspend_deadline_ = Now() + HANDOFF_TIMEOUT;
+    if (! suspend_timer_) {
+        suspend_timer_ = new PeriodicTimer(TimeVal(0, SUSPEND_CHECK_MS * 1000), [this](auto*) { OnSuspendTimer(); });
+    }
+    suspend_timer_->Start();
+}
+
+void SwitchUpgrade::OnSuspendTimer()
+{
+    bool is_suspended = switch_server_->GetTcpServer()->IsSuspended();
+    if (! is_suspended && Now() < suspend_deadline_) {
+        return;
+    }
+    suspend_timer_->Stop();
+    if (! is_suspended) {
+        fprintf(stderr, "[SwitchUpgrade] Error: the connections are not suspended in %d seconds\n", HANDOFF_TIMEOUT);
+    } else if (HandOver(channel_fd_)) {
+        printf("[SwitchUpgrade] handed over to the new process, exit\n");
+        switch_server_->QuitForUpgrade();  // no return
+    }
+    fprintf(stderr, "[SwitchUpgrade] Error: failed to hand over, continue serving\n");
+    close(channel_fd_);
+    channel_fd_ = -1;
+    Resume();
+}
+
+bool SwitchUpgrade::HandOver(int channel_fd)
+{
+    auto context = switch_server_->GetContext();
+    // queued frames go along with the tx buffer, appended only while the server is suspended
+    for (auto& [_, ep] : context->endpoints) {
+        ep->GetOutputQueue().Flush();
+    }
+    auto session_store = switch_server_->GetSessionStore();
+    if (session_store) {
+        session_store->WriteSnapshot();
+    }
+
+    vector<int> fds;
+    string state = EncodeState(fds);
+    uint32_t state_len = state.size();
+    if (! write_all(channel_fd, (const char*)&state_len, sizeof(state_len)) ||
+            ! write_all(channel_fd, state.data(), state.size())) {
+        return false;
+    }
+    for (size_t i = 0; i < fds.size(); i += MAX_FDS_PER_MESSAGE) {
+        size_t n = std::min(MAX_FDS_PER_MESSAGE, fds.size() - i);
+        if (! send_fds(channel_fd, &fds[i], n)) {
+            return false;
+        }
+    }
+    printf("[SwitchUpgrade] sent state: %d bytes, fds: %ld, waiting for ack\n", state_len, fds.size());
+
+    char ack = 0;
+    return read_all(channel_fd, &ack, 1) && ack == HANDOFF_ACK;
+}
+
+string SwitchUpgrade::EncodeState(vector<int>& fds) const
+{
+    auto context = switch_server_->GetContext();
+    auto config = context->Config();
+
+    string state;
+    put_value<uint32_t>(state, HANDOFF_MAGIC);
+    put_value<uint16_t>(state, HANDOFF_VERSION);
+    put_string(state, config->access_code);
+    put_string(state, config->admin_code);
+    put_string(state, config->service_access_code);
+    put_value<uint8_t>(state, (uint8_t)config->serving_mode);
+
+    fds.push_back(switch_server_->GetTcpServer()->FD());
+    put_value<uint32_t>(state, context->endpoints.size() + context->pending_clients.size());
+    for (auto& [ep_id, ep] : context->endpoints) {
+        auto conn = ep->Connection();
+        fds.push_back(conn->FD());
+        put_value<uint32_t>(state, ep_id);
+        EndpointSession::FromEndpoint(ep.get()).EncodeTo(state);
+        put_string(state, conn->RxPendingData());
+        put_string(state, conn->TxPendingData());
+    }
+    for (auto& [_, conn] : context->pending_clients) {
+        fds.push_back(conn->FD());
+        put_value<uint32_t>(state, 0);
+        put_string(state, conn->RxPendingData());
+        put_string(state, conn->TxPendingData());
+    }
+    return state;
+}
+
+void SwitchUpgrade::Resume()
+{
+    // the reading disabled by the rate limiter stays disabled
+    switch_server_->GetTcpServer()->Resume();
+}
+
+static bool decode_state(const string& state, HandoffState& handoff)
+{
+    const char* data = state.data();
+    const char* end = data + state.size();
+    uint32_t magic = 0;
+    uint16_t version = 0;
+    uint8_t serving_mode = 0;
+    uint32_t n_conns = 0;
+    if (! get_value(data, end, magic) || magic != HANDOFF_MAGIC ||
+            ! get_value(data, end, version) || version != HANDOFF_VERSION) {
+        return false;
+    }
+    auto& config = handoff.config;
+    if (! get_string(data, end, config.access_code) || ! get_string(data, end, config.admin_code) ||
+            ! get_string(data, end, config.service_access_code) || ! get_value(data, end, serving_mode) ||
+            ! get_value(data, end, n_conns)) {
+        return false;
+    }
+    config.serving_mode = (EServingMode)serving_mode;
+
+    handoff.conns.resize(n_conns);
+    for (auto& conn : handoff.conns) {
+        if (! get_value(data, end, conn.id)) {
+            return false;
+        }
+        if (conn.id != 0 && ! conn.session.DecodeFrom(data, end)) {
+            return false;
+        }
+        if (! get_string(data, end, conn.rx_pending) || ! get_string(data, end, conn.tx_pending)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+HandoffStatePtr SwitchUpgrade::TakeOver(const string& socket_path)
+{
+    struct sockaddr_un addr;
+    int fd = open_unix_socket(socket_path, addr);
+    if (fd < 0) {
+        return nullptr;
+    }
+    auto handoff = std::make_shared<HandoffState>();
+    handoff->channel_fd = fd;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "[SwitchUpgrade] Error: can not connect to %s: %s\n", socket_path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    set_socket_timeout(fd, HANDOFF_TIMEOUT);
+
+    uint32_t state_len = 0;
+    string state;
+    if (! read_all(fd, (char*)&state_len, sizeof(state_len))) {
+        fprintf(stderr, "[SwitchUpgrade] Error: failed to receive state\n");
+        return nullptr;
+    }
+    state.resize(state_len);
+    if (! read_all(fd, state.data(), state_len) || ! decode_state(state, *handoff)) {
+        fprintf(stderr, "[SwitchUpgrade] Error: failed to receive state or the state is invalid\n");
+        return nullptr;
+    }
+
+    vector<int> fds;
+    size_t n_fds = 1 + handoff->conns.size();
+    while (fds.size() < n_fds) {
+        if (recv_fds(fd, fds) <= 0) {
+            fprintf(stderr, "[SwitchUpgrade] Error: failed to receive fds, received: %ld, expected: %ld\n",
+                    fds.size(), n_fds);
+            for (auto received_fd : fds) {
+                close(received_fd);
+            }
+            return nullptr;
+        }
+    }
+    handoff->listen_fd = fds[0];
+    for (size_t i = 0; i < handoff->conns.size(); i++) {
+        handoff->conns[i].fd = fds[i + 1];
+    }
+    printf("[SwitchUpgrade] took over the listening socket and %ld connections\n", handoff->conns.size());
+    return handoff;
+}
+
+void SwitchUpgrade::Adopt(SwitchServer* server, const HandoffStatePtr& handoff)
+{
+    auto context = server->GetContext();
+    auto service = server->GetService();
+    context->UpdateConfig(std::make_shared<SwitchConfig>(handoff->config));
+
+    for (auto& handoff_conn : handoff->conns) {
+        auto conn = server->GetTcpServer()->AdoptConnection(handoff_conn.fd, handoff_conn.rx_pending,
+                handoff_conn.tx_pending);
+        server->GetWatchdog()->Watch(conn);
+        if (handoff_conn.id == 0) {
+            context->pending_clients.insert(std::make_pair(conn->FD(), conn));
+        } else {
+            service->adopt_endpoint(conn, handoff_conn.session);
+        }
+    }
+    handoff->Ack();
+}
+
+#endif  // USE_UPGRADE
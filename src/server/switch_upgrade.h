@@ -0,0 +1,82 @@
+#ifndef _SWITCH_UPGRADE_H
+#define _SWITCH_UPGRADE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "switch_config.h"
+#include "switch_session_store.h"
+
+using std::string;
+using std::vector;
+
+namespace evt_loop {
+    class TcpConnection;
+    class PeriodicTimer;
+}
+using evt_loop::TcpConnection;
+
+class SwitchServer;
+class UpgradeListenEvent;
+
+// A client connection handed over by the old process
+struct HandoffConnection {
+    int             fd = -1;
+    EndpointId      id = 0;         // 0 if not registered yet
+    EndpointSession session;        // valid if id is not 0
+    string          rx_pending;     // received but not yet parsed bytes
+    string          tx_pending;     // buffered but not yet sent bytes
+};
+
+struct HandoffState {
+    int             channel_fd = -1;    // the unix socket to the old process, for the ack
+    int             listen_fd = -1;
+    SwitchConfig    config;
+    vector<HandoffConnection> conns;
+
+    ~HandoffState();
+    void Ack();     // let the old process exit
+};
+using HandoffStatePtr = std::shared_ptr<HandoffState>;
+
+// Zero-downtime upgrade of the switch binary.
+// The running process listens on a unix socket, a new process started with --upgrade
+// connects to it, the old process suspends its TcpServer (no accept, receive or send) and
+// once the requests in flight completed, passes its listening socket and all client sockets
+// with SCM_RIGHTS, along with the serialized routing state and the partial read/write buffers
+// of connections. After the new process adopted them and acked, the old process exits
+// without closing the connections.
+// The hooks it needs are of the io_uring EventLoop of ../uring only, so USE_UPGRADE needs
+// USE_IO_URING: TcpServer::Suspend/IsSuspended/Resume, a TcpServer constructor taking a
+// listening fd, TcpServer::AdoptConnection(fd, rx_pending, tx_pending) and
+// TcpConnection::RxPendingData()/TxPendingData().
+class SwitchUpgrade {
+public:
+    SwitchUpgrade(SwitchServer* server, const string& socket_path);
+    ~SwitchUpgrade();
+
+    bool Listen();
+
+    // called by the new process before initializing its TcpServer
+    static HandoffStatePtr TakeOver(const string& socket_path);
+    static void Adopt(SwitchServer* server, const HandoffStatePtr& state);
+
+private:
+    friend class UpgradeListenEvent;
+    void OnTakeOverRequest();
+    void OnSuspendTimer();
+    bool HandOver(int channel_fd);
+    string EncodeState(vector<int>& fds) const;
+    void Resume();
+
+private:
+    SwitchServer*       switch_server_;
+    string              socket_path_;
+    UpgradeListenEvent* listen_event_ = nullptr;
+    int                 channel_fd_ = -1;       // to the new process, while handing over
+    time_t              suspend_deadline_ = 0;
+    evt_loop::PeriodicTimer* suspend_timer_ = nullptr;
+};
+using SwitchUpgradePtr = std::shared_ptr<SwitchUpgrade>;
+
+#endif  // _SWITCH_UPGRADE_H
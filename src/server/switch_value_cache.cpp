@@ -0,0 +1,84 @@
+#include "switch_value_cache.h"
+
+bool ValueCache::Update(MessageId msg_type, uint32_t key, EndpointId source, const string& frame,
+        int64_t deadline, size_t max_bytes)
+{
+    auto& values = values_[msg_type];
+    auto iter = values.find(key);
+    if (iter != values.end()) {
+        auto& value = iter->second;
+        cached_bytes_ = cached_bytes_ - value.frame.size() + frame.size();
+        value.source = source;
+        value.frame = frame;
+        value.deadline = deadline;
+        return true;
+    }
+    if (max_bytes > 0 && cached_bytes_ + frame.size() > max_bytes) {
+        if (values.empty()) {
+            values_.erase(msg_type);
+        }
+        if (! is_full_) {
+            is_full_ = true;
+            refused_values_ = 0;
+        }
+        refused_values_++;
+        return false;
+    }
+    is_full_ = false;
+    values.emplace(key, Value{ key, source, frame, deadline });
+    cached_values_++;
+    cached_bytes_ += frame.size();
+    return true;
+}
+
+void ValueCache::Remove(MessageId msg_type)
+{
+    auto iter = values_.find(msg_type);
+    if (iter == values_.end()) {
+        return;
+    }
+    for (auto& [_, value] : iter->second) {
+        cached_values_--;
+        cached_bytes_ -= value.frame.size();
+    }
+    values_.erase(iter);
+}
+
+void ValueCache::RetainOnly(const set<MessageId>& msg_types)
+{
+    vector<MessageId> removing;
+    for (auto& [msg_type, _] : values_) {
+        if (! msg_types.contains(msg_type)) {
+            removing.push_back(msg_type);
+        }
+    }
+    for (auto msg_type : removing) {
+        Remove(msg_type);
+    }
+}
+
+vector<const ValueCache::Value*> ValueCache::Lookup(MessageId msg_type, int64_t now)
+{
+    vector<const Value*> result;
+    auto iter = values_.find(msg_type);
+    if (iter == values_.end()) {
+        return result;
+    }
+    auto& values = iter->second;
+    for (auto value_iter = values.begin(); value_iter != values.end(); ) {
+        auto& value = value_iter->second;
+        if (value.deadline > 0 && value.deadline <= now) {
+            // the latest value is outdated, nothing to offer for the key
+            cached_values_--;
+            cached_bytes_ -= value.frame.size();
+            value_iter = values.erase(value_iter);
+            continue;
+        }
+        result.push_back(&value);
+        ++value_iter;
+    }
+    if (values.empty()) {
+        values_.erase(iter);
+    }
+    return result;
+}
@@ -0,0 +1,55 @@
+#ifndef _SWITCH_VALUE_CACHE_H
+#define _SWITCH_VALUE_CACHE_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+#include "switch_types.h"
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+// Last-value cache of published messages.
+// For the message types enabled in SwitchConfig.cached_messages, the latest frame per
+// (msg_type, key) is kept, the key comes from PublishingExtension, 0 if not given.
+// A new subscriber of the message type receives the cached frames right after the ack
+// of SUB, instead of waiting for the next publish. Only the newest value of a key is
+// kept, so the snapshot is conflated by nature.
+class ValueCache {
+public:
+    struct Value {
+        uint32_t    key;
+        EndpointId  source;
+        string      frame;      // the network frame as forwarded to subscribers
+        int64_t     deadline;   // monotonic milliseconds, 0 for never expire
+    };
+
+    ValueCache() {}
+
+    // returns false if the cache is full and the key is new, the cache stays full until
+    // a new key fits again, counting the keys refused meanwhile
+    bool Update(MessageId msg_type, uint32_t key, EndpointId source, const string& frame,
+            int64_t deadline, size_t max_bytes);
+    void Remove(MessageId msg_type);
+    void RetainOnly(const set<MessageId>& msg_types);  // drop the types disabled by reload
+    vector<const Value*> Lookup(MessageId msg_type, int64_t now);
+
+    size_t CachedValues() const { return cached_values_; }
+    size_t CachedBytes() const { return cached_bytes_; }
+    bool IsFull() const { return is_full_; }
+    size_t RefusedValues() const { return refused_values_; }  // since the cache became full
+
+private:
+    map<MessageId, map<uint32_t, Value>> values_;   // msg_type -> key -> value
+    size_t  cached_values_ = 0;
+    size_t  cached_bytes_ = 0;
+    bool    is_full_ = false;
+    size_t  refused_values_ = 0;
+};
+using ValueCachePtr = std::shared_ptr<ValueCache>;
+
+#endif  // _SWITCH_VALUE_CACHE_H
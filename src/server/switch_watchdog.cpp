@@ -0,0 +1,138 @@
+#include "switch_watchdog.h"
+#include <stdio.h>
+#include <algorithm>
+#include <eventloop/el.h>
+#include "switch_context.h"
+#include "utils/time.h"
+
+using namespace evt_loop;
+
+// the liveness of connections is still checked this often while heartbeat_timeout and idle_timeout
+// are disabled, so enabling them by RELOAD covers the connections made before
+static const uint32_t DISABLED_CHECK_INTERVAL = 30;
+
+ConnectionWatchdog::ConnectionWatchdog(SwitchContext* context)
+    : context_(context), start_ms_(coarse_monotonic_milliseconds())
+{
+}
+
+ConnectionWatchdog::~ConnectionWatchdog()
+{
+    if (tick_timer_) {
+        tick_timer_->Stop();
+        delete tick_timer_;
+        tick_timer_ = nullptr;
+    }
+}
+
+void ConnectionWatchdog::Start()
+{
+    if (! tick_timer_) {
+        tick_timer_ = new PeriodicTimer(TimeVal(0, TICK_MS * 1000), [this](auto*) { OnTick(); });
+        tick_timer_->Start();
+    }
+}
+
+int64_t ConnectionWatchdog::NowMs() const
+{
+    return coarse_monotonic_milliseconds();
+}
+
+void ConnectionWatchdog::Watch(TcpConnection* conn)
+{
+    auto [iter, is_new] = serials_.emplace(conn->FD(), ++next_serial_);
+    if (! is_new) {
+        return;
+    }
+    auto& config = context_->Config();
+    Check check;
+    check.conn = conn;
+    check.fd = conn->FD();
+    check.serial = iter->second;
+    check.rx_bytes = conn->StatsRxBytes();
+    check.rx_changed_ms = NowMs();
+    if (config->register_timeout > 0) {
+        check.kind = ECheck::REGISTER;
+        wheel_.Schedule(ToTicks(config->register_timeout), check);
+    }
+    check.kind = ECheck::LIVENESS;
+    ScheduleLiveness(check, *config);
+}
+
+void ConnectionWatchdog::Forget(TcpConnection* conn)
+{
+    // the checks scheduled for it are dropped as they come up
+    serials_.erase(conn->FD());
+}
+
+void ConnectionWatchdog::ScheduleLiveness(Check& check, const SwitchConfig& config)
+{
+    uint32_t interval = DISABLED_CHECK_INTERVAL;
+    if (config.heartbeat_timeout > 0) {
+        interval = config.heartbeat_timeout;
+    }
+    if (config.idle_timeout > 0) {
+        interval = std::min(interval, config.idle_timeout);
+    }
+    wheel_.Schedule(ToTicks(interval), check);
+}
+
+void ConnectionWatchdog::OnTick()
+{
+    uint64_t now_tick = (NowMs() - start_ms_) / TICK_MS;
+    wheel_.Advance(now_tick, [this](Check& check) { OnCheck(check); });
+}
+
+void ConnectionWatchdog::OnCheck(Check& check)
+{
+    auto iter = serials_.find(check.fd);
+    if (iter == serials_.end() || iter->second != check.serial) {
+        return;  // closed, or the fd is of another connection now
+    }
+    auto conn = check.conn;
+    auto& config = context_->Config();
+    auto now_ms = NowMs();
+
+    if (check.kind == ECheck::REGISTER) {
+        auto pending = context_->pending_clients.find(check.fd);
+        if (pending != context_->pending_clients.end() && pending->second == conn) {
+            printf("[ConnectionWatchdog] not registered in %u seconds, disconnect, fd: %d\n",
+                    config->register_timeout, check.fd);
+            conn->Disconnect();
+        }
+        return;
+    }
+
+    auto ep_iter = context_->endpoints.find(conn->ID());
+    Endpoint* ep = nullptr;
+    if (ep_iter != context_->endpoints.end() && ep_iter->second->Connection() == conn) {
+        ep = ep_iter->second.get();
+    }
+    if (ep && ep->IsReadingPaused()) {
+        // Switch stopped reading it (rate limit, backpressure), its silence is not its fault,
+        // both timeouts count again from the resume
+        check.rx_bytes = conn->StatsRxBytes();
+        check.rx_changed_ms = now_ms;
+        ep->SetLastMessageTime(now_ms);
+        ScheduleLiveness(check, *config);
+        return;
+    }
+
+    auto rx_bytes = conn->StatsRxBytes();
+    if (rx_bytes != check.rx_bytes) {
+        check.rx_bytes = rx_bytes;
+        check.rx_changed_ms = now_ms;
+    } else if (config->heartbeat_timeout > 0 && now_ms - check.rx_changed_ms >= (int64_t)config->heartbeat_timeout * 1000) {
+        printf("[ConnectionWatchdog] nothing received in %u seconds, disconnect, fd: %d, id: %d\n",
+                config->heartbeat_timeout, check.fd, conn->ID());
+        conn->Disconnect();
+        return;
+    }
+    if (config->idle_timeout > 0 && ep &&
+            now_ms - ep->GetLastMessageTime() >= (int64_t)config->idle_timeout * 1000) {
+        printf("[ConnectionWatchdog] idle for %u seconds, disconnect, id: %d\n", config->idle_timeout, conn->ID());
+        conn->Disconnect();
+        return;
+    }
+    ScheduleLiveness(check, *config);
+}
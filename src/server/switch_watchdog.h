@@ -0,0 +1,66 @@
+#ifndef _SWITCH_WATCHDOG_H
+#define _SWITCH_WATCHDOG_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include "utils/timer_wheel.h"
+
+namespace evt_loop {
+    class TcpConnection;
+    class PeriodicTimer;
+}
+using evt_loop::TcpConnection;
+
+struct SwitchContext;
+struct SwitchConfig;
+
+// Closes the dead and idle connections, all of them checked on one timer wheel driven by
+// one timer, instead of a timer per connection:
+//   - a connection not registered within register_timeout
+//   - a connection receiving nothing, heartbeats included, within heartbeat_timeout
+//   - an endpoint sending no message, heartbeats excluded, within idle_timeout
+// The timeouts are of SwitchConfig, in seconds, 0 disables; a reloaded value applies from the
+// next check of a connection. Nothing is done per message except the timestamp of endpoint.
+// An endpoint whose reading is paused by Switch is not checked until it is resumed.
+class ConnectionWatchdog {
+public:
+    static const int64_t TICK_MS = 100;
+
+    ConnectionWatchdog(SwitchContext* context);
+    ~ConnectionWatchdog();
+
+    void Start();
+    void Watch(TcpConnection* conn);    // once per connection, the repeated calls are ignored
+    void Forget(TcpConnection* conn);
+    size_t Watched() const { return serials_.size(); }
+
+    void OnTick();
+
+private:
+    enum class ECheck : uint8_t { REGISTER, LIVENESS };
+    struct Check {
+        TcpConnection*  conn = nullptr;
+        int             fd = -1;
+        uint32_t        serial = 0;     // tells a reused fd from the connection scheduled
+        ECheck          kind = ECheck::LIVENESS;
+        uint64_t        rx_bytes = 0;   // of the connection, at the last change
+        int64_t         rx_changed_ms = 0;
+    };
+
+    void OnCheck(Check& check);
+    void ScheduleLiveness(Check& check, const SwitchConfig& config);
+    uint64_t ToTicks(uint32_t seconds) const { return ((uint64_t)seconds * 1000 + TICK_MS - 1) / TICK_MS; }
+    int64_t NowMs() const;
+
+private:
+    SwitchContext*                      context_;
+    TimerWheel<Check>                   wheel_;
+    evt_loop::PeriodicTimer*            tick_timer_ = nullptr;
+    std::unordered_map<int, uint32_t>   serials_;   // fd -> serial of the connection watched
+    uint32_t                            next_serial_ = 0;
+    int64_t                             start_ms_;
+};
+typedef std::shared_ptr<ConnectionWatchdog> ConnectionWatchdogPtr;
+
+#endif  // _SWITCH_WATCHDOG_H
@@ -0,0 +1,259 @@
+#ifndef _SIM_EVENTLOOP_EL_H
+#define _SIM_EVENTLOOP_EL_H
+
+// In-memory stand-in of EventLoop for the routing simulation (see ../switch_sim.cpp).
+// It covers what the switch uses, with the same names, so the sources of server are
+// compiled unchanged against it: connections are buffers instead of sockets, frames
+// are injected by SimNetwork, timers never fire and the loop never runs.
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+namespace evt_loop {
+
+const size_t DUMP_MAX_BYTES = 64;
+
+inline string DumpHex(const char* data, size_t len, size_t max_len=0)
+{
+    std::stringstream ss;
+    size_t n = max_len > 0 && max_len < len ? max_len : len;
+    char buf[4];
+    for (size_t i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "%02x ", (uint8_t)data[i]);
+        ss << buf;
+    }
+    return ss.str();
+}
+inline string DumpHex(const string& data, size_t max_len=0) { return DumpHex(data.data(), data.size(), max_len); }
+inline string DumpHexWithChars(const char* data, size_t len, size_t max_len=0) { return DumpHex(data, len, max_len); }
+inline string DumpHexWithChars(const string& data, size_t max_len=0) { return DumpHex(data, max_len); }
+
+inline time_t Now() { return time(nullptr); }
+
+struct TimeVal {
+    long sec;
+    long usec;
+    TimeVal(long s=0, long us=0) : sec(s), usec(us) {}
+};
+
+enum class MessageType { CUSTOM, BINARY };
+
+class Message {
+    public:
+    Message(const string& data) : data_(data) {}
+    const string& Data() const { return data_; }
+    size_t Size() const { return data_.size(); }
+    size_t PayloadSize() const { return data_.size(); }
+    string DumpHexWithChars(size_t max_len) const { return evt_loop::DumpHexWithChars(data_, max_len); }
+
+    private:
+    string data_;
+};
+
+struct HeaderDescription {
+    size_t hdr_len = 0;
+    size_t payload_len_offset = 0;
+    size_t payload_len_bytes = 0;
+    bool   is_payload_len_including_self = false;
+    string heartbeat_request;
+    string heartbeat_response;
+
+    string ToString() const {
+        std::stringstream ss;
+        ss << "{hdr_len: " << hdr_len << ", payload_len_offset: " << payload_len_offset
+            << ", payload_len_bytes: " << payload_len_bytes << "}";
+        return ss.str();
+    }
+};
+using HeaderDescriptionPtr = std::shared_ptr<HeaderDescription>;
+
+class IOEvent {
+    public:
+    static const uint32_t READ = 1;
+    static const uint32_t WRITE = 2;
+    IOEvent(uint32_t events=READ) {}
+    virtual ~IOEvent() {}
+    void SetFD(int fd) { fd_ = fd; }
+    int FD() const { return fd_; }
+    virtual void OnEvents(uint32_t events) = 0;
+    void EnableReading() {}
+    void DisableReading() {}
+
+    private:
+    int fd_ = -1;
+};
+
+class TcpConnection;
+struct TcpCallbacks {
+    std::function<void(TcpConnection*, const Message*)> on_msg_recvd_cb;
+    std::function<void(TcpConnection*, const Message*)> on_msg_sent_cb;
+    std::function<void(TcpConnection*)> on_conn_ready_cb;
+    std::function<void(TcpConnection*)> on_closed_cb;
+};
+using TcpCallbacksPtr = std::shared_ptr<TcpCallbacks>;
+
+// The frames sent to a connection are appended to its tx buffer, the simulation takes
+// them out with TakeTxData(). TxBufferSize() is what is not taken yet, so a slow
+// virtual endpoint is a connection whose buffer is taken rarely.
+class TcpConnection {
+    public:
+    TcpConnection(int fd, TcpCallbacksPtr cbs) : fd_(fd), cbs_(cbs) {}
+
+    int FD() const { return fd_; }
+    uint32_t ID() const { return id_; }
+    void SetID(uint32_t id) { id_ = id; }
+
+    void Send(const string& data) { Send(data.data(), data.size()); }
+    void Send(const char* data, size_t len) {
+        if (is_closed_) {
+            return;
+        }
+        tx_data_.append(data, len);
+        tx_bytes_ += len;
+    }
+    void Disconnect() {
+        if (is_closed_) {
+            return;
+        }
+        is_closed_ = true;
+        if (cbs_ && cbs_->on_closed_cb) {
+            cbs_->on_closed_cb(this);
+        }
+    }
+    bool IsClosed() const { return is_closed_; }
+
+    size_t StatsRxBytes() const { return rx_bytes_; }
+    size_t StatsTxBytes() const { return tx_bytes_; }
+    size_t TxBufferSize() const { return tx_data_.size(); }
+    void EnableReading() { is_reading_ = true; }
+    void DisableReading() { is_reading_ = false; }
+    bool IsReading() const { return is_reading_; }
+
+    // for SimNetwork
+    void Receive(const string& frame) {
+        rx_bytes_ += frame.size();
+        Message msg(frame);
+        cbs_->on_msg_recvd_cb(this, &msg);
+    }
+    string TakeTxData() {
+        string data;
+        data.swap(tx_data_);
+        if (! data.empty() && cbs_->on_msg_sent_cb) {
+            cbs_->on_msg_sent_cb(this, nullptr);  // drained
+        }
+        return data;
+    }
+
+    private:
+    int     fd_;
+    uint32_t id_ = 0;
+    TcpCallbacksPtr cbs_;
+    string  tx_data_;
+    size_t  rx_bytes_ = 0;
+    size_t  tx_bytes_ = 0;
+    bool    is_reading_ = true;
+    bool    is_closed_ = false;
+};
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+
+class TcpServer;
+
+// The registry of the simulated server and its connections
+class SimNetwork {
+    public:
+    static SimNetwork& Instance() {
+        static SimNetwork network;
+        return network;
+    }
+    TcpServer* Server() const { return server_; }
+    void SetServer(TcpServer* server) { server_ = server; }
+
+    private:
+    TcpServer* server_ = nullptr;
+};
+
+class TcpServer {
+    public:
+    TcpServer(const char* host, uint16_t port, MessageType type) { SimNetwork::Instance().SetServer(this); }
+
+    void SetMessageHeaderDescription(HeaderDescriptionPtr desc) { hdr_desc_ = desc; }
+    HeaderDescriptionPtr GetMessageHeaderDescription() const { return hdr_desc_; }
+    void SetTcpCallbacks(TcpCallbacksPtr cbs) { cbs_ = cbs; }
+    size_t GetConnectionNumber() const { return conns_.size(); }
+
+    // a new virtual client, announced to the switch as accepted
+    TcpConnection* Accept() {
+        conns_.push_back(std::make_unique<TcpConnection>(next_fd_++, cbs_));
+        auto conn = conns_.back().get();
+        if (cbs_->on_conn_ready_cb) {
+            cbs_->on_conn_ready_cb(conn);
+        }
+        return conn;
+    }
+
+    private:
+    HeaderDescriptionPtr hdr_desc_;
+    TcpCallbacksPtr cbs_;
+    std::vector<std::unique_ptr<TcpConnection>> conns_;   // kept until exit, the switch may hold them
+    int next_fd_ = 100;
+};
+using TcpServerPtr = std::shared_ptr<TcpServer>;
+
+class PeriodicTimer {
+    public:
+    PeriodicTimer(const TimeVal& interval, const std::function<void(PeriodicTimer*)>& cb) {}
+    void Start() { is_running_ = true; }
+    void Stop() { is_running_ = false; }
+    bool IsRunning() const { return is_running_; }
+
+    private:
+    bool is_running_ = false;
+};
+
+class OneshotTimer {
+    public:
+    OneshotTimer(const TimeVal& interval, const std::function<void(OneshotTimer*)>& cb) {}
+    void Start() { is_running_ = true; }
+    void Stop() { is_running_ = false; }
+    bool IsRunning() const { return is_running_; }
+    void SetInterval(const TimeVal& interval) {}
+
+    private:
+    bool is_running_ = false;
+};
+
+enum class SignalEvent { INT, HUP, TERM, USR1, USR2 };
+class SignalHandler {
+    public:
+    SignalHandler(SignalEvent event, std::function<void(SignalHandler*, uint32_t)> cb) {}
+};
+
+class EventLoop {
+    public:
+    static EventLoop* Instance() {
+        static EventLoop loop;
+        return &loop;
+    }
+    void StartLoop() {}
+    void StopLoop() {}
+    void AddEvent(IOEvent* e) {}
+    void DeleteEvent(IOEvent* e) {}
+};
+
+}  // namespace evt_loop
+
+#define EV_Singleton (evt_loop::EventLoop::Instance())
+
+#endif  // _SIM_EVENTLOOP_EL_H
@@ -0,0 +1,26 @@
+#ifndef _SIM_EVENTLOOP_CONSOLE_H
+#define _SIM_EVENTLOOP_CONSOLE_H
+
+// the console of simulation takes no input, the commands are registered and never called
+#include <vector>
+#include "../el.h"
+
+namespace evt_loop {
+
+class Console {
+    public:
+    static void Initialize(const char* prompt, const char* history_file=nullptr) {}
+    static Console* Instance() {
+        static Console console;
+        return &console;
+    }
+    template <typename... Args> void put_line(Args... args) {}
+    template <typename... Args> void put_line_p(Args... args) {}
+    void destory() {}
+    void registerCommand(const char* name, const char* help,
+            std::function<int(const std::vector<std::string>&)> cb) {}
+};
+
+}  // namespace evt_loop
+
+#endif  // _SIM_EVENTLOOP_CONSOLE_H
@@ -0,0 +1,481 @@
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "switch_sim.h"
+#include "command_messages.h"
+#include "switch_context.h"
+
+RoutingSimulation::RoutingSimulation(const SimParams& params) :
+    params_(params), server_("127.0.0.1", 0),
+    network_(SimNetwork::Instance().Server()), rng_(params.seed)
+{
+    // a small tx buffer, so the slow endpoints overflow into the lanes of OutputQueue
+    auto context = server_.GetContext();
+    auto config = std::make_shared<SwitchConfig>(*context->Config());
+    config->tx_watermark = 4 * 1024;
+    context->UpdateConfig(config);
+}
+
+uint64_t RoutingSimulation::Run()
+{
+    clients_.resize(params_.endpoints);
+    for (size_t i = 0; i < clients_.size(); i++) {
+        auto& client = clients_[i];
+        client.id = i + 1;
+        client.is_slow = rng_() % 100 < params_.slow_percent;
+        client_index_[client.id] = i;
+        client.conn = network_->Accept();
+        Register(client);
+    }
+    CollectAll(true);
+
+    if (params_.is_bench) {
+        RunBenchmark();
+    } else {
+        RunWorkload();
+        RunRestart();
+    }
+    return violations_;
+}
+
+void RoutingSimulation::RunWorkload()
+{
+    for (auto& client : clients_) {
+        Subscribe(client, RandomMessages(params_.subscriptions));
+    }
+    CollectAll(true);
+
+    for (uint32_t step = 0; step < params_.steps; step++) {
+        auto& client = clients_[rng_() % clients_.size()];
+        uint32_t op = rng_() % 100;
+        if (op < 60) {
+            Publish(client, rng_() % params_.message_types + 1);
+        } else if (op < 70) {
+            // one or two groups, which may share members
+            vector<GroupId> groups = { (GroupId)(rng_() % params_.groups + 1) };
+            if (rng_() % 2 == 0) {
+                groups.push_back(rng_() % params_.groups + 1);
+            }
+            PublishToGroups(client, groups);
+        } else if (op < 80) {
+            Subscribe(client, RandomMessages(1));
+        } else if (op < 87) {
+            if (! client.subs_messages.empty()) {
+                auto iter = client.subs_messages.begin();
+                std::advance(iter, rng_() % client.subs_messages.size());
+                Unsubscribe(client, { *iter });
+            }
+        } else if (op < 92) {
+            Join(client, rng_() % params_.groups + 1);
+        } else if (op < 95) {
+            if (! client.groups.empty()) {
+                auto iter = client.groups.begin();
+                std::advance(iter, rng_() % client.groups.size());
+                Leave(client, *iter);
+            }
+        } else {
+            Reconnect(client);
+        }
+        // the slow ones read their frames one step in sixteen
+        CollectAll(step % 16 == 0);
+    }
+    CollectAll(true);
+
+    for (auto& client : clients_) {
+        if (! client.expected_seqs.empty()) {
+            Fail(client, "%ld publishes not delivered, first seq: %lu",
+                    client.expected_seqs.size(), client.expected_seqs.front());
+        }
+        if (! client.expected_results.empty()) {
+            Fail(client, "%ld commands not answered, first: %s",
+                    client.expected_results.size(), CommandToTag(client.expected_results.front().first));
+        }
+    }
+    fprintf(stderr, "[RoutingSimulation] endpoints: %u, steps: %u, publishes: %lu, routed frames: %lu, violations: %lu\n",
+            params_.endpoints, params_.steps, publish_seq_, routed_frames_, violations_);
+}
+
+void RoutingSimulation::RunBenchmark()
+{
+    for (auto& client : clients_) {
+        Subscribe(client, RandomMessages(params_.subscriptions));
+    }
+    CollectAll(true);
+
+    // the model is bypassed, the frames are taken without parsing, only the cost of switch is left
+    uint64_t routed_bytes = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (uint32_t step = 0; step < params_.steps; step++) {
+        auto& client = clients_[rng_() % clients_.size()];
+        PublishingMessage pub_msg;
+        pub_msg.msg_type = rng_() % params_.message_types + 1;
+        pub_msg.source = client.id;
+        string payload((char*)&pub_msg, sizeof(pub_msg));
+        payload.append((char*)&step, sizeof(step));
+        SendCommand(client, ECommand::PUBLISH_2, payload, false);
+        for (auto& target : clients_) {
+            routed_bytes += target.conn->TakeTxData().size();
+        }
+    }
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count();
+
+    fprintf(stderr, "[RoutingSimulation] endpoints: %u, message types: %u, subscriptions: %u, publishes: %u\n",
+            params_.endpoints, params_.message_types, params_.subscriptions, params_.steps);
+    fprintf(stderr, "[RoutingSimulation] elapsed: %.3f ms, per publish: %.0f ns, routed bytes: %lu\n",
+            elapsed_ns / 1e6, (double)elapsed_ns / std::max<uint32_t>(params_.steps, 1), routed_bytes);
+}
+
+void RoutingSimulation::RunRestart()
+{
+    char dir[] = "/tmp/switch_sim_XXXXXX";
+    if (! mkdtemp(dir)) {
+        perror("mkdtemp");
+        return;
+    }
+    auto options = std::make_shared<Options>();
+    options->host = "127.0.0.1";
+    options->session_store = string(dir) + "/sessions";
+
+    // a switch of its own, the clients of the workload stay with server_
+    const GroupId group = 1;
+    SimClient publisher, member;
+    publisher.id = 1;
+    member.id = 2;
+    map<EndpointId, string> tokens;
+    {
+        SwitchServer server(options);
+        auto network = SimNetwork::Instance().Server();
+        for (auto client : { &publisher, &member }) {
+            client->conn = network->Accept();
+            Register(*client);
+        }
+        CommandJoin join_cmd;
+        join_cmd.groups = { group };
+        SendCommand(member, ECommand::JOIN, join_cmd.encodeToJSON(), true);
+        member.expected_results.push_back({ ECommand::JOIN, -1 });
+        for (auto client : { &publisher, &member }) {
+            Collect(*client);
+            tokens[client->id] = server.GetContext()->endpoints[client->id]->GetToken();
+        }
+        server.GetSessionStore()->Close();
+    }
+
+    // both resume their sessions by token, without replaying any state
+    SwitchServer server(options);
+    auto network = SimNetwork::Instance().Server();
+    for (auto client : { &publisher, &member }) {
+        client->conn = network->Accept();
+        CommandRegister reg_cmd;
+        reg_cmd.id = client->id;
+        reg_cmd.role = (role_id_t)EEndpointRole::Normal;
+        reg_cmd.access_code = DEFAULT_ACCESS_TOKEN;
+        reg_cmd.token = tokens[client->id];
+        SendCommand(*client, ECommand::REG, reg_cmd.encodeToJSON(), true);
+        client->expected_results.push_back({ ECommand::REG, -1 });
+    }
+    uint64_t seq = ++publish_seq_;
+    PublishingMessage pub_msg;
+    pub_msg.source = publisher.id;
+    pub_msg.n_targets = 1;
+    string payload((char*)&pub_msg, sizeof(pub_msg));
+    ep_id_t target = GroupTarget(group);
+    payload.append((char*)&target, sizeof(target));
+    payload.append((char*)&seq, sizeof(seq));
+    SendCommand(publisher, ECommand::PUBLISH_2, payload, false);
+    publisher.expected_results.push_back({ ECommand::PUBLISH_2, 1 });
+    member.expected_seqs.push_back(seq);
+
+    for (auto client : { &publisher, &member }) {
+        Collect(*client);
+        if (! client->expected_seqs.empty()) {
+            Fail(*client, "publish to group %u not delivered after restart", group);
+        }
+        if (! client->expected_results.empty()) {
+            Fail(*client, "%ld commands not answered after restart", client->expected_results.size());
+        }
+    }
+    fprintf(stderr, "[RoutingSimulation] restart with the session store, violations: %lu\n", violations_);
+
+    server.GetSessionStore()->Close();
+    unlink((options->session_store + ".snapshot").c_str());
+    unlink((options->session_store + ".journal").c_str());
+    rmdir(dir);
+}
+
+void RoutingSimulation::Register(SimClient& client)
+{
+    CommandRegister reg_cmd;
+    reg_cmd.id = client.id;
+    reg_cmd.role = (role_id_t)EEndpointRole::Normal;
+    reg_cmd.access_code = DEFAULT_ACCESS_TOKEN;
+    SendCommand(client, ECommand::REG, reg_cmd.encodeToJSON(), true);
+    client.expected_results.push_back({ ECommand::REG, -1 });
+}
+
+void RoutingSimulation::Subscribe(SimClient& client, const vector<MessageId>& messages)
+{
+    CommandSubUnsubRejUnrej sub_cmd;
+    sub_cmd.messages.assign(messages.begin(), messages.end());
+    SendCommand(client, ECommand::SUB, sub_cmd.encodeToJSON(), true);
+    client.expected_results.push_back({ ECommand::SUB, -1 });
+    for (auto msg_type : messages) {
+        client.subs_messages.insert(msg_type);
+        subscribers_[msg_type].insert(client.id);
+    }
+}
+
+void RoutingSimulation::Unsubscribe(SimClient& client, const vector<MessageId>& messages)
+{
+    CommandSubUnsubRejUnrej unsub_cmd;
+    unsub_cmd.messages.assign(messages.begin(), messages.end());
+    SendCommand(client, ECommand::UNSUB, unsub_cmd.encodeToJSON(), true);
+    client.expected_results.push_back({ ECommand::UNSUB, -1 });
+    for (auto msg_type : messages) {
+        client.subs_messages.erase(msg_type);
+        auto iter = subscribers_.find(msg_type);
+        if (iter != subscribers_.end()) {
+            iter->second.erase(client.id);
+            if (iter->second.empty()) {
+                subscribers_.erase(iter);
+            }
+        }
+    }
+}
+
+void RoutingSimulation::Publish(SimClient& client, MessageId msg_type)
+{
+    uint64_t seq = ++publish_seq_;
+    PublishingMessage pub_msg;
+    pub_msg.msg_type = msg_type;
+    pub_msg.source = client.id;
+    string payload((char*)&pub_msg, sizeof(pub_msg));
+    payload.append((char*)&seq, sizeof(seq));
+
+    // the subscribers of msg_type, or everyone if nobody subscribes anything (broadcast)
+    int64_t total = 0;
+    auto add_target = [&](EndpointId ep_id) {
+        if (ep_id == client.id) {
+            return;
+        }
+        clients_[client_index_[ep_id]].expected_seqs.push_back(seq);
+        total++;
+    };
+    if (subscribers_.empty()) {
+        for (auto& target : clients_) {
+            add_target(target.id);
+        }
+    } else {
+        auto iter = subscribers_.find(msg_type);
+        if (iter != subscribers_.end()) {
+            for (auto ep_id : iter->second) {
+                add_target(ep_id);
+            }
+        }
+    }
+    SendCommand(client, ECommand::PUBLISH_2, payload, false);
+    client.expected_results.push_back({ ECommand::PUBLISH_2, total });
+}
+
+void RoutingSimulation::Join(SimClient& client, GroupId group)
+{
+    CommandJoin join_cmd;
+    join_cmd.groups = { group };
+    SendCommand(client, ECommand::JOIN, join_cmd.encodeToJSON(), true);
+    client.expected_results.push_back({ ECommand::JOIN, -1 });
+    client.groups.insert(group);
+    group_members_[group].insert(client.id);
+}
+
+void RoutingSimulation::Leave(SimClient& client, GroupId group)
+{
+    CommandLeave leave_cmd;
+    leave_cmd.groups = { group };
+    SendCommand(client, ECommand::LEAVE, leave_cmd.encodeToJSON(), true);
+    client.expected_results.push_back({ ECommand::LEAVE, -1 });
+    client.groups.erase(group);
+    group_members_[group].erase(client.id);
+}
+
+void RoutingSimulation::PublishToGroups(SimClient& client, const vector<GroupId>& groups)
+{
+    uint64_t seq = ++publish_seq_;
+    PublishingMessage pub_msg;
+    pub_msg.msg_type = 0;   // the subscriptions of members do not apply
+    pub_msg.source = client.id;
+    pub_msg.n_targets = groups.size();
+    string payload((char*)&pub_msg, sizeof(pub_msg));
+    for (auto group : groups) {
+        ep_id_t target = GroupTarget(group);
+        payload.append((char*)&target, sizeof(target));
+    }
+    payload.append((char*)&seq, sizeof(seq));
+
+    // the members of all the groups except the publisher, once each
+    set<EndpointId> targets;
+    for (auto group : groups) {
+        auto& members = group_members_[group];
+        targets.insert(members.begin(), members.end());
+    }
+    targets.erase(client.id);
+    for (auto ep_id : targets) {
+        clients_[client_index_[ep_id]].expected_seqs.push_back(seq);
+    }
+    SendCommand(client, ECommand::PUBLISH_2, payload, false);
+    client.expected_results.push_back({ ECommand::PUBLISH_2, (int64_t)targets.size() });
+}
+
+void RoutingSimulation::Reconnect(SimClient& client)
+{
+    client.conn->Disconnect();
+    for (auto msg_type : client.subs_messages) {
+        auto iter = subscribers_.find(msg_type);
+        if (iter != subscribers_.end()) {
+            iter->second.erase(client.id);
+            if (iter->second.empty()) {
+                subscribers_.erase(iter);
+            }
+        }
+    }
+    for (auto group : client.groups) {
+        group_members_[group].erase(client.id);
+    }
+    // what was not taken from the old connection is lost with it
+    client.subs_messages.clear();
+    client.groups.clear();
+    client.expected_seqs.clear();
+    client.expected_results.clear();
+
+    client.conn = network_->Accept();
+    Register(client);
+    Collect(client);
+}
+
+void RoutingSimulation::SendCommand(SimClient& client, ECommand cmd, const string& payload, bool is_json)
+{
+    CommandMessage cmdMsg;
+    cmdMsg.SetCommand(cmd);
+    if (is_json) {
+        cmdMsg.SetToJSON();
+    }
+    cmdMsg.SetPayloadLen(payload.size());
+    cmdMsg.ConvertToNetworkMessage(server_.IsMessagePayloadLengthIncludingSelf());
+
+    string frame((char*)&cmdMsg, sizeof(cmdMsg));
+    frame.append(payload);
+    client.conn->Receive(frame);
+}
+
+void RoutingSimulation::Collect(SimClient& client)
+{
+    bool is_including_self = server_.IsMessagePayloadLengthIncludingSelf();
+    for (string data = client.conn->TakeTxData(); ! data.empty(); data = client.conn->TakeTxData()) {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            if (data.size() - offset < CommandMessage::HeaderSize()) {
+                Fail(client, "truncated header, %ld bytes left", data.size() - offset);
+                break;
+            }
+            payload_size_t payload_len;
+            memcpy(&payload_len, data.data() + offset + CommandMessage::OffsetOfPayloadLen(), sizeof(payload_len));
+            size_t frame_size = CommandMessage::OffsetOfPayloadLen() + ntohs(payload_len) +
+                (is_including_self ? 0 : CommandMessage::PayloadLenBytes());
+            if (frame_size < CommandMessage::HeaderSize() || frame_size > data.size() - offset) {
+                Fail(client, "truncated frame, size: %ld, %ld bytes left", frame_size, data.size() - offset);
+                break;
+            }
+            auto cmdMsg = CommandMessage::FromNetworkData(data.data() + offset, frame_size, is_including_self);
+            if (! cmdMsg || ! cmdMsg->IsWellFormed(frame_size)) {
+                Fail(client, "malformed frame, size: %ld", frame_size);
+            } else {
+                OnFrame(client, cmdMsg, frame_size);
+            }
+            offset += frame_size;
+        }
+    }
+}
+
+void RoutingSimulation::CollectAll(bool is_including_slow)
+{
+    for (auto& client : clients_) {
+        if (is_including_slow || ! client.is_slow) {
+            Collect(client);
+        }
+    }
+}
+
+void RoutingSimulation::OnFrame(SimClient& client, CommandMessage* cmdMsg, size_t frame_size)
+{
+    client.received_frames++;
+    auto cmd = cmdMsg->Command();
+    if (cmdMsg->HasResponseFlag()) {
+        if (client.expected_results.empty() || client.expected_results.front().first != cmd) {
+            Fail(client, "unexpected RESULT of %s", CommandToTag(cmd));
+            return;
+        }
+        auto [expected_cmd, expected_total] = client.expected_results.front();
+        client.expected_results.pop_front();
+
+        auto result = cmdMsg->GetResultMessage();
+        string content(cmdMsg->GetResultMessageContent(), cmdMsg->GetResultMessageContentSize());
+        if (! result || result->errcode != 0) {
+            Fail(client, "RESULT of %s failed: %s", CommandToTag(cmd), content.c_str());
+            return;
+        }
+        if (expected_total >= 0) {
+            char expected[64];
+            snprintf(expected, sizeof(expected), "{\"total\": %ld}", expected_total);
+            if (content != expected) {
+                Fail(client, "RESULT of %s: %s, expected: %s", CommandToTag(cmd), content.c_str(), expected);
+            }
+        }
+        return;
+    }
+
+    if (cmd != ECommand::PUBLISH_2) {
+        Fail(client, "unexpected %s", CommandToTag(cmd));
+        return;
+    }
+    routed_frames_++;
+    auto [payload, payload_len] = cmdMsg->Payload();   // after the routing headers
+    uint64_t seq = 0;
+    if (payload_len != sizeof(seq)) {
+        Fail(client, "PUBLISH_2 with content of %d bytes, expected: %ld", payload_len, sizeof(seq));
+        return;
+    }
+    memcpy(&seq, payload, sizeof(seq));
+    if (client.expected_seqs.empty()) {
+        Fail(client, "unexpected publish, seq: %lu", seq);
+    } else if (client.expected_seqs.front() != seq) {
+        Fail(client, "publish out of order or duplicated, seq: %lu, expected: %lu", seq, client.expected_seqs.front());
+    } else {
+        client.expected_seqs.pop_front();
+    }
+}
+
+vector<MessageId> RoutingSimulation::RandomMessages(uint32_t n)
+{
+    vector<MessageId> messages;
+    for (uint32_t i = 0; i < n; i++) {
+        messages.push_back(rng_() % params_.message_types + 1);
+    }
+    return messages;
+}
+
+void RoutingSimulation::Fail(const SimClient& client, const char* fmt, ...)
+{
+    violations_++;
+    if (violations_ > 20) {
+        return;  // the first ones tell enough
+    }
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    fprintf(stderr, "[RoutingSimulation] violation, id: %d: %s\n", client.id, buf);
+}
@@ -0,0 +1,95 @@
+#ifndef _SWITCH_SIM_H
+#define _SWITCH_SIM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <random>
+#include "switch_server.h"
+
+using std::string;
+using std::vector;
+using std::deque;
+using std::map;
+using std::set;
+
+struct SimParams {
+    uint32_t endpoints = 1000;          // virtual endpoints
+    uint32_t message_types = 50;
+    uint32_t subscriptions = 5;         // initial subscriptions per endpoint
+    uint32_t groups = 20;
+    uint32_t steps = 20000;             // operations of the randomized workload
+    uint32_t seed = 1;
+    uint32_t slow_percent = 10;         // the endpoints reading their frames only now and then
+    bool     is_bench = false;          // publishing only, without checking the deliveries
+};
+
+// A virtual endpoint: a simulated connection, the subscriptions of the model,
+// and the frames it should receive next, in order.
+struct SimClient {
+    EndpointId      id = 0;
+    TcpConnection*  conn = nullptr;
+    bool            is_slow = false;
+    set<MessageId>  subs_messages;
+    set<GroupId>    groups;
+    deque<uint64_t> expected_seqs;      // of the publishes routed to it, in publishing order
+    deque<std::pair<ECommand, int64_t>> expected_results;   // command, total of targets or -1
+    uint64_t        received_frames = 0;
+};
+
+// Deterministic in-process simulation of routing: SwitchServer with its CommandHandler and
+// SwitchService runs over the in-memory EventLoop (sim/eventloop), virtual endpoints send
+// REG/SUB/UNSUB/JOIN/LEAVE/PUBLISH_2 frames into it and take the frames it sends back. Checks:
+//   - each command is answered by one RESULT with errcode 0
+//   - a publish reaches exactly the subscribers of its type except the publisher, once each,
+//     and the total in its RESULT agrees; the same for a publish to groups and their members
+//   - a target receives the publishes in publishing order, the slow ones included
+//   - after a restart of switch with the session store, the resumed endpoints are back in
+//     their groups, a publish to a group reaches the members joined before the restart
+// The bench mode publishes only and reports the routing cost per frame, without I/O.
+class RoutingSimulation {
+public:
+    RoutingSimulation(const SimParams& params);
+
+    uint64_t Run();     // returns the number of violations
+    uint64_t Violations() const { return violations_; }
+
+private:
+    void Register(SimClient& client);
+    void Subscribe(SimClient& client, const vector<MessageId>& messages);
+    void Unsubscribe(SimClient& client, const vector<MessageId>& messages);
+    void Publish(SimClient& client, MessageId msg_type);
+    void Join(SimClient& client, GroupId group);
+    void Leave(SimClient& client, GroupId group);
+    void PublishToGroups(SimClient& client, const vector<GroupId>& groups);
+    void Reconnect(SimClient& client);
+
+    void SendCommand(SimClient& client, ECommand cmd, const string& payload, bool is_json);
+    void Collect(SimClient& client);
+    void CollectAll(bool is_including_slow);
+    void OnFrame(SimClient& client, CommandMessage* cmdMsg, size_t frame_size);
+    vector<MessageId> RandomMessages(uint32_t n);
+    void Fail(const SimClient& client, const char* fmt, ...);
+
+    void RunWorkload();
+    void RunBenchmark();
+    void RunRestart();
+
+private:
+    SimParams       params_;
+    SwitchServer    server_;
+    TcpServer*      network_;
+    std::mt19937    rng_;
+    vector<SimClient>   clients_;
+    map<EndpointId, size_t>             client_index_;      // id -> index of clients_
+    map<MessageId, set<EndpointId>>     subscribers_;       // the model of routing
+    map<GroupId, set<EndpointId>>       group_members_;
+    uint64_t        publish_seq_ = 0;
+    uint64_t        routed_frames_ = 0;
+    uint64_t        violations_ = 0;
+};
+
+#endif  // _SWITCH_SIM_H
@@ -0,0 +1,84 @@
+#include <cstdio>
+#include "argparse/argparse.hpp"
+#include "switch_sim.h"
+
+int parse_arguments(int argc, char **argv, SimParams& params, bool& is_verbose) {
+    argparse::ArgumentParser program("switch_sim");
+
+    program.add_description("In-process simulation of the routing of switch, without sockets");
+
+    program.add_argument("-e", "--endpoints")
+        .help("number of virtual endpoints")
+        .default_value(1000)
+        .scan<'i', int>();
+    program.add_argument("-m", "--message_types")
+        .help("number of message types")
+        .default_value(50)
+        .scan<'i', int>();
+    program.add_argument("-s", "--subscriptions")
+        .help("initial subscriptions per endpoint")
+        .default_value(5)
+        .scan<'i', int>();
+    program.add_argument("-g", "--groups")
+        .help("number of groups")
+        .default_value(20)
+        .scan<'i', int>();
+    program.add_argument("-n", "--steps")
+        .help("operations of the randomized workload, or publishes of the benchmark")
+        .default_value(20000)
+        .scan<'i', int>();
+    program.add_argument("-r", "--seed")
+        .help("seed of the workload, the same seed replays the same run")
+        .default_value(1)
+        .scan<'i', int>();
+    program.add_argument("-l", "--slow_percent")
+        .help("percent of the endpoints reading their frames only now and then")
+        .default_value(10)
+        .scan<'i', int>();
+    program.add_argument("-b", "--bench")
+        .help("measure the routing cost per publish instead of checking the deliveries")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("-v", "--verbose")
+        .help("keep the logs of switch on STDOUT")
+        .default_value(false)
+        .implicit_value(true);
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        return -1;
+    }
+
+    params.endpoints = std::max(program.get<int>("--endpoints"), 2);
+    params.message_types = std::max(program.get<int>("--message_types"), 1);
+    params.subscriptions = program.get<int>("--subscriptions");
+    params.groups = std::max(program.get<int>("--groups"), 1);
+    params.steps = program.get<int>("--steps");
+    params.seed = program.get<int>("--seed");
+    params.slow_percent = program.get<int>("--slow_percent");
+    params.is_bench = program.get<bool>("--bench");
+    is_verbose = program.get<bool>("--verbose");
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    SimParams params;
+    bool is_verbose = false;
+    if (parse_arguments(argc, argv, params, is_verbose) < 0) {
+        return 1;
+    }
+    if (! is_verbose) {
+        // switch logs every frame, the results are reported on STDERR
+        if (! freopen("/dev/null", "w", stdout)) {
+            perror("freopen");
+        }
+    }
+
+    RoutingSimulation simulation(params);
+    auto violations = simulation.Run();
+    return violations == 0 ? 0 : 2;
+}
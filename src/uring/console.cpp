@@ -0,0 +1,86 @@
+#include "eventloop/extensions/console.h"
+#include <unistd.h>
+
+namespace evt_loop {
+
+Console* Console::Instance()
+{
+    // never destroyed, its event must not outlive the EventLoop at exit
+    static Console* console = new Console();
+    return console;
+}
+
+void Console::Initialize(const char* prompt, const char* history_file)
+{
+    auto console = Instance();
+    console->prompt_ = prompt;
+    if (console->stdin_event_ || ! isatty(STDIN_FILENO)) {
+        return;
+    }
+    console->stdin_event_ = new StdinEvent(console);
+    console->stdin_event_->SetFD(STDIN_FILENO);
+    EV_Singleton->AddEvent(console->stdin_event_);
+    console->PutPrompt();
+}
+
+void Console::destory()
+{
+    delete stdin_event_;
+    stdin_event_ = nullptr;
+}
+
+void Console::registerCommand(const char* name, const char* help, CommandCallback cb)
+{
+    commands_[name] = { help, cb };
+}
+
+void Console::PutPrompt()
+{
+    if (stdin_event_) {
+        cout << prompt_ << std::flush;
+    }
+}
+
+void Console::OnInput()
+{
+    char buf[1024];
+    ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+    if (n <= 0) {
+        destory();  // EOF, the switch keeps running without console
+        return;
+    }
+    input_.append(buf, n);
+    size_t pos;
+    while ((pos = input_.find('\n')) != string::npos) {
+        string line = input_.substr(0, pos);
+        input_.erase(0, pos + 1);
+        RunLine(line);
+    }
+}
+
+void Console::RunLine(const string& line)
+{
+    std::vector<string> argv;
+    std::stringstream ss(line);
+    string arg;
+    while (ss >> arg) {
+        argv.push_back(arg);
+    }
+    if (argv.empty()) {
+        PutPrompt();
+        return;
+    }
+    auto iter = commands_.find(argv[0]);
+    if (iter != commands_.end()) {
+        iter->second.second(argv);
+    } else if (argv[0] == "help") {
+        for (auto& [name, command] : commands_) {
+            put_line("  ", name, "\t", command.first);
+        }
+    } else {
+        put_line("unknown command: ", argv[0], ", try help");
+    }
+    PutPrompt();
+}
+
+}  // namespace evt_loop
@@ -0,0 +1,805 @@
+#include "eventloop/el.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+
+namespace evt_loop {
+
+static const uint32_t RING_ENTRIES = 4096;
+static const uint32_t RECV_BUFFERS = 1024;          // shared by all connections, recycled once copied out
+static const uint32_t RECV_BUFFER_SIZE = 4096;
+static const size_t RX_COMPACT_BYTES = 64 * 1024;   // the parsed bytes kept before the buffer is compacted
+static const int64_t ACCEPT_RETRY_MS = 100;
+
+string DumpHex(const char* data, size_t len, size_t max_len)
+{
+    std::stringstream ss;
+    size_t n = max_len > 0 && max_len < len ? max_len : len;
+    char buf[4];
+    for (size_t i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "%02x ", (uint8_t)data[i]);
+        ss << buf;
+    }
+    return ss.str();
+}
+
+string DumpHexWithChars(const char* data, size_t len, size_t max_len)
+{
+    size_t n = max_len > 0 && max_len < len ? max_len : len;
+    string chars(data, n);
+    for (auto& c : chars) {
+        if (! isprint((uint8_t)c)) {
+            c = '.';
+        }
+    }
+    return DumpHex(data, len, max_len) + " |" + chars + "|";
+}
+
+//---------------------------------------------------------------- EventLoop
+
+EventLoop* EventLoop::Instance()
+{
+    static EventLoop loop;
+    return &loop;
+}
+
+EventLoop::EventLoop()
+{
+    int err = ring_.Setup(RING_ENTRIES);
+    if (err == 0) {
+        err = ring_.SetupBufferRing(BUFFER_GROUP, RECV_BUFFERS, RECV_BUFFER_SIZE);
+    }
+    if (err != 0) {
+        fprintf(stderr, "[EventLoop] Error: can not set up io_uring: %s, Linux 6.0 or newer is required\n", strerror(-err));
+        exit(EXIT_FAILURE);
+    }
+    UpdateTime();
+}
+
+void EventLoop::UpdateTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now_ms_ = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void EventLoop::StartLoop()
+{
+    is_running_ = true;
+    while (is_running_) {
+        // the sends, re-arms and cancels of this iteration go out with the wait for the next one
+        Flush();
+        int64_t timeout_ms = -1;
+        if (! timers_.empty()) {
+            timeout_ms = std::max<int64_t>(timers_.begin()->first.first - now_ms_, 0);
+        }
+        // busy polling enters only to submit and to run the completions, it never sleeps
+        int n = is_busy_polling_ ? ring_.Enter(0, 0) : ring_.Enter(1, timeout_ms);
+        if (n < 0 && n != -EBUSY) {
+            fprintf(stderr, "[EventLoop] Error: io_uring_enter: %s\n", strerror(-n));
+        }
+        UpdateTime();
+        iterations_++;
+
+        ring_.ForEachCqe([this](const struct io_uring_cqe* cqe) {
+            auto iter = handlers_.find(cqe->user_data >> 8);
+            if (iter != handlers_.end()) {
+                iter->second->OnCompletion(cqe->user_data & 0xff, cqe->res, cqe->flags);
+            }
+        });
+        RunTimers();
+    }
+    // the frames sent by the last iteration, e.g. the results before a shutdown
+    Flush();
+    ring_.Enter(0, 0);
+}
+
+void EventLoop::Flush()
+{
+    while (! flush_ids_.empty()) {
+        std::vector<uint64_t> ids;
+        ids.swap(flush_ids_);
+        for (auto id : ids) {
+            auto iter = handlers_.find(id);
+            if (iter == handlers_.end()) {
+                continue;
+            }
+            auto handler = iter->second;
+            handler->is_flush_scheduled_ = false;
+            handler->OnFlush();
+        }
+    }
+}
+
+void EventLoop::RunTimers()
+{
+    // only those due now, a timer restarted by its callback waits for the next iteration
+    std::vector<std::pair<int64_t, uint64_t>> due;
+    for (auto& [key, _] : timers_) {
+        if (key.first > now_ms_) {
+            break;
+        }
+        due.push_back(key);
+    }
+    for (auto& key : due) {
+        auto iter = timers_.find(key);
+        if (iter == timers_.end()) {
+            continue;   // stopped by a callback before
+        }
+        auto timer = iter->second;
+        timers_.erase(iter);
+        timer->is_running_ = false;
+        timer->OnTimer();
+    }
+}
+
+uint64_t EventLoop::Register(IoHandler* handler)
+{
+    handler->handler_id_ = next_handler_id_++;
+    handlers_[handler->handler_id_] = handler;
+    return handler->handler_id_;
+}
+
+void EventLoop::Unregister(IoHandler* handler)
+{
+    handlers_.erase(handler->handler_id_);
+    handler->handler_id_ = 0;
+    handler->is_flush_scheduled_ = false;
+}
+
+void EventLoop::ScheduleFlush(IoHandler* handler)
+{
+    if (handler->handler_id_ == 0 || handler->is_flush_scheduled_) {
+        return;
+    }
+    handler->is_flush_scheduled_ = true;
+    flush_ids_.push_back(handler->handler_id_);
+}
+
+void EventLoop::AddEvent(IOEvent* e)
+{
+    if (e->handler_id_ != 0) {
+        return;
+    }
+    Register(e);
+    ScheduleFlush(e);
+}
+
+void EventLoop::DeleteEvent(IOEvent* e)
+{
+    if (e->handler_id_ == 0) {
+        return;
+    }
+    if (e->is_polling_) {
+        auto sqe = ring_.GetSqe();
+        if (sqe) {
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->addr = UserData(e, OP_POLL);
+            sqe->user_data = 0;     // no handler has id 0
+        }
+        e->is_polling_ = false;
+    }
+    Unregister(e);
+}
+
+void EventLoop::AddTimer(TimerEvent* timer)
+{
+    if (timer->is_running_) {
+        DeleteTimer(timer);
+    }
+    UpdateTime();   // may be started out of the loop, e.g. before StartLoop
+    timer->key_ = { now_ms_ + timer->interval_ms_, next_timer_seq_++ };
+    timers_[timer->key_] = timer;
+    timer->is_running_ = true;
+}
+
+void EventLoop::DeleteTimer(TimerEvent* timer)
+{
+    if (timer->is_running_) {
+        timers_.erase(timer->key_);
+        timer->is_running_ = false;
+    }
+}
+
+//---------------------------------------------------------------- Timers, IOEvent, SignalHandler
+
+void TimerEvent::Start()
+{
+    EV_Singleton->AddTimer(this);
+}
+
+void TimerEvent::Stop()
+{
+    if (is_running_) {
+        EV_Singleton->DeleteTimer(this);
+    }
+}
+
+void PeriodicTimer::OnTimer()
+{
+    // at least a millisecond apart, a zero interval would keep the loop in the timers
+    if (interval_ms_ <= 0) {
+        interval_ms_ = 1;
+    }
+    Start();
+    cb_(this);
+}
+
+IOEvent::~IOEvent()
+{
+    if (handler_id_ != 0) {
+        EV_Singleton->DeleteEvent(this);
+    }
+}
+
+void IOEvent::EnableReading()
+{
+    SetEvents(events_ | READ);
+}
+
+void IOEvent::DisableReading()
+{
+    SetEvents(events_ & ~READ);
+}
+
+void IOEvent::SetEvents(uint32_t events)
+{
+    if (events == events_) {
+        return;
+    }
+    events_ = events;
+    if (handler_id_ != 0) {
+        EV_Singleton->DeleteEvent(this);
+        EV_Singleton->AddEvent(this);
+    }
+}
+
+void IOEvent::OnFlush()
+{
+    if (is_polling_ || events_ == 0 || fd_ < 0) {
+        return;
+    }
+    auto sqe = EV_Singleton->Ring().GetSqe();
+    if (! sqe) {
+        EV_Singleton->ScheduleFlush(this);
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd_;
+    sqe->poll32_events = ((events_ & READ) ? POLLIN : 0) | ((events_ & WRITE) ? POLLOUT : 0);
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = EventLoop::UserData(this, OP_POLL);
+    is_polling_ = true;
+}
+
+void IOEvent::OnCompletion(uint8_t op, int32_t res, uint32_t flags)
+{
+    if (op != OP_POLL) {
+        return;
+    }
+    if (! (flags & IORING_CQE_F_MORE)) {
+        is_polling_ = false;
+        EV_Singleton->ScheduleFlush(this);
+    }
+    if (res > 0) {
+        uint32_t events = ((res & (POLLIN | POLLHUP | POLLERR)) ? READ : 0) | ((res & POLLOUT) ? WRITE : 0);
+        OnEvents(events);   // the last use of this, the callback may delete it
+    } else if (res < 0 && res != -ECANCELED) {
+        fprintf(stderr, "[IOEvent] Error: poll, fd: %d: %s\n", fd_, strerror(-res));
+    }
+}
+
+static int signal_number(SignalEvent event)
+{
+    switch (event) {
+        case SignalEvent::INT: return SIGINT;
+        case SignalEvent::HUP: return SIGHUP;
+        case SignalEvent::TERM: return SIGTERM;
+        case SignalEvent::USR1: return SIGUSR1;
+        case SignalEvent::USR2: return SIGUSR2;
+    }
+    return 0;
+}
+
+SignalHandler::SignalHandler(SignalEvent event, std::function<void(SignalHandler*, uint32_t)> cb) :
+    IOEvent(IOEvent::READ), signo_(signal_number(event)), cb_(cb)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, signo_);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[SignalHandler] Error: signalfd, signal: %d: %s\n", signo_, strerror(errno));
+        return;
+    }
+    SetFD(fd);
+    EV_Singleton->AddEvent(this);
+}
+
+SignalHandler::~SignalHandler()
+{
+    EV_Singleton->DeleteEvent(this);
+    if (FD() >= 0) {
+        close(FD());
+    }
+}
+
+void SignalHandler::OnEvents(uint32_t events)
+{
+    struct signalfd_siginfo info;
+    while (read(FD(), &info, sizeof(info)) == sizeof(info)) {
+        cb_(this, info.ssi_signo);
+    }
+}
+
+//---------------------------------------------------------------- TcpServer
+
+TcpServer::TcpServer(const char* host, uint16_t port, MessageType type)
+{
+    // the frames are cut by the HeaderDescription if it is set, whatever the type
+    (void)type;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    int on = 1;
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0 || setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+            inet_pton(AF_INET, host, &addr.sin_addr) != 1 ||
+            bind(fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd_, SOMAXCONN) != 0) {
+        fprintf(stderr, "[TcpServer] Error: can not listen on %s:%d: %s\n", host, port, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    Init();
+}
+
+TcpServer::TcpServer(int listen_fd, MessageType type) : fd_(listen_fd)
+{
+    Init();
+}
+
+void TcpServer::Init()
+{
+    retry_timer_ = new OneshotTimer(TimeVal(0, ACCEPT_RETRY_MS * 1000), [this](auto*) { EV_Singleton->ScheduleFlush(this); });
+    EV_Singleton->Register(this);
+    EV_Singleton->ScheduleFlush(this);
+}
+
+TcpServer::~TcpServer()
+{
+    EV_Singleton->Unregister(this);
+    delete retry_timer_;
+    conns_.clear();
+    close(fd_);
+}
+
+uint16_t TcpServer::Port() const
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    if (getsockname(fd_, (struct sockaddr*)&addr, &addr_len) != 0) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+void TcpServer::OnFlush()
+{
+    if (! is_suspended_ && ! is_accept_armed_ && ! is_cancel_inflight_ && ! retry_timer_->IsRunning()) {
+        ArmAccept();
+    }
+}
+
+void TcpServer::Suspend()
+{
+    if (is_suspended_) {
+        return;
+    }
+    is_suspended_ = true;
+    if (is_accept_armed_ && ! is_cancel_inflight_) {
+        auto sqe = EV_Singleton->Ring().GetSqe();
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = EventLoop::UserData(this, OP_ACCEPT);
+            sqe->user_data = EventLoop::UserData(this, OP_CANCEL);
+            is_cancel_inflight_ = true;
+        }
+    }
+    for (auto& [conn, _] : conns_) {
+        conn->Suspend();
+    }
+}
+
+void TcpServer::Resume()
+{
+    if (! is_suspended_) {
+        return;
+    }
+    is_suspended_ = false;
+    EV_Singleton->ScheduleFlush(this);
+    for (auto& [conn, _] : conns_) {
+        conn->Resume();
+    }
+}
+
+bool TcpServer::IsSuspended() const
+{
+    if (! is_suspended_ || is_accept_armed_ || is_cancel_inflight_) {
+        return false;
+    }
+    for (auto& [conn, _] : conns_) {
+        if (! conn->IsIdle()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TcpConnection* TcpServer::AdoptConnection(int fd, const string& rx_pending, const string& tx_pending)
+{
+    auto conn = new TcpConnection(fd, this);
+    conns_[conn].reset(conn);
+    conn->rx_buffer_ = rx_pending;
+    conn->tx_pending_ = tx_pending;
+    conn->is_suspended_ = is_suspended_;
+    EV_Singleton->Register(conn);
+    EV_Singleton->ScheduleFlush(conn);  // parses the frames received by the other process, and arms the receive
+    return conn;
+}
+
+void TcpServer::ArmAccept()
+{
+    auto sqe = EV_Singleton->Ring().GetSqe();
+    if (! sqe) {
+        retry_timer_->Start();
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = EventLoop::UserData(this, OP_ACCEPT);
+    is_accept_armed_ = true;
+}
+
+void TcpServer::OnCompletion(uint8_t op, int32_t res, uint32_t flags)
+{
+    if (op == OP_CANCEL) {
+        is_cancel_inflight_ = false;
+        EV_Singleton->ScheduleFlush(this);
+        return;
+    }
+    if (op != OP_ACCEPT) {
+        return;
+    }
+    if (! (flags & IORING_CQE_F_MORE)) {
+        is_accept_armed_ = false;
+        if (res >= 0 || res == -ECANCELED) {
+            EV_Singleton->ScheduleFlush(this);
+        } else {
+            retry_timer_->Start();
+        }
+    }
+    if (res == -ECANCELED) {
+        return;
+    }
+    if (res < 0) {
+        fprintf(stderr, "[TcpServer] Error: accept: %s\n", strerror(-res));
+        return;
+    }
+    auto conn = new TcpConnection(res, this);
+    conns_[conn].reset(conn);
+    conn->is_suspended_ = is_suspended_;   // accepted before the accept was cancelled
+    EV_Singleton->Register(conn);
+    EV_Singleton->ScheduleFlush(conn);  // arms the receive
+    if (cbs_ && cbs_->on_conn_ready_cb) {
+        cbs_->on_conn_ready_cb(conn);
+    }
+}
+
+void TcpServer::ReleaseConnection(TcpConnection* conn)
+{
+    conns_.erase(conn);
+}
+
+//---------------------------------------------------------------- TcpConnection
+
+TcpConnection::TcpConnection(int fd, TcpServer* server) : fd_(fd), server_(server)
+{
+}
+
+TcpConnection::~TcpConnection()
+{
+    EV_Singleton->Unregister(this);
+    close(fd_);
+}
+
+void TcpConnection::Send(const char* data, size_t len)
+{
+    if (is_closed_ || len == 0) {
+        return;
+    }
+    tx_pending_.append(data, len);
+    EV_Singleton->ScheduleFlush(this);
+}
+
+void TcpConnection::Disconnect()
+{
+    if (is_closed_) {
+        return;
+    }
+    // best effort for what is not sent yet, e.g. the result before a kickout
+    if (! is_send_inflight_ && TxBufferSize() > 0) {
+        tx_sending_.append(tx_pending_);
+        ssize_t n = send(fd_, tx_sending_.data() + tx_sent_, tx_sending_.size() - tx_sent_, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            tx_bytes_ += n;
+        }
+    }
+    Close();
+}
+
+void TcpConnection::Close()
+{
+    is_closed_ = true;
+    tx_pending_.clear();
+    // wakes the requests in flight, the connection is released once they complete
+    shutdown(fd_, SHUT_RDWR);
+    auto& cbs = server_->cbs_;
+    if (cbs && cbs->on_closed_cb) {
+        cbs->on_closed_cb(this);
+    }
+    EV_Singleton->ScheduleFlush(this);
+}
+
+void TcpConnection::Suspend()
+{
+    is_suspended_ = true;
+    if (is_closed_ || is_cancel_inflight_ || (! is_recv_armed_ && ! is_send_inflight_)) {
+        return;
+    }
+    auto sqe = EV_Singleton->Ring().GetSqe();
+    if (! sqe) {
+        return;
+    }
+    // both the receive and the send of the connection
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd_;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = EventLoop::UserData(this, OP_CANCEL);
+    is_cancel_inflight_ = true;
+}
+
+void TcpConnection::Resume()
+{
+    is_suspended_ = false;
+    EV_Singleton->ScheduleFlush(this);
+}
+
+void TcpConnection::EnableReading()
+{
+    if (is_closed_ || is_reading_) {
+        return;
+    }
+    is_reading_ = true;
+    EV_Singleton->ScheduleFlush(this);  // the frames received meanwhile, and the receive
+}
+
+void TcpConnection::DisableReading()
+{
+    if (is_closed_ || ! is_reading_) {
+        return;
+    }
+    is_reading_ = false;
+    CancelRecv();
+}
+
+void TcpConnection::OnFlush()
+{
+    if (is_closed_) {
+        if (! is_recv_armed_ && ! is_send_inflight_ && ! is_cancel_inflight_) {
+            server_->ReleaseConnection(this);   // deletes this
+        }
+        return;
+    }
+    if (is_suspended_) {
+        return;
+    }
+    if (is_reading_) {
+        ParseFrames();
+        if (is_closed_) {
+            return;     // flushed again, scheduled by Close
+        }
+        if (! is_recv_armed_ && ! is_cancel_inflight_) {
+            ArmRecv();
+        }
+    }
+    if (! is_send_inflight_ && TxBufferSize() > 0) {
+        SubmitSend();
+    }
+}
+
+void TcpConnection::ArmRecv()
+{
+    auto sqe = EV_Singleton->Ring().GetSqe();
+    if (! sqe) {
+        EV_Singleton->ScheduleFlush(this);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd_;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = EventLoop::BUFFER_GROUP;
+    sqe->user_data = EventLoop::UserData(this, OP_RECV);
+    is_recv_armed_ = true;
+}
+
+void TcpConnection::CancelRecv()
+{
+    if (! is_recv_armed_ || is_cancel_inflight_) {
+        return;
+    }
+    auto sqe = EV_Singleton->Ring().GetSqe();
+    if (! sqe) {
+        return;     // the frames are kept in rx buffer until reading is enabled
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = EventLoop::UserData(this, OP_RECV);
+    sqe->user_data = EventLoop::UserData(this, OP_CANCEL);
+    is_cancel_inflight_ = true;
+}
+
+void TcpConnection::SubmitSend()
+{
+    auto sqe = EV_Singleton->Ring().GetSqe();
+    if (! sqe) {
+        EV_Singleton->ScheduleFlush(this);
+        return;
+    }
+    if (tx_sending_.empty()) {
+        tx_sending_.swap(tx_pending_);
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd_;
+    sqe->addr = (uint64_t)(tx_sending_.data() + tx_sent_);
+    sqe->len = tx_sending_.size() - tx_sent_;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = EventLoop::UserData(this, OP_SEND);
+    is_send_inflight_ = true;
+}
+
+void TcpConnection::OnCompletion(uint8_t op, int32_t res, uint32_t flags)
+{
+    switch (op) {
+        case OP_RECV:
+            OnReceived(res, flags);
+            break;
+        case OP_SEND:
+            OnSent(res);
+            break;
+        case OP_CANCEL:
+            is_cancel_inflight_ = false;
+            EV_Singleton->ScheduleFlush(this);
+            break;
+        default:
+            break;
+    }
+}
+
+void TcpConnection::OnReceived(int32_t res, uint32_t flags)
+{
+    if (! (flags & IORING_CQE_F_MORE)) {
+        is_recv_armed_ = false;
+        EV_Singleton->ScheduleFlush(this);  // re-arm, or release
+    }
+    if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+        uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        auto& ring = EV_Singleton->Ring();
+        if (! is_closed_) {
+            rx_buffer_.append(ring.Buffer(bid), res);
+            rx_bytes_ += res;
+        }
+        ring.RecycleBuffer(bid);
+        if (! is_closed_ && is_reading_ && ! is_suspended_) {
+            ParseFrames();
+        }
+    } else if (res == 0) {
+        if (! is_closed_) {
+            Close();    // by peer
+        }
+    } else if (res < 0 && res != -ENOBUFS && res != -ECANCELED) {
+        if (! is_closed_) {
+            Close();
+        }
+    }
+}
+
+void TcpConnection::OnSent(int32_t res)
+{
+    is_send_inflight_ = false;
+    EV_Singleton->ScheduleFlush(this);  // the rest, or release
+    if (is_closed_ || res == -ECANCELED) {
+        return;     // cancelled, nothing sent
+    }
+    if (res < 0) {
+        Close();
+        return;
+    }
+    tx_sent_ += res;
+    tx_bytes_ += res;
+    if (tx_sent_ == tx_sending_.size()) {
+        tx_sending_.clear();
+        tx_sent_ = 0;
+    }
+    auto& cbs = server_->cbs_;
+    if (TxBufferSize() == 0 && cbs && cbs->on_msg_sent_cb) {
+        cbs->on_msg_sent_cb(this, nullptr);     // drained
+    }
+}
+
+size_t TcpConnection::FrameSize(const char* data, size_t len) const
+{
+    auto hdr_desc = server_->hdr_desc_.get();
+    if (len < hdr_desc->hdr_len) {
+        return 0;
+    }
+    auto p = (const uint8_t*)data + hdr_desc->payload_len_offset;
+    size_t payload_len = 0;
+    for (size_t i = 0; i < hdr_desc->payload_len_bytes; i++) {
+        payload_len = (payload_len << 8) | p[i];    // network order
+    }
+    if (hdr_desc->is_payload_len_including_self && payload_len >= hdr_desc->payload_len_bytes) {
+        payload_len -= hdr_desc->payload_len_bytes;
+    }
+    return hdr_desc->hdr_len + payload_len;
+}
+
+static bool is_same_frame(const char* data, size_t len, const string& frame)
+{
+    return ! frame.empty() && len == frame.size() && memcmp(data, frame.data(), len) == 0;
+}
+
+void TcpConnection::ParseFrames()
+{
+    auto hdr_desc = server_->hdr_desc_.get();
+    auto cbs = server_->cbs_.get();
+    while (is_reading_ && ! is_suspended_ && ! is_closed_ && rx_offset_ < rx_buffer_.size()) {
+        const char* data = rx_buffer_.data() + rx_offset_;
+        size_t len = rx_buffer_.size() - rx_offset_;
+        size_t frame_size = hdr_desc ? FrameSize(data, len) : len;
+        if (frame_size == 0 || frame_size > len) {
+            break;
+        }
+        rx_offset_ += frame_size;
+        if (hdr_desc && is_same_frame(data, frame_size, hdr_desc->heartbeat_request)) {
+            Send(hdr_desc->heartbeat_response);
+            continue;
+        }
+        if (hdr_desc && is_same_frame(data, frame_size, hdr_desc->heartbeat_response)) {
+            continue;
+        }
+        // a copy, the callback may convert the frame in place
+        rx_msg_.Assign(data, frame_size);
+        if (cbs && cbs->on_msg_recvd_cb) {
+            cbs->on_msg_recvd_cb(this, &rx_msg_);
+        }
+    }
+    if (rx_offset_ == rx_buffer_.size()) {
+        rx_buffer_.clear();
+        rx_offset_ = 0;
+    } else if (rx_offset_ >= RX_COMPACT_BYTES) {
+        rx_buffer_.erase(0, rx_offset_);
+        rx_offset_ = 0;
+    }
+}
+
+}  // namespace evt_loop
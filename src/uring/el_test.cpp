@@ -0,0 +1,295 @@
+#if defined(__UNITTEST__)
+
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include "eventloop/el.h"
+
+using namespace evt_loop;
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+// the header of switch: cmd(1), flag(1), payload_len(2) including itself
+static const string HEARTBEAT_REQUEST("\x09\x00\x00\x02", 4);
+static const string HEARTBEAT_RESPONSE("\x0a\x00\x00\x02", 4);
+static const char CMD_ECHO = 0x01;
+static const char CMD_PAUSE = 0x7e;         // echoed, and no more read for PAUSE_MS
+static const char CMD_DISCONNECT = 0x7f;    // echoed, then disconnected by server
+static const int PAUSE_MS = 50;
+static const size_t BATCH_FRAMES = 1000;
+
+static string frame(char cmd, const string& payload)
+{
+    uint16_t len = htons(payload.size() + 2);
+    string data(1, cmd);
+    data += '\0';
+    data.append((const char*)&len, 2);
+    return data + payload;
+}
+
+class StopEvent : public IOEvent {
+    public:
+    StopEvent() { SetFD(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)); }
+    ~StopEvent() { close(FD()); }
+    void Notify() {
+        uint64_t n = 1;
+        ssize_t ret = write(FD(), &n, sizeof(n));
+        assert(ret == sizeof(n));
+    }
+
+    protected:
+    void OnEvents(uint32_t events) override {
+        uint64_t n;
+        ssize_t ret = read(FD(), &n, sizeof(n));
+        assert(ret == sizeof(n));
+        EV_Singleton->StopLoop();
+    }
+};
+
+static int connect_to(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int ret = connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+    assert(ret == 0);
+    return fd;
+}
+
+static void write_all(int fd, const string& data)
+{
+    for (size_t n = 0; n < data.size(); ) {
+        ssize_t ret = write(fd, data.data() + n, data.size() - n);
+        assert(ret > 0);
+        n += ret;
+    }
+}
+
+static string read_exact(int fd, size_t len)
+{
+    string data(len, '\0');
+    for (size_t n = 0; n < len; ) {
+        ssize_t ret = read(fd, &data[n], len - n);
+        assert(ret > 0);
+        n += ret;
+    }
+    return data;
+}
+
+static void run_client(uint16_t port, StopEvent* stop_event)
+{
+    int fd = connect_to(port);
+
+    // the frames of one write, echoed
+    string batch;
+    for (size_t i = 0; i < BATCH_FRAMES; i++) {
+        batch += frame(CMD_ECHO, "frame-" + std::to_string(i));
+    }
+    write_all(fd, batch);
+    assert(read_exact(fd, batch.size()) == batch);
+
+    // a frame in pieces
+    string split = frame(CMD_ECHO, "split into bytes");
+    for (char c : split) {
+        write_all(fd, string(1, c));
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    assert(read_exact(fd, split.size()) == split);
+
+    // the heartbeat is answered by the loop, not passed to the callback
+    write_all(fd, HEARTBEAT_REQUEST);
+    assert(read_exact(fd, HEARTBEAT_RESPONSE.size()) == HEARTBEAT_RESPONSE);
+
+    // the frame after a pause is read once reading is enabled again
+    string pause = frame(CMD_PAUSE, "");
+    string after = frame(CMD_ECHO, "after pause");
+    auto start = steady_clock::now();
+    write_all(fd, pause + after);
+    assert(read_exact(fd, pause.size() + after.size()) == pause + after);
+    assert(steady_clock::now() - start >= milliseconds(PAUSE_MS - 5));
+
+    // disconnected by server after the echo
+    string bye = frame(CMD_DISCONNECT, "bye");
+    write_all(fd, bye);
+    assert(read_exact(fd, bye.size()) == bye);
+    char c;
+    ssize_t ret = read(fd, &c, 1);
+    assert(ret == 0);
+    close(fd);
+
+    // disconnected by client
+    fd = connect_to(port);
+    write_all(fd, split);
+    assert(read_exact(fd, split.size()) == split);
+    close(fd);
+
+    std::this_thread::sleep_for(milliseconds(50));
+    stop_event->Notify();
+}
+
+static void run_handoff_client(uint16_t port, StopEvent* suspend_event, StopEvent* stop_event)
+{
+    int fd = connect_to(port);
+    string first = frame(CMD_ECHO, "before handoff");
+    string second = frame(CMD_ECHO, "across handoff");
+    write_all(fd, first + second.substr(0, 6));
+    assert(read_exact(fd, first.size()) == first);
+    std::this_thread::sleep_for(milliseconds(20));
+    suspend_event->Notify();
+
+    // queued by the first server while suspended, sent by the second one
+    string queued = frame(CMD_ECHO, "queued");
+    assert(read_exact(fd, queued.size()) == queued);
+    write_all(fd, second.substr(6));
+    assert(read_exact(fd, second.size()) == second);
+    close(fd);
+
+    // accepted by the second server
+    fd = connect_to(port);
+    write_all(fd, first);
+    assert(read_exact(fd, first.size()) == first);
+    close(fd);
+    stop_event->Notify();
+}
+
+// The sockets of a suspended server are adopted by another one, as the upgrade of switch does
+// between processes: the bytes received and not parsed, and the ones not sent, go along
+static void test_handoff(const HeaderDescriptionPtr& hdr_desc)
+{
+    size_t n_frames_a = 0, n_frames_b = 0;
+    TcpConnection* conn_a = nullptr;
+    auto cbs_a = std::make_shared<TcpCallbacks>();
+    cbs_a->on_conn_ready_cb = [&](TcpConnection* conn) { conn_a = conn; };
+    cbs_a->on_msg_recvd_cb = [&](TcpConnection* conn, const Message* msg) { n_frames_a++; conn->Send(msg->Data()); };
+    auto cbs_b = std::make_shared<TcpCallbacks>();
+    cbs_b->on_msg_recvd_cb = [&](TcpConnection* conn, const Message* msg) { n_frames_b++; conn->Send(msg->Data()); };
+
+    auto server_a = std::make_shared<TcpServer>("127.0.0.1", 0, MessageType::BINARY);
+    server_a->SetMessageHeaderDescription(hdr_desc);
+    server_a->SetTcpCallbacks(cbs_a);
+    TcpServerPtr server_b;
+
+    PeriodicTimer handoff_timer(TimeVal(0, 1000), [&](PeriodicTimer* timer) {
+        if (! server_a->IsSuspended()) {
+            return;
+        }
+        timer->Stop();
+        auto rx_pending = conn_a->RxPendingData();
+        auto tx_pending = conn_a->TxPendingData();
+        assert(rx_pending.size() == 6);
+        assert(tx_pending == frame(CMD_ECHO, "queued"));
+        server_b = std::make_shared<TcpServer>(dup(server_a->FD()), MessageType::BINARY);
+        server_b->SetMessageHeaderDescription(hdr_desc);
+        server_b->SetTcpCallbacks(cbs_b);
+        server_b->AdoptConnection(dup(conn_a->FD()), rx_pending, tx_pending);
+        server_a.reset();
+    });
+    struct SuspendEvent : public StopEvent {
+        std::function<void()> cb;
+        void OnEvents(uint32_t events) override {
+            uint64_t n;
+            ssize_t ret = read(FD(), &n, sizeof(n));
+            assert(ret == sizeof(n));
+            cb();
+        }
+    } suspend_event;
+    suspend_event.cb = [&]() {
+        server_a->Suspend();
+        conn_a->Send(frame(CMD_ECHO, "queued"));
+        handoff_timer.Start();
+    };
+    StopEvent stop_event;
+    EV_Singleton->AddEvent(&suspend_event);
+    EV_Singleton->AddEvent(&stop_event);
+
+    std::thread client(run_handoff_client, server_a->Port(), &suspend_event, &stop_event);
+    EV_Singleton->StartLoop();
+    client.join();
+
+    assert(! server_a);
+    assert(n_frames_a == 1);
+    assert(n_frames_b == 2);
+    cout << "io_uring eventloop handoff: ok" << endl;
+}
+
+int main()
+{
+    auto server = std::make_shared<TcpServer>("127.0.0.1", 0, MessageType::BINARY);
+    auto hdr_desc = std::make_shared<HeaderDescription>();
+    hdr_desc->hdr_len = 4;
+    hdr_desc->payload_len_offset = 2;
+    hdr_desc->payload_len_bytes = 2;
+    hdr_desc->is_payload_len_including_self = true;
+    hdr_desc->heartbeat_request = HEARTBEAT_REQUEST;
+    hdr_desc->heartbeat_response = HEARTBEAT_RESPONSE;
+    server->SetMessageHeaderDescription(hdr_desc);
+
+    size_t n_conns = 0, n_closed = 0, n_frames = 0, n_drained = 0, n_ticks = 0;
+    TcpConnection* paused_conn = nullptr;
+    OneshotTimer resume_timer(TimeVal(0, PAUSE_MS * 1000), [&](auto*) { paused_conn->EnableReading(); });
+
+    auto cbs = std::make_shared<TcpCallbacks>();
+    cbs->on_conn_ready_cb = [&](TcpConnection* conn) { n_conns++; };
+    cbs->on_closed_cb = [&](TcpConnection* conn) { n_closed++; };
+    cbs->on_msg_sent_cb = [&](TcpConnection* conn, const Message* msg) { n_drained++; };
+    cbs->on_msg_recvd_cb = [&](TcpConnection* conn, const Message* msg) {
+        n_frames++;
+        conn->Send(msg->Data());
+        if (msg->Data()[0] == CMD_PAUSE) {
+            conn->DisableReading();
+            paused_conn = conn;
+            resume_timer.Start();
+        } else if (msg->Data()[0] == CMD_DISCONNECT) {
+            conn->Disconnect();
+        }
+    };
+    server->SetTcpCallbacks(cbs);
+
+    PeriodicTimer tick_timer(TimeVal(0, 10 * 1000), [&](auto*) { n_ticks++; });
+    tick_timer.Start();
+    StopEvent stop_event;
+    EV_Singleton->AddEvent(&stop_event);
+
+    std::thread client(run_client, server->Port(), &stop_event);
+    EV_Singleton->StartLoop();
+    client.join();
+
+    assert(n_conns == 2);
+    assert(n_closed == 2);
+    assert(server->GetConnectionNumber() == 0);
+    assert(n_frames == BATCH_FRAMES + 5);
+    assert(n_drained > 0);
+    assert(n_ticks > 0);
+    // a syscall carries many frames, the batch is echoed by a few sends
+    assert(EV_Singleton->StatsEnterCalls() < n_frames / 4);
+    cout << "io_uring eventloop: ok, " << n_frames << " frames, " << EV_Singleton->StatsEnterCalls()
+        << " io_uring_enter calls, " << EV_Singleton->StatsIterations() << " iterations" << endl;
+
+    // busy polling spins without waiting, the timers still fire on time
+    EV_Singleton->SetBusyPolling(true);
+    auto iterations = EV_Singleton->StatsIterations();
+    auto start = steady_clock::now();
+    OneshotTimer stop_timer(TimeVal(0, 20 * 1000), [](auto*) { EV_Singleton->StopLoop(); });
+    stop_timer.Start();
+    EV_Singleton->StartLoop();
+    auto elapsed = steady_clock::now() - start;
+    assert(elapsed >= milliseconds(19) && elapsed < milliseconds(200));
+    assert(EV_Singleton->StatsIterations() - iterations > 100);
+    cout << "io_uring eventloop busy polling: ok, " << EV_Singleton->StatsIterations() - iterations
+        << " iterations in 20 ms" << endl;
+
+    EV_Singleton->SetBusyPolling(false);
+    test_handoff(hdr_desc);
+    return 0;
+}
+
+#endif
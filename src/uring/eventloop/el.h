@@ -0,0 +1,358 @@
+#ifndef _URING_EVENTLOOP_EL_H
+#define _URING_EVENTLOOP_EL_H
+
+// EventLoop on io_uring, the network backend of switch built with USE_IO_URING (see
+// ../../server/Makefile). It has the API of the EventLoop submodule as the switch uses it,
+// so the sources of server and common are compiled unchanged against it:
+//   - TcpServer accepts by one multishot accept, a connection receives by one multishot recv
+//     into the ring of provided buffers, the frames are cut by the HeaderDescription
+//   - Send() appends to the tx buffer of connection, the connections sent to in a loop
+//     iteration get one SEND each, all submitted by the io_uring_enter which also waits
+//     for the next completions, so a syscall carries the frames of a whole iteration
+//   - the timers bound the wait, the IOEvents and signals are multishot polls
+// Requires Linux 6.0 or newer.
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include "../io_uring.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+namespace evt_loop {
+
+const size_t DUMP_MAX_BYTES = 64;
+
+string DumpHex(const char* data, size_t len, size_t max_len=0);
+inline string DumpHex(const string& data, size_t max_len=0) { return DumpHex(data.data(), data.size(), max_len); }
+string DumpHexWithChars(const char* data, size_t len, size_t max_len=0);
+inline string DumpHexWithChars(const string& data, size_t max_len=0) { return DumpHexWithChars(data.data(), data.size(), max_len); }
+
+inline time_t Now() { return time(nullptr); }
+
+struct TimeVal {
+    long sec;
+    long usec;
+    TimeVal(long s=0, long us=0) : sec(s), usec(us) {}
+    int64_t Milliseconds() const { return sec * 1000 + usec / 1000; }
+};
+
+enum class MessageType { CUSTOM, BINARY };
+
+class Message {
+    public:
+    Message() = default;
+    Message(const string& data) : data_(data) {}
+    const string& Data() const { return data_; }
+    size_t Size() const { return data_.size(); }
+    size_t PayloadSize() const { return data_.size(); }
+    string DumpHexWithChars(size_t max_len) const { return evt_loop::DumpHexWithChars(data_, max_len); }
+    void Assign(const char* data, size_t len) { data_.assign(data, len); }
+
+    private:
+    string data_;
+};
+
+struct HeaderDescription {
+    size_t hdr_len = 0;
+    size_t payload_len_offset = 0;
+    size_t payload_len_bytes = 0;
+    bool   is_payload_len_including_self = false;
+    string heartbeat_request;
+    string heartbeat_response;
+
+    string ToString() const {
+        std::stringstream ss;
+        ss << "{hdr_len: " << hdr_len << ", payload_len_offset: " << payload_len_offset
+            << ", payload_len_bytes: " << payload_len_bytes << "}";
+        return ss.str();
+    }
+};
+using HeaderDescriptionPtr = std::shared_ptr<HeaderDescription>;
+
+// The owner of the requests in flight, their completions are dispatched to it by the id
+// registered in EventLoop, none after it is unregistered. OnFlush runs once at the end of
+// the loop iteration it was scheduled in, before the pending SQEs are submitted.
+class IoHandler {
+    public:
+    virtual ~IoHandler() {}
+    virtual void OnCompletion(uint8_t op, int32_t res, uint32_t flags) = 0;
+    virtual void OnFlush() {}
+
+    protected:
+    friend class EventLoop;
+    uint64_t handler_id_ = 0;   // 0: not registered
+    bool     is_flush_scheduled_ = false;
+};
+
+class IOEvent : public IoHandler {
+    public:
+    static const uint32_t READ = 1;
+    static const uint32_t WRITE = 2;
+    IOEvent(uint32_t events=READ) : events_(events) {}
+    virtual ~IOEvent();
+    void SetFD(int fd) { fd_ = fd; }
+    int FD() const { return fd_; }
+    uint32_t Events() const { return events_; }
+    virtual void OnEvents(uint32_t events) = 0;
+    void EnableReading();
+    void DisableReading();
+
+    private:
+    friend class EventLoop;
+    void OnCompletion(uint8_t op, int32_t res, uint32_t flags) override;
+    void OnFlush() override;
+    void SetEvents(uint32_t events);
+
+    int      fd_ = -1;
+    uint32_t events_;
+    bool     is_polling_ = false;   // the multishot poll is armed
+};
+
+class TcpConnection;
+struct TcpCallbacks {
+    std::function<void(TcpConnection*, const Message*)> on_msg_recvd_cb;
+    std::function<void(TcpConnection*, const Message*)> on_msg_sent_cb;
+    std::function<void(TcpConnection*)> on_conn_ready_cb;
+    std::function<void(TcpConnection*)> on_closed_cb;
+};
+using TcpCallbacksPtr = std::shared_ptr<TcpCallbacks>;
+
+class TcpServer;
+
+// on_msg_sent_cb is called with nullptr once the tx buffer is sent out, and the connection
+// is released at the end of the loop iteration after its requests in flight complete,
+// so it stays valid during the iteration of on_closed_cb.
+class TcpConnection : public IoHandler {
+    public:
+    TcpConnection(int fd, TcpServer* server);
+    ~TcpConnection();
+
+    int FD() const { return fd_; }
+    uint32_t ID() const { return id_; }
+    void SetID(uint32_t id) { id_ = id; }
+
+    void Send(const string& data) { Send(data.data(), data.size()); }
+    void Send(const char* data, size_t len);
+    void Disconnect();
+    bool IsClosed() const { return is_closed_; }
+
+    size_t StatsRxBytes() const { return rx_bytes_; }
+    size_t StatsTxBytes() const { return tx_bytes_; }
+    size_t TxBufferSize() const { return tx_sending_.size() - tx_sent_ + tx_pending_.size(); }
+    void EnableReading();
+    void DisableReading();
+    bool IsReading() const { return is_reading_; }
+
+    // what is received and not parsed, and what is not sent, exact once the server is suspended
+    string RxPendingData() const { return rx_buffer_.substr(rx_offset_); }
+    string TxPendingData() const { return tx_sending_.substr(tx_sent_) + tx_pending_; }
+
+    private:
+    friend class TcpServer;
+    void OnCompletion(uint8_t op, int32_t res, uint32_t flags) override;
+    void OnFlush() override;
+    void OnReceived(int32_t res, uint32_t flags);
+    void OnSent(int32_t res);
+    void Close();
+    void Suspend();
+    void Resume();
+    bool IsIdle() const { return ! is_recv_armed_ && ! is_send_inflight_ && ! is_cancel_inflight_; }
+    void ArmRecv();
+    void CancelRecv();
+    void SubmitSend();
+    void ParseFrames();
+    size_t FrameSize(const char* data, size_t len) const;   // 0: incomplete
+
+    int         fd_;
+    uint32_t    id_ = 0;
+    TcpServer*  server_;
+    string      rx_buffer_;
+    size_t      rx_offset_ = 0;         // parsed up to
+    Message     rx_msg_;                // the frame passed to on_msg_recvd_cb, reused
+    string      tx_sending_;            // in flight, not touched until its SEND completes
+    size_t      tx_sent_ = 0;
+    string      tx_pending_;            // appended since
+    size_t      rx_bytes_ = 0;
+    size_t      tx_bytes_ = 0;
+    bool        is_reading_ = true;
+    bool        is_closed_ = false;
+    bool        is_suspended_ = false;
+    bool        is_recv_armed_ = false;
+    bool        is_send_inflight_ = false;
+    bool        is_cancel_inflight_ = false;
+};
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+
+class OneshotTimer;
+
+class TcpServer : public IoHandler {
+    public:
+    TcpServer(const char* host, uint16_t port, MessageType type);
+    TcpServer(int listen_fd, MessageType type);     // listening already, e.g. handed over
+    ~TcpServer();
+
+    void SetMessageHeaderDescription(HeaderDescriptionPtr desc) { hdr_desc_ = desc; }
+    HeaderDescriptionPtr GetMessageHeaderDescription() const { return hdr_desc_; }
+    void SetTcpCallbacks(TcpCallbacksPtr cbs) { cbs_ = cbs; }
+    TcpCallbacksPtr GetTcpCallbacks() const { return cbs_; }
+    size_t GetConnectionNumber() const { return conns_.size(); }
+    int FD() const { return fd_; }
+    uint16_t Port() const;  // bound, for port 0
+
+    // For the handoff of the sockets to another process, see ../server/switch_upgrade.h.
+    // Suspend stops accepting, receiving and sending, by cancelling the requests in flight,
+    // IsSuspended is true once they completed, then the pending data of connections is exact.
+    void Suspend();
+    void Resume();
+    bool IsSuspended() const;
+    // a connection of the socket of another process, not passed to on_conn_ready_cb
+    TcpConnection* AdoptConnection(int fd, const string& rx_pending, const string& tx_pending);
+
+    private:
+    friend class TcpConnection;
+    void Init();
+    void OnCompletion(uint8_t op, int32_t res, uint32_t flags) override;
+    void OnFlush() override;
+    void ArmAccept();
+    void ReleaseConnection(TcpConnection* conn);
+
+    int fd_ = -1;
+    HeaderDescriptionPtr hdr_desc_;
+    TcpCallbacksPtr cbs_;
+    std::unordered_map<TcpConnection*, std::unique_ptr<TcpConnection>> conns_;
+    bool is_accept_armed_ = false;
+    bool is_cancel_inflight_ = false;
+    bool is_suspended_ = false;
+    OneshotTimer* retry_timer_ = nullptr;   // after a failed accept, e.g. EMFILE
+};
+using TcpServerPtr = std::shared_ptr<TcpServer>;
+
+class TimerEvent {
+    public:
+    TimerEvent(const TimeVal& interval) : interval_ms_(interval.Milliseconds()) {}
+    virtual ~TimerEvent() { Stop(); }
+    void Start();
+    void Stop();
+    bool IsRunning() const { return is_running_; }
+    void SetInterval(const TimeVal& interval) { interval_ms_ = interval.Milliseconds(); }
+
+    protected:
+    friend class EventLoop;
+    virtual void OnTimer() = 0;
+
+    int64_t  interval_ms_;
+    bool     is_running_ = false;
+    std::pair<int64_t, uint64_t> key_;  // expire time and sequence, in EventLoop
+};
+
+class PeriodicTimer : public TimerEvent {
+    public:
+    PeriodicTimer(const TimeVal& interval, const std::function<void(PeriodicTimer*)>& cb) :
+        TimerEvent(interval), cb_(cb) {}
+
+    protected:
+    void OnTimer() override;
+
+    private:
+    std::function<void(PeriodicTimer*)> cb_;
+};
+
+class OneshotTimer : public TimerEvent {
+    public:
+    OneshotTimer(const TimeVal& interval, const std::function<void(OneshotTimer*)>& cb) :
+        TimerEvent(interval), cb_(cb) {}
+
+    protected:
+    void OnTimer() override { cb_(this); }
+
+    private:
+    std::function<void(OneshotTimer*)> cb_;
+};
+
+enum class SignalEvent { INT, HUP, TERM, USR1, USR2 };
+
+// the signal is blocked and read from a signalfd polled by the loop
+class SignalHandler : public IOEvent {
+    public:
+    SignalHandler(SignalEvent event, std::function<void(SignalHandler*, uint32_t)> cb);
+    ~SignalHandler();
+
+    protected:
+    void OnEvents(uint32_t events) override;
+
+    private:
+    int signo_;
+    std::function<void(SignalHandler*, uint32_t)> cb_;
+};
+
+class EventLoop {
+    public:
+    static EventLoop* Instance();
+    void StartLoop();
+    void StopLoop() { is_running_ = false; }
+    // for latency over CPU: io_uring_enter does not wait, the loop spins on the completions
+    void SetBusyPolling(bool is_busy_polling) { is_busy_polling_ = is_busy_polling; }
+    void AddEvent(IOEvent* e);
+    void DeleteEvent(IOEvent* e);
+
+    // for the handlers of this backend
+    IoUring& Ring() { return ring_; }
+    uint64_t Register(IoHandler* handler);
+    void Unregister(IoHandler* handler);
+    void ScheduleFlush(IoHandler* handler);
+    static uint64_t UserData(const IoHandler* handler, uint8_t op) { return (handler->handler_id_ << 8) | op; }
+
+    void AddTimer(TimerEvent* timer);
+    void DeleteTimer(TimerEvent* timer);
+    int64_t NowMs() const { return now_ms_; }
+
+    uint64_t StatsIterations() const { return iterations_; }
+    uint64_t StatsEnterCalls() const { return ring_.StatsEnterCalls(); }
+
+    static const uint16_t BUFFER_GROUP = 1;
+
+    private:
+    EventLoop();
+    void Flush();
+    void RunTimers();
+    void UpdateTime();
+
+    IoUring  ring_;
+    bool     is_running_ = false;
+    bool     is_busy_polling_ = false;
+    uint64_t next_handler_id_ = 1;
+    std::unordered_map<uint64_t, IoHandler*> handlers_;
+    std::vector<uint64_t> flush_ids_;
+    uint64_t next_timer_seq_ = 0;
+    std::map<std::pair<int64_t, uint64_t>, TimerEvent*> timers_;
+    int64_t  now_ms_ = 0;
+    uint64_t iterations_ = 0;
+};
+
+// the requests of the backend, the low byte of user_data
+enum IoOp : uint8_t {
+    OP_ACCEPT = 1,
+    OP_RECV,
+    OP_SEND,
+    OP_CANCEL,
+    OP_POLL,
+    OP_POLL_REMOVE,
+};
+
+}  // namespace evt_loop
+
+#define EV_Singleton (evt_loop::EventLoop::Instance())
+
+#endif  // _URING_EVENTLOOP_EL_H
@@ -0,0 +1,54 @@
+#ifndef _URING_EVENTLOOP_CONSOLE_H
+#define _URING_EVENTLOOP_CONSOLE_H
+
+// the console of the io_uring backend, reads the commands from stdin when it is a terminal,
+// one per line, with no line editing or history
+#include <vector>
+#include <map>
+#include "../el.h"
+
+namespace evt_loop {
+
+class Console {
+    public:
+    using CommandCallback = std::function<int(const std::vector<string>&)>;
+
+    static void Initialize(const char* prompt, const char* history_file=nullptr);
+    static Console* Instance();
+
+    template <typename... Args> void put_line(Args... args) {
+        std::stringstream ss;
+        (ss << ... << args);
+        cout << ss.str() << endl;
+    }
+    template <typename... Args> void put_line_p(Args... args) {
+        put_line(args...);
+        PutPrompt();
+    }
+    void destory();
+    void registerCommand(const char* name, const char* help, CommandCallback cb);
+
+    private:
+    class StdinEvent : public IOEvent {
+        public:
+        StdinEvent(Console* console) : console_(console) {}
+        protected:
+        void OnEvents(uint32_t events) override { console_->OnInput(); }
+        private:
+        Console* console_;
+    };
+
+    Console() = default;
+    void OnInput();
+    void RunLine(const string& line);
+    void PutPrompt();
+
+    string prompt_;
+    string input_;
+    StdinEvent* stdin_event_ = nullptr;
+    std::map<string, std::pair<string, CommandCallback>> commands_;
+};
+
+}  // namespace evt_loop
+
+#endif  // _URING_EVENTLOOP_CONSOLE_H
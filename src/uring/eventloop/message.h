@@ -0,0 +1 @@
+#include "el.h"
@@ -0,0 +1,210 @@
+#include "io_uring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace evt_loop {
+
+static int io_uring_setup(uint32_t entries, struct io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, void* arg, size_t arg_size)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int io_uring_register(int fd, uint32_t opcode, void* arg, uint32_t n_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, n_args);
+}
+
+IoUring::~IoUring()
+{
+    if (buf_ring_) {
+        munmap(buf_ring_, buf_ring_size_);
+    }
+    if (buffers_) {
+        munmap(buffers_, (size_t)n_buffers_ * buffer_size_);
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (sq_ring_) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+    }
+}
+
+int IoUring::Setup(uint32_t entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // a completion queue larger than the submission one, a multishot request completes many times
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    params.cq_entries = entries * 4;
+    int fd = io_uring_setup(entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        // the kernels before 6.0 have not all of the flags
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        fd = io_uring_setup(entries, &params);
+    }
+    if (fd < 0) {
+        return -errno;
+    }
+    if (! (params.features & IORING_FEAT_SINGLE_MMAP) || ! (params.features & IORING_FEAT_EXT_ARG)) {
+        close(fd);
+        return -ENOSYS;
+    }
+    ring_fd_ = fd;
+
+    // one mapping holds both rings
+    sq_ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+            params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    void* ring = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) {
+        return -errno;
+    }
+    sq_ring_ = ring;
+    cq_ring_ = ring;
+    cq_ring_size_ = sq_ring_size_;
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return -errno;
+    }
+    sqes_ = (struct io_uring_sqe*)sqes;
+
+    char* sq = (char*)sq_ring_;
+    sq_head_ = (uint32_t*)(sq + params.sq_off.head);
+    sq_tail_ = (uint32_t*)(sq + params.sq_off.tail);
+    sq_mask_ = *(uint32_t*)(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_array_ = (uint32_t*)(sq + params.sq_off.array);
+    for (uint32_t i = 0; i < sq_entries_; i++) {
+        sq_array_[i] = i;   // the SQEs are used in ring order
+    }
+
+    char* cq = (char*)cq_ring_;
+    cq_head_ = (uint32_t*)(cq + params.cq_off.head);
+    cq_tail_ = (uint32_t*)(cq + params.cq_off.tail);
+    cq_mask_ = *(uint32_t*)(cq + params.cq_off.ring_mask);
+    cqes_ = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+int IoUring::SetupBufferRing(uint16_t group, uint32_t n_buffers, uint32_t buffer_size)
+{
+    if (n_buffers == 0 || (n_buffers & (n_buffers - 1)) != 0 || n_buffers > 32768) {
+        return -EINVAL;
+    }
+    buf_ring_size_ = n_buffers * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        return -errno;
+    }
+    buf_ring_ = (struct io_uring_buf_ring*)ring;
+    void* buffers = mmap(nullptr, (size_t)n_buffers * buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        return -errno;
+    }
+    buffers_ = (char*)buffers;
+    n_buffers_ = n_buffers;
+    buffer_size_ = buffer_size;
+    buf_ring_mask_ = n_buffers - 1;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)buf_ring_;
+    reg.ring_entries = n_buffers;
+    reg.bgid = group;
+    if (io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -errno;
+    }
+    for (uint32_t bid = 0; bid < n_buffers; bid++) {
+        RecycleBuffer(bid);
+    }
+    return 0;
+}
+
+void IoUring::RecycleBuffer(uint16_t bid)
+{
+    // not buf_ring_->bufs, whose __DECLARE_FLEX_ARRAY is at offset 8 in C++, after an empty struct
+    auto buf = (struct io_uring_buf*)buf_ring_ + (buf_ring_tail_ & buf_ring_mask_);
+    buf->addr = (uint64_t)Buffer(bid);
+    buf->len = buffer_size_;
+    buf->bid = bid;
+    buf_ring_tail_++;
+    __atomic_store_n(&buf_ring_->tail, buf_ring_tail_, __ATOMIC_RELEASE);
+}
+
+struct io_uring_sqe* IoUring::GetSqe()
+{
+    if (sq_pending_ == sq_entries_) {
+        Enter(0, 0);
+    }
+    if (sq_pending_ == sq_entries_) {
+        return nullptr;
+    }
+    uint32_t tail = *sq_tail_ + sq_pending_;
+    auto sqe = &sqes_[tail & sq_mask_];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_pending_++;
+    return sqe;
+}
+
+int IoUring::Enter(uint32_t min_complete, int64_t timeout_ms)
+{
+    // the kernel consumes the SQEs in io_uring_enter, no SQ polling thread
+    uint32_t to_submit = sq_pending_;
+    __atomic_store_n(sq_tail_, *sq_tail_ + to_submit, __ATOMIC_RELEASE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    uint32_t flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)&ts;
+    }
+    enter_calls_++;
+    int n = io_uring_enter(ring_fd_, to_submit, min_complete, flags, &arg, sizeof(arg));
+    int err = n < 0 ? errno : 0;
+
+    // the SQEs not consumed, if any failed to submit, stay pending in order
+    uint32_t head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    sq_pending_ = *sq_tail_ - head;
+    __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+    if (n < 0 && err != ETIME && err != EINTR) {
+        return -err;
+    }
+    // the submission is done before the wait, which timed out or was interrupted
+    return to_submit - sq_pending_;
+}
+
+size_t IoUring::ForEachCqe(const std::function<void (const struct io_uring_cqe*)>& cb)
+{
+    size_t n = 0;
+    uint32_t head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe cqe = cqes_[head & cq_mask_];
+        // release the slot before the callback, which may submit and reap more
+        __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+        cb(&cqe);
+        n++;
+    }
+    return n;
+}
+
+}  // namespace evt_loop
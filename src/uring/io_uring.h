@@ -0,0 +1,75 @@
+#ifndef _URING_IO_URING_H
+#define _URING_IO_URING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <linux/io_uring.h>
+
+namespace evt_loop {
+
+// A minimal io_uring over the raw syscalls, no liburing: the submission and completion
+// rings, and one ring of provided buffers for the multishot receives.
+// The SQEs taken by GetSqe() are submitted together by the next Enter(), so one
+// syscall submits the work of a loop iteration and waits for the next completions.
+class IoUring {
+    public:
+    IoUring() = default;
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // returns 0 or -errno
+    int Setup(uint32_t entries);
+    int SetupBufferRing(uint16_t group, uint32_t n_buffers, uint32_t buffer_size);
+    bool IsReady() const { return ring_fd_ >= 0; }
+
+    // a zeroed SQE, the pending ones are submitted first when the ring is full
+    struct io_uring_sqe* GetSqe();
+
+    // submit the pending SQEs and wait for min_complete CQEs at most timeout_ms,
+    // -1 to wait without timeout. Returns the number submitted, or -errno
+    int Enter(uint32_t min_complete, int64_t timeout_ms);
+
+    // call cb on each completion ready, returns their number
+    size_t ForEachCqe(const std::function<void (const struct io_uring_cqe*)>& cb);
+
+    char* Buffer(uint16_t bid) const { return buffers_ + (size_t)bid * buffer_size_; }
+    void RecycleBuffer(uint16_t bid);
+
+    uint64_t StatsEnterCalls() const { return enter_calls_; }
+
+    private:
+    int         ring_fd_ = -1;
+    void*       sq_ring_ = nullptr;
+    size_t      sq_ring_size_ = 0;
+    void*       cq_ring_ = nullptr;
+    size_t      cq_ring_size_ = 0;
+    struct io_uring_sqe* sqes_ = nullptr;
+    size_t      sqes_size_ = 0;
+
+    uint32_t*   sq_head_ = nullptr;
+    uint32_t*   sq_tail_ = nullptr;
+    uint32_t    sq_mask_ = 0;
+    uint32_t    sq_entries_ = 0;
+    uint32_t*   sq_array_ = nullptr;
+    uint32_t    sq_pending_ = 0;    // taken by GetSqe and not submitted yet
+    uint32_t*   cq_head_ = nullptr;
+    uint32_t*   cq_tail_ = nullptr;
+    uint32_t    cq_mask_ = 0;
+    struct io_uring_cqe* cqes_ = nullptr;
+
+    struct io_uring_buf_ring* buf_ring_ = nullptr;
+    size_t      buf_ring_size_ = 0;
+    uint32_t    buf_ring_mask_ = 0;
+    uint16_t    buf_ring_tail_ = 0;
+    char*       buffers_ = nullptr;
+    uint32_t    n_buffers_ = 0;
+    uint32_t    buffer_size_ = 0;
+
+    uint64_t    enter_calls_ = 0;
+};
+
+}  // namespace evt_loop
+
+#endif  // _URING_IO_URING_H